@@ -1,6 +1,13 @@
 /* (C) 2020 Roman Werpachowski. */
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <Eigen/Cholesky>
 #include <benchmark/benchmark.h>
 #include "ML/Crossvalidation.hpp"
+#include "ML/HyperparameterSearch.hpp"
+#include "ML/LinearRegression.hpp"
+#include "ML/LinearRegressionCrossvalidation.hpp"
 
 
 static void k_fold(benchmark::State& state)
@@ -43,4 +50,161 @@ static void leave_one_out(benchmark::State& state)
 	state.SetComplexityN(state.range(0));
 }
 
-BENCHMARK(leave_one_out)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
\ No newline at end of file
+BENCHMARK(leave_one_out)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
+
+
+/** 10-fold cross-validation of ridge regression, with folds trained on NumberThreads threads. */
+template <unsigned int NumberThreads> static void k_fold_ridge(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const int dim = 50;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(dim, sample_size));
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(dim) + 0.1 * Eigen::VectorXd::Random(sample_size));
+	const int num_folds = 10;
+	const auto train_func = [](const Eigen::Ref<const Eigen::MatrixXd> train_X, const Eigen::Ref<const Eigen::VectorXd> train_y) {
+		return ml::LinearRegression::ridge<true>(train_X, train_y, 0.1);
+	};
+	const auto test_func = [](const ml::LinearRegression::RidgeRegressionResult& model, const Eigen::Ref<const Eigen::MatrixXd> test_X, const Eigen::Ref<const Eigen::VectorXd> test_y) -> double {
+		return (test_y - model.predict(test_X)).squaredNorm() / static_cast<double>(test_y.size());
+	};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(ml::Crossvalidation::k_fold(X, y, train_func, test_func, num_folds, NumberThreads));
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto k_fold_ridge_1_thread = k_fold_ridge<1>;
+constexpr auto k_fold_ridge_4_threads = k_fold_ridge<4>;
+
+BENCHMARK(k_fold_ridge_1_thread)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(k_fold_ridge_4_threads)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+
+/** Accumulates X * X^T and X * y for OLS over a block of data points. */
+struct OLSAccumulator
+{
+	Eigen::MatrixXd XXt;
+	Eigen::VectorXd Xy;
+
+	explicit OLSAccumulator(const Eigen::Index dim)
+		: XXt(Eigen::MatrixXd::Zero(dim, dim)), Xy(Eigen::VectorXd::Zero(dim))
+	{}
+
+	void operator()(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y)
+	{
+		XXt.selfadjointView<Eigen::Lower>().rankUpdate(X);
+		Xy.noalias() += X * y;
+	}
+
+	Eigen::VectorXd solve() const
+	{
+		return XXt.selfadjointView<Eigen::Lower>().ldlt().solve(Xy);
+	}
+};
+
+static double ols_test_error(const Eigen::VectorXd& beta, const Eigen::Ref<const Eigen::MatrixXd> test_X, const Eigen::Ref<const Eigen::VectorXd> test_y)
+{
+	return (test_y - test_X.transpose() * beta).squaredNorm() / static_cast<double>(test_y.size());
+}
+
+/** 10-fold cross-validation of OLS, copying the training data for every fold. */
+static void k_fold_ols_copy(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const int dim = 50;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(dim, sample_size));
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(dim) + 0.1 * Eigen::VectorXd::Random(sample_size));
+	const auto train_func = [](const Eigen::Ref<const Eigen::MatrixXd> train_X, const Eigen::Ref<const Eigen::VectorXd> train_y) {
+		OLSAccumulator accumulator(train_X.rows());
+		accumulator(train_X, train_y);
+		return accumulator.solve();
+	};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(ml::Crossvalidation::k_fold(X, y, train_func, ols_test_error, 10));
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+/** 10-fold cross-validation of OLS, passing the training data as a FoldView. */
+static void k_fold_ols_view(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const int dim = 50;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(dim, sample_size));
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(dim) + 0.1 * Eigen::VectorXd::Random(sample_size));
+	const auto train_func = [](const ml::Crossvalidation::FoldView& train) {
+		OLSAccumulator accumulator(train.dim());
+		train.for_each_block(std::ref(accumulator));
+		return accumulator.solve();
+	};
+	const auto test_func = [](const Eigen::VectorXd& beta, const ml::Crossvalidation::FoldView& test) {
+		double error = 0;
+		test.for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> test_X, const Eigen::Ref<const Eigen::VectorXd> test_y) {
+			error += ols_test_error(beta, test_X, test_y) * static_cast<double>(test_y.size());
+		});
+		return error / static_cast<double>(test.size());
+	};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(ml::Crossvalidation::k_fold_view(X, y, train_func, test_func, 10));
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(k_fold_ols_copy)->RangeMultiplier(10)->Range(1000, 1000000)->Complexity();
+BENCHMARK(k_fold_ols_view)->RangeMultiplier(10)->Range(1000, 1000000)->Complexity();
+
+
+/** 10-fold cross-validation of ridge regression for NumberLambdas regularisation strengths, using fold-wise sufficient statistics. */
+template <int NumberLambdas> static void k_fold_ridge_from_moments(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const int dim = 50;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(dim, sample_size));
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(dim) + 0.1 * Eigen::VectorXd::Random(sample_size));
+	const Eigen::VectorXd lambdas(Eigen::VectorXd::LinSpaced(NumberLambdas, 0.1, 10));
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(ml::LinearRegression::k_fold_ridge<true>(X, y, lambdas, 10));
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto k_fold_ridge_from_moments_1_lambda = k_fold_ridge_from_moments<1>;
+constexpr auto k_fold_ridge_from_moments_20_lambdas = k_fold_ridge_from_moments<20>;
+
+BENCHMARK(k_fold_ridge_from_moments_1_lambda)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(k_fold_ridge_from_moments_20_lambdas)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+
+/** Search over 27 ridge regularisation strengths with 9-fold cross-validation, training on copies of fold data. */
+template <bool UseSuccessiveHalving> static void hyperparameter_search(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const int dim = 20;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(dim, sample_size));
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(dim) + 0.1 * Eigen::VectorXd::Random(sample_size));
+	const auto folds = ml::Crossvalidation::calc_shuffled_folds(static_cast<size_t>(sample_size), 9, 42);
+	std::vector<double> lambdas(27);
+	for (size_t i = 0; i < lambdas.size(); ++i) {
+		lambdas[i] = std::pow(10., -3. + 0.25 * static_cast<double>(i));
+	}
+	const auto train_func = [](const double lambda, const ml::Crossvalidation::FoldView& train) {
+		return ml::LinearRegression::ridge<true>(train.X(), train.y(), lambda);
+	};
+	const auto test_func = [](const ml::LinearRegression::RidgeRegressionResult& model, const ml::Crossvalidation::FoldView& test) {
+		return (test.y() - model.predict(test.X())).squaredNorm() / static_cast<double>(test.size());
+	};
+	for (auto _ : state) {
+		if (UseSuccessiveHalving) {
+			benchmark::DoNotOptimize(ml::HyperparameterSearch::successive_halving(X, y, lambdas, train_func, test_func, folds));
+		} else {
+			benchmark::DoNotOptimize(ml::HyperparameterSearch::grid_search(X, y, lambdas, train_func, test_func, folds));
+		}
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto hyperparameter_grid_search = hyperparameter_search<false>;
+constexpr auto hyperparameter_successive_halving = hyperparameter_search<true>;
+
+BENCHMARK(hyperparameter_grid_search)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(hyperparameter_successive_halving)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
@@ -1,8 +1,13 @@
 /* (C) 2021 Roman Werpachowski. */
 #include <benchmark/benchmark.h>
+#include <algorithm>
+#include <limits>
 #include <random>
 #include "ML/Clustering.hpp"
+#include "ML/Coreset.hpp"
+#include "ML/HierarchicalKMeans.hpp"
 #include "ML/KMeans.hpp"
+#include "ML/MiniBatchKMeans.hpp"
 
 static constexpr double PI = 3.14159265358979323846;
 
@@ -44,4 +49,283 @@ static void km_mousie(benchmark::State& state)
 	state.SetComplexityN(state.range(0));
 }
 
-BENCHMARK(km_mousie)->RangeMultiplier(10)->Range(100, 100000)->Complexity();
\ No newline at end of file
+BENCHMARK(km_mousie)->RangeMultiplier(10)->Range(100, 100000)->Complexity();
+
+/** K-means with 64 clusters in 8 dimensions, using a given assignment algorithm. */
+template <ml::Clustering::KMeansAlgorithm Algorithm> static void km_many_clusters(benchmark::State& state)
+{
+	const unsigned int num_dimensions = 8;
+	const unsigned int num_clusters = 64;
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	std::default_random_engine rng;
+	std::normal_distribution<double> standard_normal;
+	const Eigen::MatrixXd centres(10 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (Eigen::Index i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+
+	// Benchmarked code.
+	for (auto _ : state) {
+		ml::Clustering::KMeans km(num_clusters);
+		km.set_algorithm(Algorithm);
+		km.set_absolute_tolerance(1e-14);
+		km.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+		km.fit(data);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto km_many_clusters_lloyd = km_many_clusters<ml::Clustering::KMeansAlgorithm::LLOYD>;
+constexpr auto km_many_clusters_hamerly = km_many_clusters<ml::Clustering::KMeansAlgorithm::HAMERLY>;
+constexpr auto km_many_clusters_elkan = km_many_clusters<ml::Clustering::KMeansAlgorithm::ELKAN>;
+
+BENCHMARK(km_many_clusters_lloyd)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(km_many_clusters_hamerly)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(km_many_clusters_elkan)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+
+/** K-means with 50 clusters in 2 dimensions, using a given assignment algorithm. */
+template <ml::Clustering::KMeansAlgorithm Algorithm> static void km_low_dimensional(benchmark::State& state)
+{
+	const unsigned int num_dimensions = 2;
+	const unsigned int num_clusters = 50;
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	std::default_random_engine rng;
+	std::normal_distribution<double> standard_normal;
+	const Eigen::MatrixXd centres(10 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (Eigen::Index i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + 0.5 * standard_normal(rng);
+		}
+	}
+
+	// Benchmarked code.
+	for (auto _ : state) {
+		ml::Clustering::KMeans km(num_clusters);
+		km.set_algorithm(Algorithm);
+		km.set_absolute_tolerance(1e-14);
+		km.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+		km.fit(data);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto km_low_dimensional_lloyd = km_low_dimensional<ml::Clustering::KMeansAlgorithm::LLOYD>;
+constexpr auto km_low_dimensional_filtering = km_low_dimensional<ml::Clustering::KMeansAlgorithm::FILTERING>;
+
+BENCHMARK(km_low_dimensional_lloyd)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(km_low_dimensional_filtering)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+
+/** Mini-batch K-means with 64 clusters in 8 dimensions and batches of 1024 points. */
+static void km_many_clusters_mini_batch(benchmark::State& state)
+{
+	const unsigned int num_dimensions = 8;
+	const unsigned int num_clusters = 64;
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	std::default_random_engine rng;
+	std::normal_distribution<double> standard_normal;
+	const Eigen::MatrixXd centres(10 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (Eigen::Index i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+
+	// Benchmarked code.
+	for (auto _ : state) {
+		ml::Clustering::MiniBatchKMeans km(num_clusters);
+		km.set_maximum_steps(100);
+		km.fit(data);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(km_many_clusters_mini_batch)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+
+/** K-means with 64 clusters in 8 dimensions, fitted to a coreset of 4096 points built in chunks of 10000 points. */
+static void km_many_clusters_coreset(benchmark::State& state)
+{
+	const unsigned int num_dimensions = 8;
+	const unsigned int num_clusters = 64;
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	std::default_random_engine rng;
+	std::normal_distribution<double> standard_normal;
+	const Eigen::MatrixXd centres(10 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (Eigen::Index i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+
+	// Benchmarked code.
+	for (auto _ : state) {
+		ml::Clustering::Coreset coreset(num_clusters, 4096);
+		const Eigen::Index chunk_size = 10000;
+		for (Eigen::Index i0 = 0; i0 < sample_size; i0 += chunk_size) {
+			coreset.add(data.middleCols(i0, std::min(chunk_size, sample_size - i0)));
+		}
+		ml::Clustering::KMeans km(num_clusters);
+		km.set_absolute_tolerance(1e-14);
+		km.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+		km.fit(coreset.points(), coreset.weights());
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(km_many_clusters_coreset)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+
+/** Finding the closest of 256 centroids in 32 dimensions by calculating every distance directly. */
+static void closest_centroids_direct(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd data(Eigen::MatrixXd::Random(32, sample_size));
+	const Eigen::MatrixXd centroids(Eigen::MatrixXd::Random(32, 256));
+	std::vector<unsigned int> labels(static_cast<size_t>(sample_size));
+	for (auto _ : state) {
+		for (Eigen::Index i = 0; i < sample_size; ++i) {
+			double min_squared_distance = std::numeric_limits<double>::infinity();
+			for (Eigen::Index k = 0; k < centroids.cols(); ++k) {
+				const double squared_distance = (data.col(i) - centroids.col(k)).squaredNorm();
+				if (squared_distance < min_squared_distance) {
+					min_squared_distance = squared_distance;
+					labels[static_cast<size_t>(i)] = static_cast<unsigned int>(k);
+				}
+			}
+		}
+		benchmark::DoNotOptimize(labels.data());
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+/** Finding the closest of 256 centroids in 32 dimensions using ml::Clustering::find_closest_centroids(). */
+static void closest_centroids_blocked(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd data(Eigen::MatrixXd::Random(32, sample_size));
+	const Eigen::MatrixXd centroids(Eigen::MatrixXd::Random(32, 256));
+	const Eigen::VectorXd data_squared_norms(data.colwise().squaredNorm().transpose());
+	std::vector<unsigned int> labels;
+	Eigen::VectorXd squared_distances(sample_size);
+	for (auto _ : state) {
+		ml::Clustering::find_closest_centroids(data, data_squared_norms, centroids, labels, squared_distances);
+		benchmark::DoNotOptimize(labels.data());
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(closest_centroids_direct)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(closest_centroids_blocked)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+
+/** Choosing 1000 initial centroids in 8 dimensions with a given initialiser. */
+template <class Initialiser> static void init_many_centroids(benchmark::State& state)
+{
+	const unsigned int num_dimensions = 8;
+	const unsigned int num_clusters = 1000;
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	std::default_random_engine rng;
+	std::normal_distribution<double> standard_normal;
+	const Eigen::MatrixXd centres(10 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (Eigen::Index i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+	const Initialiser initialiser;
+	Eigen::MatrixXd centroids(num_dimensions, num_clusters);
+
+	// Benchmarked code.
+	for (auto _ : state) {
+		initialiser.init(data, rng, num_clusters, centroids);
+		benchmark::DoNotOptimize(centroids.data());
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto init_many_centroids_kpp = init_many_centroids<ml::Clustering::KPP>;
+constexpr auto init_many_centroids_scalable_kpp = init_many_centroids<ml::Clustering::ScalableKPP>;
+
+BENCHMARK(init_many_centroids_kpp)->RangeMultiplier(10)->Range(10000, 100000)->Complexity();
+BENCHMARK(init_many_centroids_scalable_kpp)->RangeMultiplier(10)->Range(10000, 100000)->Complexity();
+
+
+/** K-means with 1000 clusters in 8 dimensions, flat or as a tree with branching factor 10. */
+template <bool Hierarchical> static void km_very_many_clusters(benchmark::State& state)
+{
+	const unsigned int num_dimensions = 8;
+	const unsigned int num_clusters = 1000;
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	std::default_random_engine rng;
+	std::normal_distribution<double> standard_normal;
+	const Eigen::MatrixXd centres(10 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (Eigen::Index i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+
+	// Benchmarked code.
+	for (auto _ : state) {
+		if (Hierarchical) {
+			ml::Clustering::HierarchicalKMeans km(num_clusters, 10);
+			km.set_absolute_tolerance(1e-14);
+			km.fit(data);
+		} else {
+			ml::Clustering::KMeans km(num_clusters);
+			km.set_absolute_tolerance(1e-14);
+			km.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+			km.fit(data);
+		}
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto km_very_many_clusters_flat = km_very_many_clusters<false>;
+constexpr auto km_very_many_clusters_hierarchical = km_very_many_clusters<true>;
+
+BENCHMARK(km_very_many_clusters_flat)->RangeMultiplier(10)->Range(10000, 100000)->Complexity();
+BENCHMARK(km_very_many_clusters_hierarchical)->RangeMultiplier(10)->Range(10000, 100000)->Complexity();
+
+
+/** Assigning 10000 points in 32 dimensions to one of K clusters, with a flat model or a tree with branching factor 8. */
+template <bool Hierarchical> static void assign_label_many_clusters(benchmark::State& state)
+{
+	const unsigned int num_dimensions = 32;
+	const auto num_clusters = static_cast<unsigned int>(state.range(0));
+	const Eigen::MatrixXd data(Eigen::MatrixXd::Random(num_dimensions, 4 * num_clusters));
+	const Eigen::MatrixXd queries(Eigen::MatrixXd::Random(num_dimensions, 10000));
+	ml::Clustering::KMeans flat(num_clusters);
+	ml::Clustering::HierarchicalKMeans hierarchical(num_clusters, 8);
+	flat.set_maximum_steps(2);
+	hierarchical.set_maximum_steps(2);
+	if (Hierarchical) {
+		hierarchical.fit(data);
+	} else {
+		flat.fit(data);
+	}
+
+	// Benchmarked code.
+	for (auto _ : state) {
+		for (Eigen::Index i = 0; i < queries.cols(); ++i) {
+			benchmark::DoNotOptimize(Hierarchical ? hierarchical.assign_label(queries.col(i)) : flat.assign_label(queries.col(i)));
+		}
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto assign_label_many_clusters_flat = assign_label_many_clusters<false>;
+constexpr auto assign_label_many_clusters_hierarchical = assign_label_many_clusters<true>;
+
+BENCHMARK(assign_label_many_clusters_flat)->RangeMultiplier(8)->Range(64, 4096)->Complexity();
+BENCHMARK(assign_label_many_clusters_hierarchical)->RangeMultiplier(8)->Range(64, 4096)->Complexity();
@@ -1,8 +1,17 @@
 /* (C) 2020 Roman Werpachowski. */
 #include <random>
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
 #include <benchmark/benchmark.h>
+#include "ML/ConjugateGradientRidge.hpp"
 #include "ML/LinearRegression.hpp"
+#include "ML/MixedPrecisionOLS.hpp"
 #include "ML/RecursiveMultivariateOLS.hpp"
+#include "ML/RecursiveOLSBank.hpp"
+#include "ML/SketchedOLS.hpp"
+#include "ML/SlidingWindowMultivariateOLS.hpp"
+#include "ML/StepwiseSelection.hpp"
 
 
 static void univariate_linear_regression(benchmark::State& state)
@@ -46,6 +55,52 @@ static void univariate_linear_regression_without_intercept(benchmark::State& sta
 BENCHMARK(univariate_linear_regression_without_intercept)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
 
 
+static void univariate_linear_regression_many_series(benchmark::State& state)
+{
+	constexpr Eigen::Index sample_size = 100;
+	const auto num_series = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(sample_size, num_series));
+	const Eigen::MatrixXd Y(0.1 * X.array().sin() + X.array());
+	for (auto _ : state) {
+		for (Eigen::Index i = 0; i < num_series; ++i) {
+			ml::LinearRegression::univariate(X.col(i), Y.col(i));
+		}
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(univariate_linear_regression_many_series)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
+
+
+static void univariate_linear_regression_batch(benchmark::State& state)
+{
+	constexpr Eigen::Index sample_size = 100;
+	const auto num_series = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(sample_size, num_series));
+	const Eigen::MatrixXd Y(0.1 * X.array().sin() + X.array());
+	for (auto _ : state) {
+		ml::LinearRegression::univariate_batch(X, Y);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(univariate_linear_regression_batch)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
+
+
+static void univariate_linear_regression_regular_batch(benchmark::State& state)
+{
+	constexpr Eigen::Index sample_size = 100;
+	const auto num_series = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd Y(Eigen::MatrixXd::Random(sample_size, num_series));
+	for (auto _ : state) {
+		ml::LinearRegression::univariate_batch(0.05, 0.1, Y);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(univariate_linear_regression_regular_batch)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
+
+
 template <unsigned int D> static void multivariate_linear_regression(benchmark::State& state)
 {
 	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
@@ -70,6 +125,87 @@ BENCHMARK(multivariate_linear_regression_5d)->RangeMultiplier(10)->Range(10, 100
 BENCHMARK(multivariate_linear_regression_10d)->RangeMultiplier(10)->Range(100, 10000)->Complexity();
 BENCHMARK(multivariate_linear_regression_50d)->RangeMultiplier(10)->Range(100, 10000)->Complexity();
 
+template <unsigned int D> static void multivariate_linear_regression_exact_tall(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	const Eigen::VectorXd beta(Eigen::VectorXd::Random(D));
+	const Eigen::VectorXd y(X.transpose() * beta + 0.02 * Eigen::VectorXd::Random(sample_size));
+	for (auto _ : state) {
+		ml::LinearRegression::multivariate(X, y);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+/** Without refinement (MaxIterations == 0) or refined to full precision. */
+template <unsigned int MaxIterations, unsigned int D> static void multivariate_linear_regression_sketched(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	const Eigen::VectorXd beta(Eigen::VectorXd::Random(D));
+	const Eigen::VectorXd y(X.transpose() * beta + 0.02 * Eigen::VectorXd::Random(sample_size));
+	for (auto _ : state) {
+		ml::LinearRegression::multivariate_sketched(X, y, 0, 1e-12, MaxIterations);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto multivariate_linear_regression_exact_tall_100d = multivariate_linear_regression_exact_tall<100>;
+constexpr auto multivariate_linear_regression_sketched_100d = multivariate_linear_regression_sketched<0, 100>;
+constexpr auto multivariate_linear_regression_sketched_refined_100d = multivariate_linear_regression_sketched<20, 100>;
+
+BENCHMARK(multivariate_linear_regression_exact_tall_100d)->RangeMultiplier(10)->Range(10000, 1000000)->Complexity();
+BENCHMARK(multivariate_linear_regression_sketched_100d)->RangeMultiplier(10)->Range(10000, 1000000)->Complexity();
+BENCHMARK(multivariate_linear_regression_sketched_refined_100d)->RangeMultiplier(10)->Range(10000, 1000000)->Complexity();
+
+/** Reports the relative error of beta with respect to multivariate() in the "relative_error" counter. */
+template <bool MixedPrecision, unsigned int D> static void multivariate_linear_regression_precision(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	const Eigen::VectorXd beta(Eigen::VectorXd::Random(D));
+	const Eigen::VectorXd y(X.transpose() * beta + 0.02 * Eigen::VectorXd::Random(sample_size));
+	const Eigen::VectorXd exact_beta(ml::LinearRegression::multivariate(X, y).beta);
+	Eigen::VectorXd fitted_beta;
+	for (auto _ : state) {
+		if (MixedPrecision) {
+			fitted_beta = ml::LinearRegression::multivariate_mixed_precision(X, y).beta;
+		} else {
+			fitted_beta = ml::LinearRegression::multivariate(X, y).beta;
+		}
+	}
+	state.counters["relative_error"] = (fitted_beta - exact_beta).norm() / exact_beta.norm();
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto multivariate_linear_regression_double_precision_200d = multivariate_linear_regression_precision<false, 200>;
+constexpr auto multivariate_linear_regression_mixed_precision_200d = multivariate_linear_regression_precision<true, 200>;
+
+BENCHMARK(multivariate_linear_regression_double_precision_200d)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(multivariate_linear_regression_mixed_precision_200d)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+template <bool ImplicitIntercept, unsigned int D> static void multivariate_linear_regression_with_intercept(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	const Eigen::VectorXd beta(Eigen::VectorXd::Random(D));
+	const Eigen::VectorXd y(X.transpose() * beta + 0.02 * Eigen::VectorXd::Random(sample_size));
+	for (auto _ : state) {
+		if (ImplicitIntercept) {
+			ml::LinearRegression::multivariate_with_intercept(X, y);
+		} else {
+			ml::LinearRegression::multivariate(ml::LinearRegression::add_ones(X), y);
+		}
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto multivariate_linear_regression_add_ones_10d = multivariate_linear_regression_with_intercept<false, 10>;
+constexpr auto multivariate_linear_regression_implicit_intercept_10d = multivariate_linear_regression_with_intercept<true, 10>;
+
+BENCHMARK(multivariate_linear_regression_add_ones_10d)->RangeMultiplier(10)->Range(100, 100000)->Complexity();
+BENCHMARK(multivariate_linear_regression_implicit_intercept_10d)->RangeMultiplier(10)->Range(100, 100000)->Complexity();
+
 
 template <unsigned int D> static void recursive_multivariate_linear_regression_constant_sample_size(benchmark::State& state)
 {
@@ -125,6 +261,116 @@ BENCHMARK(recursive_multivariate_linear_regression_random_sample_size_5d)->Range
 BENCHMARK(recursive_multivariate_linear_regression_random_sample_size_500d)->RangeMultiplier(2)->Range(1, 32)->Complexity();
 
 
+/** One data point per model per update. Range is the number of models. */
+template <unsigned int D> static void recursive_multivariate_linear_regression_many_models(benchmark::State& state)
+{
+	const auto number_models = static_cast<unsigned int>(state.range(0));
+	std::vector<ml::LinearRegression::RecursiveMultivariateOLS> models;
+	for (unsigned int m = 0; m < number_models; ++m) {
+		models.emplace_back(Eigen::MatrixXd::Random(D, 2 * D), Eigen::VectorXd::Random(2 * D));
+	}
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, number_models));
+	const Eigen::VectorXd y(Eigen::VectorXd::Random(number_models));
+	for (auto _ : state) {
+		for (unsigned int m = 0; m < number_models; ++m) {
+			models[m].update(X.col(m), y.segment(m, 1));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * number_models);
+	state.SetComplexityN(state.range(0));
+}
+
+template <unsigned int NumberThreads, int D> static void recursive_ols_bank(benchmark::State& state)
+{
+	const auto number_models = static_cast<unsigned int>(state.range(0));
+	ml::LinearRegression::RecursiveOLSBank<D> bank(number_models);
+	for (unsigned int m = 0; m < number_models; ++m) {
+		bank.initialise(m, Eigen::MatrixXd::Random(D, 2 * D), Eigen::VectorXd::Random(2 * D));
+	}
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, number_models));
+	const Eigen::VectorXd y(Eigen::VectorXd::Random(number_models));
+	for (auto _ : state) {
+		bank.update(X, y, NumberThreads);
+	}
+	state.SetItemsProcessed(state.iterations() * number_models);
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto recursive_multivariate_linear_regression_many_models_5d = recursive_multivariate_linear_regression_many_models<5>;
+constexpr auto recursive_ols_bank_1_thread_5d = recursive_ols_bank<1, 5>;
+constexpr auto recursive_ols_bank_4_threads_5d = recursive_ols_bank<4, 5>;
+
+BENCHMARK(recursive_multivariate_linear_regression_many_models_5d)->RangeMultiplier(10)->Range(100, 100000)->Complexity();
+BENCHMARK(recursive_ols_bank_1_thread_5d)->RangeMultiplier(10)->Range(100, 100000)->Complexity();
+BENCHMARK(recursive_ols_bank_4_threads_5d)->RangeMultiplier(10)->Range(100, 100000)->Complexity();
+
+template <unsigned int D> static void sliding_window_multivariate_linear_regression(benchmark::State& state)
+{
+	const auto window_size = static_cast<unsigned int>(state.range(0));
+	const Eigen::VectorXd beta(Eigen::VectorXd::Random(D));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, 2 * window_size));
+	const Eigen::VectorXd y(X.transpose() * beta + 0.02 * Eigen::VectorXd::Random(2 * window_size));
+	ml::LinearRegression::SlidingWindowMultivariateOLS swols(window_size);
+	swols.update(X.leftCols(window_size), y.head(window_size));
+	Eigen::Index i = window_size;
+	for (auto _ : state) {
+		swols.update(X.col(i), y.segment(i, 1));
+		i = (i + 1) % X.cols();
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto sliding_window_multivariate_linear_regression_5d = sliding_window_multivariate_linear_regression<5>;
+constexpr auto sliding_window_multivariate_linear_regression_50d = sliding_window_multivariate_linear_regression<50>;
+
+BENCHMARK(sliding_window_multivariate_linear_regression_5d)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
+BENCHMARK(sliding_window_multivariate_linear_regression_50d)->RangeMultiplier(10)->Range(100, 10000)->Complexity();
+
+
+template <unsigned int NumberThreads, unsigned int D> static void forward_stepwise_selection(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	Eigen::VectorXd beta(Eigen::VectorXd::Zero(D));
+	beta.head(D / 10).setRandom();
+	const Eigen::VectorXd y(X.transpose() * beta + 0.02 * Eigen::VectorXd::Random(sample_size));
+	for (auto _ : state) {
+		ml::LinearRegression::forward_stepwise(X, y, ml::LinearRegression::StepwiseCriterion::BIC, 0, std::vector<unsigned int>(), NumberThreads);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto forward_stepwise_selection_1_thread_200d = forward_stepwise_selection<1, 200>;
+constexpr auto forward_stepwise_selection_4_threads_200d = forward_stepwise_selection<4, 200>;
+
+BENCHMARK(forward_stepwise_selection_1_thread_200d)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+BENCHMARK(forward_stepwise_selection_4_threads_200d)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
+template <bool MultiTarget, unsigned int D> static void ridge_regression_many_targets(benchmark::State& state)
+{
+	constexpr Eigen::Index sample_size = 1000;
+	constexpr double lambda = 1e-2;
+	const auto num_targets = static_cast<Eigen::Index>(state.range(0));
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	const Eigen::MatrixXd Y(X.transpose() * Eigen::MatrixXd::Random(D, num_targets) + 0.02 * Eigen::MatrixXd::Random(sample_size, num_targets));
+	for (auto _ : state) {
+		if (MultiTarget) {
+			ml::LinearRegression::ridge_multi_target<true>(X, Y, lambda);
+		} else {
+			for (Eigen::Index i = 0; i < num_targets; ++i) {
+				ml::LinearRegression::ridge<true>(X, Y.col(i), lambda);
+			}
+		}
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto ridge_regression_many_targets_loop_20d = ridge_regression_many_targets<false, 20>;
+constexpr auto ridge_regression_many_targets_multi_target_20d = ridge_regression_many_targets<true, 20>;
+
+BENCHMARK(ridge_regression_many_targets_loop_20d)->RangeMultiplier(10)->Range(1, 1000)->Complexity();
+BENCHMARK(ridge_regression_many_targets_multi_target_20d)->RangeMultiplier(10)->Range(1, 1000)->Complexity();
+
 template <bool DoStandardise, unsigned int D> static void ridge_regression(benchmark::State& state)
 {
 	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
@@ -151,6 +397,45 @@ BENCHMARK(ridge_regression_no_standardise_4d)->RangeMultiplier(4)->Range(8, 1638
 BENCHMARK(ridge_regression_no_standardise_12d)->RangeMultiplier(4)->Range(16, 16384)->Complexity();
 BENCHMARK(ridge_regression_no_standardise_36d)->RangeMultiplier(4)->Range(64, 16384)->Complexity();
 
+/** Returns the peak resident set size of the process in bytes, or 0 if it is not available on this platform. */
+static double peak_resident_set_size()
+{
+#ifdef __unix__
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	// Linux reports kilobytes.
+	return 1024. * static_cast<double>(usage.ru_maxrss);
+#else
+	return 0;
+#endif
+}
+
+/** Tracks peak memory of ridge regression as the sample size grows. The peak is a process-wide high-water mark,
+so run this benchmark on its own (using --benchmark_filter) for meaningful "peak_memory" values. */
+template <bool DoStandardise, unsigned int D> static void ridge_regression_peak_memory(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	constexpr double lambda = 1e-2;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	if (!DoStandardise) {
+		ml::LinearRegression::standardise(X);
+	}
+	const Eigen::VectorXd beta(Eigen::VectorXd::Random(D));
+	const Eigen::VectorXd y(X.transpose() * beta + 0.02 * Eigen::VectorXd::Random(sample_size) + Eigen::VectorXd::Constant(sample_size, 0.16));
+	for (auto _ : state) {
+		ml::LinearRegression::ridge<DoStandardise>(X, y, lambda);
+	}
+	state.counters["peak_memory"] = benchmark::Counter(peak_resident_set_size(), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+	state.counters["data_memory"] = benchmark::Counter(static_cast<double>(sizeof(double) * (D + 1) * sample_size), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto ridge_regression_peak_memory_no_standardise_12d = ridge_regression_peak_memory<false, 12>;
+constexpr auto ridge_regression_peak_memory_do_standardise_12d = ridge_regression_peak_memory<true, 12>;
+
+BENCHMARK(ridge_regression_peak_memory_no_standardise_12d)->RangeMultiplier(10)->Range(1000, 1000000)->Complexity();
+BENCHMARK(ridge_regression_peak_memory_do_standardise_12d)->RangeMultiplier(10)->Range(1000, 1000000)->Complexity();
+
 
 constexpr auto ridge_regression_do_standardise_4d = ridge_regression<true, 4>;
 constexpr auto ridge_regression_do_standardise_12d = ridge_regression<true, 12>;
@@ -161,6 +446,74 @@ BENCHMARK(ridge_regression_do_standardise_12d)->RangeMultiplier(4)->Range(16, 16
 BENCHMARK(ridge_regression_do_standardise_36d)->RangeMultiplier(4)->Range(64, 16384)->Complexity();
 
 
+/** More features than data points: ridge() uses the dual form. */
+template <bool DoStandardise, unsigned int D> static void ridge_regression_wide(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	constexpr double lambda = 1e-2;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	if (!DoStandardise) {
+		ml::LinearRegression::standardise(X);
+	}
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(D) + 0.02 * Eigen::VectorXd::Random(sample_size));
+	for (auto _ : state) {
+		ml::LinearRegression::ridge<DoStandardise>(X, y, lambda);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto ridge_regression_wide_no_standardise_10000d = ridge_regression_wide<false, 10000>;
+constexpr auto ridge_regression_wide_do_standardise_10000d = ridge_regression_wide<true, 10000>;
+
+BENCHMARK(ridge_regression_wide_no_standardise_10000d)->RangeMultiplier(4)->Range(16, 1024)->Complexity();
+BENCHMARK(ridge_regression_wide_do_standardise_10000d)->RangeMultiplier(4)->Range(16, 1024)->Complexity();
+
+template <unsigned int D> static void ridge_regression_conjugate_gradient_dense(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	constexpr double lambda = 1e-2;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(D, sample_size));
+	ml::LinearRegression::standardise(X);
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(D) + 0.02 * Eigen::VectorXd::Random(sample_size));
+	for (auto _ : state) {
+		ml::LinearRegression::ridge_conjugate_gradient(X, y, lambda, 1e-8);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto ridge_regression_conjugate_gradient_dense_36d = ridge_regression_conjugate_gradient_dense<36>;
+
+BENCHMARK(ridge_regression_conjugate_gradient_dense_36d)->RangeMultiplier(4)->Range(64, 16384)->Complexity();
+
+/** Hashed features: every data point has a few nonzero values among D features. */
+template <unsigned int D> static void ridge_regression_conjugate_gradient_sparse(benchmark::State& state)
+{
+	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
+	constexpr unsigned int nonzeros_per_point = 10;
+	constexpr double lambda = 1;
+	std::default_random_engine rng(34234);
+	std::uniform_int_distribution<unsigned int> feature_dist(0, D - 1);
+	std::uniform_real_distribution<double> value_dist(-1, 1);
+	std::vector<Eigen::Triplet<double>> triplets;
+	triplets.reserve(sample_size * nonzeros_per_point);
+	for (Eigen::Index i = 0; i < sample_size; ++i) {
+		for (unsigned int k = 0; k < nonzeros_per_point; ++k) {
+			triplets.emplace_back(feature_dist(rng), static_cast<int>(i), value_dist(rng));
+		}
+	}
+	Eigen::SparseMatrix<double> X(D, sample_size);
+	X.setFromTriplets(triplets.begin(), triplets.end());
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(D) + 0.02 * Eigen::VectorXd::Random(sample_size));
+	for (auto _ : state) {
+		ml::LinearRegression::ridge_conjugate_gradient(X, y, lambda, 1e-6);
+	}
+	state.SetComplexityN(state.range(0));
+}
+
+constexpr auto ridge_regression_conjugate_gradient_sparse_1000000d = ridge_regression_conjugate_gradient_sparse<1000000>;
+
+BENCHMARK(ridge_regression_conjugate_gradient_sparse_1000000d)->RangeMultiplier(10)->Range(1000, 100000)->Complexity();
+
 template <bool DoStandardise, unsigned int D> static void lasso_regression(benchmark::State& state)
 {
 	const auto sample_size = static_cast<Eigen::Index>(state.range(0));
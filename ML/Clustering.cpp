@@ -1,7 +1,12 @@
 /* (C) 2020 Roman Werpachowski. */
+#include <algorithm>
 #include <cassert>
+#include <limits>
 #include <numeric>
+#include <stdexcept>
 #include "Clustering.hpp"
+#include "Parallel.hpp"
+#include "RandomStreams.hpp"
 
 namespace ml
 {
@@ -10,9 +15,107 @@ namespace ml
 		Model::~Model()
 		{}
 
+		/// Number of data points and number of centroids in a tile of distances calculated at once.
+		static constexpr Eigen::Index distance_tile_size = 256;
+
+		void find_closest_centroids(const Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> data_squared_norms, const Eigen::Ref<const Eigen::MatrixXd> centroids, std::vector<unsigned int>& labels, Eigen::Ref<Eigen::VectorXd> squared_distances, const unsigned int number_threads)
+		{
+			const auto sample_size = data.cols();
+			const auto number_centroids = centroids.cols();
+			if (!number_centroids) {
+				throw std::invalid_argument("At least one centroid required");
+			}
+			if (centroids.rows() != data.rows() || data_squared_norms.size() != sample_size || squared_distances.size() != sample_size) {
+				throw std::invalid_argument("Dimension mismatch");
+			}
+			labels.resize(static_cast<size_t>(sample_size));
+			const Eigen::VectorXd centroid_squared_norms(centroids.colwise().squaredNorm().transpose());
+			const double max_centroid_squared_norm = centroid_squared_norms.maxCoeff();
+			// Bound on the rounding error of |x|^2 - 2 x^T c + |c|^2, with a safety factor.
+			const double relative_error_bound = 8 * static_cast<double>(data.rows() + 4) * std::numeric_limits<double>::epsilon();
+			// Tiles of data points are independent, so the results do not depend on how they are split between threads.
+			const auto number_point_tiles = static_cast<size_t>((sample_size + distance_tile_size - 1) / distance_tile_size);
+			Parallel::for_each_chunk(number_point_tiles, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				Eigen::MatrixXd distances;
+				Eigen::VectorXd error_bounds;
+				Eigen::Array<bool, Eigen::Dynamic, 1> is_ambiguous;
+				for (auto tile = begin; tile < end; ++tile) {
+					const auto i0 = static_cast<Eigen::Index>(tile) * distance_tile_size;
+					const auto number_points = std::min(distance_tile_size, sample_size - i0);
+					// The minima are tracked without adding |x|^2, which is the same for all centroids.
+					auto min_distances = squared_distances.segment(i0, number_points);
+					min_distances.setConstant(std::numeric_limits<double>::infinity());
+					error_bounds = 2 * relative_error_bound * (data_squared_norms.segment(i0, number_points).array() + max_centroid_squared_norm);
+					is_ambiguous.setConstant(number_points, false);
+					for (Eigen::Index k0 = 0; k0 < number_centroids; k0 += distance_tile_size) {
+						const auto tile_number_centroids = std::min(distance_tile_size, number_centroids - k0);
+						distances.noalias() = -2 * centroids.middleCols(k0, tile_number_centroids).transpose() * data.middleCols(i0, number_points);
+						distances.colwise() += centroid_squared_norms.segment(k0, tile_number_centroids);
+						for (Eigen::Index j = 0; j < number_points; ++j) {
+							auto column = distances.col(j);
+							const double tile_min_distance = column.minCoeff();
+							// Values within error_bounds[j] of the minimum cannot be ordered reliably.
+							if (tile_min_distance < min_distances[j]) {
+								const auto k = std::find(column.data(), column.data() + tile_number_centroids, tile_min_distance) - column.data();
+								labels[static_cast<size_t>(i0 + j)] = static_cast<unsigned int>(k0 + k);
+								// All values in previous tiles are >= the previous minimum.
+								is_ambiguous[j] = min_distances[j] <= tile_min_distance + error_bounds[j];
+								if (!is_ambiguous[j] && tile_number_centroids > 1) {
+									column[k] = std::numeric_limits<double>::infinity();
+									is_ambiguous[j] = column.minCoeff() <= tile_min_distance + error_bounds[j];
+								}
+								min_distances[j] = tile_min_distance;
+							} else if (tile_min_distance <= min_distances[j] + error_bounds[j]) {
+								is_ambiguous[j] = true;
+							}
+						}
+					}
+					for (Eigen::Index j = 0; j < number_points; ++j) {
+						const auto i = static_cast<size_t>(i0 + j);
+						const Eigen::Ref<const Eigen::VectorXd> x(data.col(i0 + j));
+						if (is_ambiguous[j]) {
+							double min_squared_distance = std::numeric_limits<double>::infinity();
+							for (Eigen::Index k = 0; k < number_centroids; ++k) {
+								const double squared_distance = (x - centroids.col(k)).squaredNorm();
+								if (squared_distance < min_squared_distance) {
+									min_squared_distance = squared_distance;
+									labels[i] = static_cast<unsigned int>(k);
+								}
+							}
+							min_distances[j] = min_squared_distance;
+						} else {
+							min_distances[j] = (x - centroids.col(labels[i])).squaredNorm();
+						}
+					}
+				}
+			});
+		}
+
+		void find_closest_centroids(const Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::MatrixXd> centroids, std::vector<unsigned int>& labels, Eigen::Ref<Eigen::VectorXd> squared_distances, const unsigned int number_threads)
+		{
+			const Eigen::VectorXd data_squared_norms(data.colwise().squaredNorm().transpose());
+			find_closest_centroids(data, data_squared_norms, centroids, labels, squared_distances, number_threads);
+		}
+
+		std::vector<std::default_random_engine> make_initialisation_prngs(std::default_random_engine& prng, const unsigned int number_initialisations)
+		{
+			std::vector<std::default_random_engine> prngs(number_initialisations, prng);
+			const uint64_t seed = prng();
+			for (unsigned int i = 1; i < number_initialisations; ++i) {
+				RandomStreams::Stream stream(seed, i);
+				prngs[i].seed(static_cast<std::default_random_engine::result_type>(stream()));
+			}
+			return prngs;
+		}
+
 		CentroidsInitialiser::~CentroidsInitialiser()
 		{}
 
+		void CentroidsInitialiser::weighted_init(const Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd>, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const
+		{
+			init(data, prng, number_components, centroids);
+		}
+
 		void Forgy::init(Eigen::Ref<const Eigen::MatrixXd> data, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const
 		{
 			std::vector<Eigen::Index> all_indices(data.cols());
@@ -36,28 +139,166 @@ namespace ml
 			assert(std::accumulate(counters.begin(), counters.end(), 0) == data.cols());
 		}
 
-		void KPP::init(Eigen::Ref<const Eigen::MatrixXd> data, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const
+		/// Lowers the squared distances from data points to their closest centroids to the squared distances to a new centroid, where these are smaller.
+		static void update_min_squared_distances(const Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> centroid, Eigen::Ref<Eigen::VectorXd> min_squared_distances, const unsigned int number_threads)
 		{
-			std::vector<double> weights(data.cols());
-			for (unsigned int n = 0; n < number_components; ++n) {
-				if (n) {
-					for (Eigen::Index i = 0; i < data.cols(); ++i) {
-						double min_distance_squared = std::numeric_limits<double>::infinity();
-						for (unsigned int k = 0; k < n; ++k) {
-							const double distance_squared = (data.col(i) - centroids.col(k)).squaredNorm();
-							min_distance_squared = std::min(min_distance_squared, distance_squared);
-						}
-						weights[i] = min_distance_squared;
+			Parallel::for_each_chunk(static_cast<size_t>(data.cols()), number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto i = static_cast<Eigen::Index>(begin); i < static_cast<Eigen::Index>(end); ++i) {
+					min_squared_distances[i] = std::min(min_squared_distances[i], (data.col(i) - centroid).squaredNorm());
+				}
+			});
+		}
+
+		/// Draws an index with probability proportional to its (non-negative) weight, or uniformly if all weights are zero.
+		static Eigen::Index sample_index(const Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng)
+		{
+			const double total = weights.sum();
+			if (!(total > 0)) {
+				return std::uniform_int_distribution<Eigen::Index>(0, weights.size() - 1)(prng);
+			}
+			const double u = std::uniform_real_distribution<double>(0, total)(prng);
+			double cumulative_weight = 0;
+			Eigen::Index last_positive = 0;
+			for (Eigen::Index i = 0; i < weights.size(); ++i) {
+				if (weights[i] > 0) {
+					cumulative_weight += weights[i];
+					if (u < cumulative_weight) {
+						return i;
 					}
+					last_positive = i;
+				}
+			}
+			// Summed in a different order than the total, so rounding errors can leave u above the cumulative sum.
+			return last_positive;
+		}
+
+		/** Chooses centroids among data points with the K++ algorithm. Points are drawn with probabilities proportional to the squared distances to the closest
+		centroids chosen so far, multiplied by the weights of the points (unless `weights` is empty).
+		*/
+		static void weighted_kpp(const Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids, const unsigned int number_threads)
+		{
+			const bool weighted = weights.size() > 0;
+			Eigen::VectorXd min_squared_distances(Eigen::VectorXd::Constant(data.cols(), std::numeric_limits<double>::infinity()));
+			Eigen::VectorXd probabilities;
+			for (unsigned int n = 0; n < number_components; ++n) {
+				Eigen::Index new_mean_idx;
+				if (!n) {
+					new_mean_idx = weighted ? sample_index(weights, prng) : std::uniform_int_distribution<Eigen::Index>(0, data.cols() - 1)(prng);
+				} else if (weighted) {
+					probabilities = weights.cwiseProduct(min_squared_distances);
+					new_mean_idx = sample_index(probabilities, prng);
 				} else {
-					std::fill(weights.begin(), weights.end(), 1);
+					new_mean_idx = sample_index(min_squared_distances, prng);
 				}
-				std::discrete_distribution<Eigen::Index> dist(weights.begin(), weights.end());
-				const auto new_mean_idx = dist(prng);
 				centroids.col(n) = data.col(new_mean_idx);
+				if (n + 1 < number_components) {
+					update_min_squared_distances(data, centroids.col(n), min_squared_distances, number_threads);
+				}
 			}
 		}
 
+		KPP::KPP(const unsigned int number_threads)
+			: number_threads_(number_threads)
+		{}
+
+		void KPP::init(Eigen::Ref<const Eigen::MatrixXd> data, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const
+		{
+			weighted_kpp(data, Eigen::VectorXd(), prng, number_components, centroids, number_threads_);
+		}
+
+		void KPP::weighted_init(Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const
+		{
+			weighted_kpp(data, weights, prng, number_components, centroids, number_threads_);
+		}
+
+		ScalableKPP::ScalableKPP(const double oversampling_factor, const unsigned int number_rounds, const unsigned int number_threads)
+			: oversampling_factor_(oversampling_factor), number_rounds_(number_rounds), number_threads_(number_threads)
+		{
+			if (!(oversampling_factor > 0)) {
+				throw std::domain_error("Oversampling factor must be positive");
+			}
+			if (!number_rounds) {
+				throw std::invalid_argument("At least one round required");
+			}
+		}
+
+		/// Implements ScalableKPP, with weights of data points unless `weights` is empty.
+		static void scalable_kpp(const Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids, const double oversampling_factor, const unsigned int number_rounds, const unsigned int number_threads)
+		{
+			const bool weighted = weights.size() > 0;
+			const auto sample_size = data.cols();
+			const Eigen::VectorXd data_squared_norms(data.colwise().squaredNorm().transpose());
+			const auto first_index = weighted ? sample_index(weights, prng) : std::uniform_int_distribution<Eigen::Index>(0, sample_size - 1)(prng);
+			std::vector<Eigen::Index> candidate_indices(1, first_index);
+			// Index of the closest candidate to every data point and the squared distance to it.
+			std::vector<unsigned int> closest_candidates(static_cast<size_t>(sample_size), 0);
+			Eigen::VectorXd min_squared_distances(Eigen::VectorXd::Constant(sample_size, std::numeric_limits<double>::infinity()));
+			update_min_squared_distances(data, data.col(candidate_indices[0]), min_squared_distances, number_threads);
+			Eigen::MatrixXd new_candidates;
+			std::vector<unsigned int> labels;
+			Eigen::VectorXd squared_distances(sample_size);
+			Eigen::VectorXd probabilities;
+			// Finds the distances to candidates added since `number_old_candidates`, all at once.
+			const auto add_candidates = [&](const size_t number_old_candidates) {
+				const auto number_new_candidates = static_cast<Eigen::Index>(candidate_indices.size() - number_old_candidates);
+				new_candidates.resize(data.rows(), number_new_candidates);
+				for (Eigen::Index j = 0; j < number_new_candidates; ++j) {
+					new_candidates.col(j) = data.col(candidate_indices[number_old_candidates + static_cast<size_t>(j)]);
+				}
+				find_closest_centroids(data, data_squared_norms, new_candidates, labels, squared_distances, number_threads);
+				for (Eigen::Index i = 0; i < sample_size; ++i) {
+					if (squared_distances[i] < min_squared_distances[i]) {
+						min_squared_distances[i] = squared_distances[i];
+						closest_candidates[static_cast<size_t>(i)] = static_cast<unsigned int>(number_old_candidates) + labels[static_cast<size_t>(i)];
+					}
+				}
+				probabilities = weighted ? weights.cwiseProduct(min_squared_distances) : min_squared_distances;
+			};
+			probabilities = weighted ? weights.cwiseProduct(min_squared_distances) : min_squared_distances;
+			const double expected_number_sampled = oversampling_factor * number_components;
+			std::uniform_real_distribution<double> u01(0, 1);
+			for (unsigned int round = 0; round < number_rounds; ++round) {
+				const double total = probabilities.sum();
+				if (!(total > 0)) {
+					break;
+				}
+				const auto number_old_candidates = candidate_indices.size();
+				for (Eigen::Index i = 0; i < sample_size; ++i) {
+					if (u01(prng) * total < expected_number_sampled * probabilities[i]) {
+						candidate_indices.push_back(i);
+					}
+				}
+				if (candidate_indices.size() > number_old_candidates) {
+					add_candidates(number_old_candidates);
+				}
+			}
+			// Too few candidates: add more one by one, like KPP.
+			while (candidate_indices.size() < number_components) {
+				candidate_indices.push_back(sample_index(probabilities, prng));
+				add_candidates(candidate_indices.size() - 1);
+			}
+			const auto number_candidates = static_cast<Eigen::Index>(candidate_indices.size());
+			Eigen::MatrixXd candidates(data.rows(), number_candidates);
+			for (Eigen::Index j = 0; j < number_candidates; ++j) {
+				candidates.col(j) = data.col(candidate_indices[static_cast<size_t>(j)]);
+			}
+			Eigen::VectorXd candidate_weights(Eigen::VectorXd::Zero(number_candidates));
+			for (Eigen::Index i = 0; i < sample_size; ++i) {
+				candidate_weights[closest_candidates[static_cast<size_t>(i)]] += weighted ? weights[i] : 1;
+			}
+			weighted_kpp(candidates, candidate_weights, prng, number_components, centroids, number_threads);
+		}
+
+		void ScalableKPP::init(Eigen::Ref<const Eigen::MatrixXd> data, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const
+		{
+			scalable_kpp(data, Eigen::VectorXd(), prng, number_components, centroids, oversampling_factor_, number_rounds_, number_threads_);
+		}
+
+		void ScalableKPP::weighted_init(Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng, const unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const
+		{
+			scalable_kpp(data, weights, prng, number_components, centroids, oversampling_factor_, number_rounds_, number_threads_);
+		}
+
 		ResponsibilitiesInitialiser::~ResponsibilitiesInitialiser()
 		{}
 
@@ -73,18 +314,12 @@ namespace ml
 		{
 			Eigen::MatrixXd centroids(data.rows(), number_components);
 			centroids_initialiser_->init(data, prng, number_components, centroids);
+			std::vector<unsigned int> labels;
+			Eigen::VectorXd squared_distances(data.cols());
+			find_closest_centroids(data, centroids, labels, squared_distances);
 			responsibilities.setZero();
 			for (Eigen::Index i = 0; i < data.cols(); ++i) {
-				double min_distance_squared = (data.col(i) - centroids.col(0)).squaredNorm();
-				unsigned int closest_mean_index = 0;
-				for (unsigned int k = 1; k < number_components; ++k) {
-					const double distance_squared = (data.col(i) - centroids.col(k)).squaredNorm();
-					if (distance_squared < min_distance_squared) {
-						min_distance_squared = distance_squared;
-						closest_mean_index = k;
-					}
-				}
-				responsibilities(i, closest_mean_index) = 1;
+				responsibilities(i, labels[static_cast<size_t>(i)]) = 1;
 			}
 		}
 	}
@@ -54,6 +54,42 @@ namespace ml
 			virtual bool converged() const = 0;
 		};
 
+		/** @brief Finds the closest centroid to every data point.
+
+		Squared distances are calculated as \f$ |\vec{x}|^2 - 2 \vec{x}^T \vec{c} + |\vec{c}|^2 \f$, with the cross terms obtained by matrix
+		products of tiles of centroids and data points. This formula loses precision when the distance is much smaller than the norms,
+		so if another centroid is within the rounding error bound of the closest one, the distances to all centroids for that
+		point are recalculated directly as \f$ |\vec{x} - \vec{c}|^2 \f$. The squared distance to the chosen centroid is always calculated
+		directly. The labels and distances are the same as if every distance was calculated directly, with ties resolved in favour of
+		the centroid with the lowest index.
+
+		@param[in] data Data matrix with data points in columns.
+		@param[in] data_squared_norms Squared Euclidean norms of data points, `data.colwise().squaredNorm()`. Can be calculated once and reused for different centroids.
+		@param[in] centroids Matrix with centroids in columns.
+		@param[out] labels Index of the closest centroid to every data point. Resized to `data.cols()` if needed.
+		@param[out] squared_distances Vector with length `data.cols()` for squared distances to the closest centroids.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used. The results do not depend on it.
+		@throw std::invalid_argument If `centroids` has no columns, or the dimensions do not match.
+		*/
+		DLL_DECLSPEC void find_closest_centroids(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> data_squared_norms, Eigen::Ref<const Eigen::MatrixXd> centroids, std::vector<unsigned int>& labels, Eigen::Ref<Eigen::VectorXd> squared_distances, unsigned int number_threads = 1);
+
+		/** @brief Finds the closest centroid to every data point.
+
+		Calculates the squared norms of data points and calls find_closest_centroids(Eigen::Ref<const Eigen::MatrixXd>, Eigen::Ref<const Eigen::VectorXd>, Eigen::Ref<const Eigen::MatrixXd>, std::vector<unsigned int>&, Eigen::Ref<Eigen::VectorXd>, unsigned int).
+		*/
+		DLL_DECLSPEC void find_closest_centroids(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::MatrixXd> centroids, std::vector<unsigned int>& labels, Eigen::Ref<Eigen::VectorXd> squared_distances, unsigned int number_threads = 1);
+
+		/** @brief Creates pseudo-random number generators for independent initialisations of a clustering model.
+
+		The first generator is a copy of `prng`, so that the first initialisation is the same as a single fit would be. The others are seeded
+		from counter-based random streams (see RandomStreams::Stream), keyed by a number drawn from `prng`. The generators depend only on the state
+		of `prng`, so initialisations using them can be run in any order or concurrently.
+		@param[in,out] prng Pseudo-random number generator of the model. Advanced by one draw.
+		@param[in] number_initialisations Number of initialisations.
+		@return Vector of `number_initialisations` generators.
+		*/
+		DLL_DECLSPEC std::vector<std::default_random_engine> make_initialisation_prngs(std::default_random_engine& prng, unsigned int number_initialisations);
+
 		/** @brief Chooses initial locations of centroids. */
 		class CentroidsInitialiser
 		{
@@ -69,6 +105,18 @@ namespace ml
 			@param[out] centroids Destination matrix for centroid locations, with `data.rows()` rows and `number_components` columns.
 			*/
 			DLL_DECLSPEC virtual void init(Eigen::Ref<const Eigen::MatrixXd> data, std::default_random_engine& prng, unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const = 0;
+
+			/** @brief Initialises location of centroids for weighted data points.
+
+			The default implementation ignores the weights and calls init().
+
+			@param[in] data Data matrix with data points in columns.
+			@param[in] weights Non-negative weights of data points, with size `data.cols()`.
+			@param[in,out] prng Pseudo-random number generator.
+			@param[in] number_components Number of centroids. Must be less or equal to `data.cols()`.
+			@param[out] centroids Destination matrix for centroid locations, with `data.rows()` rows and `number_components` columns.
+			*/
+			DLL_DECLSPEC virtual void weighted_init(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng, unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const;
 		};
 
 		/** @brief Chooses initial component responsibilities. */
@@ -104,11 +152,53 @@ namespace ml
 
 		/** @brief Implements the K++ algorithm.
 		
-		See https://en.wikipedia.org/wiki/K-means%2B%2B */
+		See https://en.wikipedia.org/wiki/K-means%2B%2B
+
+		Keeps the squared distance from every point to its closest chosen centroid and updates it only with the distance to the newest
+		centroid, so choosing K centroids costs O(N K D) operations. For weighted data, the probabilities of choosing points are multiplied by their weights.
+		*/
 		class KPP : public CentroidsInitialiser
 		{
 		public:
+			/** @brief Constructor.
+			@param[in] number_threads Number of threads used to update the distances. If 0, the number of hardware threads is used. The results do not depend on it.
+			*/
+			DLL_DECLSPEC KPP(unsigned int number_threads = 1);
+
 			DLL_DECLSPEC void init(Eigen::Ref<const Eigen::MatrixXd> data, std::default_random_engine& prng, unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const override;
+
+			DLL_DECLSPEC void weighted_init(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng, unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const override;
+		private:
+			unsigned int number_threads_;
+		};
+
+		/** @brief Implements the k-means|| ("scalable K++") algorithm.
+
+		See Bahmani et al., "Scalable K-Means++", 2012. Starts from a random data point and, in each of a few rounds, samples every data point independently
+		with probability \f$ \min(1, l K d^2(\vec{x}) / \sum_{\vec{y}} d^2(\vec{y})) \f$, where \f$ d(\vec{x}) \f$ is the distance to the closest candidate
+		sampled so far and \f$ l \f$ is the oversampling factor. The candidates are then weighted by the numbers of data points closest to them and K of them
+		are chosen with weighted K++. Instead of K passes over the data, like KPP, it needs only a few, which can run on several threads.
+		For weighted data, the sampling probabilities are multiplied by the weights of the points, and the candidates are weighted by the total weights of the points closest to them.
+		*/
+		class ScalableKPP : public CentroidsInitialiser
+		{
+		public:
+			/** @brief Constructor.
+			@param[in] oversampling_factor Expected number of candidates sampled in a round, divided by the number of centroids.
+			@param[in] number_rounds Number of sampling rounds.
+			@param[in] number_threads Number of threads. If 0, the number of hardware threads is used. The results do not depend on it.
+			@throw std::domain_error If `oversampling_factor` is not positive.
+			@throw std::invalid_argument If `number_rounds == 0`.
+			*/
+			DLL_DECLSPEC ScalableKPP(double oversampling_factor = 2, unsigned int number_rounds = 2, unsigned int number_threads = 1);
+
+			DLL_DECLSPEC void init(Eigen::Ref<const Eigen::MatrixXd> data, std::default_random_engine& prng, unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const override;
+
+			DLL_DECLSPEC void weighted_init(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> weights, std::default_random_engine& prng, unsigned int number_components, Eigen::Ref<Eigen::MatrixXd> centroids) const override;
+		private:
+			double oversampling_factor_;
+			unsigned int number_rounds_;
+			unsigned int number_threads_;
 		};
 
 		/** @brief Initialises centroids and then assigns the responsibility for each point to its closest centroid. */
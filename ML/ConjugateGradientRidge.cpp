@@ -0,0 +1,139 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "ConjugateGradientRidge.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		std::string ConjugateGradientRidgeResult::to_string() const
+		{
+			std::stringstream s;
+			s << "ConjugateGradientRidgeResult(n=" << n << ", dof=" << dof << ", rss=" << rss << ", tss=" << tss;
+			s << ", var_y=" << var_y() << ", r2=" << r2() << ", adjusted_r2=" << adjusted_r2();
+			s << ", beta=[" << beta.transpose() << "]";
+			s << ", iterations=" << iterations << ", relative_residual=" << relative_residual << ", converged=" << converged;
+			s << ")";
+			return s.str();
+		}
+
+		/// Returns the squared norms of X rows.
+		static Eigen::VectorXd row_squared_norms(const Eigen::Ref<const Eigen::MatrixXd> X)
+		{
+			return X.rowwise().squaredNorm();
+		}
+
+		static Eigen::VectorXd row_squared_norms(const Eigen::SparseMatrix<double>& X)
+		{
+			return X.cwiseAbs2() * Eigen::VectorXd::Ones(X.cols());
+		}
+
+		template <class M> static ConjugateGradientRidgeResult ridge_conjugate_gradient_impl(const M& X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda, const double tolerance, unsigned int max_iterations)
+		{
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			if (lambda < 0) {
+				throw std::domain_error("Ridge regularisation constant cannot be negative");
+			}
+			if (n != y.size()) {
+				throw std::invalid_argument("X matrix has different number of data points than Y has values");
+			}
+			if (n < 2) {
+				throw std::invalid_argument("Not enough data points for regression");
+			}
+			if (!q) {
+				throw std::invalid_argument("At least one feature required");
+			}
+			if (!(tolerance > 0)) {
+				throw std::invalid_argument("Tolerance must be positive");
+			}
+			if (!max_iterations) {
+				max_iterations = static_cast<unsigned int>(q);
+			}
+			ConjugateGradientRidgeResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = n > q + 1 ? static_cast<unsigned int>(n - q - 1) : 0; // -1 for the intercept.
+			result.effective_dof = std::numeric_limits<double>::quiet_NaN();
+			const double mean_y = y.mean();
+			const Eigen::VectorXd means(X * Eigen::VectorXd::Constant(n, 1. / static_cast<double>(n)));
+			// Because (X - means * 1^T) * 1 == 0, (X - means * 1^T) * u == X * u for any u which sums to 0, and
+			// (X - means * 1^T) * (X - means * 1^T)^T * v == X * (X^T * v - (means^T * v) * 1).
+			Eigen::VectorXd work_n(n);
+			const auto apply_normal_matrix = [&](const Eigen::VectorXd& v, Eigen::VectorXd& dest) {
+				work_n.noalias() = X.transpose() * v;
+				work_n.array() -= means.dot(v);
+				dest.noalias() = X * work_n;
+				dest += lambda * v;
+			};
+			work_n = y.array() - mean_y;
+			Eigen::VectorXd b(X * work_n);
+			// Jacobi preconditioner: the inverted diagonal of (X - means * 1^T) * (X - means * 1^T)^T + lambda * I.
+			const Eigen::VectorXd squared_norms(row_squared_norms(X));
+			Eigen::VectorXd inv_diagonal((squared_norms - static_cast<double>(n) * means.cwiseAbs2()).array() + lambda);
+			Eigen::VectorXd active(Eigen::VectorXd::Ones(q));
+			for (Eigen::Index i = 0; i < q; ++i) {
+				if (lambda == 0 && inv_diagonal[i] <= 16 * std::numeric_limits<double>::epsilon() * squared_norms[i]) {
+					// Feature with zero variance (up to rounding errors) and no penalty: its row of the normal equations is 0 = 0,
+					// so it is left out of the search directions and its slope stays 0.
+					inv_diagonal[i] = 0;
+					active[i] = 0;
+					b[i] = 0;
+				} else {
+					inv_diagonal[i] = inv_diagonal[i] > 0 ? 1 / inv_diagonal[i] : 1;
+				}
+			}
+			const double b_norm = b.norm();
+			Eigen::VectorXd slopes(Eigen::VectorXd::Zero(q));
+			Eigen::VectorXd r(b);
+			Eigen::VectorXd z(inv_diagonal.cwiseProduct(r));
+			Eigen::VectorXd p(z);
+			Eigen::VectorXd Ap(q);
+			double rz = r.dot(z);
+			double r_norm = b_norm;
+			result.iterations = 0;
+			while (r_norm > tolerance * b_norm && result.iterations < max_iterations) {
+				apply_normal_matrix(p, Ap);
+				const double pAp = p.dot(Ap);
+				if (!(pAp > 0)) {
+					// The normal matrix is singular (or numerically indefinite) along p, so the step is undefined.
+					break;
+				}
+				const double alpha = rz / pAp;
+				slopes += alpha * p;
+				r -= alpha * Ap;
+				r = r.cwiseProduct(active);
+				z = inv_diagonal.cwiseProduct(r);
+				const double next_rz = r.dot(z);
+				p = z + (next_rz / rz) * p;
+				rz = next_rz;
+				r_norm = r.norm();
+				++result.iterations;
+			}
+			result.relative_residual = b_norm > 0 ? r_norm / b_norm : 0;
+			result.converged = r_norm <= tolerance * b_norm;
+			result.beta.resize(q + 1);
+			result.beta.head(q) = slopes;
+			// intercept = mean(y) - slopes^T * means
+			result.beta[q] = mean_y - slopes.dot(means);
+			work_n.noalias() = X.transpose() * slopes;
+			// Residual sum of squares:
+			result.rss = ((y - work_n).array() - result.beta[q]).matrix().squaredNorm();
+			// Total sum of squares:
+			result.tss = (y.array() - mean_y).matrix().squaredNorm();
+			return result;
+		}
+
+		ConjugateGradientRidgeResult ridge_conjugate_gradient(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda, const double tolerance, const unsigned int max_iterations)
+		{
+			return ridge_conjugate_gradient_impl(X, y, lambda, tolerance, max_iterations);
+		}
+
+		ConjugateGradientRidgeResult ridge_conjugate_gradient(const Eigen::SparseMatrix<double>& X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda, const double tolerance, const unsigned int max_iterations)
+		{
+			return ridge_conjugate_gradient_impl(X, y, lambda, tolerance, max_iterations);
+		}
+	}
+}
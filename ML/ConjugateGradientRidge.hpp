@@ -0,0 +1,55 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <Eigen/SparseCore>
+#include "LinearRegression.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		/** @brief Result of a ridge regression with intercept solved by conjugate gradients.
+
+		Neither \f$ X X^T \f$ nor any other D x D matrix is formed, so the covariance matrix of beta and the effective
+		number of degrees of freedom are not calculated: #effective_dof is set to NaN.
+		*/
+		struct ConjugateGradientRidgeResult : public RegularisedRegressionResult
+		{
+			unsigned int iterations; /**< Number of conjugate gradient iterations carried out. */
+			double relative_residual; /**< Norm of the residual of the normal equations, divided by the norm of their right-hand side. */
+			bool converged; /**< Whether #relative_residual fell below the requested tolerance. */
+
+			/** @brief Formats the result as string. */
+			DLL_DECLSPEC std::string to_string() const;
+
+			using RegularisedRegressionResult::predict;
+		};
+
+		/** @brief Carries out multivariate ridge regression with intercept using preconditioned conjugate gradients.
+
+		Finds the same \f$ \vec{\beta'} \f$ and \f$ \beta_0 \f$ as ridge(), by solving \f$ (X_c X_c^T + \lambda I) \vec{\beta'} = X_c \vec{y} \f$,
+		where \f$ X_c \f$ is X with row means subtracted. Only products \f$ X \vec{v} \f$ and \f$ X^T \vec{u} \f$ are used: centring is
+		applied implicitly, so sparse X stays sparse. Memory used scales with the size (or number of nonzeros) of X, plus O(N + D).
+
+		X is not standardised internally; scale its rows beforehand if the penalty should treat features equally.
+
+		The Jacobi (diagonal) preconditioner is used. Iterations stop when the norm of the residual of the normal equations
+		falls below `tolerance` times the norm of the right-hand side, or after `max_iterations` iterations. They also stop (without convergence)
+		if the normal matrix is singular along the search direction. If `lambda == 0`, features with zero variance are left out and get zero slopes.
+
+		@param[in] X D x N matrix of X values, with data points in columns. Should NOT contain a row with all 1's.
+		@param[in] y Y vector with length N.
+		@param[in] lambda Regularisation strength.
+		@param[in] tolerance Relative tolerance for the residual.
+		@param[in] max_iterations Maximum number of iterations. If 0, D is used.
+		@return ConjugateGradientRidgeResult object with `beta.size() == X.rows() + 1`.
+		@throw std::invalid_argument If `y.size() != X.cols()`, `X.cols() < 2`, `X.rows() == 0` or `!(tolerance > 0)`.
+		@throw std::domain_error If `lambda < 0`.
+		*/
+		DLL_DECLSPEC ConjugateGradientRidgeResult ridge_conjugate_gradient(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, double lambda, double tolerance = 1e-10, unsigned int max_iterations = 0);
+
+		/** @brief Carries out multivariate ridge regression with intercept using preconditioned conjugate gradients, for sparse X.
+		@see ridge_conjugate_gradient(Eigen::Ref<const Eigen::MatrixXd>, Eigen::Ref<const Eigen::VectorXd>, double, double, unsigned int)
+		*/
+		DLL_DECLSPEC ConjugateGradientRidgeResult ridge_conjugate_gradient(const Eigen::SparseMatrix<double>& X, Eigen::Ref<const Eigen::VectorXd> y, double lambda, double tolerance = 1e-10, unsigned int max_iterations = 0);
+	}
+}
@@ -0,0 +1,196 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "Clustering.hpp"
+#include "Coreset.hpp"
+
+namespace ml
+{
+    namespace Clustering
+    {
+		Coreset::Coreset(const unsigned int number_clusters, const unsigned int size)
+			: number_clusters_(number_clusters)
+			, size_(size)
+			, number_threads_(1)
+		{
+			if (!number_clusters) {
+				throw std::invalid_argument("Coreset: number of clusters cannot be zero");
+			}
+			if (size < number_clusters) {
+				throw std::invalid_argument("Coreset: size cannot be smaller than the number of clusters");
+			}
+		}
+
+		void Coreset::add(const Eigen::Ref<const Eigen::MatrixXd> chunk)
+		{
+			add(chunk, Eigen::VectorXd::Ones(chunk.cols()));
+		}
+
+		void Coreset::add(const Eigen::Ref<const Eigen::MatrixXd> chunk, const Eigen::Ref<const Eigen::VectorXd> weights)
+		{
+			if (!chunk.rows()) {
+				throw std::invalid_argument("Coreset: At least one dimension required");
+			}
+			if (points_.size() && chunk.rows() != points_.rows()) {
+				throw std::invalid_argument("Coreset: Data dimension mismatch");
+			}
+			if (weights.size() != chunk.cols()) {
+				throw std::invalid_argument("Coreset: Wrong number of weights");
+			}
+			if (!weights.allFinite() || (weights.array() < 0).any()) {
+				throw std::domain_error("Coreset: Weights must be finite and non-negative");
+			}
+			Level level;
+			const auto number_points = static_cast<Eigen::Index>((weights.array() > 0).count());
+			if (!number_points) {
+				return;
+			}
+			level.points.resize(chunk.rows(), number_points);
+			level.weights.resize(number_points);
+			Eigen::Index j = 0;
+			for (Eigen::Index i = 0; i < chunk.cols(); ++i) {
+				if (weights[i] > 0) {
+					level.points.col(j) = chunk.col(i);
+					level.weights[j] = weights[i];
+					++j;
+				}
+			}
+			carry(reduce(std::move(level)), 0);
+			update_union();
+		}
+
+		void Coreset::merge(const Coreset& other)
+		{
+			if (other.number_clusters_ != number_clusters_ || other.size_ != size_) {
+				throw std::invalid_argument("Coreset: Number of clusters or size mismatch");
+			}
+			if (points_.size() && other.points_.size() && other.points_.rows() != points_.rows()) {
+				throw std::invalid_argument("Coreset: Data dimension mismatch");
+			}
+			for (size_t l = 0; l < other.levels_.size(); ++l) {
+				if (other.levels_[l].weights.size()) {
+					carry(Level(other.levels_[l]), l);
+				}
+			}
+			update_union();
+		}
+
+		void Coreset::reset()
+		{
+			levels_.clear();
+			points_.resize(0, 0);
+			weights_.resize(0);
+		}
+
+		void Coreset::set_seed(const unsigned int seed)
+		{
+			prng_.seed(seed);
+		}
+
+		Coreset::Level Coreset::reduce(Level&& level)
+		{
+			const auto number_points = level.points.cols();
+			if (number_points <= size_) {
+				return std::move(level);
+			}
+			const Eigen::Index K = number_clusters_;
+			Eigen::MatrixXd seeds(level.points.rows(), K);
+			KPP(number_threads_).weighted_init(level.points, level.weights, prng_, number_clusters_, seeds);
+			std::vector<unsigned int> labels;
+			Eigen::VectorXd squared_distances(number_points);
+			find_closest_centroids(level.points, seeds, labels, squared_distances, number_threads_);
+			// Weights and costs of the clusters around seeds.
+			Eigen::VectorXd cluster_weights(Eigen::VectorXd::Zero(K));
+			Eigen::VectorXd cluster_costs(Eigen::VectorXd::Zero(K));
+			for (Eigen::Index i = 0; i < number_points; ++i) {
+				const auto k = labels[static_cast<size_t>(i)];
+				cluster_weights[k] += level.weights[i];
+				cluster_costs[k] += level.weights[i] * squared_distances[i];
+			}
+			const double total_weight = cluster_weights.sum();
+			const double mean_cost = cluster_costs.sum() / total_weight;
+			// Approximation factor of K++ seeding (in expectation).
+			const double alpha = 16 * (std::log2(static_cast<double>(K)) + 2);
+			// Sampling probabilities proportional to the weights times the upper bounds on sensitivities.
+			Eigen::VectorXd cumulative_probabilities(number_points);
+			double cumulative_probability = 0;
+			for (Eigen::Index i = 0; i < number_points; ++i) {
+				const auto k = labels[static_cast<size_t>(i)];
+				double sensitivity = 4 * total_weight / cluster_weights[k];
+				if (mean_cost > 0) {
+					sensitivity += alpha * squared_distances[i] / mean_cost + 2 * alpha * cluster_costs[k] / (cluster_weights[k] * mean_cost);
+				}
+				cumulative_probability += level.weights[i] * sensitivity;
+				cumulative_probabilities[i] = cumulative_probability;
+			}
+			std::uniform_real_distribution<double> uniform(0, cumulative_probability);
+			std::vector<Eigen::Index> sampled_indices(size_);
+			for (auto& index : sampled_indices) {
+				const auto u = uniform(prng_);
+				index = std::min(number_points - 1, static_cast<Eigen::Index>(std::upper_bound(cumulative_probabilities.data(), cumulative_probabilities.data() + number_points, u) - cumulative_probabilities.data()));
+			}
+			// Points drawn more than once are kept once, with the weights added up.
+			std::sort(sampled_indices.begin(), sampled_indices.end());
+			Level reduced;
+			reduced.points.resize(level.points.rows(), static_cast<Eigen::Index>(size_));
+			reduced.weights.resize(static_cast<Eigen::Index>(size_));
+			Eigen::Index number_distinct = 0;
+			for (auto it = sampled_indices.begin(); it != sampled_indices.end(); ) {
+				const auto i = *it;
+				const auto next = std::upper_bound(it, sampled_indices.end(), i);
+				const auto count = static_cast<double>(next - it);
+				const double probability = (cumulative_probabilities[i] - (i ? cumulative_probabilities[i - 1] : 0)) / cumulative_probability;
+				reduced.points.col(number_distinct) = level.points.col(i);
+				reduced.weights[number_distinct] = count * level.weights[i] / (static_cast<double>(size_) * probability);
+				++number_distinct;
+				it = next;
+			}
+			reduced.points.conservativeResize(Eigen::NoChange, number_distinct);
+			reduced.weights.conservativeResize(number_distinct);
+			return reduced;
+		}
+
+		void Coreset::carry(Level&& level, size_t index)
+		{
+			while (index < levels_.size() && levels_[index].weights.size()) {
+				auto& occupied = levels_[index];
+				Level merged;
+				merged.points.resize(level.points.rows(), occupied.points.cols() + level.points.cols());
+				merged.points << occupied.points, level.points;
+				merged.weights.resize(occupied.weights.size() + level.weights.size());
+				merged.weights << occupied.weights, level.weights;
+				occupied = Level();
+				level = reduce(std::move(merged));
+				++index;
+			}
+			if (index == levels_.size()) {
+				levels_.emplace_back();
+			}
+			levels_[index] = std::move(level);
+		}
+
+		void Coreset::update_union()
+		{
+			Eigen::Index number_points = 0;
+			Eigen::Index number_dimensions = 0;
+			for (const auto& level : levels_) {
+				number_points += level.weights.size();
+				if (level.weights.size()) {
+					number_dimensions = level.points.rows();
+				}
+			}
+			points_.resize(number_dimensions, number_points);
+			weights_.resize(number_points);
+			Eigen::Index j = 0;
+			for (const auto& level : levels_) {
+				const auto n = level.weights.size();
+				if (n) {
+					points_.middleCols(j, n) = level.points;
+					weights_.segment(j, n) = level.weights;
+					j += n;
+				}
+			}
+		}
+    }
+}
\ No newline at end of file
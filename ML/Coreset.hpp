@@ -0,0 +1,127 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <random>
+#include <vector>
+#include <Eigen/Core>
+#include "dll.hpp"
+
+namespace ml
+{
+    namespace Clustering
+    {
+        /**
+         * @brief Weighted coreset for K-means clustering, built by sensitivity sampling.
+         *
+         * A coreset is a small set of weighted points such that the weighted K-means cost of any K centroids on it approximates their cost on the full data.
+         * It can then be clustered with KMeans::fit(Eigen::Ref<const Eigen::MatrixXd>, Eigen::Ref<const Eigen::VectorXd>) or EM::fit(Eigen::Ref<const Eigen::MatrixXd>, Eigen::Ref<const Eigen::VectorXd>).
+         *
+         * Data is reduced by seeding K centroids with weighted K++, bounding the sensitivity of every point (its largest possible share of the cost)
+         * by its distance to the closest seed and the sizes and costs of the seed clusters, and sampling points with probabilities proportional to these bounds
+         * (Bachem, Lucic and Krause, "Practical Coreset Constructions for Machine Learning", 2017). Each sampled point is weighted by the inverse of its
+         * sampling probability, so that the cost on the coreset is an unbiased estimate. The size needed for a given accuracy with high probability
+         * depends on K and the dimension, but not on the number of data points.
+         *
+         * Coresets of disjoint data sets can be merged, because the union of coresets is a coreset of the union. add() and merge() keep coresets of equal
+         * numbers of chunks in levels of a merge-and-reduce tree: two coresets in the same level are merged, reduced and moved one level up. The error
+         * therefore grows only with the logarithm of the number of chunks, and data sets which do not fit in memory can be summarised chunk by chunk.
+         */
+        class Coreset
+        {
+        public:
+            /** @brief Constructs an empty coreset.
+            @param[in] number_clusters Number of clusters K the coreset is built for.
+            @param[in] size Number of points in a reduced coreset.
+            @throw std::invalid_argument If `number_clusters == 0` or `size < number_clusters`.
+            */
+            DLL_DECLSPEC Coreset(unsigned int number_clusters, unsigned int size);
+
+            /** @brief Adds a chunk of data points with unit weights.
+            @param[in] chunk Matrix with a data point in every column.
+            @throw std::invalid_argument If `chunk` has no rows, or a different number of rows than the points added before.
+            */
+            DLL_DECLSPEC void add(Eigen::Ref<const Eigen::MatrixXd> chunk);
+
+            /** @brief Adds a chunk of weighted data points. Points with zero weights are skipped.
+            @param[in] chunk Matrix with a data point in every column.
+            @param[in] weights Non-negative weights of data points, with size `chunk.cols()`.
+            @throw std::invalid_argument If `chunk` has no rows, a different number of rows than the points added before, or if `weights.size() != chunk.cols()`.
+            @throw std::domain_error If a weight is negative or not finite.
+            */
+            DLL_DECLSPEC void add(Eigen::Ref<const Eigen::MatrixXd> chunk, Eigen::Ref<const Eigen::VectorXd> weights);
+
+            /** @brief Merges another coreset (e.g. built from a different part of the data on another machine or thread) into this one.
+            @param[in] other Coreset with the same number of clusters and size.
+            @throw std::invalid_argument If the number of clusters, the size or the dimension of points differ.
+            */
+            DLL_DECLSPEC void merge(const Coreset& other);
+
+            /** @brief Removes all points. */
+            DLL_DECLSPEC void reset();
+
+            /** @brief Points of the coreset, in columns.
+
+            Union of the coresets in all levels, with at most `size * L` points, where L is the number of levels (about the logarithm of the number of chunks).
+            Chunks with at most `size` points in total are kept unchanged.
+            */
+            const Eigen::MatrixXd& points() const
+            {
+                return points_;
+            }
+
+            /** @brief Weights of the coreset points. */
+            const Eigen::VectorXd& weights() const
+            {
+                return weights_;
+            }
+
+            /** @brief Number of clusters K the coreset is built for. */
+            unsigned int number_clusters() const
+            {
+                return number_clusters_;
+            }
+
+            /** @brief Number of points in a reduced coreset. */
+            unsigned int size() const
+            {
+                return size_;
+            }
+
+            /** @brief Sets PRNG seed.
+            @param[in] seed PRNG seed.
+            */
+            DLL_DECLSPEC void set_seed(unsigned int seed);
+
+            /** @brief Sets the number of threads used to calculate distances. Default is 1. The results do not depend on it.
+            @param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+            */
+            void set_number_threads(unsigned int number_threads)
+            {
+                number_threads_ = number_threads;
+            }
+        private:
+            /// Weighted points in a level of the merge-and-reduce tree.
+            struct Level
+            {
+                Eigen::MatrixXd points;
+                Eigen::VectorXd weights;
+            };
+
+            std::vector<Level> levels_; /**< Levels of the merge-and-reduce tree. Level l summarises 2^l chunks, or is empty. */
+            Eigen::MatrixXd points_;
+            Eigen::VectorXd weights_;
+            std::default_random_engine prng_;
+            unsigned int number_clusters_;
+            unsigned int size_;
+            unsigned int number_threads_;
+
+            /// Reduces the weighted points to `size_` points, if there are more.
+            Level reduce(Level&& level);
+
+            /// Adds weighted points to a level, merging them with the points already there and moving them up as needed.
+            void carry(Level&& level, size_t index);
+
+            /// Sets points_ and weights_ to the union of all levels.
+            void update_union();
+        };
+    }
+}
@@ -1,6 +1,11 @@
 /* (C) 2020 Roman Werpachowski. */
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
 #include <stdexcept>
 #include "Crossvalidation.hpp"
+#include "RandomStreams.hpp"
 
 namespace ml
 {
@@ -15,13 +20,19 @@ namespace ml
 				throw std::invalid_argument("Too many folds requested");
 			}
 			const size_t fold_len = static_cast<size_t>(std::round(static_cast<double>(total_len) / static_cast<double>(num_folds)));
-			i0 = k * fold_len;
-			if (k + 1 < num_folds) {
-				i1 = i0 + fold_len;
+			if ((num_folds - 1) * fold_len < total_len) {
+				i0 = k * fold_len;
+				if (k + 1 < num_folds) {
+					i1 = i0 + fold_len;
+				} else {
+					i1 = total_len;
+				}
 			} else {
-				i1 = total_len;
+				// Rounding up would leave nothing for the last fold, e.g. for 15 points in 10 folds.
+				i0 = (k * total_len) / num_folds;
+				i1 = ((k + 1) * total_len) / num_folds;
 			}
-			assert(i1 <= total_len);
+			assert(i0 < i1 && i1 <= total_len);
 		}
 
 		Eigen::Ref<const Eigen::MatrixXd> only_kth_fold_2d(Eigen::Ref<const Eigen::MatrixXd, 0> data, const unsigned int k, const unsigned int num_folds)
@@ -68,5 +79,160 @@ namespace ml
 			remaining.tail(remaining_len - i0) = data.tail(remaining_len - i0);
 			return remaining;
 		}
+
+		FoldView::FoldView(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const Eigen::Index i0, const Eigen::Index i1, const Eigen::Index i2, const Eigen::Index i3)
+			: X_(X), y_(y), folds_(nullptr), fold_(0), in_fold_(false)
+		{
+			if (X.cols() != y.size()) {
+				throw std::invalid_argument("Data size mismatch");
+			}
+			if (!(0 <= i0 && i0 <= i1 && i1 <= i2 && i2 <= i3 && i3 <= X.cols())) {
+				throw std::invalid_argument("Invalid data point ranges");
+			}
+			ranges_[0] = std::make_pair(i0, i1);
+			ranges_[1] = std::make_pair(i2, i3);
+			size_ = (i1 - i0) + (i3 - i2);
+		}
+
+		FoldView::FoldView(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const std::vector<unsigned int>& folds, const unsigned int fold, const bool in_fold)
+			: X_(X), y_(y), folds_(&folds), fold_(fold), in_fold_(in_fold)
+		{
+			if (X.cols() != y.size() || static_cast<size_t>(X.cols()) != folds.size()) {
+				throw std::invalid_argument("Data size mismatch");
+			}
+			const auto number_in_fold = std::count(folds.begin(), folds.end(), fold);
+			size_ = in_fold ? number_in_fold : X.cols() - number_in_fold;
+		}
+
+		Eigen::MatrixXd FoldView::X() const
+		{
+			Eigen::MatrixXd result(dim(), size_);
+			Eigen::Index i = 0;
+			for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> X_block, Eigen::Ref<const Eigen::VectorXd>) {
+				result.middleCols(i, X_block.cols()) = X_block;
+				i += X_block.cols();
+			});
+			return result;
+		}
+
+		Eigen::VectorXd FoldView::y() const
+		{
+			Eigen::VectorXd result(size_);
+			Eigen::Index i = 0;
+			for_each_block([&](Eigen::Ref<const Eigen::MatrixXd>, const Eigen::Ref<const Eigen::VectorXd> y_block) {
+				result.segment(i, y_block.size()) = y_block;
+				i += y_block.size();
+			});
+			return result;
+		}
+
+		std::vector<unsigned int> folds_from_permutation(const std::vector<size_t>& permutation, const unsigned int num_folds)
+		{
+			const auto n = permutation.size();
+			if (!num_folds) {
+				throw std::invalid_argument("At least one fold required");
+			}
+			if (num_folds > n) {
+				throw std::invalid_argument("Too many folds requested");
+			}
+			std::vector<bool> seen(n, false);
+			for (const auto i : permutation) {
+				if (i >= n || seen[i]) {
+					throw std::invalid_argument("Not a permutation");
+				}
+				seen[i] = true;
+			}
+			std::vector<unsigned int> folds(n);
+			for (unsigned int k = 0; k < num_folds; ++k) {
+				size_t i0, i1;
+				calc_fold_indices(n, k, num_folds, i0, i1);
+				for (auto j = i0; j < i1; ++j) {
+					folds[permutation[j]] = k;
+				}
+			}
+			return folds;
+		}
+
+		std::vector<unsigned int> calc_contiguous_folds(const size_t total_len, const unsigned int num_folds)
+		{
+			if (!num_folds) {
+				throw std::invalid_argument("At least one fold required");
+			}
+			std::vector<unsigned int> folds(total_len);
+			for (unsigned int k = 0; k < num_folds; ++k) {
+				size_t i0, i1;
+				calc_fold_indices(total_len, k, num_folds, i0, i1);
+				std::fill(folds.begin() + i0, folds.begin() + i1, k);
+			}
+			return folds;
+		}
+
+		std::vector<size_t> random_permutation(const size_t total_len, const uint64_t seed, const uint64_t stream)
+		{
+			std::vector<size_t> permutation(total_len);
+			std::iota(permutation.begin(), permutation.end(), 0);
+			RandomStreams::Stream random_stream(seed, stream);
+			for (size_t i = total_len; i > 1; --i) {
+				const auto j = static_cast<size_t>(random_stream.uniform_index(i));
+				std::swap(permutation[i - 1], permutation[j]);
+			}
+			return permutation;
+		}
+
+		std::vector<unsigned int> calc_shuffled_folds(const size_t total_len, const unsigned int num_folds, const uint64_t seed, const unsigned int repeat)
+		{
+			return folds_from_permutation(random_permutation(total_len, seed, repeat), num_folds);
+		}
+
+		std::vector<unsigned int> calc_stratified_folds(const Eigen::Ref<const Eigen::VectorXd> labels, const unsigned int num_folds, const uint64_t seed, const unsigned int repeat)
+		{
+			const auto total_len = static_cast<size_t>(labels.size());
+			if (!num_folds) {
+				throw std::invalid_argument("At least one fold required");
+			}
+			if (num_folds > total_len) {
+				throw std::invalid_argument("Too many folds requested");
+			}
+			std::map<double, std::vector<size_t>> classes;
+			for (size_t i = 0; i < total_len; ++i) {
+				const double label = labels[static_cast<Eigen::Index>(i)];
+				if (std::isnan(label)) {
+					throw std::invalid_argument("Label is NaN");
+				}
+				classes[label].push_back(i);
+			}
+			RandomStreams::Stream random_stream(seed, repeat);
+			std::vector<unsigned int> folds(total_len);
+			size_t j = 0;
+			for (auto& cls : classes) {
+				auto& members = cls.second;
+				for (size_t i = members.size(); i > 1; --i) {
+					std::swap(members[i - 1], members[static_cast<size_t>(random_stream.uniform_index(i))]);
+				}
+				for (const auto i : members) {
+					folds[i] = static_cast<unsigned int>(j % num_folds);
+					++j;
+				}
+			}
+			return folds;
+		}
+
+		std::vector<size_t> calc_fold_sizes(const std::vector<unsigned int>& folds)
+		{
+			std::vector<size_t> fold_sizes;
+			for (const auto k : folds) {
+				if (k >= fold_sizes.size()) {
+					fold_sizes.resize(static_cast<size_t>(k) + 1, 0);
+				}
+				++fold_sizes[k];
+			}
+			if (fold_sizes.size() < 2) {
+				throw std::invalid_argument("At least 2 folds required");
+			}
+			if (std::find(fold_sizes.begin(), fold_sizes.end(), 0u) != fold_sizes.end()) {
+				throw std::invalid_argument("Empty fold");
+			}
+			return fold_sizes;
+		}
 	}
 }
\ No newline at end of file
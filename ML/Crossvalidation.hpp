@@ -1,18 +1,46 @@
 #pragma once
 /* (C) 2020 Roman Werpachowski. */
-#include <vector>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 #include <Eigen/Core>
 #include "dll.hpp"
+#include "Parallel.hpp"
 
 namespace ml
 {
-	/** @brief Methods used for cross-validation. */
+	/** @brief Methods used for cross-validation.
+
+	Cross-validation functions accept an optional number of threads. With more than one thread, folds (or left-out data points)
+	are split between threads in contiguous chunks, and `train_func` and `test_func` are called concurrently, so they must be
+	safe to call from several threads at once. Errors are summed in fold order, so the result does not depend on the number of threads.
+
+	Functions with the `_view` suffix pass training and test data to `train_func` and `test_func` as FoldView objects instead of
+	matrices, so that the training data of every fold are not copied. They also accept arbitrary assignments of data points to folds,
+	e.g. shuffled or stratified ones, which are generated from counter-based random streams and do not depend on the number of threads.
+	*/
 	namespace Crossvalidation
-	{		
+	{
+		/** @brief Sums per-fold errors in fold order.
+		@private Used by the cross-validation functions.
+		*/
+		inline double sum_in_order(const std::vector<double>& errors)
+		{
+			double sum = 0;
+			for (const double error : errors) {
+				sum += error;
+			}
+			return sum;
+		}
+
 		/** @brief Calculates indices delimiting a fold.
 
-		Calculates i0 and i1 such that the k-th fold consists of data points with indices in the [i0, i1) range.
+		Calculates i0 and i1 such that the k-th fold consists of data points with indices in the [i0, i1) range. All folds but the last
+		have `round(total_len / num_folds)` points and the last one takes the rest. If that would leave the last fold empty, the k-th fold
+		is `[k * total_len / num_folds, (k + 1) * total_len / num_folds)` instead (rounded down). Every fold is non-empty.
 
 		@param[in] total_len Total number of data points.
 		@param[in] k Fold index with `0 <= k < num_folds`.
@@ -111,6 +139,213 @@ namespace ml
 			return remaining;
 		}
 
+		/** @brief Read-only view of a subset of data points (columns of X and elements of y) which does not copy the data.
+
+		A view either consists of up to two contiguous ranges of data points (e.g. all folds except one, when folds are contiguous),
+		or of the data points assigned (or not assigned) to a given fold by a fold assignment vector. The latter is used for
+		shuffled folds, without reordering X.
+
+		Trainers and testers read the data with for_each_block(), which passes contiguous blocks of data points as references
+		to the original data. In the fold assignment mode, data points forming short runs are gathered into a buffer with at most
+		#gather_block_size columns, so the memory used does not grow with the number of data points.
+
+		The view keeps references to X, y and the fold assignment vector, which must outlive it.
+		*/
+		class FoldView
+		{
+		public:
+			/** @brief Maximum number of data points gathered into one block in the fold assignment mode. */
+			static constexpr Eigen::Index gather_block_size = 256;
+
+			/** @brief Constructs a view of data points with indices in the ranges [i0, i1) and [i2, i3).
+
+			@param[in] X Matrix with all features (data points in columns).
+			@param[in] y Vector with all responses.
+			@param[in] i0 Start of the first range.
+			@param[in] i1 End of the first range.
+			@param[in] i2 Start of the second range.
+			@param[in] i3 End of the second range.
+			@throw std::invalid_argument If `y.size() != X.cols()` or the ranges are not ordered as `0 <= i0 <= i1 <= i2 <= i3 <= X.cols()`.
+			*/
+			DLL_DECLSPEC FoldView(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Eigen::Index i0, Eigen::Index i1, Eigen::Index i2, Eigen::Index i3);
+
+			/** @brief Constructs a view of data points assigned (or not assigned) to a fold.
+
+			@param[in] X Matrix with all features (data points in columns).
+			@param[in] y Vector with all responses.
+			@param[in] folds Fold index of every data point.
+			@param[in] fold Fold index.
+			@param[in] in_fold If true, the view contains the data points in fold `fold`, otherwise the data points in all other folds.
+			@throw std::invalid_argument If `y.size() != X.cols()` or `folds.size() != X.cols()`.
+			*/
+			DLL_DECLSPEC FoldView(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, const std::vector<unsigned int>& folds, unsigned int fold, bool in_fold);
+
+			/** @brief Returns the number of data points in the view. */
+			Eigen::Index size() const
+			{
+				return size_;
+			}
+
+			/** @brief Returns the dimension of data points. */
+			Eigen::Index dim() const
+			{
+				return X_.rows();
+			}
+
+			/** @brief Calls `f(X_block, y_block)` on consecutive blocks of data points in the view, in index order.
+
+			@param[in] f Callable with signature `void(Eigen::Ref<const Eigen::MatrixXd> X_block, Eigen::Ref<const Eigen::VectorXd> y_block)`.
+			@tparam F Callable type.
+			*/
+			template <class F> void for_each_block(F f) const
+			{
+				if (!folds_) {
+					for (const auto& range : ranges_) {
+						if (range.second > range.first) {
+							call(f, X_.middleCols(range.first, range.second - range.first), y_.segment(range.first, range.second - range.first));
+						}
+					}
+					return;
+				}
+				Eigen::MatrixXd X_buffer;
+				Eigen::VectorXd y_buffer;
+				Eigen::Index number_buffered = 0;
+				const auto flush = [&]() {
+					if (number_buffered) {
+						call(f, X_buffer.leftCols(number_buffered), y_buffer.head(number_buffered));
+						number_buffered = 0;
+					}
+				};
+				const auto n = y_.size();
+				Eigen::Index i = 0;
+				while (i < n) {
+					if (!is_selected(i)) {
+						++i;
+						continue;
+					}
+					auto j = i + 1;
+					while (j < n && is_selected(j)) {
+						++j;
+					}
+					if (j - i >= min_direct_run) {
+						flush();
+						call(f, X_.middleCols(i, j - i), y_.segment(i, j - i));
+					} else {
+						if (!X_buffer.size()) {
+							X_buffer.resize(X_.rows(), std::min(gather_block_size, size_));
+							y_buffer.resize(X_buffer.cols());
+						}
+						for (; i < j; ++i) {
+							if (number_buffered == X_buffer.cols()) {
+								flush();
+							}
+							X_buffer.col(number_buffered) = X_.col(i);
+							y_buffer[number_buffered] = y_[i];
+							++number_buffered;
+						}
+					}
+					i = j;
+				}
+				flush();
+			}
+
+			/** @brief Copies the features of data points in the view to a matrix (data points in columns). */
+			DLL_DECLSPEC Eigen::MatrixXd X() const;
+
+			/** @brief Copies the responses of data points in the view to a vector. */
+			DLL_DECLSPEC Eigen::VectorXd y() const;
+		private:
+			/// Runs of at least this many selected data points are passed without gathering.
+			static constexpr Eigen::Index min_direct_run = 32;
+
+			Eigen::Ref<const Eigen::MatrixXd> X_;
+			Eigen::Ref<const Eigen::VectorXd> y_;
+			std::pair<Eigen::Index, Eigen::Index> ranges_[2]; /**< Ranges of data points (range mode only). */
+			const std::vector<unsigned int>* folds_; /**< Fold assignment (fold assignment mode only). */
+			unsigned int fold_;
+			bool in_fold_;
+			Eigen::Index size_;
+
+			bool is_selected(const Eigen::Index i) const
+			{
+				return ((*folds_)[static_cast<size_t>(i)] == fold_) == in_fold_;
+			}
+
+			template <class F> static void call(F& f, const Eigen::Ref<const Eigen::MatrixXd> X_block, const Eigen::Ref<const Eigen::VectorXd> y_block)
+			{
+				f(X_block, y_block);
+			}
+		};
+
+		/** @brief Assigns data points to folds given their permutation.
+
+		Data point `permutation[j]` is assigned to the fold which contains position `j` (see calc_fold_indices()). With a random
+		permutation, this gives shuffled folds without reordering the data.
+
+		@param[in] permutation Permutation of indices 0, ..., N - 1.
+		@param[in] num_folds Number of folds with `num_folds <= N`.
+		@return Vector with fold index of every data point.
+		@throw std::invalid_argument If `permutation` is not a permutation, `num_folds == 0` or `num_folds > N`.
+		*/
+		DLL_DECLSPEC std::vector<unsigned int> folds_from_permutation(const std::vector<size_t>& permutation, unsigned int num_folds);
+
+		/** @brief Assigns data points to contiguous folds, as in calc_fold_indices().
+
+		@param[in] total_len Total number of data points.
+		@param[in] num_folds Number of folds with `num_folds <= total_len`.
+		@return Vector with fold index of every data point.
+		@throw std::invalid_argument If `num_folds == 0` or `num_folds > total_len`.
+		*/
+		DLL_DECLSPEC std::vector<unsigned int> calc_contiguous_folds(size_t total_len, unsigned int num_folds);
+
+		/** @brief Generates a random permutation of indices 0, ..., N - 1.
+
+		Uses the Fisher-Yates shuffle driven by a counter-based random stream (see RandomStreams::Stream), so the permutation
+		depends only on `total_len`, `seed` and `stream`.
+
+		@param[in] total_len Number of indices N.
+		@param[in] seed Random seed.
+		@param[in] stream Random stream index, e.g. the index of a repetition of cross-validation.
+		@return Permutation vector.
+		*/
+		DLL_DECLSPEC std::vector<size_t> random_permutation(size_t total_len, uint64_t seed, uint64_t stream = 0);
+
+		/** @brief Assigns data points randomly to folds, with fold sizes as in calc_fold_indices().
+
+		Equal to `folds_from_permutation(random_permutation(total_len, seed, repeat), num_folds)`.
+
+		@param[in] total_len Total number of data points.
+		@param[in] num_folds Number of folds with `num_folds <= total_len`.
+		@param[in] seed Random seed.
+		@param[in] repeat Index of the repetition of cross-validation; different repetitions use different random streams.
+		@return Vector with fold index of every data point.
+		@throw std::invalid_argument If `num_folds == 0` or `num_folds > total_len`.
+		*/
+		DLL_DECLSPEC std::vector<unsigned int> calc_shuffled_folds(size_t total_len, unsigned int num_folds, uint64_t seed, unsigned int repeat = 0);
+
+		/** @brief Assigns data points randomly to folds, so that every class is spread over the folds as evenly as possible.
+
+		Data points of every class (in increasing order of labels) are shuffled, the shuffled classes are concatenated and
+		the j-th data point in the concatenated list is assigned to fold `j % num_folds`. The numbers of data points of every class
+		in any two folds, as well as the fold sizes, differ by at most 1.
+
+		@param[in] labels Class labels (e.g. the responses for a classification problem).
+		@param[in] num_folds Number of folds with `num_folds <= labels.size()`.
+		@param[in] seed Random seed.
+		@param[in] repeat Index of the repetition of cross-validation; different repetitions use different random streams.
+		@return Vector with fold index of every data point.
+		@throw std::invalid_argument If `num_folds == 0`, `num_folds > labels.size()` or any label is NaN.
+		*/
+		DLL_DECLSPEC std::vector<unsigned int> calc_stratified_folds(Eigen::Ref<const Eigen::VectorXd> labels, unsigned int num_folds, uint64_t seed, unsigned int repeat = 0);
+
+		/** @brief Calculates the number of data points in every fold.
+
+		@param[in] folds Fold index of every data point.
+		@return Vector with fold sizes, with length equal to the number of folds (the largest fold index plus 1).
+		@throw std::invalid_argument If there are fewer than 2 folds or any fold is empty.
+		*/
+		DLL_DECLSPEC std::vector<size_t> calc_fold_sizes(const std::vector<unsigned int>& folds);
+
 		/** @brief Calculates model test error using k-fold cross-validation.
 
 		See https://en.wikipedia.org/wiki/Cross-validation_(statistics)#k-fold_cross-validation
@@ -123,6 +358,7 @@ namespace ml
 		@param[in] train_func Functor returning a trained model given training features and responses as arguments.
 		@param[in] test_func Functor calculating test error per data point given the model, test features and test responses as arguments.
 		@param[in] num_folds Number of folds.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
 
 		@tparam Trainer Functor type for model training.
 		@tparam Tester Functor type for calculating test error.
@@ -131,22 +367,24 @@ namespace ml
 
 		@throw std::invalid_argument If `num_folds > X.cols()` or `y.size() != X.cols()`.
 		*/
-		template <class Trainer, class Tester> double k_fold(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int num_folds)
+		template <class Trainer, class Tester> double k_fold(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int num_folds, const unsigned int number_threads = 1)
 		{
 			if (X.cols() != y.size()) {
 				throw std::invalid_argument("Data size mismatch");
 			}
-			double sum_weighted_errors = 0;
-			for (unsigned int k = 0; k < num_folds; ++k) {
-				const Eigen::MatrixXd train_X(without_kth_fold_2d(X, k, num_folds));
-				const Eigen::VectorXd train_y(without_kth_fold_1d(y, k, num_folds));
-				const auto test_X = only_kth_fold_2d(X, k, num_folds);
-				const auto test_y= only_kth_fold_1d(y, k, num_folds);
-				auto trained_model = train_func(train_X, train_y);
-				const double test_error = test_func(trained_model, test_X, test_y);
-				sum_weighted_errors += test_error * static_cast<double>(test_y.size());
-			}
-			return sum_weighted_errors / static_cast<double>(y.size());
+			std::vector<double> weighted_errors(num_folds);
+			Parallel::for_each_chunk(num_folds, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto k = static_cast<unsigned int>(begin); k < end; ++k) {
+					const Eigen::MatrixXd train_X(without_kth_fold_2d(X, k, num_folds));
+					const Eigen::VectorXd train_y(without_kth_fold_1d(y, k, num_folds));
+					const auto test_X = only_kth_fold_2d(X, k, num_folds);
+					const auto test_y = only_kth_fold_1d(y, k, num_folds);
+					auto trained_model = train_func(train_X, train_y);
+					const double test_error = test_func(trained_model, test_X, test_y);
+					weighted_errors[k] = test_error * static_cast<double>(test_y.size());
+				}
+			});
+			return sum_in_order(weighted_errors) / static_cast<double>(y.size());
 		}
 
 		/** @brief Calculates model test error using k-fold cross-validation (scalar X version).
@@ -161,6 +399,7 @@ namespace ml
 		@param[in] train_func Functor returning a trained model given training features and responses as arguments.
 		@param[in] test_func Functor calculating test error per data point given the model, test features and test responses as arguments.
 		@param[in] num_folds Number of folds.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
 
 		@tparam Trainer Functor type for model training.
 		@tparam Tester Functor type for calculating test error.
@@ -169,22 +408,24 @@ namespace ml
 
 		@throw std::invalid_argument If `num_folds > X.cols()` or `y.size() != y.size()`.
 		*/
-		template <class Trainer, class Tester> double k_fold_scalar(Eigen::Ref<const Eigen::VectorXd> x, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int num_folds)
+		template <class Trainer, class Tester> double k_fold_scalar(Eigen::Ref<const Eigen::VectorXd> x, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int num_folds, const unsigned int number_threads = 1)
 		{
 			if (x.size() != y.size()) {
 				throw std::invalid_argument("Data size mismatch");
 			}
-			double sum_weighted_errors = 0;
-			for (unsigned int k = 0; k < num_folds; ++k) {
-				const Eigen::VectorXd train_X(without_kth_fold_1d(x, k, num_folds));
-				const Eigen::VectorXd train_y(without_kth_fold_1d(y, k, num_folds));
-				const auto test_X = only_kth_fold_1d(x, k, num_folds);
-				const auto test_y = only_kth_fold_1d(y, k, num_folds);
-				auto trained_model = train_func(train_X, train_y);
-				const double test_error = test_func(trained_model, test_X, test_y);
-				sum_weighted_errors += test_error * static_cast<double>(test_y.size());
-			}
-			return sum_weighted_errors / static_cast<double>(y.size());
+			std::vector<double> weighted_errors(num_folds);
+			Parallel::for_each_chunk(num_folds, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto k = static_cast<unsigned int>(begin); k < end; ++k) {
+					const Eigen::VectorXd train_X(without_kth_fold_1d(x, k, num_folds));
+					const Eigen::VectorXd train_y(without_kth_fold_1d(y, k, num_folds));
+					const auto test_X = only_kth_fold_1d(x, k, num_folds);
+					const auto test_y = only_kth_fold_1d(y, k, num_folds);
+					auto trained_model = train_func(train_X, train_y);
+					const double test_error = test_func(trained_model, test_X, test_y);
+					weighted_errors[k] = test_error * static_cast<double>(test_y.size());
+				}
+			});
+			return sum_in_order(weighted_errors) / static_cast<double>(y.size());
 		}
 
 		/** @brief Calculates model test error using leave-one-out cross-validation.
@@ -198,6 +439,7 @@ namespace ml
 		@param[in] y Vector with all responses (scalars).
 		@param[in] train_func Functor returning a trained model given training features and responses as arguments.
 		@param[in] test_func Functor calculating test error per data point given the model, test features and test responses as arguments.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
 
 		@tparam Trainer Functor type for model training.
 		@tparam Tester Functor type for calculating test error.
@@ -206,7 +448,7 @@ namespace ml
 
 		@throw std::invalid_argument If `y.size() < 2` or `y.size() != X.cols()`.
 		*/
-		template <class Trainer, class Tester> double leave_one_out(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func)
+		template <class Trainer, class Tester> double leave_one_out(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int number_threads = 1)
 		{
 			const Eigen::Index n = y.size();
 			if (n < 2) {
@@ -215,24 +457,31 @@ namespace ml
 			if (X.cols() != n) {
 				throw std::invalid_argument("Data size mismatch");
 			}
-			double sum_weighted_errors = 0;			
-			Eigen::MatrixXd train_X(X.rows(), n - 1);
-			Eigen::VectorXd train_y(n - 1);
-			for (Eigen::Index k = 0; k < n; ++k) {
-				if (k) {
-					train_X.leftCols(k) = X.leftCols(k);
-					train_y.head(k) = y.head(k);
-				}
-				if (k + 1 < n) {
-					const auto l = n - k - 1;
-					train_X.rightCols(l) = X.rightCols(l);
-					train_y.tail(l) = y.tail(l);
+			std::vector<double> errors(static_cast<size_t>(n));
+			Parallel::for_each_chunk(errors.size(), number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				// Every thread has its own copy of the training data. Moving from left-out point k - 1 to k changes only column k - 1.
+				Eigen::MatrixXd train_X(X.rows(), n - 1);
+				Eigen::VectorXd train_y(n - 1);
+				for (auto k = static_cast<Eigen::Index>(begin); k < static_cast<Eigen::Index>(end); ++k) {
+					if (k == static_cast<Eigen::Index>(begin)) {
+						if (k) {
+							train_X.leftCols(k) = X.leftCols(k);
+							train_y.head(k) = y.head(k);
+						}
+						if (k + 1 < n) {
+							const auto l = n - k - 1;
+							train_X.rightCols(l) = X.rightCols(l);
+							train_y.tail(l) = y.tail(l);
+						}
+					} else {
+						train_X.col(k - 1) = X.col(k - 1);
+						train_y[k - 1] = y[k - 1];
+					}
+					auto trained_model = train_func(train_X, train_y);
+					errors[static_cast<size_t>(k)] = test_func(trained_model, X.block(0, k, X.rows(), 1), y.segment(k, 1));
 				}
-				auto trained_model = train_func(train_X, train_y);
-				const double test_error = test_func(trained_model, X.block(0, k, X.rows(), 1), y.segment(k, 1));
-				sum_weighted_errors += test_error;
-			}
-			return sum_weighted_errors / static_cast<double>(n);
+			});
+			return sum_in_order(errors) / static_cast<double>(n);
 		}
 
 		/** @brief Calculates model test error using leave-one-out cross-validation (scalar X version).
@@ -246,6 +495,7 @@ namespace ml
 		@param[in] y Vector with all responses (scalars).
 		@param[in] train_func Functor returning a trained model given training features and responses as arguments.
 		@param[in] test_func Functor calculating test error per data point given the model, test features and test responses as arguments.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
 
 		@tparam Trainer Functor type for model training.
 		@tparam Tester Functor type for calculating test error.
@@ -254,7 +504,7 @@ namespace ml
 
 		@throw std::invalid_argument If `y.size() < 2` or `y.size() != x.size()`.
 		*/
-		template <class Trainer, class Tester> double leave_one_out_scalar(const Eigen::Ref<const Eigen::VectorXd> x, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func)
+		template <class Trainer, class Tester> double leave_one_out_scalar(const Eigen::Ref<const Eigen::VectorXd> x, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int number_threads = 1)
 		{
 			const Eigen::Index n = y.size();
 			if (n < 2) {
@@ -263,24 +513,218 @@ namespace ml
 			if (x.size() != n) {
 				throw std::invalid_argument("Data size mismatch");
 			}
-			double sum_weighted_errors = 0;
-			Eigen::VectorXd train_x(n - 1);
-			Eigen::VectorXd train_y(n - 1);
-			for (Eigen::Index k = 0; k < n; ++k) {
-				if (k) {
-					train_x.head(k) = x.head(k);
-					train_y.head(k) = y.head(k);
+			std::vector<double> errors(static_cast<size_t>(n));
+			Parallel::for_each_chunk(errors.size(), number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				// Every thread has its own copy of the training data. Moving from left-out point k - 1 to k changes only element k - 1.
+				Eigen::VectorXd train_x(n - 1);
+				Eigen::VectorXd train_y(n - 1);
+				for (auto k = static_cast<Eigen::Index>(begin); k < static_cast<Eigen::Index>(end); ++k) {
+					if (k == static_cast<Eigen::Index>(begin)) {
+						if (k) {
+							train_x.head(k) = x.head(k);
+							train_y.head(k) = y.head(k);
+						}
+						if (k + 1 < n) {
+							const auto l = n - k - 1;
+							train_x.tail(l) = x.tail(l);
+							train_y.tail(l) = y.tail(l);
+						}
+					} else {
+						train_x[k - 1] = x[k - 1];
+						train_y[k - 1] = y[k - 1];
+					}
+					auto trained_model = train_func(train_x, train_y);
+					errors[static_cast<size_t>(k)] = test_func(trained_model, x.segment(k, 1), y.segment(k, 1));
+				}
+			});
+			return sum_in_order(errors) / static_cast<double>(n);
+		}
+
+		/** @brief Calculates model test error using k-fold cross-validation, passing fold data as FoldView objects.
+
+		Equivalent to k_fold(), but the training data for every fold are not copied: `train_func` receives a FoldView with two
+		contiguous ranges of data points, and `test_func` a FoldView with one.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses (scalars).
+		@param[in] train_func Functor returning a trained model given a `const FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const FoldView&` with test data.
+		@param[in] num_folds Number of folds.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+
+		@return Error value per data point.
+
+		@throw std::invalid_argument If `num_folds > X.cols()` or `y.size() != X.cols()`.
+		*/
+		template <class Trainer, class Tester> double k_fold_view(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int num_folds, const unsigned int number_threads = 1)
+		{
+			if (X.cols() != y.size()) {
+				throw std::invalid_argument("Data size mismatch");
+			}
+			const auto n = X.cols();
+			std::vector<double> weighted_errors(num_folds);
+			Parallel::for_each_chunk(num_folds, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto k = static_cast<unsigned int>(begin); k < end; ++k) {
+					size_t i0, i1;
+					calc_fold_indices(static_cast<size_t>(n), k, num_folds, i0, i1);
+					const auto j0 = static_cast<Eigen::Index>(i0);
+					const auto j1 = static_cast<Eigen::Index>(i1);
+					const FoldView train(X, y, 0, j0, j1, n);
+					const FoldView test(X, y, j0, j1, j1, j1);
+					auto trained_model = train_func(train);
+					const double test_error = test_func(trained_model, test);
+					weighted_errors[k] = test_error * static_cast<double>(test.size());
 				}
-				if (k + 1 < n) {
-					const auto l = n - k - 1;
-					train_x.tail(l) = x.tail(l);
-					train_y.tail(l) = y.tail(l);
+			});
+			return sum_in_order(weighted_errors) / static_cast<double>(n);
+		}
+
+		/** @brief Calculates model test error using k-fold cross-validation with arbitrary assignment of data points to folds, passing fold data as FoldView objects.
+
+		Use with folds_from_permutation() to cross-validate on shuffled folds without reordering the data.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses (scalars).
+		@param[in] train_func Functor returning a trained model given a `const FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const FoldView&` with test data.
+		@param[in] folds Fold index of every data point. Every fold must be non-empty.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+
+		@return Error value per data point.
+
+		@throw std::invalid_argument If `y.size() != X.cols()`, `folds.size() != X.cols()`, there are fewer than 2 folds or any fold is empty.
+		*/
+		template <class Trainer, class Tester> double k_fold_view(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const std::vector<unsigned int>& folds, const unsigned int number_threads = 1)
+		{
+			if (X.cols() != y.size() || static_cast<size_t>(X.cols()) != folds.size()) {
+				throw std::invalid_argument("Data size mismatch");
+			}
+			const auto fold_sizes = calc_fold_sizes(folds);
+			std::vector<double> weighted_errors(fold_sizes.size());
+			Parallel::for_each_chunk(fold_sizes.size(), number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto k = static_cast<unsigned int>(begin); k < end; ++k) {
+					const FoldView train(X, y, folds, k, false);
+					const FoldView test(X, y, folds, k, true);
+					auto trained_model = train_func(train);
+					const double test_error = test_func(trained_model, test);
+					weighted_errors[k] = test_error * static_cast<double>(fold_sizes[k]);
 				}
-				auto trained_model = train_func(train_x, train_y);
-				const double test_error = test_func(trained_model, x.segment(k, 1), y.segment(k, 1));
-				sum_weighted_errors += test_error;
+			});
+			return sum_in_order(weighted_errors) / static_cast<double>(y.size());
+		}
+
+		/** @brief Calculates model test error using leave-one-out cross-validation, passing fold data as FoldView objects.
+
+		Equivalent to leave_one_out(), but the training data are not copied.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses (scalars).
+		@param[in] train_func Functor returning a trained model given a `const FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const FoldView&` with test data.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+
+		@return Error value per data point.
+
+		@throw std::invalid_argument If `y.size() < 2` or `y.size() != X.cols()`.
+		*/
+		template <class Trainer, class Tester> double leave_one_out_view(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const unsigned int number_threads = 1)
+		{
+			const Eigen::Index n = y.size();
+			if (n < 2) {
+				throw std::invalid_argument("Too few data points");
+			}
+			if (X.cols() != n) {
+				throw std::invalid_argument("Data size mismatch");
+			}
+			std::vector<double> errors(static_cast<size_t>(n));
+			Parallel::for_each_chunk(errors.size(), number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto k = static_cast<Eigen::Index>(begin); k < static_cast<Eigen::Index>(end); ++k) {
+					const FoldView train(X, y, 0, k, k + 1, n);
+					const FoldView test(X, y, k, k + 1, k + 1, k + 1);
+					auto trained_model = train_func(train);
+					errors[static_cast<size_t>(k)] = test_func(trained_model, test);
+				}
+			});
+			return sum_in_order(errors) / static_cast<double>(n);
+		}
+
+		/** @brief Calculates model test errors using repeated k-fold cross-validation, passing fold data as FoldView objects.
+
+		Every repetition uses its own assignment of data points to folds, returned by `splitter(repeat)` (e.g. a call to
+		calc_shuffled_folds() or calc_stratified_folds() with the repetition index). All folds of all repetitions are
+		processed in parallel. The results do not depend on the number of threads.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses (scalars).
+		@param[in] train_func Functor returning a trained model given a `const FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const FoldView&` with test data.
+		@param[in] splitter Functor returning the fold assignment vector (`std::vector<unsigned int>`) given the repetition index. May be called concurrently.
+		@param[in] num_repeats Number of repetitions.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+		@tparam Splitter Functor type for assigning data points to folds.
+
+		@return Vector with error value per data point for every repetition. Their mean is the repeated cross-validation error.
+
+		@throw std::invalid_argument If `y.size() != X.cols()`, `num_repeats == 0`, or any fold assignment is invalid (see k_fold_view()).
+		*/
+		template <class Trainer, class Tester, class Splitter> std::vector<double> repeated_k_fold_view(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, Splitter splitter, const unsigned int num_repeats, const unsigned int number_threads = 1)
+		{
+			if (X.cols() != y.size()) {
+				throw std::invalid_argument("Data size mismatch");
 			}
-			return sum_weighted_errors / static_cast<double>(n);
-		}		
+			if (!num_repeats) {
+				throw std::invalid_argument("At least one repetition required");
+			}
+			std::vector<std::vector<unsigned int>> fold_sets(num_repeats);
+			std::vector<std::vector<size_t>> fold_sizes(num_repeats);
+			Parallel::for_each_chunk(num_repeats, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto r = begin; r < end; ++r) {
+					fold_sets[r] = splitter(static_cast<unsigned int>(r));
+					if (fold_sets[r].size() != static_cast<size_t>(X.cols())) {
+						throw std::invalid_argument("Data size mismatch");
+					}
+					fold_sizes[r] = calc_fold_sizes(fold_sets[r]);
+				}
+			});
+			// Every task is a (repetition, fold) pair.
+			std::vector<std::pair<unsigned int, unsigned int>> tasks;
+			for (unsigned int r = 0; r < num_repeats; ++r) {
+				for (unsigned int k = 0; k < fold_sizes[r].size(); ++k) {
+					tasks.emplace_back(r, k);
+				}
+			}
+			std::vector<double> weighted_errors(tasks.size());
+			Parallel::for_each_chunk(tasks.size(), number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto t = begin; t < end; ++t) {
+					const auto r = tasks[t].first;
+					const auto k = tasks[t].second;
+					const FoldView train(X, y, fold_sets[r], k, false);
+					const FoldView test(X, y, fold_sets[r], k, true);
+					auto trained_model = train_func(train);
+					const double test_error = test_func(trained_model, test);
+					weighted_errors[t] = test_error * static_cast<double>(fold_sizes[r][k]);
+				}
+			});
+			std::vector<double> errors(num_repeats, 0.);
+			for (size_t t = 0; t < tasks.size(); ++t) {
+				errors[tasks[t].first] += weighted_errors[t];
+			}
+			for (auto& error : errors) {
+				error /= static_cast<double>(y.size());
+			}
+			return errors;
+		}
 	}
 }
\ No newline at end of file
@@ -321,7 +321,7 @@ namespace ml
 			return static_cast<double>(num_correctly_classified) / static_cast<double>(sample_size);
 		}		
 
-		template <class Trainer, class Tester> std::pair<double, double> find_best_alpha(const std::vector<double>& alphas, Trainer grow_function, Tester test_error_function, const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const unsigned int num_folds)
+		template <class Trainer, class Tester> std::pair<double, double> find_best_alpha(const std::vector<double>& alphas, Trainer grow_function, Tester test_error_function, const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const unsigned int num_folds, const unsigned int number_threads)
 		{
 			double min_cv_test_error = std::numeric_limits<double>::infinity();
 			double best_alpha = -1;
@@ -331,7 +331,7 @@ namespace ml
 					cost_complexity_prune(tree, alpha);
 					return tree;
 				};
-				const double cv_test_error = Crossvalidation::k_fold(X, y, train_func, test_error_function, num_folds);
+				const double cv_test_error = Crossvalidation::k_fold(X, y, train_func, test_error_function, num_folds, number_threads);
 				if (cv_test_error < min_cv_test_error) {
 					min_cv_test_error = cv_test_error;
 					best_alpha = alpha;
@@ -340,7 +340,7 @@ namespace ml
 			return std::make_pair(best_alpha, min_cv_test_error);
 		}
 
-		template <class Y, class Metrics, class Tester> std::tuple<DecisionTree<Y>, double, double> tree_1d_auto_prune(const Metrics metrics, Tester test_error_function, const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const unsigned int max_split_levels, const unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds)
+		template <class Y, class Metrics, class Tester> std::tuple<DecisionTree<Y>, double, double> tree_1d_auto_prune(const Metrics metrics, Tester test_error_function, const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const unsigned int max_split_levels, const unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds, const unsigned int number_threads)
 		{
 			double alpha = std::numeric_limits<double>::quiet_NaN();
 			double min_cv_test_error = std::numeric_limits<double>::quiet_NaN();
@@ -348,7 +348,7 @@ namespace ml
 				auto grow_function = [max_split_levels, min_sample_size, metrics](const Eigen::Ref<const Eigen::MatrixXd> train_X, const Eigen::Ref<const Eigen::VectorXd> train_y) {
 					return tree_1d<Y, Metrics>(metrics, train_X, train_y, max_split_levels, min_sample_size);
 				};
-				const auto best_alpha_and_min_cv_test_error = find_best_alpha(alphas, grow_function, test_error_function, X, y, num_folds);
+				const auto best_alpha_and_min_cv_test_error = find_best_alpha(alphas, grow_function, test_error_function, X, y, num_folds, number_threads);
 				alpha = best_alpha_and_min_cv_test_error.first;
 				min_cv_test_error = best_alpha_and_min_cv_test_error.second;
 			} else if (alphas.size() == 1) {
@@ -361,14 +361,14 @@ namespace ml
 			return std::make_tuple(std::move(tree), alpha, min_cv_test_error);
 		}
 
-		std::tuple<RegressionTree, double, double> regression_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds)
+		std::tuple<RegressionTree, double, double> regression_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds, const unsigned int number_threads)
 		{
-			return tree_1d_auto_prune<double>(RegressionMetrics(), regression_tree_mean_squared_error, X, y, max_split_levels, min_sample_size, alphas, num_folds);
+			return tree_1d_auto_prune<double>(RegressionMetrics(), regression_tree_mean_squared_error, X, y, max_split_levels, min_sample_size, alphas, num_folds, number_threads);
 		}
 
-		std::tuple<ClassificationTree, double, double> classification_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds)
+		std::tuple<ClassificationTree, double, double> classification_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds, const unsigned int number_threads)
 		{
-			return tree_1d_auto_prune<unsigned int>(ClassificationMetrics(static_cast<unsigned int>(y.maxCoeff()) + 1), classification_tree_misclassification_rate, X, y, max_split_levels, min_sample_size, alphas, num_folds);
+			return tree_1d_auto_prune<unsigned int>(ClassificationMetrics(static_cast<unsigned int>(y.maxCoeff()) + 1), classification_tree_misclassification_rate, X, y, max_split_levels, min_sample_size, alphas, num_folds, number_threads);
 		}
 	}
 }
\ No newline at end of file
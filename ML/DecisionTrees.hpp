@@ -24,10 +24,11 @@ namespace ml
 		@param[in] min_sample_size Minimum sample size which can be split (at least 2).
 		@param[in] alphas Candidate alphas for pruning to be selected by cross-validation. If this vector is empty, no pruning is done. If it has just one element, this value is used for pruning. If it has more than one, the one with smallest k-fold cross-validation test error is used.
 		@param[in] num_folds Number of folds for cross-validation. Ignored if cross-validation is not done.
+		@param[in] number_threads Number of threads used to train the folds in cross-validation. If 0, the number of hardware threads is used.
 		@return Tuple of: trained regression tree, chosen alpha (NaN if no pruning was done) and minimum cross-validation test error (NaN if no cross-validation was done).
 		@throw std::invalid_argument If `min_sample_size < 2`, `y.size() < 2` or `X.cols() != y.size()`.
 		*/
-		DLL_DECLSPEC std::tuple<RegressionTree, double, double> regression_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds);
+		DLL_DECLSPEC std::tuple<RegressionTree, double, double> regression_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds, unsigned int number_threads = 1);
 
 		/** @brief Grows a classification tree with pruning.
 		@param[in] X Features (column-wise).
@@ -36,10 +37,11 @@ namespace ml
 		@param[in] min_sample_size Minimum sample size which can be split (at least 2).
 		@param[in] alphas Candidate alphas for pruning to be selected by cross-validation. If this vector is empty, no pruning is done. If it has just one element, this value is used for pruning. If it has more than one, the one with smallest k-fold cross-validation test error is used.
 		@param[in] num_folds Number of folds for cross-validation. Ignored if cross-validation is not done.
+		@param[in] number_threads Number of threads used to train the folds in cross-validation. If 0, the number of hardware threads is used.
 		@return Tuple of: trained classification tree, chosen alpha (NaN if no pruning was done) and minimum cross-validation test error (NaN if no cross-validation was done).
 		@throw std::invalid_argument If `min_sample_size < 2`, `y.size() < 2` or `X.cols() != y.size()`.
 		*/
-		DLL_DECLSPEC std::tuple<ClassificationTree, double, double> classification_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds);		
+		DLL_DECLSPEC std::tuple<ClassificationTree, double, double> classification_tree_auto_prune(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int max_split_levels, unsigned int min_sample_size, const std::vector<double>& alphas, const unsigned int num_folds, unsigned int number_threads = 1);		
 
 		/** @brief Grows a regression tree without pruning.
 		@param[in] X Independent variables (column-wise).
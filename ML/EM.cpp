@@ -3,13 +3,17 @@
 #include <cmath>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <stdexcept>
+#include <tuple>
 #include <Eigen/Cholesky>
 #include <Eigen/Dense>
 #include "Clustering.hpp"
 #include "EM.hpp"
 #include "LinearAlgebra.hpp"
+#include "Parallel.hpp"
 
 #define PI 3.14159265358979323846
 
@@ -27,6 +31,8 @@ namespace ml
 		, relative_tolerance_(1e-8)
 		, number_components_(number_components)
 		, maximum_steps_(1000)
+		, num_inits_(1)
+		, number_threads_(1)
 		, verbose_(false)
 		, maximise_first_(false)
 		, converged_(false)
@@ -65,6 +71,14 @@ namespace ml
 		maximum_steps_ = maximum_steps;
 	}
 
+	void EM::set_number_initialisations(unsigned int number_initialisations)
+	{
+		if (number_initialisations < 1) {
+			throw std::invalid_argument("EM: At least 1 initialisation required");
+		}
+		num_inits_ = number_initialisations;
+	}
+
 	void EM::set_means_initialiser(std::shared_ptr<const Clustering::CentroidsInitialiser> means_initialiser)
 	{
 		if (!means_initialiser) {
@@ -89,6 +103,68 @@ namespace ml
 	}
 
 	bool EM::fit(const Eigen::Ref<const Eigen::MatrixXd> data)
+	{
+		sample_weights_.resize(0);
+		return fit_all(data);
+	}
+
+	bool EM::fit(const Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> weights)
+	{
+		if (weights.size() != data.cols()) {
+			throw std::invalid_argument("EM: Wrong number of weights");
+		}
+		if (!weights.allFinite() || (weights.array() < 0).any()) {
+			throw std::domain_error("EM: Weights must be finite and non-negative");
+		}
+		if (!(weights.sum() > 0)) {
+			throw std::domain_error("EM: At least one weight must be positive");
+		}
+		sample_weights_ = weights;
+		const bool converged = fit_all(data);
+		sample_weights_.resize(0);
+		return converged;
+	}
+
+	bool EM::fit_all(const Eigen::Ref<const Eigen::MatrixXd> data)
+	{
+		if (num_inits_ == 1) {
+			return fit_once(data);
+		}
+		const auto prngs = Clustering::make_initialisation_prngs(prng_, num_inits_);
+		std::unique_ptr<EM> best_fit;
+		unsigned int best_index = 0;
+		std::mutex best_fit_mutex;
+		Parallel::for_each_dynamic(num_inits_, number_threads_, [&](const size_t i, unsigned int) {
+			auto fit = std::make_unique<EM>(number_components_);
+			fit->means_initialiser_ = means_initialiser_;
+			fit->responsibilities_initialiser_ = responsibilities_initialiser_;
+			fit->absolute_tolerance_ = absolute_tolerance_;
+			fit->relative_tolerance_ = relative_tolerance_;
+			fit->maximum_steps_ = maximum_steps_;
+			fit->verbose_ = verbose_;
+			fit->maximise_first_ = maximise_first_;
+			fit->prng_ = prngs[i];
+			fit->sample_weights_ = sample_weights_;
+			fit->fit_once(data);
+			// Converged fits are better than unconverged ones, then higher log-likelihood is better, then lower index.
+			const auto index = static_cast<unsigned int>(i);
+			const std::lock_guard<std::mutex> lock(best_fit_mutex);
+			if (!best_fit || std::make_tuple(!fit->converged_, -fit->log_likelihood_, index) < std::make_tuple(!best_fit->converged_, -best_fit->log_likelihood_, best_index)) {
+				best_fit = std::move(fit);
+				best_index = index;
+			}
+		});
+		const auto prng = prng_;
+		const auto num_inits = num_inits_;
+		const auto number_threads = number_threads_;
+		*this = std::move(*best_fit);
+		prng_ = prng;
+		num_inits_ = num_inits;
+		number_threads_ = number_threads;
+		return converged_;
+	}
+
+	bool EM::fit_once(const Eigen::Ref<const Eigen::MatrixXd> data)
 	{
 		converged_ = false;
 		const auto number_dimensions = static_cast<unsigned int>(data.rows());
@@ -125,8 +201,12 @@ namespace ml
 				maximisation_step(data);
 			} else {
 				// Initialise means and covariances to sensible guesses.
-				means_initialiser_->init(data, prng_, number_components_, means_);
-				const Eigen::MatrixXd sample_covariance(calculate_sample_covariance(data));
+				if (sample_weights_.size()) {
+					means_initialiser_->weighted_init(data, sample_weights_, prng_, number_components_, means_);
+				} else {
+					means_initialiser_->init(data, prng_, number_components_, means_);
+				}
+				const Eigen::MatrixXd sample_covariance(sample_weights_.size() ? calculate_sample_covariance(data, sample_weights_) : calculate_sample_covariance(data));
 				assert(static_cast<unsigned int>(sample_covariance.rows()) == number_dimensions);
 				assert(static_cast<unsigned int>(sample_covariance.cols()) == number_dimensions);
 				for (unsigned int k = 0; k < number_components_; ++k) {
@@ -208,7 +288,11 @@ namespace ml
 			}			
 			component_weights *= mixing_probabilities_[k] / sqrt_covariance_determinants_[k];
 		}
-		log_likelihood_ = responsibilities_.rowwise().sum().array().log().mean() - log_likelihood_normalisation_constant;
+		if (sample_weights_.size()) {
+			log_likelihood_ = (responsibilities_.rowwise().sum().array().log() * sample_weights_.array()).sum() / sample_weights_.sum() - log_likelihood_normalisation_constant;
+		} else {
+			log_likelihood_ = responsibilities_.rowwise().sum().array().log().mean() - log_likelihood_normalisation_constant;
+		}
 
 		// Normalise responsibilities for each datapoint.
 		for (unsigned int i = 0; i < sample_size; ++i) {
@@ -225,8 +309,15 @@ namespace ml
 		const auto sample_size = static_cast<unsigned int>(data.cols());
 		assert(sample_size >= number_components_);
 
+		const bool weighted = sample_weights_.size() > 0;
+		if (weighted) {
+			weighted_responsibilities_ = sample_weights_.asDiagonal() * responsibilities_;
+		}
+		const auto& component_responsibilities = weighted ? weighted_responsibilities_ : responsibilities_;
+		const double total_weight = weighted ? sample_weights_.sum() : static_cast<double>(sample_size);
+
 		// Calculate new means.
-		means_.noalias() = data * responsibilities_; // Unnormalised!
+		means_.noalias() = data * component_responsibilities; // Unnormalised!
 		assert(means_.rows() == number_dimensions);
 		assert(static_cast<unsigned int>(means_.cols()) == number_components_);
 
@@ -234,7 +325,7 @@ namespace ml
 		for (unsigned int k = 0; k < number_components_; ++k) {
 			auto& covariance = covariances_[k];
 			covariance *= 0;
-			const auto component_weights = responsibilities_.col(k);
+			const auto component_weights = component_responsibilities.col(k);
 			const double sum_component_weights = component_weights.sum();
 
 			// Normalise the mean.
@@ -254,7 +345,7 @@ namespace ml
 			for (Eigen::Index i = 0; i < number_dimensions; ++i) {
 				covariance(i, i) += epsilon;
 			}
-			mixing_probabilities_[k] = sum_component_weights / static_cast<double>(sample_size);
+			mixing_probabilities_[k] = sum_component_weights / total_weight;
 			assert(covariance.rows() == number_dimensions);
 			assert(covariance.cols() == number_dimensions);
 		}
@@ -271,6 +362,18 @@ namespace ml
 		return covariance;
 	}
 
+	Eigen::MatrixXd EM::calculate_sample_covariance(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> weights)
+	{
+		const double total_weight = weights.sum();
+		const Eigen::VectorXd mean((data * weights) / total_weight);
+		const Eigen::MatrixXd centred = data.colwise() - mean;
+		// Bessel's correction, treating the total weight as the number of data points (but dividing by at least half of it, for small total weights).
+		const Eigen::MatrixXd covariance = (centred * weights.asDiagonal() * centred.adjoint()) / std::max(total_weight - 1, total_weight / 2);
+		assert(covariance.rows() == covariance.cols());
+		assert(covariance.rows() == data.rows());
+		return covariance;
+	}
+
 	void EM::process_covariances(const Eigen::Index number_dimensions)
 	{
 		// Decompose and invert covariance matrices.
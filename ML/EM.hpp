@@ -59,6 +59,24 @@ namespace ml
 		*/
 		DLL_DECLSPEC void set_responsibilities_initialiser(std::shared_ptr<const Clustering::ResponsibilitiesInitialiser> responsibilities_initialiser);
 
+		/** @brief Sets number of initialisations to try, to find the fit with the highest log-likelihood.
+
+		If there is more than one, the initialisations are run concurrently (see set_number_threads()) on independent copies of the model,
+		with pseudo-random number generators created by Clustering::make_initialisation_prngs(). The first initialisation is the same as a single fit.
+		The converged fit with the highest log-likelihood is chosen (the first one in case of a tie), so the result does not depend on the number of threads.
+		@param[in] number_initialisations Number of initialisations.
+		@throw std::invalid_argument If `number_initialisations < 1`.
+		*/
+		DLL_DECLSPEC void set_number_initialisations(unsigned int number_initialisations);
+
+		/** @brief Sets the number of threads used to run multiple initialisations. Default is 1.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+		*/
+		void set_number_threads(unsigned int number_threads)
+		{
+			number_threads_ = number_threads;
+		}
+
 		/** @brief Switches between verbose and quiet mode.
 		@param[in] verbose `true` if we want verbose output.
 		*/
@@ -81,6 +99,18 @@ namespace ml
 		*/
 		DLL_DECLSPEC bool fit(Eigen::Ref<const Eigen::MatrixXd> data) override;
 
+		/** @brief Fits the model to weighted data points, e.g. a Clustering::Coreset.
+
+		Every point counts as if it was repeated as many times as its weight, in the mixing probabilities, means, covariances and log-likelihood.
+		Means are initialised by Clustering::CentroidsInitialiser::weighted_init(). Responsibilities (if maximising first) are initialised without weights.
+		@param[in] data Matrix (column-major order) with a data point in every column.
+		@param[in] weights Non-negative weights of data points, with size `data.cols()`.
+		@return `true` if fitting converged successfully.
+		@throw std::invalid_argument If `data` has no rows, if the sample size is too low, or if `weights.size() != data.cols()`.
+		@throw std::domain_error If a weight is negative or not finite, or if all weights are zero.
+		*/
+		DLL_DECLSPEC bool fit(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> weights);
+
 		/** @brief Returns the number of components. 
 		*/
 		auto number_components() const
@@ -135,7 +165,7 @@ namespace ml
 			return responsibilities_;
 		}
 
-		/** @brief Returns a const reference to maximised log-likelihood of training data. */
+		/** @brief Returns a const reference to maximised log-likelihood of training data (average per data point, weighted if the data points were weighted). */
 		double log_likelihood() const 
 		{
 			return log_likelihood_;
@@ -171,6 +201,8 @@ namespace ml
 		Eigen::VectorXd mixing_probabilities_;
 		Eigen::MatrixXd means_; /**< 2D matrix with size number_dimensions x number_components. */
 		Eigen::MatrixXd responsibilities_; /**< 2D matrix with size sample_size x number_components. */
+		Eigen::MatrixXd weighted_responsibilities_; /**< Responsibilities multiplied by sample_weights_. */
+		Eigen::VectorXd sample_weights_; /**< Weights of data points, or empty if they are not weighted. */
 		Eigen::VectorXd work_vector_;
 		std::vector<Eigen::MatrixXd> covariances_; /**< Vector of `number_components_` 2D matrices with size number_dimensions x number_dimensions. */
 		std::vector<Eigen::MatrixXd> inverse_covariances_; /**< Inverses of `covariance_` matrices. */
@@ -182,12 +214,22 @@ namespace ml
 		double log_likelihood_;
 		unsigned int number_components_;
 		unsigned int maximum_steps_;
+		unsigned int num_inits_;
+		unsigned int number_threads_;
 		bool verbose_;
 		bool maximise_first_;
 		bool converged_;
 
+		/// Fits the model with all initialisations, using sample_weights_.
+		bool fit_all(Eigen::Ref<const Eigen::MatrixXd> data);
+
+		bool fit_once(Eigen::Ref<const Eigen::MatrixXd> data);
+
 		static Eigen::MatrixXd calculate_sample_covariance(Eigen::Ref<const Eigen::MatrixXd> data);
 
+		/// Calculates the covariance of weighted data, equal to calculate_sample_covariance() for unit weights.
+		static Eigen::MatrixXd calculate_sample_covariance(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> weights);
+
 		void process_covariances(Eigen::Index number_dimensions);
 
 		void expectation_step(Eigen::Ref<const Eigen::MatrixXd> data);
@@ -0,0 +1,291 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+#include "HierarchicalKMeans.hpp"
+#include "Parallel.hpp"
+#include "RandomStreams.hpp"
+
+namespace ml
+{
+    namespace Clustering
+    {
+		/** Splits a budget of leaves between children with given numbers of distinct points, as evenly as possible without giving any child
+		more leaves than distinct points. Requires the budget not to exceed the total number of distinct points.
+		*/
+		static std::vector<unsigned int> split_budget(unsigned int budget, const std::vector<size_t>& children_number_distinct)
+		{
+			std::vector<unsigned int> budgets(children_number_distinct.size(), 0);
+			const auto capacity = [&](const size_t j) {
+				return children_number_distinct[j] - budgets[j];
+			};
+			while (budget) {
+				unsigned int number_open = 0;
+				for (size_t j = 0; j < budgets.size(); ++j) {
+					number_open += capacity(j) > 0;
+				}
+				assert(number_open);
+				const unsigned int share = budget / number_open;
+				unsigned int extra = budget % number_open;
+				for (size_t j = 0; j < budgets.size() && budget; ++j) {
+					if (capacity(j)) {
+						unsigned int added = share;
+						if (extra) {
+							++added;
+							--extra;
+						}
+						added = static_cast<unsigned int>(std::min(static_cast<size_t>(added), capacity(j)));
+						budgets[j] += added;
+						budget -= added;
+					}
+				}
+			}
+			return budgets;
+		}
+
+		/** Returns the index of the first occurrence of every distinct point among the data points with given indices, in lexicographic order of the points.
+		*/
+		static std::vector<Eigen::Index> find_distinct_points(const Eigen::Ref<const Eigen::MatrixXd> data, std::vector<Eigen::Index> indices)
+		{
+			const auto less = [&](const Eigen::Index a, const Eigen::Index b) {
+				return std::lexicographical_compare(data.col(a).begin(), data.col(a).end(), data.col(b).begin(), data.col(b).end());
+			};
+			std::stable_sort(indices.begin(), indices.end(), less);
+			std::vector<Eigen::Index> distinct;
+			for (size_t j = 0; j < indices.size(); ++j) {
+				if (!j || less(indices[j - 1], indices[j])) {
+					distinct.push_back(indices[j]);
+				}
+			}
+			return distinct;
+		}
+
+		HierarchicalKMeans::HierarchicalKMeans(const unsigned int number_clusters, const unsigned int branching_factor)
+			: centroids_initialiser_(std::make_shared<KPP>())
+			, algorithm_(KMeansAlgorithm::LLOYD)
+			, absolute_tolerance_(1e-8)
+			, inertia_(0)
+			, maximum_steps_(1000)
+			, num_clusters_(number_clusters)
+			, num_inits_(1)
+			, branching_factor_(branching_factor)
+			, number_threads_(1)
+			, depth_(0)
+			, converged_(false)
+		{
+			if (!number_clusters) {
+				throw std::invalid_argument("HierarchicalKMeans: number of clusters cannot be zero");
+			}
+			if (branching_factor < 2) {
+				throw std::invalid_argument("HierarchicalKMeans: branching factor must be at least 2");
+			}
+		}
+
+		bool HierarchicalKMeans::fit(const Eigen::Ref<const Eigen::MatrixXd> data)
+		{
+			const auto sample_size = data.cols();
+			if (!data.rows()) {
+				throw std::invalid_argument("HierarchicalKMeans: At least one dimension required");
+			}
+			if (sample_size < num_clusters_) {
+				throw std::invalid_argument("HierarchicalKMeans: Not enough data");
+			}
+			std::vector<Eigen::Index> all_indices(static_cast<size_t>(sample_size));
+			std::iota(all_indices.begin(), all_indices.end(), Eigen::Index(0));
+			// Duplicate points cannot be split between leaves.
+			if (find_distinct_points(data, all_indices).size() < num_clusters_) {
+				throw std::invalid_argument("HierarchicalKMeans: Not enough distinct data points");
+			}
+			// Node to be fitted, with the points assigned to it and its budget of leaves, which does not exceed its number of distinct points.
+			struct Task
+			{
+				size_t node;
+				std::vector<Eigen::Index> indices;
+				unsigned int budget;
+			};
+			nodes_.assign(1, Node{ 0, 0, 0 });
+			std::vector<Eigen::VectorXd> node_centroids(1, data.rowwise().mean());
+			std::vector<Task> level(1, Task{ 0, std::move(all_indices), num_clusters_ });
+			const uint64_t seed = prng_();
+			const auto number_threads = Parallel::resolve_number_threads(number_threads_);
+			unsigned int number_leaves = 0;
+			depth_ = 0;
+			converged_ = true;
+			while (!level.empty()) {
+				const auto number_fits = static_cast<unsigned int>(std::count_if(level.begin(), level.end(), [](const Task& task) { return task.budget > 1; }));
+				const auto number_threads_per_fit = std::max(1u, number_threads / std::max(1u, number_fits));
+				std::vector<Eigen::MatrixXd> level_centroids(level.size());
+				std::vector<std::vector<std::vector<Eigen::Index>>> level_children_indices(level.size());
+				std::vector<std::vector<size_t>> level_children_number_distinct(level.size());
+				std::vector<char> level_converged(level.size(), 1);
+				Parallel::for_each_dynamic(level.size(), number_threads, [&](const size_t i, unsigned int) {
+					const auto& task = level[i];
+					if (task.budget == 1) {
+						return;
+					}
+					Eigen::MatrixXd X(data.rows(), static_cast<Eigen::Index>(task.indices.size()));
+					for (Eigen::Index j = 0; j < X.cols(); ++j) {
+						X.col(j) = data.col(task.indices[static_cast<size_t>(j)]);
+					}
+					const auto number_children = std::min(branching_factor_, task.budget);
+					KMeans km(number_children);
+					km.set_seed(static_cast<unsigned int>(RandomStreams::Stream(seed, task.node)()));
+					km.set_absolute_tolerance(absolute_tolerance_);
+					km.set_maximum_steps(maximum_steps_);
+					km.set_number_initialisations(num_inits_);
+					km.set_centroids_initialiser(centroids_initialiser_);
+					km.set_algorithm(algorithm_);
+					km.set_number_threads(number_threads_per_fit);
+					level_converged[i] = km.fit(X);
+					auto& centroids = level_centroids[i];
+					centroids = km.centroids();
+					std::vector<unsigned int> labels(km.labels());
+					if (std::count(labels.begin(), labels.end(), labels.front()) == static_cast<std::ptrdiff_t>(labels.size())) {
+						// K-means did not split the points (e.g. the initialiser chose duplicate points). The node has at least
+						// as many distinct points as children, so centring the children on distinct points splits it.
+						const auto distinct = find_distinct_points(data, task.indices);
+						for (Eigen::Index k = 0; k < centroids.cols(); ++k) {
+							centroids.col(k) = data.col(distinct[static_cast<size_t>(k)]);
+						}
+						Eigen::VectorXd squared_distances(X.cols());
+						find_closest_centroids(X, centroids, labels, squared_distances);
+						std::vector<Eigen::VectorXd> sums(number_children, Eigen::VectorXd::Zero(data.rows()));
+						std::vector<double> counts(number_children, 0);
+						for (Eigen::Index j = 0; j < X.cols(); ++j) {
+							sums[labels[static_cast<size_t>(j)]] += X.col(j);
+							++counts[labels[static_cast<size_t>(j)]];
+						}
+						for (Eigen::Index k = 0; k < centroids.cols(); ++k) {
+							centroids.col(k) = sums[static_cast<size_t>(k)] / counts[static_cast<size_t>(k)];
+						}
+					}
+					auto& children_indices = level_children_indices[i];
+					children_indices.resize(number_children);
+					for (size_t j = 0; j < task.indices.size(); ++j) {
+						children_indices[labels[j]].push_back(task.indices[j]);
+					}
+					auto& children_number_distinct = level_children_number_distinct[i];
+					for (const auto& indices : children_indices) {
+						children_number_distinct.push_back(find_distinct_points(data, indices).size());
+					}
+					});
+				// Children are added in the order of nodes in the level, so that nodes and labels do not depend on the number of threads.
+				std::vector<Task> next_level;
+				for (size_t i = 0; i < level.size(); ++i) {
+					auto& task = level[i];
+					if (task.budget == 1) {
+						nodes_[task.node].label = number_leaves++;
+						continue;
+					}
+					converged_ = converged_ && level_converged[i];
+					const auto& centroids = level_centroids[i];
+					auto& children_indices = level_children_indices[i];
+					const auto budgets = split_budget(task.budget, level_children_number_distinct[i]);
+					nodes_[task.node].first_child = nodes_.size();
+					for (size_t k = 0; k < budgets.size(); ++k) {
+						// Empty clusters get no leaves.
+						if (budgets[k]) {
+							next_level.push_back(Task{ nodes_.size(), std::move(children_indices[k]), budgets[k] });
+							nodes_.push_back(Node{ 0, 0, 0 });
+							node_centroids.push_back(centroids.col(static_cast<Eigen::Index>(k)));
+							++nodes_[task.node].number_children;
+						}
+					}
+				}
+				if (!next_level.empty()) {
+					++depth_;
+				}
+				level = std::move(next_level);
+			}
+			node_centroids_.resize(data.rows(), static_cast<Eigen::Index>(nodes_.size()));
+			centroids_.resize(data.rows(), num_clusters_);
+			for (size_t n = 0; n < nodes_.size(); ++n) {
+				node_centroids_.col(static_cast<Eigen::Index>(n)) = node_centroids[n];
+				if (!nodes_[n].number_children) {
+					centroids_.col(nodes_[n].label) = node_centroids[n];
+				}
+			}
+
+			labels_.resize(static_cast<size_t>(sample_size));
+			Eigen::VectorXd squared_distances(sample_size);
+			Parallel::for_each_chunk(static_cast<size_t>(sample_size), number_threads_, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto i = begin; i < end; ++i) {
+					const auto label_and_distance = descend(data.col(static_cast<Eigen::Index>(i)));
+					labels_[i] = label_and_distance.first;
+					squared_distances[static_cast<Eigen::Index>(i)] = label_and_distance.second;
+				}
+				});
+			// Summed in the order of data points, so that the inertia does not depend on the number of threads.
+			inertia_ = 0;
+			for (Eigen::Index i = 0; i < sample_size; ++i) {
+				inertia_ += squared_distances[i];
+			}
+			return converged_;
+		}
+
+		void HierarchicalKMeans::set_seed(const unsigned int seed)
+		{
+			prng_.seed(seed);
+		}
+
+		void HierarchicalKMeans::set_absolute_tolerance(const double absolute_tolerance)
+		{
+			if (absolute_tolerance < 0) {
+				throw std::domain_error("HierarchicalKMeans: Negative absolute tolerance");
+			}
+			absolute_tolerance_ = absolute_tolerance;
+		}
+
+		void HierarchicalKMeans::set_maximum_steps(const unsigned int maximum_steps)
+		{
+			if (maximum_steps < 2) {
+				throw std::invalid_argument("HierarchicalKMeans: At least two steps required for convergence test");
+			}
+			maximum_steps_ = maximum_steps;
+		}
+
+		void HierarchicalKMeans::set_number_initialisations(const unsigned int number_initialisations)
+		{
+			if (number_initialisations < 1) {
+				throw std::invalid_argument("HierarchicalKMeans: At least 1 initialisation required");
+			}
+			num_inits_ = number_initialisations;
+		}
+
+		void HierarchicalKMeans::set_centroids_initialiser(std::shared_ptr<const CentroidsInitialiser> centroids_initialiser)
+		{
+			if (!centroids_initialiser) {
+				throw std::invalid_argument("HierarchicalKMeans: Null centroids initialiser");
+			}
+			centroids_initialiser_ = centroids_initialiser;
+		}
+
+		std::pair<unsigned int, double> HierarchicalKMeans::assign_label(const Eigen::Ref<const Eigen::VectorXd> x) const
+		{
+			if (x.size() != centroids_.rows()) {
+				throw std::invalid_argument("HierarchicalKMeans: Data dimension mismatch");
+			}
+			return descend(x);
+		}
+
+		std::pair<unsigned int, double> HierarchicalKMeans::descend(const Eigen::Ref<const Eigen::VectorXd> x) const
+		{
+			size_t node = 0;
+			double min_squared_distance = (x - node_centroids_.col(0)).squaredNorm();
+			while (nodes_[node].number_children) {
+				const auto& parent = nodes_[node];
+				node = parent.first_child;
+				min_squared_distance = (x - node_centroids_.col(static_cast<Eigen::Index>(node))).squaredNorm();
+				for (auto child = node + 1; child < parent.first_child + parent.number_children; ++child) {
+					const auto squared_distance = (x - node_centroids_.col(static_cast<Eigen::Index>(child))).squaredNorm();
+					if (squared_distance < min_squared_distance) {
+						min_squared_distance = squared_distance;
+						node = child;
+					}
+				}
+			}
+			return std::make_pair(nodes_[node].label, min_squared_distance);
+		}
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include "Clustering.hpp"
+#include "KMeans.hpp"
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+#include "dll.hpp"
+
+namespace ml
+{
+    namespace Clustering
+    {
+        /**
+         * @brief Hierarchical (tree-structured) K-means clustering, for very large numbers of clusters.
+         *
+         * Builds a tree of centroids by clustering the data with KMeans into at most `b` clusters (the branching factor), and then recursively
+         * clustering the points in every cluster (Nistér and Stewénius, "Scalable Recognition with a Vocabulary Tree", 2006). Each node
+         * has a budget of leaves, split evenly between its children (and moved to the other children if a child has fewer distinct points than its share);
+         * a node with a budget of one leaf is a leaf. If K-means puts all points of a node in one cluster, e.g. because of duplicate points,
+         * the node is split by centring its children on distinct points, so that the tree always grows towards the leaves. The leaves are the K clusters, so the tree has depth about \f$ \log_b K \f$.
+         *
+         * Building the tree costs \f$ O(n b d \log_b K) \f$ per K-means step instead of \f$ O(n K d) \f$, and assign_label() descends
+         * the tree greedily, choosing the closest child at every level, in \f$ O(b d \log_b K) \f$ instead of \f$ O(K d) \f$.
+         * The assigned leaf is not always the closest one.
+         *
+         * The tree is built level by level, and the nodes in every level are fitted concurrently (see set_number_threads()).
+         * Every node is fitted with its own pseudo-random number generator, seeded from a counter-based random stream (see RandomStreams::Stream)
+         * keyed by the index of the node, so the results do not depend on the number of threads.
+        */
+        class HierarchicalKMeans : public Model
+        {
+        public:
+            /** @brief Constructs a hierarchical K-means model ready to fit.
+            @param[in] number_clusters Number of clusters (leaves of the tree).
+            @param[in] branching_factor Maximum number of children of a node.
+            @throw std::invalid_argument If `number_clusters == 0` or `branching_factor < 2`.
+            */
+            DLL_DECLSPEC HierarchicalKMeans(unsigned int number_clusters, unsigned int branching_factor = 10);
+
+            /** @brief Fits the model.
+
+            After building the tree, all data points are assigned to leaves by assign_label(), to calculate labels() and inertia().
+            @return `true` if the K-means fits in all nodes converged.
+            @throw std::invalid_argument If `data` has no rows or fewer than number_clusters() distinct columns.
+            */
+            DLL_DECLSPEC bool fit(Eigen::Ref<const Eigen::MatrixXd> data) override;
+
+            unsigned int number_clusters() const override
+            {
+                return num_clusters_;
+            }
+
+            const std::vector<unsigned int>& labels() const override
+            {
+                return labels_;
+            }
+
+            /** @brief Centroids of the leaves, in the order of labels. */
+            const Eigen::MatrixXd& centroids() const override
+            {
+                return centroids_;
+            }
+
+            /** @brief Maximum number of children of a node. */
+            unsigned int branching_factor() const
+            {
+                return branching_factor_;
+            }
+
+            /** @brief Number of levels below the root, i.e. the maximum number of centroid comparisons in assign_label() is `branching_factor() * depth()`. */
+            unsigned int depth() const
+            {
+                return depth_;
+            }
+
+            /** @brief Sets PRNG seed.
+            @param[in] seed PRNG seed.
+            */
+            DLL_DECLSPEC void set_seed(unsigned int seed);
+
+            /** @brief Sets absolute tolerance for the convergence test of K-means in every node (see KMeans::set_absolute_tolerance()).
+            @param[in] absolute_tolerance Absolute tolerance.
+            @throw std::domain_error If `absolute_tolerance < 0`.
+            */
+            DLL_DECLSPEC void set_absolute_tolerance(double absolute_tolerance);
+
+            /** @brief Sets maximum number of K-means steps in every node.
+            @param[in] maximum_steps Maximum number of steps.
+            @throw std::invalid_argument If `maximum_steps < 2`.
+            */
+            DLL_DECLSPEC void set_maximum_steps(unsigned int maximum_steps);
+
+            /** @brief Sets number of initialisations to try in every node (see KMeans::set_number_initialisations()). Default is 1.
+            @param[in] number_initialisations Number of initialisations.
+            @throw std::invalid_argument If `number_initialisations < 1`.
+            */
+            DLL_DECLSPEC void set_number_initialisations(unsigned int number_initialisations);
+
+            /** @brief Sets centroids initialiser used in every node. Default is KPP.
+            @param[in] centroids_initialiser Pointer to CentroidsInitialiser implementation.
+            @throw std::invalid_argument If `centroids_initialiser` is null.
+            */
+            DLL_DECLSPEC void set_centroids_initialiser(std::shared_ptr<const CentroidsInitialiser> centroids_initialiser);
+
+            /** @brief Sets the algorithm used to assign points to centroids in every node. Default is KMeansAlgorithm::LLOYD.
+            @param[in] algorithm Assignment algorithm.
+            */
+            void set_algorithm(KMeansAlgorithm algorithm)
+            {
+                algorithm_ = algorithm;
+            }
+
+            /** @brief Sets the number of threads. Default is 1. The results do not depend on it.
+
+            Nodes in the same level are fitted concurrently. If there are fewer nodes than threads, the remaining threads are shared by the K-means fits.
+            @param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+            */
+            void set_number_threads(unsigned int number_threads)
+            {
+                number_threads_ = number_threads;
+            }
+
+            /** @brief Given a data point x, descend the tree to a leaf and return its label and the squared Euclidean distance to its centroid.
+
+            @param[in] x Data point with correct dimension.
+            @throw std::invalid_argument If `x.size() != centroids().rows()`.
+            */
+            DLL_DECLSPEC std::pair<unsigned int, double> assign_label(Eigen::Ref<const Eigen::VectorXd> x) const;
+
+            /**
+             * @brief Sum of squared distances to the centroids of the assigned leaves.
+             * @return Non-negative number;
+            */
+            double inertia() const
+            {
+                return inertia_;
+            }
+
+            bool converged() const override
+            {
+                return converged_;
+            }
+        private:
+            /// Node of the tree. Children of a node have consecutive indices.
+            struct Node
+            {
+                size_t first_child; /**< Index of the first child. */
+                unsigned int number_children; /**< Number of children, 0 for a leaf. */
+                unsigned int label; /**< Label of a leaf. */
+            };
+
+            std::vector<Node> nodes_; /**< Nodes in breadth-first order, starting from the root. */
+            std::vector<unsigned int> labels_;
+            Eigen::MatrixXd node_centroids_; /**< Centroids of the nodes, in the order of `nodes_`. The root centroid is the mean of all data. */
+            Eigen::MatrixXd centroids_;
+            std::default_random_engine prng_;
+            std::shared_ptr<const CentroidsInitialiser> centroids_initialiser_;
+            KMeansAlgorithm algorithm_;
+            double absolute_tolerance_;
+            double inertia_;
+            unsigned int maximum_steps_;
+            unsigned int num_clusters_;
+            unsigned int num_inits_;
+            unsigned int branching_factor_;
+            unsigned int number_threads_;
+            unsigned int depth_;
+            bool converged_;
+
+            /// Finds the leaf reached by x and the squared distance to its centroid.
+            std::pair<unsigned int, double> descend(Eigen::Ref<const Eigen::VectorXd> x) const;
+        };
+    }
+}
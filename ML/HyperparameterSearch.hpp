@@ -0,0 +1,343 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Crossvalidation.hpp"
+#include "Parallel.hpp"
+#include "RandomStreams.hpp"
+
+namespace ml
+{
+	/** @brief Hyperparameter search using k-fold cross-validation.
+
+	Candidates are hyperparameter values of any copyable type `Param` (e.g. `double` for a regularisation strength, or a struct).
+	Models are trained and tested with the functor convention of Crossvalidation::k_fold_view(), extended with the hyperparameters:
+	`train_func(param, train)` returns a model trained with hyperparameters `param` on the data in `const Crossvalidation::FoldView& train`,
+	and `test_func(model, test)` returns its test error per data point on the data in `const Crossvalidation::FoldView& test`.
+
+	All (candidate, fold) pairs evaluated at the same stage of a search are trained on one set of threads, which take
+	the next pair as soon as they finish the previous one. All candidates read the same data through views, without copying it.
+	`train_func` and `test_func` are called concurrently, so they must be safe to call from several threads at once.
+	The results do not depend on the number of threads.
+
+	Successive halving and Hyperband evaluate candidates on the first few folds only, and drop poor candidates before
+	evaluating them on the remaining folds. Use shuffled folds (see Crossvalidation::calc_shuffled_folds()) so that the first
+	folds are representative.
+	*/
+	namespace HyperparameterSearch
+	{
+		/** @brief Result of a hyperparameter search.
+		@tparam Param Hyperparameter type.
+		*/
+		template <class Param> struct SearchResult
+		{
+			std::vector<Param> candidates; /**< All candidates considered. */
+			std::vector<double> errors; /**< Cross-validation error per data point of every candidate, on the folds it was evaluated on. */
+			std::vector<unsigned int> number_folds; /**< Number of folds (the first ones) every candidate was evaluated on. */
+			size_t best; /**< Index of the candidate with the lowest error among those evaluated on all folds (the lowest index in case of a tie). */
+			size_t number_trainings; /**< Total number of calls to `train_func`. */
+
+			/** @brief Returns the best candidate. */
+			const Param& best_candidate() const
+			{
+				return candidates[best];
+			}
+
+			/** @brief Returns the cross-validation error of the best candidate. */
+			double best_error() const
+			{
+				return errors[best];
+			}
+		};
+
+		/** @brief Evaluates candidates on increasing numbers of folds, reusing the errors on folds already evaluated.
+		@private Used by the search functions.
+		*/
+		template <class Param, class Trainer, class Tester> class CandidateEvaluator
+		{
+		public:
+			CandidateEvaluator(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, Trainer train_func, Tester test_func, const std::vector<unsigned int>& folds, const unsigned int number_threads)
+				: X_(X), y_(y), train_func_(train_func), test_func_(test_func), folds_(folds), number_threads_(number_threads), number_trainings_(0)
+			{
+				if (X.cols() != y.size() || static_cast<size_t>(X.cols()) != folds.size()) {
+					throw std::invalid_argument("Data size mismatch");
+				}
+				fold_sizes_ = Crossvalidation::calc_fold_sizes(folds);
+			}
+
+			unsigned int number_folds() const
+			{
+				return static_cast<unsigned int>(fold_sizes_.size());
+			}
+
+			size_t number_candidates() const
+			{
+				return candidates_.size();
+			}
+
+			/// Adds a candidate and returns its index.
+			size_t add(const Param& candidate)
+			{
+				candidates_.push_back(candidate);
+				weighted_errors_.emplace_back();
+				return candidates_.size() - 1;
+			}
+
+			/// Evaluates candidates on the first `number_folds` folds.
+			void evaluate(const std::vector<size_t>& indices, const unsigned int number_folds)
+			{
+				std::vector<std::pair<size_t, unsigned int>> tasks;
+				for (const auto c : indices) {
+					for (auto k = static_cast<unsigned int>(weighted_errors_[c].size()); k < number_folds; ++k) {
+						tasks.emplace_back(c, k);
+					}
+				}
+				std::vector<double> weighted_errors(tasks.size());
+				Parallel::for_each_dynamic(tasks.size(), number_threads_, [&](const size_t t, unsigned int) {
+					const auto c = tasks[t].first;
+					const auto k = tasks[t].second;
+					const Crossvalidation::FoldView train(X_, y_, folds_, k, false);
+					const Crossvalidation::FoldView test(X_, y_, folds_, k, true);
+					auto trained_model = train_func_(candidates_[c], train);
+					weighted_errors[t] = test_func_(trained_model, test) * static_cast<double>(fold_sizes_[k]);
+				});
+				// Tasks of every candidate are in fold order.
+				for (size_t t = 0; t < tasks.size(); ++t) {
+					weighted_errors_[tasks[t].first].push_back(weighted_errors[t]);
+				}
+				number_trainings_ += tasks.size();
+			}
+
+			/// Calculates the error per data point of a candidate on the folds it was evaluated on, or NaN if it was not evaluated.
+			double error(const size_t c) const
+			{
+				const auto& weighted_errors = weighted_errors_[c];
+				if (weighted_errors.empty()) {
+					return std::numeric_limits<double>::quiet_NaN();
+				}
+				double sum = 0;
+				size_t size = 0;
+				for (size_t k = 0; k < weighted_errors.size(); ++k) {
+					sum += weighted_errors[k];
+					size += fold_sizes_[k];
+				}
+				return sum / static_cast<double>(size);
+			}
+
+			/// Sorts candidates by increasing error (by index in case of a tie) and keeps the first `number_kept`.
+			void keep_best(std::vector<size_t>& indices, const size_t number_kept) const
+			{
+				std::vector<std::pair<double, size_t>> ranked;
+				for (const auto c : indices) {
+					const double e = error(c);
+					ranked.emplace_back(std::isnan(e) ? std::numeric_limits<double>::infinity() : e, c);
+				}
+				std::sort(ranked.begin(), ranked.end());
+				indices.resize(std::min(number_kept, indices.size()));
+				for (size_t i = 0; i < indices.size(); ++i) {
+					indices[i] = ranked[i].second;
+				}
+			}
+
+			/// Evaluates candidates by successive halving, starting with `min_folds` folds and multiplying it by `eta` at each stage.
+			void successive_halving(std::vector<size_t> indices, const unsigned int min_folds, const unsigned int eta)
+			{
+				auto number_folds_evaluated = std::min(min_folds, number_folds());
+				while (true) {
+					evaluate(indices, number_folds_evaluated);
+					if (number_folds_evaluated == number_folds()) {
+						break;
+					}
+					keep_best(indices, std::max<size_t>(1, indices.size() / eta));
+					number_folds_evaluated = std::min(number_folds(), number_folds_evaluated * eta);
+				}
+			}
+
+			SearchResult<Param> result() const
+			{
+				SearchResult<Param> result;
+				result.candidates = candidates_;
+				result.best = candidates_.size();
+				for (size_t c = 0; c < candidates_.size(); ++c) {
+					result.errors.push_back(error(c));
+					result.number_folds.push_back(static_cast<unsigned int>(weighted_errors_[c].size()));
+					if (result.number_folds[c] == number_folds() && (result.best == candidates_.size() || result.errors[c] < result.errors[result.best] || (std::isnan(result.errors[result.best]) && !std::isnan(result.errors[c])))) {
+						result.best = c;
+					}
+				}
+				result.number_trainings = number_trainings_;
+				return result;
+			}
+		private:
+			Eigen::Ref<const Eigen::MatrixXd> X_;
+			Eigen::Ref<const Eigen::VectorXd> y_;
+			Trainer train_func_;
+			Tester test_func_;
+			const std::vector<unsigned int>& folds_;
+			std::vector<size_t> fold_sizes_;
+			unsigned int number_threads_;
+			size_t number_trainings_;
+			std::vector<Param> candidates_;
+			std::vector<std::vector<double>> weighted_errors_; /**< Test errors times fold sizes, for every candidate and evaluated fold. */
+		};
+
+		/** @brief Returns the hyperparameter type generated by a sampler.
+		@private Used by the search functions.
+		*/
+		template <class Sampler> using SampledParam = std::decay_t<std::invoke_result_t<Sampler&, RandomStreams::Stream&>>;
+
+		/** @brief Evaluates every candidate on all folds.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses.
+		@param[in] candidates Candidate hyperparameter values, e.g. points of a grid.
+		@param[in] train_func Functor returning a trained model given the hyperparameters and a `const Crossvalidation::FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const Crossvalidation::FoldView&` with test data.
+		@param[in] folds Fold index of every data point. Every fold must be non-empty.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+		@tparam Param Hyperparameter type.
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+		@return SearchResult object.
+		@throw std::invalid_argument If `candidates` is empty, `y.size() != X.cols()`, `folds.size() != X.cols()`, there are fewer than 2 folds or any fold is empty.
+		*/
+		template <class Param, class Trainer, class Tester> SearchResult<Param> grid_search(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, const std::vector<Param>& candidates, Trainer train_func, Tester test_func, const std::vector<unsigned int>& folds, const unsigned int number_threads = 1)
+		{
+			if (candidates.empty()) {
+				throw std::invalid_argument("No candidates");
+			}
+			CandidateEvaluator<Param, Trainer, Tester> evaluator(X, y, train_func, test_func, folds, number_threads);
+			std::vector<size_t> indices;
+			for (const auto& candidate : candidates) {
+				indices.push_back(evaluator.add(candidate));
+			}
+			evaluator.evaluate(indices, evaluator.number_folds());
+			return evaluator.result();
+		}
+
+		/** @brief Evaluates randomly sampled candidates on all folds.
+
+		Candidate `i` is `sampler(stream)`, where `stream` is `RandomStreams::Stream(seed, i)`, so the candidates depend only on `seed`.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses.
+		@param[in] sampler Functor returning a candidate given a `RandomStreams::Stream&`.
+		@param[in] number_candidates Number of sampled candidates.
+		@param[in] seed Random seed.
+		@param[in] train_func Functor returning a trained model given the hyperparameters and a `const Crossvalidation::FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const Crossvalidation::FoldView&` with test data.
+		@param[in] folds Fold index of every data point. Every fold must be non-empty.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+		@tparam Sampler Functor type for sampling candidates.
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+		@return SearchResult object.
+		@throw std::invalid_argument If `number_candidates == 0`, `y.size() != X.cols()`, `folds.size() != X.cols()`, there are fewer than 2 folds or any fold is empty.
+		*/
+		template <class Sampler, class Trainer, class Tester> SearchResult<SampledParam<Sampler>> random_search(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Sampler sampler, const unsigned int number_candidates, const uint64_t seed, Trainer train_func, Tester test_func, const std::vector<unsigned int>& folds, const unsigned int number_threads = 1)
+		{
+			std::vector<SampledParam<Sampler>> candidates;
+			for (unsigned int i = 0; i < number_candidates; ++i) {
+				RandomStreams::Stream stream(seed, i);
+				candidates.push_back(sampler(stream));
+			}
+			return grid_search(X, y, candidates, train_func, test_func, folds, number_threads);
+		}
+
+		/** @brief Searches candidates by successive halving, using folds as the resource.
+
+		All candidates are evaluated on the first `min_folds` folds. The best `1 / eta` of them (at least one) are then evaluated
+		on `eta` times as many folds, and so on, until the remaining candidates are evaluated on all folds. Errors on folds evaluated
+		at earlier stages are reused.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses.
+		@param[in] candidates Candidate hyperparameter values.
+		@param[in] train_func Functor returning a trained model given the hyperparameters and a `const Crossvalidation::FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const Crossvalidation::FoldView&` with test data.
+		@param[in] folds Fold index of every data point. Every fold must be non-empty.
+		@param[in] eta Reduction factor, at least 2.
+		@param[in] min_folds Number of folds at the first stage, at least 1.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+		@tparam Param Hyperparameter type.
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+		@return SearchResult object.
+		@throw std::invalid_argument If `candidates` is empty, `eta < 2`, `min_folds == 0`, `y.size() != X.cols()`, `folds.size() != X.cols()`, there are fewer than 2 folds or any fold is empty.
+		*/
+		template <class Param, class Trainer, class Tester> SearchResult<Param> successive_halving(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, const std::vector<Param>& candidates, Trainer train_func, Tester test_func, const std::vector<unsigned int>& folds, const unsigned int eta = 3, const unsigned int min_folds = 1, const unsigned int number_threads = 1)
+		{
+			if (candidates.empty()) {
+				throw std::invalid_argument("No candidates");
+			}
+			if (eta < 2) {
+				throw std::invalid_argument("Reduction factor must be at least 2");
+			}
+			if (!min_folds) {
+				throw std::invalid_argument("At least one fold required at the first stage");
+			}
+			CandidateEvaluator<Param, Trainer, Tester> evaluator(X, y, train_func, test_func, folds, number_threads);
+			std::vector<size_t> indices;
+			for (const auto& candidate : candidates) {
+				indices.push_back(evaluator.add(candidate));
+			}
+			evaluator.successive_halving(indices, min_folds, eta);
+			return evaluator.result();
+		}
+
+		/** @brief Searches randomly sampled candidates with the Hyperband algorithm, using folds as the resource.
+
+		See Li et al., "Hyperband: A Novel Bandit-Based Approach to Hyperparameter Optimization" (2018). With K folds and
+		\f$ s_{\max} = \lfloor \log_\eta K \rfloor \f$, runs successive_halving() for brackets \f$ s = s_{\max}, \ldots, 0 \f$, with
+		\f$ \lceil (s_{\max} + 1) \eta^s / (s + 1) \rceil \f$ new candidates evaluated first on \f$ \max(1, \lfloor K / \eta^s \rfloor) \f$ folds.
+		Bracket \f$ s_{\max} \f$ explores many candidates with aggressive early stopping; bracket 0 evaluates few candidates on all folds.
+
+		Candidate `i` (counting over all brackets) is `sampler(stream)`, where `stream` is `RandomStreams::Stream(seed, i)`.
+
+		@param[in] X Matrix with all features (data points in columns).
+		@param[in] y Vector with all responses.
+		@param[in] sampler Functor returning a candidate given a `RandomStreams::Stream&`.
+		@param[in] seed Random seed.
+		@param[in] train_func Functor returning a trained model given the hyperparameters and a `const Crossvalidation::FoldView&` with training data.
+		@param[in] test_func Functor calculating test error per data point given the model and a `const Crossvalidation::FoldView&` with test data.
+		@param[in] folds Fold index of every data point. Every fold must be non-empty.
+		@param[in] eta Reduction factor, at least 2.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+		@tparam Sampler Functor type for sampling candidates.
+		@tparam Trainer Functor type for model training.
+		@tparam Tester Functor type for calculating test error.
+		@return SearchResult object.
+		@throw std::invalid_argument If `eta < 2`, `y.size() != X.cols()`, `folds.size() != X.cols()`, there are fewer than 2 folds or any fold is empty.
+		*/
+		template <class Sampler, class Trainer, class Tester> SearchResult<SampledParam<Sampler>> hyperband(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Sampler sampler, const uint64_t seed, Trainer train_func, Tester test_func, const std::vector<unsigned int>& folds, const unsigned int eta = 3, const unsigned int number_threads = 1)
+		{
+			if (eta < 2) {
+				throw std::invalid_argument("Reduction factor must be at least 2");
+			}
+			CandidateEvaluator<SampledParam<Sampler>, Trainer, Tester> evaluator(X, y, train_func, test_func, folds, number_threads);
+			const auto K = evaluator.number_folds();
+			unsigned int s_max = 0;
+			unsigned int eta_power = 1; // eta^s_max
+			while (eta_power * eta <= K) {
+				eta_power *= eta;
+				++s_max;
+			}
+			for (unsigned int s = s_max + 1; s-- > 0; eta_power /= eta) {
+				const auto number_candidates = ((s_max + 1) * eta_power + s) / (s + 1);
+				std::vector<size_t> indices;
+				for (unsigned int i = 0; i < number_candidates; ++i) {
+					RandomStreams::Stream stream(seed, evaluator.number_candidates());
+					indices.push_back(evaluator.add(sampler(stream)));
+				}
+				evaluator.successive_halving(indices, std::max(1u, K / eta_power), eta);
+			}
+			return evaluator.result();
+		}
+	}
+}
@@ -1,7 +1,15 @@
 /* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <tuple>
 #include "KMeans.hpp"
+#include "Parallel.hpp"
 
 namespace ml
 {
@@ -11,45 +19,199 @@ namespace ml
 			: work_vector_(number_clusters)
 			, centroids_initialiser_(std::make_shared<Clustering::Forgy>())
 			, absolute_tolerance_(1e-8)
+			, bound_slack_(0)
 			, maximum_steps_(1000)
 			, num_inits_(1)
 			, num_clusters_(number_clusters)
+			, number_threads_(1)
+			, algorithm_(KMeansAlgorithm::LLOYD)
 			, verbose_(false)
 			, converged_(false)
+			, bounds_valid_(false)
+			, labels_changed_(false)
 		{
 			if (!number_clusters) {
 				throw std::invalid_argument("KMeans: number of clusters cannot be zero");
 			}
 		}
 
+		/// Maximum number of data points in a leaf of the kd-tree used by the filtering algorithm.
+		static constexpr Eigen::Index filtering_leaf_size = 8;
+
+		/// Depth of the kd-tree nodes whose subtrees are filtered as separate tasks, which can run on different threads.
+		static constexpr unsigned int filtering_task_depth = 6;
+
+		/// Owner of a tree node whose points were not all assigned to the same centroid as a whole.
+		static constexpr unsigned int mixed_owner = std::numeric_limits<unsigned int>::max();
+
+		/// Owner of the tree nodes before the first assignment step.
+		static constexpr unsigned int no_owner = mixed_owner - 1;
+
+		struct KMeans::FilteringTree
+		{
+			/// Node with points in columns [begin, end) of `data`.
+			struct Node
+			{
+				Eigen::Index begin;
+				Eigen::Index end;
+				Eigen::Index left; /**< Index of the left child, or -1 for a leaf. */
+				Eigen::Index right; /**< Index of the right child, or -1 for a leaf. */
+			};
+
+			Eigen::MatrixXd data; /**< Data points in tree order. */
+			std::vector<Eigen::Index> indices; /**< Original index of every column of `data`. */
+			Eigen::MatrixXd lower; /**< Lower corners of the bounding boxes of the nodes. */
+			Eigen::MatrixXd upper; /**< Upper corners of the bounding boxes of the nodes. */
+			Eigen::MatrixXd sums; /**< Sums of the points in the nodes (weighted, if the points are). */
+			Eigen::VectorXd node_weights; /**< Total weights of the points in the nodes. */
+			Eigen::VectorXd weights; /**< Weights of the points in tree order, or empty if they are not weighted. */
+			std::vector<Node> nodes; /**< Nodes in depth-first order, starting from the root. */
+
+			/// Builds the tree from the data and the weights of data points (empty if they are not weighted).
+			FilteringTree(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> w)
+				: indices(static_cast<size_t>(X.cols()))
+			{
+				std::iota(indices.begin(), indices.end(), Eigen::Index(0));
+				const auto number_nodes = count_nodes(X.cols());
+				lower.resize(X.rows(), number_nodes);
+				upper.resize(X.rows(), number_nodes);
+				sums.resize(X.rows(), number_nodes);
+				node_weights.resize(number_nodes);
+				nodes.reserve(static_cast<size_t>(number_nodes));
+				build(X, w, 0, X.cols());
+				data.resize(X.rows(), X.cols());
+				for (Eigen::Index p = 0; p < X.cols(); ++p) {
+					data.col(p) = X.col(indices[static_cast<size_t>(p)]);
+				}
+				if (w.size()) {
+					weights.resize(w.size());
+					for (Eigen::Index p = 0; p < w.size(); ++p) {
+						weights[p] = w[indices[static_cast<size_t>(p)]];
+					}
+				}
+			}
+		private:
+			/// Number of nodes in a tree with n points.
+			static Eigen::Index count_nodes(const Eigen::Index n)
+			{
+				return n > filtering_leaf_size ? 1 + count_nodes(n / 2) + count_nodes(n - n / 2) : 1;
+			}
+
+			/// Builds the subtree of points `indices[begin:end]`, splitting them at the median of the widest dimension of their bounding box.
+			Eigen::Index build(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> w, const Eigen::Index begin, const Eigen::Index end)
+			{
+				const auto node = static_cast<Eigen::Index>(nodes.size());
+				nodes.push_back(Node{ begin, end, -1, -1 });
+				lower.col(node) = X.col(indices[static_cast<size_t>(begin)]);
+				upper.col(node) = lower.col(node);
+				sums.col(node).setZero();
+				node_weights[node] = 0;
+				for (auto p = begin; p < end; ++p) {
+					const auto i = indices[static_cast<size_t>(p)];
+					const auto x = X.col(i);
+					lower.col(node) = lower.col(node).cwiseMin(x);
+					upper.col(node) = upper.col(node).cwiseMax(x);
+					if (w.size()) {
+						sums.col(node) += w[i] * x;
+						node_weights[node] += w[i];
+					} else {
+						sums.col(node) += x;
+						node_weights[node] += 1;
+					}
+				}
+				if (end - begin > filtering_leaf_size) {
+					Eigen::Index dimension;
+					(upper.col(node) - lower.col(node)).maxCoeff(&dimension);
+					const auto middle = begin + (end - begin) / 2;
+					std::nth_element(indices.begin() + begin, indices.begin() + middle, indices.begin() + end, [&X, dimension](const Eigen::Index a, const Eigen::Index b) {
+						return X(dimension, a) < X(dimension, b);
+						});
+					const auto left = build(X, w, begin, middle);
+					const auto right = build(X, w, middle, end);
+					nodes[static_cast<size_t>(node)].left = left;
+					nodes[static_cast<size_t>(node)].right = right;
+				}
+				return node;
+			}
+		};
+
 		bool KMeans::fit(Eigen::Ref<const Eigen::MatrixXd> data)
 		{
+			sample_weights_.resize(0);
+			return fit_all(data);
+		}
+
+		bool KMeans::fit(Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::VectorXd> weights)
+		{
+			if (weights.size() != data.cols()) {
+				throw std::invalid_argument("KMeans: Wrong number of weights");
+			}
+			if (!weights.allFinite() || (weights.array() < 0).any()) {
+				throw std::domain_error("KMeans: Weights must be finite and non-negative");
+			}
+			if (!(weights.sum() > 0)) {
+				throw std::domain_error("KMeans: At least one weight must be positive");
+			}
+			sample_weights_ = weights;
+			const bool converged = fit_all(data);
+			sample_weights_.resize(0);
+			return converged;
+		}
+
+		bool KMeans::fit_all(Eigen::Ref<const Eigen::MatrixXd> data)
+		{
+			if (algorithm_ == KMeansAlgorithm::FILTERING && data.rows() && data.cols() > num_clusters_) {
+				filtering_tree_ = std::make_shared<const FilteringTree>(data, sample_weights_);
+			}
+			bool converged;
 			if (num_inits_ == 1) {
-				return fit_once(data);
+				converged = fit_once(data);
 			} else {
-				converged_ = false;
-				double min_inertia = std::numeric_limits<double>::infinity();
-				Eigen::MatrixXd best_centroids;				
-				for (unsigned int i = 0; i < num_inits_; ++i) {
-					if (fit_once(data)) {
-						if (inertia_ < min_inertia) {
-							min_inertia = inertia_;
-							best_centroids = centroids_;
-						}
-						converged_ = true;
+				const auto prngs = make_initialisation_prngs(prng_, num_inits_);
+				const auto number_threads = Parallel::resolve_number_threads(number_threads_);
+				// Threads not needed to run initialisations concurrently are used within them.
+				const auto number_threads_per_fit = std::max(1u, number_threads / num_inits_);
+				std::unique_ptr<KMeans> best_fit;
+				unsigned int best_index = 0;
+				std::mutex best_fit_mutex;
+				Parallel::for_each_dynamic(num_inits_, number_threads, [&](const size_t i, unsigned int) {
+					auto fit = std::make_unique<KMeans>(num_clusters_);
+					fit->centroids_initialiser_ = centroids_initialiser_;
+					fit->absolute_tolerance_ = absolute_tolerance_;
+					fit->maximum_steps_ = maximum_steps_;
+					fit->algorithm_ = algorithm_;
+					fit->verbose_ = verbose_;
+					fit->number_threads_ = number_threads_per_fit;
+					fit->prng_ = prngs[i];
+					fit->filtering_tree_ = filtering_tree_;
+					fit->sample_weights_ = sample_weights_;
+					fit->fit_once(data);
+					// Converged fits are better than unconverged ones, then lower inertia is better, then lower index.
+					const auto index = static_cast<unsigned int>(i);
+					const std::lock_guard<std::mutex> lock(best_fit_mutex);
+					if (!best_fit || std::make_tuple(!fit->converged_, fit->inertia_, index) < std::make_tuple(!best_fit->converged_, best_fit->inertia_, best_index)) {
+						best_fit = std::move(fit);
+						best_index = index;
 					}
-				}
-				if (converged_) {
-					centroids_ = best_centroids;
-					assignment_step(data);
-				}
-				return converged_;
+				});
+				const auto prng = prng_;
+				const auto num_inits = num_inits_;
+				const auto number_threads_setting = number_threads_;
+				*this = std::move(*best_fit);
+				prng_ = prng;
+				num_inits_ = num_inits;
+				number_threads_ = number_threads_setting;
+				converged = converged_;
 			}
+			// The tree holds a copy of the data.
+			filtering_tree_.reset();
+			return converged;
 		}
 
 		bool KMeans::fit_once(Eigen::Ref<const Eigen::MatrixXd> data)
 		{
 			converged_ = false;
+			bounds_valid_ = false;
 			const auto number_dimensions = static_cast<unsigned int>(data.rows());
 			const auto sample_size = static_cast<unsigned int>(data.cols());
 			if (!number_dimensions) {
@@ -63,6 +225,13 @@ namespace ml
 			old_centroids_.resize(number_dimensions, num_clusters_);
 			labels_.resize(sample_size);
 			old_labels_.resize(sample_size);			
+			data_squared_norms_ = data.colwise().squaredNorm().transpose();
+			min_squared_distances_.resize(sample_size);
+			if (algorithm_ == KMeansAlgorithm::FILTERING && sample_size > num_clusters_) {
+				assert(filtering_tree_);
+				node_owners_.assign(filtering_tree_->nodes.size(), no_owner);
+				tree_labels_.resize(sample_size);
+			}
 
 			if (sample_size == num_clusters_) {
 				// An exact deterministic fit is possible.
@@ -74,7 +243,11 @@ namespace ml
 				inertia_ = 0;
 				converged_ = true;				
 			} else {
-				centroids_initialiser_->init(data, prng_, num_clusters_, centroids_);
+				if (sample_weights_.size()) {
+					centroids_initialiser_->weighted_init(data, sample_weights_, prng_, num_clusters_, centroids_);
+				} else {
+					centroids_initialiser_->init(data, prng_, num_clusters_, centroids_);
+				}
 
 				// Main iteration loop.
 				for (unsigned int step = 0; step < maximum_steps_; ++step) {
@@ -82,7 +255,7 @@ namespace ml
 					assignment_step(data);
 
 					if (step > 0) {
-						if (old_labels_ == labels_) {
+						if (algorithm_ == KMeansAlgorithm::FILTERING ? !labels_changed_ : old_labels_ == labels_) {
 							converged_ = true;
 							break;
 						}
@@ -108,6 +281,10 @@ namespace ml
 						}
 					}
 				}
+				if (algorithm_ == KMeansAlgorithm::FILTERING) {
+					// If the loop ended without converging, the last assignment was made before the centroids were updated.
+					set_filtering_labels(data, converged_ ? centroids_ : old_centroids_);
+				}
 			}
 
 			return converged_;
@@ -155,39 +332,417 @@ namespace ml
 			double min_squared_distance = std::numeric_limits<double>::infinity();
 			unsigned int label = 0;
 			for (unsigned int k = 0; k < num_clusters_; ++k) {
-				const auto squared_distance = (x - centroids_.col(k)).squaredNorm();
-				if (squared_distance < min_squared_distance) {
-					min_squared_distance = squared_distance;
+				const auto squared_distance_k = squared_distance(x, k);
+				if (squared_distance_k < min_squared_distance) {
+					min_squared_distance = squared_distance_k;
 					label = k;
 				}
 			}
 			return std::make_pair(label, min_squared_distance);
 		}
 
+		/// Relative margin by which distance bounds are loosened. Much larger than rounding errors in distances, so that
+		/// skipping a centroid never changes the label chosen by assign_label(). Bounds are also loosened by `bound_margin`
+		/// times the largest norms of data points and centroids (see KMeans::bound_slack_), which covers rounding errors
+		/// in the coordinates when the data have a large common offset.
+		static constexpr double bound_margin = 1e-10;
+
+		std::pair<unsigned int, double> KMeans::assign_label_with_bounds(const Eigen::Ref<const Eigen::VectorXd> x, const Eigen::Index i)
+		{
+			const bool elkan = algorithm_ == KMeansAlgorithm::ELKAN;
+			double min_squared_distance = std::numeric_limits<double>::infinity();
+			double second_min_squared_distance = min_squared_distance;
+			unsigned int label = 0;
+			for (unsigned int k = 0; k < num_clusters_; ++k) {
+				const auto squared_distance_k = squared_distance(x, k);
+				if (elkan) {
+					lower_bounds_(k, i) = std::sqrt(squared_distance_k) * (1 - bound_margin) - bound_slack_;
+				}
+				// Same tie-breaking as in assign_label().
+				if (squared_distance_k < min_squared_distance) {
+					second_min_squared_distance = min_squared_distance;
+					min_squared_distance = squared_distance_k;
+					label = k;
+				} else if (squared_distance_k < second_min_squared_distance) {
+					second_min_squared_distance = squared_distance_k;
+				}
+			}
+			if (!elkan) {
+				lower_bounds_(0, i) = std::sqrt(second_min_squared_distance) * (1 - bound_margin) - bound_slack_;
+			}
+			return std::make_pair(label, min_squared_distance);
+		}
+
 		void KMeans::assignment_step(Eigen::Ref<const Eigen::MatrixXd> data)
 		{
+			if (algorithm_ == KMeansAlgorithm::FILTERING) {
+				// Labels and inertia are set after the last step.
+				filtering_assignment_step();
+				return;
+			}
 			const auto sample_size = data.cols();
 			assert(labels_.size() == static_cast<size_t>(sample_size));
 			old_labels_.swap(labels_); // Save previoous labels.
-			inertia_ = 0;
-			for (Eigen::Index i = 0; i < sample_size; ++i) {
-				const auto label_and_distance = assign_label(data.col(i));
-				labels_[i] = label_and_distance.first;
-				inertia_ += label_and_distance.second;
+			if (algorithm_ == KMeansAlgorithm::LLOYD) {
+				find_closest_centroids(data, data_squared_norms_, centroids_, labels_, min_squared_distances_, number_threads_);
+			} else {
+				bounded_assignment_step(data);
+			}
+			// Summed in the order of data points, so that the inertia does not depend on the algorithm or the number of threads.
+			inertia_ = sum_squared_distances();
+		}
+
+		double KMeans::sum_squared_distances() const
+		{
+			double sum = 0;
+			if (sample_weights_.size()) {
+				for (Eigen::Index i = 0; i < min_squared_distances_.size(); ++i) {
+					sum += sample_weights_[i] * min_squared_distances_[i];
+				}
+			} else {
+				for (Eigen::Index i = 0; i < min_squared_distances_.size(); ++i) {
+					sum += min_squared_distances_[i];
+				}
 			}
+			return sum;
+		}
+
+		void KMeans::bounded_assignment_step(Eigen::Ref<const Eigen::MatrixXd> data)
+		{
+			const auto sample_size = data.cols();
+			const bool elkan = algorithm_ == KMeansAlgorithm::ELKAN;
+			const Eigen::Index number_bounds = elkan ? num_clusters_ : 1;
+			bound_slack_ = bound_margin * (std::sqrt(data_squared_norms_.maxCoeff()) + centroids_.colwise().norm().maxCoeff());
+			if (!bounds_valid_ || lower_bounds_.rows() != number_bounds || lower_bounds_.cols() != sample_size) {
+				lower_bounds_.resize(number_bounds, sample_size);
+				Parallel::for_each_chunk(static_cast<size_t>(sample_size), number_threads_, [&](const size_t begin, const size_t end, unsigned int) {
+					for (auto i = static_cast<Eigen::Index>(begin); i < static_cast<Eigen::Index>(end); ++i) {
+						const auto label_and_distance = assign_label_with_bounds(data.col(i), i);
+						labels_[i] = label_and_distance.first;
+						min_squared_distances_[i] = label_and_distance.second;
+					}
+				});
+				bounded_centroids_ = centroids_;
+				bounds_valid_ = true;
+				return;
+			}
+			// By the triangle inequality, the distance to a centroid decreases by at most the distance it moved.
+			centroid_shifts_ = ((centroids_ - bounded_centroids_).colwise().norm().transpose() * (1 + bound_margin)).array() + bound_slack_;
+			bounded_centroids_ = centroids_;
+			// Hamerly: the lower bound applies to all centroids except the assigned one, so it is decreased by the largest shift among them.
+			unsigned int max_shift_label = 0;
+			double max_shift = 0;
+			double second_max_shift = 0;
+			// Elkan: a centroid k cannot be closer than the assigned centroid a if the distance to a is below half of the distance between them.
+			// The diagonal holds half of the distance from a to its nearest other centroid.
+			if (elkan) {
+				half_centroid_distances_.resize(num_clusters_, num_clusters_);
+				for (unsigned int a = 0; a < num_clusters_; ++a) {
+					half_centroid_distances_(a, a) = std::numeric_limits<double>::infinity();
+				}
+				for (unsigned int a = 0; a < num_clusters_; ++a) {
+					for (unsigned int b = a + 1; b < num_clusters_; ++b) {
+						const double half_distance = 0.5 * (centroids_.col(a) - centroids_.col(b)).norm() * (1 - bound_margin) - bound_slack_;
+						half_centroid_distances_(a, b) = half_centroid_distances_(b, a) = half_distance;
+						half_centroid_distances_(a, a) = std::min(half_centroid_distances_(a, a), half_distance);
+						half_centroid_distances_(b, b) = std::min(half_centroid_distances_(b, b), half_distance);
+					}
+				}
+			} else {
+				for (unsigned int k = 0; k < num_clusters_; ++k) {
+					const double shift = centroid_shifts_[k];
+					if (shift > max_shift) {
+						second_max_shift = max_shift;
+						max_shift = shift;
+						max_shift_label = k;
+					} else if (shift > second_max_shift) {
+						second_max_shift = shift;
+					}
+				}
+			}
+			// Every point is processed independently.
+			Parallel::for_each_chunk(static_cast<size_t>(sample_size), number_threads_, [&](const size_t begin, const size_t end, unsigned int) {
+				bounded_assignment_step(data, static_cast<Eigen::Index>(begin), static_cast<Eigen::Index>(end), max_shift_label, max_shift, second_max_shift);
+			});
+		}
+
+		void KMeans::bounded_assignment_step(Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Index begin, const Eigen::Index end, const unsigned int max_shift_label, const double max_shift, const double second_max_shift)
+		{
+			const bool elkan = algorithm_ == KMeansAlgorithm::ELKAN;
+			for (Eigen::Index i = begin; i < end; ++i) {
+				// The distance to the assigned centroid is always calculated exactly, so that the inertia does not depend on the algorithm.
+				unsigned int label = old_labels_[i];
+				double min_squared_distance = squared_distance(data.col(i), label);
+				double upper_bound = std::sqrt(min_squared_distance) * (1 + bound_margin) + bound_slack_;
+				if (elkan) {
+					auto lower_bounds = lower_bounds_.col(i);
+					lower_bounds = ((lower_bounds.array() - centroid_shifts_.array()) * (1 - bound_margin) - bound_slack_).matrix();
+					if (!(upper_bound < half_centroid_distances_(label, label))) {
+						for (unsigned int k = 0; k < num_clusters_; ++k) {
+							if (k == label || upper_bound < lower_bounds[k] || upper_bound < half_centroid_distances_(label, k)) {
+								continue;
+							}
+							const auto squared_distance_k = squared_distance(data.col(i), k);
+							lower_bounds[k] = std::sqrt(squared_distance_k) * (1 - bound_margin) - bound_slack_;
+							// Same tie-breaking as in assign_label().
+							if (squared_distance_k < min_squared_distance || (squared_distance_k == min_squared_distance && k < label)) {
+								lower_bounds[label] = std::sqrt(min_squared_distance) * (1 - bound_margin) - bound_slack_;
+								label = k;
+								min_squared_distance = squared_distance_k;
+								upper_bound = std::sqrt(min_squared_distance) * (1 + bound_margin) + bound_slack_;
+							}
+						}
+					}
+				} else {
+					double& lower_bound = lower_bounds_(0, i);
+					lower_bound = (lower_bound - (label == max_shift_label ? second_max_shift : max_shift)) * (1 - bound_margin) - bound_slack_;
+					if (!(upper_bound < lower_bound)) {
+						const auto label_and_distance = assign_label_with_bounds(data.col(i), i);
+						label = label_and_distance.first;
+						min_squared_distance = label_and_distance.second;
+					}
+				}
+				labels_[i] = label;
+				min_squared_distances_[i] = min_squared_distance;
+			}
+		}
+
+		/// Maximum number of blocks of data points for which partial centroid sums are accumulated.
+		static constexpr Eigen::Index max_number_blocks = 64;
+
+		/// Minimum number of data points in a block.
+		static constexpr Eigen::Index min_block_size = 1024;
+
+		/// Maximum total size of partial centroid sums for all blocks.
+		static constexpr Eigen::Index max_block_sums_size = 1 << 22;
+
+		/// Calculates the number of blocks, which depends only on the data and the number of clusters.
+		static Eigen::Index calc_number_blocks(const Eigen::Index sample_size, const Eigen::Index number_dimensions, const Eigen::Index number_clusters)
+		{
+			const auto max_blocks_for_memory = max_block_sums_size / (number_dimensions * number_clusters);
+			return std::max(Eigen::Index(1), std::min({ max_number_blocks, sample_size / min_block_size, max_blocks_for_memory }));
 		}
 
 		void KMeans::update_step(Eigen::Ref<const Eigen::MatrixXd> data)
 		{
-			work_vector_.setZero();
+			const Eigen::Index K = num_clusters_;
+			if (algorithm_ == KMeansAlgorithm::FILTERING) {
+				// Partial sums for every filtering task were calculated by filtering_assignment_step().
+				update_centroids(block_counts_.size() / K);
+				return;
+			}
+			const auto sample_size = data.cols();
+			const auto number_blocks = calc_number_blocks(sample_size, data.rows(), K);
+			block_sums_.setZero(data.rows(), K * number_blocks);
+			block_counts_.setZero(K * number_blocks);
+			Parallel::for_each_chunk(static_cast<size_t>(number_blocks), number_threads_, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto b = static_cast<Eigen::Index>(begin); b < static_cast<Eigen::Index>(end); ++b) {
+					auto sums = block_sums_.middleCols(b * K, K);
+					auto counts = block_counts_.segment(b * K, K);
+					const auto i_end = (b + 1) * sample_size / number_blocks;
+					for (auto i = b * sample_size / number_blocks; i < i_end; ++i) {
+						const unsigned int label = labels_[static_cast<size_t>(i)];
+						if (sample_weights_.size()) {
+							sums.col(label) += sample_weights_[i] * data.col(i);
+							counts[label] += sample_weights_[i];
+						} else {
+							sums.col(label) += data.col(i);
+							++counts[label];
+						}
+					}
+				}
+			});
+			update_centroids(number_blocks);
+		}
+
+		void KMeans::update_centroids(const Eigen::Index number_blocks)
+		{
+			const Eigen::Index K = num_clusters_;
+			// Added in block order, so that the result does not depend on the number of threads.
 			old_centroids_.swap(centroids_);
-			centroids_.setZero();
+			centroids_ = block_sums_.leftCols(K);
+			work_vector_ = block_counts_.head(K);
+			for (Eigen::Index b = 1; b < number_blocks; ++b) {
+				centroids_ += block_sums_.middleCols(b * K, K);
+				work_vector_ += block_counts_.segment(b * K, K);
+			}
+			for (Eigen::Index k = 0; k < K; ++k) {
+				// Centroids of empty clusters are set to zero.
+				if (work_vector_[k] > 0) {
+					centroids_.col(k) /= work_vector_[k];
+				}
+			}
+		}
+
+		void KMeans::filtering_assignment_step()
+		{
+			const Eigen::Index K = num_clusters_;
+			const auto number_dimensions = filtering_tree_->data.rows();
+			std::vector<unsigned int> candidates(num_clusters_);
+			std::iota(candidates.begin(), candidates.end(), 0u);
+			// Nodes at the task depth with more than one candidate are filtered separately, each with its own partial sums. The tasks depend only
+			// on the tree and the centroids, so the sums do not depend on the number of threads.
+			std::vector<std::pair<Eigen::Index, std::vector<unsigned int>>> tasks;
+			Eigen::MatrixXd root_sums(Eigen::MatrixXd::Zero(number_dimensions, K));
+			Eigen::VectorXd root_counts(Eigen::VectorXd::Zero(K));
+			labels_changed_ = filter_node(0, candidates, 0, 0, root_sums, root_counts, &tasks);
+			const auto number_tasks = static_cast<Eigen::Index>(tasks.size());
+			block_sums_.resize(number_dimensions, K * (number_tasks + 1));
+			block_counts_.resize(K * (number_tasks + 1));
+			block_sums_.leftCols(K) = root_sums;
+			block_counts_.head(K) = root_counts;
+			std::vector<char> task_labels_changed(tasks.size(), false);
+			Parallel::for_each_dynamic(tasks.size(), number_threads_, [&](const size_t t, unsigned int) {
+				const auto block = static_cast<Eigen::Index>(t) + 1;
+				auto sums = block_sums_.middleCols(block * K, K);
+				auto counts = block_counts_.segment(block * K, K);
+				sums.setZero();
+				counts.setZero();
+				task_labels_changed[t] = filter_node(tasks[t].first, tasks[t].second, 0, filtering_task_depth, sums, counts, nullptr);
+			});
+			labels_changed_ = labels_changed_ || std::find(task_labels_changed.begin(), task_labels_changed.end(), true) != task_labels_changed.end();
+		}
+
+		bool KMeans::filter_node(const Eigen::Index node, std::vector<unsigned int>& candidates, const size_t candidates_begin, const unsigned int depth, Eigen::Ref<Eigen::MatrixXd> sums, Eigen::Ref<Eigen::VectorXd> counts, std::vector<std::pair<Eigen::Index, std::vector<unsigned int>>>* tasks)
+		{
+			const auto& tree = *filtering_tree_;
+			const auto& tree_node = tree.nodes[static_cast<size_t>(node)];
+			auto& owner = node_owners_[static_cast<size_t>(node)];
+			const auto candidates_end = candidates.size();
+			if (tree_node.left < 0) {
+				// Leaf: same tie-breaking as in assign_label(), because candidates are kept in ascending order.
+				bool labels_changed = false;
+				for (auto p = tree_node.begin; p < tree_node.end; ++p) {
+					const auto x = tree.data.col(p);
+					unsigned int label = candidates[candidates_begin];
+					double min_squared_distance = squared_distance(x, label);
+					for (auto j = candidates_begin + 1; j < candidates_end; ++j) {
+						const auto squared_distance_k = squared_distance(x, candidates[j]);
+						if (squared_distance_k < min_squared_distance) {
+							min_squared_distance = squared_distance_k;
+							label = candidates[j];
+						}
+					}
+					auto& tree_label = tree_labels_[static_cast<size_t>(p)];
+					labels_changed = labels_changed || label != (owner == mixed_owner ? tree_label : owner);
+					tree_label = label;
+					if (tree.weights.size()) {
+						sums.col(label) += tree.weights[p] * x;
+						counts[label] += tree.weights[p];
+					} else {
+						sums.col(label) += x;
+						++counts[label];
+					}
+				}
+				owner = mixed_owner;
+				return labels_changed;
+			}
+			if (tasks && depth == filtering_task_depth) {
+				tasks->emplace_back(node, std::vector<unsigned int>(candidates.begin() + static_cast<std::ptrdiff_t>(candidates_begin), candidates.end()));
+				return false;
+			}
+			const auto lower = tree.lower.col(node);
+			const auto upper = tree.upper.col(node);
+			// The candidate closest to the middle of the bounding box.
+			unsigned int closest = candidates[candidates_begin];
+			double min_squared_distance = std::numeric_limits<double>::infinity();
+			for (auto j = candidates_begin; j < candidates_end; ++j) {
+				const auto squared_distance_k = ((lower + upper) / 2 - centroids_.col(candidates[j])).squaredNorm();
+				if (squared_distance_k < min_squared_distance) {
+					min_squared_distance = squared_distance_k;
+					closest = candidates[j];
+				}
+			}
+			// A candidate k is farther than the closest one from every point in the box if it is farther from the vertex of the box lying furthest
+			// in the direction from the closest one towards k. The margin covers rounding errors in the distances of the points in the box.
+			const double squared_diagonal = (upper - lower).squaredNorm();
+			const auto closest_centroid = centroids_.col(closest);
+			for (auto j = candidates_begin; j < candidates_end; ++j) {
+				const auto k = candidates[j];
+				if (k != closest) {
+					const auto centroid = centroids_.col(k);
+					double squared_distance_k = 0;
+					double squared_distance_closest = 0;
+					for (Eigen::Index l = 0; l < lower.size(); ++l) {
+						const double vertex = centroid[l] > closest_centroid[l] ? upper[l] : lower[l];
+						squared_distance_k += (vertex - centroid[l]) * (vertex - centroid[l]);
+						squared_distance_closest += (vertex - closest_centroid[l]) * (vertex - closest_centroid[l]);
+					}
+					if (!(squared_distance_k - squared_distance_closest > 2 * bound_margin * (squared_distance_k + squared_distance_closest + 2 * squared_diagonal))) {
+						candidates.push_back(k);
+					}
+				} else {
+					candidates.push_back(k);
+				}
+			}
+			bool labels_changed;
+			if (candidates.size() - candidates_end == 1) {
+				labels_changed = labels_differ(node, closest);
+				owner = closest;
+				sums.col(closest) += tree.sums.col(node);
+				counts[closest] += tree.node_weights[node];
+			} else {
+				if (owner != mixed_owner) {
+					// The children inherit the labels assigned to the node as a whole.
+					node_owners_[static_cast<size_t>(tree_node.left)] = owner;
+					node_owners_[static_cast<size_t>(tree_node.right)] = owner;
+					owner = mixed_owner;
+				}
+				const bool left_labels_changed = filter_node(tree_node.left, candidates, candidates_end, depth + 1, sums, counts, tasks);
+				const bool right_labels_changed = filter_node(tree_node.right, candidates, candidates_end, depth + 1, sums, counts, tasks);
+				labels_changed = left_labels_changed || right_labels_changed;
+			}
+			candidates.resize(candidates_end);
+			return labels_changed;
+		}
+
+		bool KMeans::labels_differ(const Eigen::Index node, const unsigned int label) const
+		{
+			const auto owner = node_owners_[static_cast<size_t>(node)];
+			if (owner != mixed_owner) {
+				return owner != label;
+			}
+			const auto& tree_node = filtering_tree_->nodes[static_cast<size_t>(node)];
+			if (tree_node.left < 0) {
+				for (auto p = tree_node.begin; p < tree_node.end; ++p) {
+					if (tree_labels_[static_cast<size_t>(p)] != label) {
+						return true;
+					}
+				}
+				return false;
+			}
+			return labels_differ(tree_node.left, label) || labels_differ(tree_node.right, label);
+		}
+
+		void KMeans::set_filtering_labels(Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::MatrixXd& assigned_centroids)
+		{
+			set_filtering_labels(0);
 			const auto sample_size = data.cols();
-			// Update centroids.
-			for (Eigen::Index i = 0; i < sample_size; ++i) {
-				const unsigned int label = labels_[i];
-				const double num = (++work_vector_[label]);
-				centroids_.col(label) += (data.col(i) - centroids_.col(label)) / num;
+			Parallel::for_each_chunk(static_cast<size_t>(sample_size), number_threads_, [&](const size_t begin, const size_t end, unsigned int) {
+				for (auto i = begin; i < end; ++i) {
+					min_squared_distances_[static_cast<Eigen::Index>(i)] = (data.col(static_cast<Eigen::Index>(i)) - assigned_centroids.col(labels_[i])).squaredNorm();
+				}
+			});
+			// Summed in the order of data points, like in assignment_step().
+			inertia_ = sum_squared_distances();
+		}
+
+		void KMeans::set_filtering_labels(const Eigen::Index node)
+		{
+			const auto& tree = *filtering_tree_;
+			const auto& tree_node = tree.nodes[static_cast<size_t>(node)];
+			const auto owner = node_owners_[static_cast<size_t>(node)];
+			if (owner != mixed_owner) {
+				for (auto p = tree_node.begin; p < tree_node.end; ++p) {
+					labels_[static_cast<size_t>(tree.indices[static_cast<size_t>(p)])] = owner;
+				}
+			} else if (tree_node.left < 0) {
+				for (auto p = tree_node.begin; p < tree_node.end; ++p) {
+					labels_[static_cast<size_t>(tree.indices[static_cast<size_t>(p)])] = tree_labels_[static_cast<size_t>(p)];
+				}
+			} else {
+				set_filtering_labels(tree_node.left);
+				set_filtering_labels(tree_node.right);
 			}
 		}
     }
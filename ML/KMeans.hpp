@@ -1,6 +1,7 @@
 #pragma once
 /* (C) 2021 Roman Werpachowski. */
 #include "Clustering.hpp"
+#include <memory>
 #include <vector>
 #include <utility>
 #include <Eigen/Core>
@@ -10,8 +11,26 @@ namespace ml
 {
     namespace Clustering
     {
+        /** @brief Algorithm used by KMeans to assign data points to centroids.
+
+        LLOYD, HAMERLY and ELKAN give identical labels and inertia. HAMERLY and ELKAN use the triangle inequality to skip most distance calculations
+        once the clusters stabilise, at the cost of keeping lower bounds on the distances to other centroids.
+
+        FILTERING assigns the same labels as the other algorithms for the same centroids, but adds up the data points in a different order,
+        so the centroids can differ from theirs by rounding errors.
+        */
+        enum class KMeansAlgorithm
+        {
+            LLOYD, /**< Calculates the distances from every point to every centroid in every step. */
+            HAMERLY, /**< Keeps one lower bound per point (distance to the second closest centroid). Best for small numbers of clusters. */
+            ELKAN, /**< Keeps a lower bound for every (point, centroid) pair, using K x N memory. Best for larger numbers of clusters. */
+            FILTERING /**< Filtering algorithm of Kanungo et al. (2002): builds a kd-tree over the data once per fit, and in every step discards centroids
+                      which cannot be the closest to any point in a tree node. Nodes left with a single centroid are assigned to it as a whole, using
+                      cached sums of their points. Best for low-dimensional data (up to about 5 dimensions), where a step costs much less than O(N). */
+        };
+
         /**
-         * @brief Naive K-means clustering method.
+         * @brief K-means clustering method.
          * 
          * Converges if exactly the same cluster assignments are chosen twice, or if sum of squared differences between new and old centroids is lower than tolerance.
         */
@@ -26,6 +45,18 @@ namespace ml
 
             DLL_DECLSPEC bool fit(Eigen::Ref<const Eigen::MatrixXd> data) override;
 
+            /** @brief Fits the model to weighted data points, e.g. a Coreset.
+
+            Every point counts as if it was repeated as many times as its weight: centroids are weighted means of the points assigned to them,
+            and inertia() is the weighted sum of squared distances. Centroids are initialised by CentroidsInitialiser::weighted_init().
+            @param[in] data Matrix with a data point in every column.
+            @param[in] weights Non-negative weights of data points, with size `data.cols()`.
+            @return `true` if fitting converged successfully.
+            @throw std::invalid_argument If `data` has no rows, if the sample size is too low, or if `weights.size() != data.cols()`.
+            @throw std::domain_error If a weight is negative or not finite, or if all weights are zero.
+            */
+            DLL_DECLSPEC bool fit(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Ref<const Eigen::VectorXd> weights);
+
             unsigned int number_clusters() const override
             {
                 return num_clusters_;
@@ -60,6 +91,10 @@ namespace ml
 
             /**
              * @brief Sets number of initialisations to try, to find the clusters with lowest inertia.
+             *
+             * If there is more than one, the initialisations are run concurrently (see set_number_threads()) on independent copies of the model,
+             * with pseudo-random number generators created by make_initialisation_prngs(). The first initialisation is the same as a single fit.
+             * The converged fit with the lowest inertia is chosen (the first one in case of a tie), so the result does not depend on the number of threads.
              * @param number_initialisations Number of initialisations.
              * @throw std::invalid_argument If `number_initialisations < 1`.
             */
@@ -71,6 +106,25 @@ namespace ml
             */
             DLL_DECLSPEC void set_centroids_initialiser(std::shared_ptr<const CentroidsInitialiser> centroids_initialiser);
 
+            /** @brief Sets the algorithm used to assign points to centroids. Default is KMeansAlgorithm::LLOYD.
+            @param[in] algorithm Assignment algorithm.
+            */
+            void set_algorithm(KMeansAlgorithm algorithm)
+            {
+                algorithm_ = algorithm;
+            }
+
+            /** @brief Sets the number of threads used to assign points to centroids and to update centroids, and to run multiple initialisations. Default is 1.
+
+            Points are split into blocks which depend only on the sample size and the number of clusters. Partial centroid sums are accumulated
+            for every block and added in block order, so the results do not depend on the number of threads.
+            @param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+            */
+            void set_number_threads(unsigned int number_threads)
+            {
+                number_threads_ = number_threads;
+            }
+
             /** @brief Switches between verbose and quiet mode.
             @param[in] verbose `true` if we want verbose output.
             */
@@ -87,7 +141,7 @@ namespace ml
             DLL_DECLSPEC std::pair<unsigned int, double> assign_label(Eigen::Ref<const Eigen::VectorXd> x) const;
 
             /**
-             * @brief  Sum of squared distances to the nearest centroid.
+             * @brief  Sum of squared distances to the nearest centroid (weighted, if the data points were weighted).
              * @return Non-negative number;
             */
             double inertia() const
@@ -105,23 +159,86 @@ namespace ml
             Eigen::MatrixXd centroids_;
             Eigen::MatrixXd old_centroids_;
             Eigen::VectorXd work_vector_;
+            Eigen::MatrixXd block_sums_; /**< Sums of data points assigned to each centroid, for every block of data points (K columns per block). */
+            Eigen::VectorXd block_counts_; /**< Numbers of data points assigned to each centroid, for every block of data points (K values per block). */
+            Eigen::VectorXd data_squared_norms_; /**< Squared norms of data points, calculated once per fit. */
+            Eigen::VectorXd min_squared_distances_; /**< Squared distances to the assigned centroids. */
+            Eigen::VectorXd sample_weights_; /**< Weights of data points, or empty if they are not weighted. */
+            Eigen::MatrixXd lower_bounds_; /**< Lower bounds on distances to centroids other than the assigned one, in columns (one row for Hamerly, K rows for Elkan). */
+            Eigen::MatrixXd bounded_centroids_; /**< Centroids for which lower_bounds_ were valid when last updated. */
+            Eigen::MatrixXd half_centroid_distances_; /**< Half of the distances between centroids. */
+            Eigen::VectorXd centroid_shifts_; /**< Distances moved by centroids since lower_bounds_ were last updated. */
             std::default_random_engine prng_;
             std::shared_ptr<const CentroidsInitialiser> centroids_initialiser_;
             double absolute_tolerance_;
             double inertia_;
+            double bound_slack_; /**< Absolute amount by which distance bounds are loosened, proportional to the norms of data points and centroids. */
             unsigned int maximum_steps_;
             unsigned int num_inits_;
             unsigned int num_clusters_;
+            unsigned int number_threads_;
+            KMeansAlgorithm algorithm_;
             bool verbose_;
             bool converged_;
+            bool bounds_valid_;
+
+            /// kd-tree used by KMeansAlgorithm::FILTERING.
+            struct FilteringTree;
+
+            std::shared_ptr<const FilteringTree> filtering_tree_; /**< Built once per call to fit() and shared by all initialisations. */
+            std::vector<unsigned int> node_owners_; /**< Centroid to which all points in a tree node were assigned, if they were assigned to the same one as a whole. */
+            std::vector<unsigned int> tree_labels_; /**< Labels of points in tree leaves which were not assigned as a whole, in tree order. */
+            bool labels_changed_; /**< Whether any label was changed by the last filtering assignment step. */
+
+            /// Fits the model with all initialisations, using sample_weights_.
+            bool fit_all(Eigen::Ref<const Eigen::MatrixXd> data);
 
             bool fit_once(Eigen::Ref<const Eigen::MatrixXd> data);
 
             /// Assigns points to centroids and updates inertia.
             void assignment_step(Eigen::Ref<const Eigen::MatrixXd> data);
 
+            /// Sums min_squared_distances_ (weighted by sample_weights_, if set) in the order of data points.
+            double sum_squared_distances() const;
+
+            /// Assigns points to centroids using the distance bounds, and updates the bounds and inertia.
+            void bounded_assignment_step(Eigen::Ref<const Eigen::MatrixXd> data);
+
+            /// Assigns points [begin, end) to centroids using the distance bounds, and updates their bounds and distances to the assigned centroids.
+            void bounded_assignment_step(Eigen::Ref<const Eigen::MatrixXd> data, Eigen::Index begin, Eigen::Index end, unsigned int max_shift_label, double max_shift, double second_max_shift);
+
+            /// Assigns a point to a centroid calculating all distances, and (re)initialises its distance bounds.
+            std::pair<unsigned int, double> assign_label_with_bounds(Eigen::Ref<const Eigen::VectorXd> x, Eigen::Index i);
+
+            /// Squared Euclidean distance between x and centroid k.
+            double squared_distance(const Eigen::Ref<const Eigen::VectorXd> x, const unsigned int k) const
+            {
+                return (x - centroids_.col(k)).squaredNorm();
+            }
+
+            /// Assigns points to centroids using the kd-tree, adding up the points assigned to each centroid for update_step().
+            void filtering_assignment_step();
+
+            /** Filters the centroids for a tree node and its subtree, taking candidate centroids from `candidates[candidates_begin:]`.
+            Adds the points to `sums` and `counts`. Nodes at the task depth are instead added to `tasks`, unless it is null.
+            @return Whether any label was changed.
+            */
+            bool filter_node(Eigen::Index node, std::vector<unsigned int>& candidates, size_t candidates_begin, unsigned int depth, Eigen::Ref<Eigen::MatrixXd> sums, Eigen::Ref<Eigen::VectorXd> counts, std::vector<std::pair<Eigen::Index, std::vector<unsigned int>>>* tasks);
+
+            /// Checks whether any point in the subtree of a node had a label different from `label`.
+            bool labels_differ(Eigen::Index node, unsigned int label) const;
+
+            /// Sets labels_ from the tree nodes, and calculates distances to the assigned centroids and inertia.
+            void set_filtering_labels(Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::MatrixXd& assigned_centroids);
+
+            /// Sets labels_ for the points in the subtree of a node.
+            void set_filtering_labels(Eigen::Index node);
+
             /// Updates positions of centroids.
             void update_step(Eigen::Ref<const Eigen::MatrixXd> data);
+
+            /// Sets centroids to the means of assigned points, from partial sums for `number_blocks` blocks in block_sums_ and block_counts_.
+            void update_centroids(Eigen::Index number_blocks);
         };
     }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 /* (C) 2020 Roman Werpachowski. */
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iostream>
@@ -40,6 +41,38 @@ namespace ml
 			return Eigen::VectorXd::Constant(x.size(), intercept) + slope * x;
 		}
 
+		Eigen::VectorXd UnivariateOLSBatchResult::var_y() const
+		{
+			if (dof) {
+				return rss / static_cast<double>(dof);
+			} else {
+				return Eigen::VectorXd::Constant(size(), std::numeric_limits<double>::quiet_NaN());
+			}
+		}
+
+		Eigen::VectorXd UnivariateOLSBatchResult::r2() const
+		{
+			return 1 - rss.array() / tss.array();
+		}
+
+		UnivariateOLSResult UnivariateOLSBatchResult::operator[](const Eigen::Index i) const
+		{
+			if (i < 0 || i >= size()) {
+				throw std::out_of_range("Series index out of range");
+			}
+			UnivariateOLSResult result;
+			result.n = n;
+			result.dof = dof;
+			result.rss = rss[i];
+			result.tss = tss[i];
+			result.slope = slope[i];
+			result.intercept = intercept[i];
+			result.var_slope = var_slope[i];
+			result.var_intercept = var_intercept[i];
+			result.cov_slope_intercept = cov_slope_intercept[i];
+			return result;
+		}
+
 		std::string MultivariateOLSResult::to_string() const
 		{
 			std::stringstream s;
@@ -110,6 +143,58 @@ namespace ml
 			return s.str();
 		}
 
+		Eigen::VectorXd MultiTargetResult::var_y() const
+		{
+			if (dof) {
+				return rss / static_cast<double>(dof);
+			} else {
+				return Eigen::VectorXd::Constant(size(), std::numeric_limits<double>::quiet_NaN());
+			}
+		}
+
+		Eigen::VectorXd MultiTargetResult::r2() const
+		{
+			return 1 - rss.array() / tss.array();
+		}
+
+		/// Copies the members common to all results for the `i`-th target.
+		static void copy_target_result(const MultiTargetResult& results, const Eigen::Index i, Result& result, Eigen::VectorXd& beta)
+		{
+			if (i < 0 || i >= results.size()) {
+				throw std::out_of_range("Target index out of range");
+			}
+			result.n = results.n;
+			result.dof = results.dof;
+			result.rss = results.rss[i];
+			result.tss = results.tss[i];
+			beta = results.beta.col(i);
+		}
+
+		MultivariateOLSResult MultivariateOLSMultiTargetResult::operator[](const Eigen::Index i) const
+		{
+			MultivariateOLSResult result;
+			copy_target_result(*this, i, result, result.beta);
+			result.cov = result.var_y() * unscaled_cov;
+			return result;
+		}
+
+		RidgeRegressionResult RidgeRegressionMultiTargetResult::operator[](const Eigen::Index i) const
+		{
+			RidgeRegressionResult result;
+			copy_target_result(*this, i, result, result.beta);
+			result.effective_dof = effective_dof;
+			result.cov = result.var_y() * unscaled_cov;
+			return result;
+		}
+
+		LassoRegressionResult LassoRegressionMultiTargetResult::operator[](const Eigen::Index i) const
+		{
+			LassoRegressionResult result;
+			copy_target_result(*this, i, result, result.beta);
+			result.effective_dof = effective_dof[i];
+			return result;
+		}
+
 		static UnivariateOLSResult calc_univariate_linear_regression_result(
 			const double sxx, const double sxy, const double tss, const double mx,
 			const double my, const unsigned int n)
@@ -171,6 +256,86 @@ namespace ml
 			return calc_univariate_linear_regression_result(sxx, sxy, tss, mx, my, n);
 		}
 
+		/** Vectorised version of calc_univariate_linear_regression_result. */
+		static UnivariateOLSBatchResult calc_univariate_linear_regression_batch_result(
+			const Eigen::Ref<const Eigen::ArrayXd> sxx, const Eigen::Ref<const Eigen::ArrayXd> sxy, const Eigen::Ref<const Eigen::ArrayXd> tss,
+			const Eigen::Ref<const Eigen::ArrayXd> mx, const Eigen::Ref<const Eigen::ArrayXd> my, const unsigned int n)
+		{
+			UnivariateOLSBatchResult result;
+			result.n = n;
+			result.dof = n - 2;
+			result.slope = sxy / sxx;
+			const auto slope = result.slope.array();
+			result.intercept = my - slope * mx;
+			// Residual sum of squares.
+			result.rss = (tss + slope * slope * sxx - 2 * slope * sxy).max(0.);
+			result.tss = tss;
+			const Eigen::ArrayXd var_y(result.var_y());
+			result.var_slope = var_y / sxx;
+			result.var_intercept = var_y * (1. / n + mx * mx / sxx);
+			result.cov_slope_intercept = -mx * var_y / sxx;
+			return result;
+		}
+
+		UnivariateOLSBatchResult univariate_batch(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y)
+		{
+			if (X.rows() != Y.rows() || X.cols() != Y.cols()) {
+				throw std::invalid_argument("X and Y matrices have different shapes");
+			}
+			const auto n = static_cast<unsigned int>(X.rows());
+			if (n < 2) {
+				throw std::invalid_argument("Need at least 2 points for regresssion");
+			}
+			const auto num_series = X.cols();
+			Eigen::ArrayXd mx(num_series);
+			Eigen::ArrayXd my(num_series);
+			Eigen::ArrayXd sxy(num_series);
+			Eigen::ArrayXd sxx(num_series);
+			Eigen::ArrayXd tss(num_series);
+			// Every column is contiguous, so the reductions are vectorised, and it stays in cache
+			// between the calculation of means and the centred moments.
+			for (Eigen::Index i = 0; i < num_series; ++i) {
+				const auto x = X.col(i).array();
+				const auto y = Y.col(i).array();
+				mx[i] = x.mean();
+				my[i] = y.mean();
+				const auto x_centred = x - mx[i];
+				const auto y_centred = y - my[i];
+				sxy[i] = (x_centred * y_centred).sum();
+				sxx[i] = x_centred.square().sum();
+				tss[i] = y_centred.square().sum();
+			}
+			return calc_univariate_linear_regression_batch_result(sxx, sxy, tss, mx, my, n);
+		}
+
+		UnivariateOLSBatchResult univariate_batch(const double x0, const double dx, const Eigen::Ref<const Eigen::MatrixXd> Y)
+		{
+			if (dx <= 0) {
+				throw std::domain_error("dx must be positive");
+			}
+			const auto n = static_cast<unsigned int>(Y.rows());
+			if (n < 2) {
+				throw std::invalid_argument("Need at least 2 points for regresssion");
+			}
+			const auto num_series = Y.cols();
+			// X moments are shared by all series.
+			const auto half_width_x = (n - 1) * dx / 2;
+			const Eigen::ArrayXd mx(Eigen::ArrayXd::Constant(num_series, x0 + half_width_x));
+			const Eigen::ArrayXd sxx(Eigen::ArrayXd::Constant(num_series, dx * dx * n * (n * n - 1) / 12.));
+			// sum_i (i - mean(i)) * (y_i - mean(y)) == sum_i (i - mean(i)) * y_i.
+			const Eigen::VectorXd centred_indices(Eigen::VectorXd::LinSpaced(n, 0, n - 1).array() - (n - 1) / 2.);
+			Eigen::ArrayXd my(num_series);
+			Eigen::ArrayXd sxy(num_series);
+			Eigen::ArrayXd tss(num_series);
+			for (Eigen::Index i = 0; i < num_series; ++i) {
+				const auto y = Y.col(i);
+				my[i] = y.mean();
+				sxy[i] = dx * centred_indices.dot(y);
+				tss[i] = (y.array() - my[i]).square().sum();
+			}
+			return calc_univariate_linear_regression_batch_result(sxx, sxy, tss, mx, my, n);
+		}
+
 		UnivariateOLSResult univariate_without_intercept(Eigen::Ref<const Eigen::VectorXd> x, const Eigen::Ref<const Eigen::VectorXd> y)
 		{
 			const auto n = static_cast<unsigned int>(x.size());
@@ -257,6 +422,245 @@ namespace ml
 			return result;
 		}
 
+		/// Checks the sizes of regression inputs, requiring at least `min_n` data points.
+		static void check_regression_inputs(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Index num_y_values, const Eigen::Index min_n)
+		{
+			if (X.cols() != num_y_values) {
+				throw std::invalid_argument("X matrix has different number of data points than Y has values");
+			}
+			if (X.cols() < min_n) {
+				throw std::invalid_argument("Not enough data points for regression");
+			}
+		}
+
+		/// Checks the sizes of multi-target regression inputs, requiring at least `min_n` data points.
+		static void check_multi_target_regression_inputs(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y, const Eigen::Index min_n)
+		{
+			if (!Y.cols()) {
+				throw std::invalid_argument("No targets in Y");
+			}
+			check_regression_inputs(X, Y.rows(), min_n);
+		}
+
+		/** Calculates the means of X rows and Y columns, \f$ (X - \bar{X}) (X - \bar{X})^T \f$ and \f$ (X - \bar{X}) (Y - \bar{Y}) \f$
+		without copying X. Centred columns are formed in blocks of fixed size, so the extra memory does not grow with N.
+		*/
+		static void calculate_centred_moments(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y, Eigen::VectorXd& means, Eigen::VectorXd& means_Y, Eigen::MatrixXd& XXt, Eigen::MatrixXd& XY)
+		{
+			constexpr Eigen::Index block_size = 256;
+			const auto q = X.rows();
+			const auto n = X.cols();
+			means = X.rowwise().mean();
+			means_Y = Y.colwise().mean();
+			XXt.setZero(q, q);
+			XY.setZero(q, Y.cols());
+			Eigen::MatrixXd centred_X(q, std::min(block_size, n));
+			for (Eigen::Index i0 = 0; i0 < n; i0 += block_size) {
+				const auto len = std::min(block_size, n - i0);
+				auto block = centred_X.leftCols(len);
+				block = X.middleCols(i0, len).colwise() - means;
+				XXt.selfadjointView<Eigen::Lower>().rankUpdate(block);
+				XY.noalias() += block * (Y.middleRows(i0, len).rowwise() - means_Y.transpose());
+			}
+			XXt.triangularView<Eigen::StrictlyUpper>() = XXt.transpose();
+		}
+
+		/** Rescales centred moments to standardised units, as if they were calculated from `X` processed by standardise().
+		@throw std::invalid_argument If any row of X has constant values.
+		*/
+		static void standardise_moments(Eigen::MatrixXd& XXt, Eigen::MatrixXd& XY, const Eigen::Index n, Eigen::VectorXd& standard_deviations)
+		{
+			standard_deviations = (XXt.diagonal() / static_cast<double>(n)).array().sqrt();
+			if (!(standard_deviations.array() > 0).all()) {
+				throw std::invalid_argument("At least one row has constant values");
+			}
+			XXt.array() /= (standard_deviations * standard_deviations.transpose()).array();
+			XY.array().colwise() /= standard_deviations.array();
+		}
+
+		/// Calculates the total sum of squares of every column of Y.
+		static Eigen::VectorXd calculate_tss(const Eigen::Ref<const Eigen::MatrixXd> Y, const Eigen::Ref<const Eigen::VectorXd> means_Y)
+		{
+			Eigen::VectorXd tss(Y.cols());
+			for (Eigen::Index i = 0; i < Y.cols(); ++i) {
+				tss[i] = (Y.col(i).array() - means_Y[i]).matrix().squaredNorm();
+			}
+			return tss;
+		}
+
+		MultivariateOLSResult multivariate_with_intercept(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y)
+		{
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			check_regression_inputs(X, y.size(), q + 1);
+			Eigen::VectorXd means;
+			Eigen::VectorXd mean_y;
+			Eigen::MatrixXd XXt;
+			Eigen::MatrixXd Xy;
+			calculate_centred_moments(X, y, means, mean_y, XXt, Xy);
+			const Eigen::LDLT<Eigen::MatrixXd> xxt_decomp(XXt);
+			MultivariateOLSResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1);
+			result.beta.resize(q + 1);
+			auto slopes = result.beta.head(q);
+			slopes = xxt_decomp.solve(Xy);
+			result.beta[q] = mean_y[0] - slopes.dot(means);
+			result.rss = ((y - X.transpose() * slopes).array() - result.beta[q]).matrix().squaredNorm();
+			result.tss = (y.array() - mean_y[0]).matrix().squaredNorm();
+			if (result.dof) {
+				result.cov.resize(q + 1, q + 1);
+				auto cov_slopes = result.cov.block(0, 0, q, q);
+				cov_slopes = xxt_decomp.solve(Eigen::MatrixXd::Identity(q, q));
+				// intercept = mean(y) - slopes^T * means, and Cov(slopes, mean(y)) == 0.
+				result.cov.col(q).head(q) = -cov_slopes * means;
+				result.cov.row(q).head(q) = result.cov.col(q).head(q);
+				result.cov(q, q) = 1. / static_cast<double>(n) + LinearAlgebra::xAx_symmetric(cov_slopes, means);
+				result.cov *= result.var_y();
+			} else {
+				result.cov = Eigen::MatrixXd::Constant(q + 1, q + 1, std::numeric_limits<double>::quiet_NaN());
+			}
+			return result;
+		}
+
+		/** Calculates the decomposition of \f$ X X^T + \mathrm{diag}(\vec{\lambda}) \f$ from precalculated `XXt` and solves it for every column of `XY`.
+		@param[out] work Memory for the regularised matrix, used only if `lambda` is nonzero.
+		*/
+		static Eigen::MatrixXd solve_regularised(const Eigen::Ref<const Eigen::MatrixXd> XXt, const Eigen::Ref<const Eigen::MatrixXd> XY, const Eigen::Ref<const Eigen::VectorXd> lambda, Eigen::MatrixXd& work, Eigen::LDLT<Eigen::MatrixXd>& xxt_decomp)
+		{
+			if (lambda.minCoeff()) {
+				work = XXt;
+				work.diagonal() += lambda;
+				xxt_decomp.compute(work);
+			} else {
+				xxt_decomp.compute(XXt);
+			}
+			return xxt_decomp.solve(XY);
+		}
+
+		/** Calculates the effective number of residual degrees of freedom and the covariance matrix of beta (before multiplying by Var(Y))
+		of a ridge regression with standardised X, using only Q x Q matrices.
+		@param[in] XXt X * X^T without regularisation.
+		@param[in] xxt_decomp Decomposition of X * X^T + diag(lambda).
+		@param[out] cov Covariance matrix of (slopes, intercept).
+		*/
+		static double calculate_ridge_effective_dof_and_cov(const Eigen::Ref<const Eigen::MatrixXd> XXt, const Eigen::LDLT<Eigen::MatrixXd>& xxt_decomp, const Eigen::Ref<const Eigen::VectorXd> lambda, const unsigned int n, const unsigned int dof, Eigen::MatrixXd& cov)
+		{
+			const auto q = XXt.rows();
+			double effective_dof;
+			cov.resize(q + 1, q + 1);
+			// Var(intercept):
+			cov(q, q) = 1. / static_cast<double>(n);
+			// Cov(slopes):
+			auto cov_slopes = cov.block(0, 0, q, q);
+			if (lambda.minCoeff() > 0) {
+				// H = (X * X^T + Lambda)^{-1} * X * X^T has the same trace as the N x N hat matrix X^T * (X * X^T + Lambda)^{-1} * X.
+				const Eigen::MatrixXd H(xxt_decomp.solve(XXt));
+				effective_dof = std::max(static_cast<double>(n) - H.trace() - 1, static_cast<double>(dof));
+				// (X * X^T + Lambda)^{-1} * X * X^T * (X * X^T + Lambda)^{-1} == (X * X^T + Lambda)^{-1} * H^T
+				cov_slopes = xxt_decomp.solve(H.transpose());
+			} else {
+				effective_dof = dof;
+				cov_slopes = xxt_decomp.solve(Eigen::MatrixXd::Identity(q, q));
+			}
+			// Cov(intercept, slopes) is zero by assumption of standardisation.
+			cov.col(q).head(q).setZero();
+			cov.row(q).head(q).setZero();
+			return effective_dof;
+		}
+
+		/// Transforms the covariance matrix of ridge regression coefficients from standardised to original X units.
+		static void unstandardise_ridge_cov(Eigen::MatrixXd& cov, const Eigen::Ref<const Eigen::VectorXd> means, const Eigen::Ref<const Eigen::VectorXd> standard_deviations)
+		{
+			const auto q = means.size();
+			auto cov_slopes = cov.block(0, 0, q, q);
+			// We only need to rescale this part, because Cov(slopes, intercept) == 0.
+			// Cov(new_slopes, new_slopes) = Cov(slopes, slopes) ./ (standard_deviations * standard_deviations^T)
+			// Cov(new_slopes, intercept) = Cov(slopes, intercept) = 0
+			cov_slopes.array() /= (standard_deviations * standard_deviations.transpose()).array();
+			// Cov(new_slopes, new_intercept) = - Cov(new_slopes) * means
+			// Var(new_intercept) = Cov(intercept - new_slopes^T * means, intercept - new_slopes^T * means) = Var(intercept) + means^T * Cov(new_slopes, new_slopes) * means
+			cov.col(q).head(q) = - cov_slopes * means;
+			cov.row(q).head(q) = cov.col(q).head(q);
+			cov(q, q) += LinearAlgebra::xAx_symmetric(cov_slopes, means);
+		}
+
+		/** Ridge regression in the dual form, for data with more features than data points. Uses the identity
+		\f$ (X X^T + \lambda I)^{-1} X = X (X^T X + \lambda I)^{-1} \f$ to decompose the N x N kernel \f$ X^T X + \lambda I \f$
+		instead of the Q x Q matrix \f$ X X^T + \lambda I \f$.
+		@param[in] do_standardise Whether to standardise X rows implicitly (block by block, without copying X), or assume X is standardised.
+		*/
+		static RidgeRegressionResult dual_ridge(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda, const bool do_standardise)
+		{
+			// X is an q x N matrix and y is a N-size vector.
+			constexpr Eigen::Index block_size = 256;
+			const auto q = X.rows();
+			const auto n = X.cols();
+			if (lambda < 0) {
+				throw std::domain_error("Ridge regularisation constant cannot be negative");
+			}
+			check_regression_inputs(X, y.size(), 2);
+			if (!(lambda > 0)) {
+				// Without regularisation, the slopes are not unique.
+				throw std::invalid_argument("Not enough data points for regression");
+			}
+			Eigen::VectorXd means;
+			Eigen::VectorXd standard_deviations;
+			if (do_standardise) {
+				means = X.rowwise().mean();
+				standard_deviations = ((X.colwise() - means).rowwise().squaredNorm() / static_cast<double>(n)).array().sqrt();
+				if (!(standard_deviations.array() > 0).all()) {
+					throw std::invalid_argument("At least one row has constant values");
+				}
+			}
+			// Standardised rows of X are formed in blocks of fixed size, so the extra memory does not grow with Q.
+			Eigen::MatrixXd standardised_rows;
+			const auto get_rows = [&](const Eigen::Index i0, const Eigen::Index len) -> Eigen::Ref<const Eigen::MatrixXd> {
+				if (do_standardise) {
+					standardised_rows = (X.middleRows(i0, len).colwise() - means.segment(i0, len)).array().colwise() / standard_deviations.segment(i0, len).array();
+					return standardised_rows;
+				} else {
+					return X.middleRows(i0, len);
+				}
+			};
+			// Kernel K = X^T * X.
+			Eigen::MatrixXd K(Eigen::MatrixXd::Zero(n, n));
+			for (Eigen::Index i0 = 0; i0 < q; i0 += block_size) {
+				const auto len = std::min(block_size, q - i0);
+				K.selfadjointView<Eigen::Lower>().rankUpdate(get_rows(i0, len).transpose());
+			}
+			K.triangularView<Eigen::StrictlyUpper>() = K.transpose();
+			RidgeRegressionResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = 0; // Q >= N.
+			result.beta.resize(q + 1);
+			const double mean_y = y.mean();
+			const Eigen::VectorXd y_centred(y.array() - mean_y);
+			Eigen::MatrixXd K_lambda(K);
+			K_lambda.diagonal().array() += lambda;
+			const Eigen::LDLT<Eigen::MatrixXd> kernel_decomp(K_lambda);
+			// Like ridge<false>, use uncentred y with X which is assumed to be standardised.
+			const Eigen::VectorXd alpha(kernel_decomp.solve(do_standardise ? y_centred : Eigen::VectorXd(y)));
+			auto slopes = result.beta.head(q);
+			for (Eigen::Index i0 = 0; i0 < q; i0 += block_size) {
+				const auto len = std::min(block_size, q - i0);
+				slopes.segment(i0, len).noalias() = get_rows(i0, len) * alpha;
+			}
+			result.beta[q] = mean_y;
+			// Residual sum of squares, using X^T * slopes == K * alpha:
+			result.rss = (y_centred - K * alpha).squaredNorm();
+			// Total sum of squares:
+			result.tss = y_centred.squaredNorm();
+			// tr[X^T * (X * X^T + lambda * I)^{-1} * X] == tr[(K + lambda * I)^{-1} * K]
+			result.effective_dof = std::max(static_cast<double>(n) - kernel_decomp.solve(K).trace() - 1, static_cast<double>(result.dof));
+			if (do_standardise) {
+				slopes.array() /= standard_deviations.array();
+				result.beta[q] -= slopes.dot(means);
+			}
+			return result;
+		}
+
 		static RidgeRegressionResult weighted_ridge(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const Eigen::Ref<const Eigen::VectorXd> lambda)
 		{
 			// X is an q x N matrix and y is a N-size vector.
@@ -265,43 +669,30 @@ namespace ml
 			if (lambda.size() != q) {
 				throw std::invalid_argument("Lambda vector must have same size as the number of features");
 			}
+			if (lambda.minCoeff() < 0) {
+				throw std::domain_error("Ridge regularisation constant cannot be negative");
+			}
+			check_regression_inputs(X, y.size(), q);
 			RidgeRegressionResult result;
 			result.n = static_cast<unsigned int>(n);
 			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
 			result.beta.resize(q + 1);
 			const double intercept = y.mean();
 			result.beta[q] = intercept;
-			Eigen::MatrixXd XXt(q, q);
+			// Effective DOF and covariance are calculated from these Q x Q and Q-size moments.
+			const Eigen::MatrixXd XXt(X * X.transpose());
+			const Eigen::VectorXd Xy(X * y);
+			Eigen::MatrixXd work;
 			Eigen::LDLT<Eigen::MatrixXd> xxt_decomp;
-			result.beta.head(q) = calculate_XXt_beta(X, y, XXt, xxt_decomp, lambda);
+			auto slopes = result.beta.head(q);
+			slopes = solve_regularised(XXt, Xy, lambda, work, xxt_decomp);
 			// Use the fact that intercept == mean(y).
 			const Eigen::VectorXd y_centred(y.array() - intercept);
-			// Residual sum of squares:
-			result.rss = (y_centred - X.transpose() * result.beta.head(q)).squaredNorm();
+			// Residual sum of squares, from residuals because y^T * y - 2 * beta^T * X * y + beta^T * X * X^T * beta suffers from cancellation:
+			result.rss = (y_centred - X.transpose() * slopes).squaredNorm();
 			// Total sum of squares:
 			result.tss = y_centred.squaredNorm();
-			if (lambda.minCoeff() > 0) {
-				result.effective_dof = std::max(static_cast<double>(n) - (X.transpose() * xxt_decomp.solve(X)).trace() - 1, static_cast<double>(result.dof));
-			} else {
-				result.effective_dof = result.dof;
-			}
-			result.cov.resize(q + 1, q + 1);
-			// Before multiplying by Var(Y).
-			// Var(intercept):
-			result.cov(q, q) = 1. / static_cast<double>(n);
-			// Cov(slopes):
-			auto cov_slopes = result.cov.block(0, 0, q, q);
-			if (lambda.minCoeff() > 0) {
-				const Eigen::MatrixXd inv_xxt_lambda(xxt_decomp.solve(Eigen::MatrixXd::Identity(q, q)));
-				cov_slopes.noalias() = XXt * inv_xxt_lambda;
-				XXt.noalias() = inv_xxt_lambda * cov_slopes;
-				cov_slopes = XXt;
-			} else {
-				cov_slopes = xxt_decomp.solve(Eigen::MatrixXd::Identity(q, q));
-			}
-			// Cov(intercept, slopes) is zero by assumption of standardisation.
-			result.cov.col(q).head(q).setZero();
-			result.cov.row(q).head(q).setZero();
+			result.effective_dof = calculate_ridge_effective_dof_and_cov(XXt, xxt_decomp, lambda, result.n, result.dof, result.cov);
 			// Scale by Var(Y):
 			result.cov *= result.var_y();
 			return result;
@@ -309,113 +700,315 @@ namespace ml
 
 		template <> RidgeRegressionResult ridge<false>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda)
 		{
+			if (X.rows() > X.cols()) {
+				return dual_ridge(X, y, lambda, false);
+			}
 			return weighted_ridge(X, y, Eigen::VectorXd::Constant(X.rows(), lambda));
 		}
 
 		template <> RidgeRegressionResult ridge<true>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda)
 		{
-			Eigen::MatrixXd workX(X);
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			if (q > n) {
+				return dual_ridge(X, y, lambda, true);
+			}
+			if (lambda < 0) {
+				throw std::domain_error("Ridge regularisation constant cannot be negative");
+			}
+			check_regression_inputs(X, y.size(), q);
+			// Standardise X * X^T and X * y instead of a copy of X.
 			Eigen::VectorXd means;
+			Eigen::VectorXd mean_y;
+			Eigen::MatrixXd XXt;
+			Eigen::MatrixXd Xy;
 			Eigen::VectorXd standard_deviations;
-			standardise(workX, means, standard_deviations);
-			auto result = ridge<false>(workX, y, lambda);
-			const auto q = X.rows();
+			calculate_centred_moments(X, y, means, mean_y, XXt, Xy);
+			standardise_moments(XXt, Xy, n, standard_deviations);
+			RidgeRegressionResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
+			result.beta.resize(q + 1);
+			result.beta[q] = mean_y[0];
+			const Eigen::VectorXd lambdas(Eigen::VectorXd::Constant(q, lambda));
+			Eigen::MatrixXd work;
+			Eigen::LDLT<Eigen::MatrixXd> xxt_decomp;
 			auto slopes = result.beta.head(q);
+			slopes = solve_regularised(XXt, Xy, lambdas, work, xxt_decomp);
+			result.effective_dof = calculate_ridge_effective_dof_and_cov(XXt, xxt_decomp, lambdas, result.n, result.dof, result.cov);
 			// Using Matlab notation: ./ and .* are elementwise / and *.
 			// new_slopes = slopes ./ standard_deviations
 			slopes.array() /= standard_deviations.array();
-			auto cov_slopes = result.cov.block(0, 0, q, q);
-			// We only need to rescale this part, because Cov(slopes, intercept) == 0.
-			// Cov(new_slopes, new_slopes) = Cov(slopes, slopes) ./ (standard_deviations * standard_deviations^T)
-			// Cov(new_slopes, intercept) = Cov(slopes, intercept) = 0
-			cov_slopes.array() /= (standard_deviations * standard_deviations.transpose()).array();
 			// new_intercept = intercept - new_slopes^T * means
-			// Cov(new_slopes, new_intercept) = - Cov(new_slopes) * means
-			// Var(new_intercept) = Cov(intercept - new_slopes^T * means, intercept - new_slopes^T * means) = Var(intercept) + means^T * Cov(new_slopes, new_slopes) * means
 			result.beta[q] -= slopes.dot(means);
-			result.cov.col(q).head(q) = - cov_slopes * means;
-			result.cov.row(q).head(q) = result.cov.col(q).head(q);
-			result.cov(q, q) += LinearAlgebra::xAx_symmetric(cov_slopes, means);
+			// Residual sum of squares:
+			result.rss = ((y - X.transpose() * slopes).array() - result.beta[q]).matrix().squaredNorm();
+			// Total sum of squares:
+			result.tss = (y.array() - mean_y[0]).matrix().squaredNorm();
+			// Scale by Var(Y):
+			result.cov *= result.var_y();
+			unstandardise_ridge_cov(result.cov, means, standard_deviations);
 			return result;
 		}
 
-		template <> LassoRegressionResult lasso<false>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda)
+		/** Finds Lasso slopes with the iterated ridge regression method of Fan and Li (2001), given precalculated X * X^T and X * y.
+		@param[in,out] slopes On input, the unregularised solution. On output, the Lasso slopes.
+		@return Effective number of residual degrees of freedom.
+		*/
+		static double calculate_lasso_slopes(const Eigen::Ref<const Eigen::MatrixXd> XXt, const Eigen::Ref<const Eigen::VectorXd> Xy, const double lambda, const unsigned int n, const unsigned int dof, Eigen::Ref<Eigen::VectorXd> slopes)
 		{
-			// X is an q x N matrix and y is a N-size vector.
-			const auto q = X.rows();
-			const auto n = X.cols();
-			LassoRegressionResult result;
-			result.n = static_cast<unsigned int>(n);
-			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
-			result.beta.resize(q + 1);
-			const double intercept = y.mean();
-			result.beta[q] = intercept;
-			{
-				const auto without_penalty = multivariate(X, y);
-				result.beta.head(q) = without_penalty.beta;
-			}
+			const auto q = XXt.rows();
 			constexpr double rel_tol = 1e-15;
 			constexpr double abs_tol = 1e-15;
 			constexpr unsigned int max_iter = 10000;
 			if (lambda > 0) {
-				Eigen::VectorXd ridge_lambda(q);
-				Eigen::MatrixXd XXt(q, q);
+				Eigen::MatrixXd work(q, q);
 				Eigen::LDLT<Eigen::MatrixXd> xxt_decomp;
+				Eigen::VectorXd ridge_lambda(q);
 				Eigen::VectorXd next_beta(q);
 				bool converged = false;
 				unsigned int num_iters = 0;
 				while (!converged && num_iters < max_iter) {
 					ridge_lambda = Eigen::VectorXd::Constant(q, lambda / 2);
-					ridge_lambda.array() /= result.beta.head(q).array().abs();
-					next_beta = calculate_XXt_beta(X, y, XXt, xxt_decomp, ridge_lambda);
+					ridge_lambda.array() /= slopes.array().abs();
+					next_beta = solve_regularised(XXt, Xy, ridge_lambda, work, xxt_decomp);
 					converged = true;
 					for (Eigen::Index i = 0; i < q; ++i) {
-						if (std::abs(next_beta[i] - result.beta[i]) > abs_tol + rel_tol * std::abs(result.beta[i])) {
+						if (std::abs(next_beta[i] - slopes[i]) > abs_tol + rel_tol * std::abs(slopes[i])) {
 							converged = false;
 							break;
 						}
 					}
-					result.beta.head(q) = next_beta;
-					//std::cout << next_beta.transpose() << "\n";
+					slopes = next_beta;
 					++num_iters;
 				}
-			}
-			// Use the fact that intercept == mean(y).
-			const Eigen::VectorXd y_centred(y.array() - intercept);
-			// Residual sum of squares:
-			result.rss = (y_centred - X.transpose() * result.beta.head(q)).squaredNorm();
-			// Total sum of squares:
-			result.tss = y_centred.squaredNorm();
-			if (lambda > 0) {
 				unsigned int num_nonzero_slopes = 0;
 				for (Eigen::Index i = 0; i < q; ++i) {
-					if (std::abs(result.beta[i]) > abs_tol) {
+					if (std::abs(slopes[i]) > abs_tol) {
 						++num_nonzero_slopes;
 					} else {
 						// Squash it.
-						result.beta[i] = 0;
+						slopes[i] = 0;
 					}
 				}
-				result.effective_dof = static_cast<double>(n - 1 - num_nonzero_slopes);
+				return static_cast<double>(n - 1 - num_nonzero_slopes);
 			} else {
-				result.effective_dof = result.dof;
+				return dof;
+			}
+		}
+
+		static void check_lasso_lambda(const double lambda)
+		{
+			if (lambda < 0) {
+				throw std::domain_error("Lasso regularisation constant cannot be negative");
 			}
+		}
+
+		template <> LassoRegressionResult lasso<false>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda)
+		{
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			check_lasso_lambda(lambda);
+			check_regression_inputs(X, y.size(), q);
+			LassoRegressionResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
+			result.beta.resize(q + 1);
+			const double intercept = y.mean();
+			result.beta[q] = intercept;
+			// Every iteration reuses X * X^T and X * y.
+			const Eigen::MatrixXd XXt(X * X.transpose());
+			const Eigen::VectorXd Xy(X * y);
+			auto slopes = result.beta.head(q);
+			slopes = XXt.ldlt().solve(Xy);
+			result.effective_dof = calculate_lasso_slopes(XXt, Xy, lambda, result.n, result.dof, slopes);
+			// Use the fact that intercept == mean(y).
+			const Eigen::VectorXd y_centred(y.array() - intercept);
+			// Residual sum of squares:
+			result.rss = (y_centred - X.transpose() * slopes).squaredNorm();
+			// Total sum of squares:
+			result.tss = y_centred.squaredNorm();
 			return result;
 		}
 
 		template <> LassoRegressionResult lasso<true>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double lambda)
 		{
-			Eigen::MatrixXd workX(X);
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			check_lasso_lambda(lambda);
+			check_regression_inputs(X, y.size(), q);
+			// Standardise X * X^T and X * y instead of a copy of X.
 			Eigen::VectorXd means;
+			Eigen::VectorXd mean_y;
+			Eigen::MatrixXd XXt;
+			Eigen::MatrixXd Xy;
 			Eigen::VectorXd standard_deviations;
-			standardise(workX, means, standard_deviations);
-			auto result = lasso<false>(workX, y, lambda);
-			const auto q = X.rows();
+			calculate_centred_moments(X, y, means, mean_y, XXt, Xy);
+			standardise_moments(XXt, Xy, n, standard_deviations);
+			LassoRegressionResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
+			result.beta.resize(q + 1);
 			auto slopes = result.beta.head(q);
+			slopes = XXt.ldlt().solve(Xy);
+			result.effective_dof = calculate_lasso_slopes(XXt, Xy, lambda, result.n, result.dof, slopes);
 			// Using Matlab notation: ./ and .* are elementwise / and *.
 			// new_slopes = slopes ./ standard_deviations
 			slopes.array() /= standard_deviations.array();
-			result.beta[q] -= slopes.dot(means);
+			result.beta[q] = mean_y[0] - slopes.dot(means);
+			// Residual sum of squares:
+			result.rss = ((y - X.transpose() * slopes).array() - result.beta[q]).matrix().squaredNorm();
+			// Total sum of squares:
+			result.tss = (y.array() - mean_y[0]).matrix().squaredNorm();
+			return result;
+		}
+
+		MultivariateOLSMultiTargetResult multivariate_multi_target(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y)
+		{
+			// X is an q x N matrix and Y is a N x T matrix.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			check_multi_target_regression_inputs(X, Y, q);
+			MultivariateOLSMultiTargetResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q);
+			const Eigen::LDLT<Eigen::MatrixXd> xxt_decomp(X * X.transpose());
+			result.beta = xxt_decomp.solve(X * Y);
+			result.rss = (Y - X.transpose() * result.beta).colwise().squaredNorm();
+			result.tss = calculate_tss(Y, Y.colwise().mean());
+			if (result.dof) {
+				result.unscaled_cov = xxt_decomp.solve(Eigen::MatrixXd::Identity(q, q));
+			} else {
+				result.unscaled_cov = Eigen::MatrixXd::Constant(q, q, std::numeric_limits<double>::quiet_NaN());
+			}
+			return result;
+		}
+
+		/// Calculates residual sums of squares for regularised regressions with slopes and intercepts in columns of `beta`.
+		static Eigen::VectorXd calculate_regularised_rss(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y, const Eigen::Ref<const Eigen::MatrixXd> beta)
+		{
+			const auto q = X.rows();
+			return ((Y - X.transpose() * beta.topRows(q)).rowwise() - beta.row(q)).colwise().squaredNorm();
+		}
+
+		template <> RidgeRegressionMultiTargetResult ridge_multi_target<false>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y, const double lambda)
+		{
+			// X is an q x N matrix and Y is a N x T matrix.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			if (lambda < 0) {
+				throw std::domain_error("Ridge regularisation constant cannot be negative");
+			}
+			check_multi_target_regression_inputs(X, Y, q);
+			RidgeRegressionMultiTargetResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
+			result.beta.resize(q + 1, Y.cols());
+			const Eigen::VectorXd means_Y(Y.colwise().mean());
+			result.beta.row(q) = means_Y.transpose();
+			const Eigen::MatrixXd XXt(X * X.transpose());
+			const Eigen::VectorXd lambdas(Eigen::VectorXd::Constant(q, lambda));
+			Eigen::MatrixXd work;
+			Eigen::LDLT<Eigen::MatrixXd> xxt_decomp;
+			result.beta.topRows(q) = solve_regularised(XXt, X * Y, lambdas, work, xxt_decomp);
+			result.rss = calculate_regularised_rss(X, Y, result.beta);
+			result.tss = calculate_tss(Y, means_Y);
+			result.effective_dof = calculate_ridge_effective_dof_and_cov(XXt, xxt_decomp, lambdas, result.n, result.dof, result.unscaled_cov);
+			return result;
+		}
+
+		template <> RidgeRegressionMultiTargetResult ridge_multi_target<true>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y, const double lambda)
+		{
+			// X is an q x N matrix and Y is a N x T matrix.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			if (lambda < 0) {
+				throw std::domain_error("Ridge regularisation constant cannot be negative");
+			}
+			check_multi_target_regression_inputs(X, Y, q);
+			Eigen::VectorXd means;
+			Eigen::VectorXd means_Y;
+			Eigen::MatrixXd XXt;
+			Eigen::MatrixXd XY;
+			Eigen::VectorXd standard_deviations;
+			calculate_centred_moments(X, Y, means, means_Y, XXt, XY);
+			standardise_moments(XXt, XY, n, standard_deviations);
+			RidgeRegressionMultiTargetResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
+			result.beta.resize(q + 1, Y.cols());
+			const Eigen::VectorXd lambdas(Eigen::VectorXd::Constant(q, lambda));
+			Eigen::MatrixXd work;
+			Eigen::LDLT<Eigen::MatrixXd> xxt_decomp;
+			auto slopes = result.beta.topRows(q);
+			slopes = solve_regularised(XXt, XY, lambdas, work, xxt_decomp);
+			result.effective_dof = calculate_ridge_effective_dof_and_cov(XXt, xxt_decomp, lambdas, result.n, result.dof, result.unscaled_cov);
+			slopes.array().colwise() /= standard_deviations.array();
+			result.beta.row(q) = means_Y.transpose() - means.transpose() * slopes;
+			result.rss = calculate_regularised_rss(X, Y, result.beta);
+			result.tss = calculate_tss(Y, means_Y);
+			unstandardise_ridge_cov(result.unscaled_cov, means, standard_deviations);
+			return result;
+		}
+
+		/// Runs Lasso iterations for every target, starting from the unregularised solutions which share one decomposition.
+		static void calculate_lasso_multi_target_slopes(const Eigen::Ref<const Eigen::MatrixXd> XXt, const Eigen::Ref<const Eigen::MatrixXd> XY, const double lambda, LassoRegressionMultiTargetResult& result)
+		{
+			const auto q = XXt.rows();
+			auto slopes = result.beta.topRows(q);
+			slopes = XXt.ldlt().solve(XY);
+			result.effective_dof.resize(XY.cols());
+			for (Eigen::Index i = 0; i < XY.cols(); ++i) {
+				result.effective_dof[i] = calculate_lasso_slopes(XXt, XY.col(i), lambda, result.n, result.dof, slopes.col(i));
+			}
+		}
+
+		template <> LassoRegressionMultiTargetResult lasso_multi_target<false>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y, const double lambda)
+		{
+			// X is an q x N matrix and Y is a N x T matrix.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			check_lasso_lambda(lambda);
+			check_multi_target_regression_inputs(X, Y, q);
+			LassoRegressionMultiTargetResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
+			result.beta.resize(q + 1, Y.cols());
+			const Eigen::VectorXd means_Y(Y.colwise().mean());
+			result.beta.row(q) = means_Y.transpose();
+			calculate_lasso_multi_target_slopes(X * X.transpose(), X * Y, lambda, result);
+			result.rss = calculate_regularised_rss(X, Y, result.beta);
+			result.tss = calculate_tss(Y, means_Y);
+			return result;
+		}
+
+		template <> LassoRegressionMultiTargetResult lasso_multi_target<true>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::MatrixXd> Y, const double lambda)
+		{
+			// X is an q x N matrix and Y is a N x T matrix.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			check_lasso_lambda(lambda);
+			check_multi_target_regression_inputs(X, Y, q);
+			Eigen::VectorXd means;
+			Eigen::VectorXd means_Y;
+			Eigen::MatrixXd XXt;
+			Eigen::MatrixXd XY;
+			Eigen::VectorXd standard_deviations;
+			calculate_centred_moments(X, Y, means, means_Y, XXt, XY);
+			standardise_moments(XXt, XY, n, standard_deviations);
+			LassoRegressionMultiTargetResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q - 1); // -1 for the intercept.
+			result.beta.resize(q + 1, Y.cols());
+			calculate_lasso_multi_target_slopes(XXt, XY, lambda, result);
+			auto slopes = result.beta.topRows(q);
+			slopes.array().colwise() /= standard_deviations.array();
+			result.beta.row(q) = means_Y.transpose() - means.transpose() * slopes;
+			result.rss = calculate_regularised_rss(X, Y, result.beta);
+			result.tss = calculate_tss(Y, means_Y);
 			return result;
 		}
 
@@ -100,6 +100,41 @@ namespace ml
 			}
 		};
 
+		/** @brief Results of many 1D Ordinary Least Squares regressions with intercept, stored as a structure of arrays.
+
+		Element `i` of every vector member describes the regression on the `i`-th series. All series have
+		the same number of data points.
+		*/
+		struct UnivariateOLSBatchResult
+		{
+			unsigned int n; /**< Number of data points in each series. */
+			unsigned int dof; /**< Number of residual degrees of freedom, equal to `n - 2`. */
+			Eigen::VectorXd rss; /**< Residual sums of squares. */
+			Eigen::VectorXd tss; /**< Total sums of squares. */
+			Eigen::VectorXd slope; /**< Slopes. */
+			Eigen::VectorXd intercept; /**< Intercepts. */
+			Eigen::VectorXd var_slope; /**< Estimated variances of the slopes. */
+			Eigen::VectorXd var_intercept; /**< Estimated variances of the intercepts. */
+			Eigen::VectorXd cov_slope_intercept; /**< Estimated covariances of the slopes and the intercepts. */
+
+			/** @brief Returns the number of series. */
+			Eigen::Index size() const
+			{
+				return slope.size();
+			}
+
+			/** @brief Estimated variances of observations Y, equal to `rss / dof`. */
+			DLL_DECLSPEC Eigen::VectorXd var_y() const;
+
+			/** @brief R2 coefficients, equal to `1 - rss / tss`. */
+			DLL_DECLSPEC Eigen::VectorXd r2() const;
+
+			/** @brief Returns the result for the `i`-th series.
+			@throw std::out_of_range If `i >= size()`.
+			*/
+			DLL_DECLSPEC UnivariateOLSResult operator[](Eigen::Index i) const;
+		};
+
 		/** @brief Result of multivariate Ordinary Least Squares regression.		
 
 		The #cov matrix is calculated asuming independent Gaussian error terms.
@@ -155,10 +190,13 @@ namespace ml
 			DLL_DECLSPEC double predict_single(Eigen::Ref<const Eigen::VectorXd> x) const;
 		};
 
-		/** @brief Result of a multivariate ridge regression with intercept.		*/
+		/** @brief Result of a multivariate ridge regression with intercept.
+
+		#effective_dof and #cov are calculated from Q x Q matrices only, using \f$ \mathrm{tr} [ X^T (X X^T + \lambda I)^{-1} X ] = \mathrm{tr} [ (X X^T + \lambda I)^{-1} X X^T ] \f$.
+		*/
 		struct RidgeRegressionResult : public RegularisedRegressionResult
 		{
-			Eigen::MatrixXd cov;  /**< Covariance matrix of beta coefficients. */
+			Eigen::MatrixXd cov;  /**< Covariance matrix of beta coefficients. For slopes, equal to \f$ \mathrm{Var}(Y) (X X^T + \lambda I)^{-1} X X^T (X X^T + \lambda I)^{-1} \f$ in standardised units. */
 			
 			/** @brief Formats the result as string. */
 			DLL_DECLSPEC std::string to_string() const;
@@ -175,6 +213,74 @@ namespace ml
 			using RegularisedRegressionResult::predict;			
 		};
 
+		/** @brief Results of multivariate regressions of many targets on the same X, stored as a structure of arrays.
+
+		Column `i` of #beta and element `i` of every vector member describe the regression on the `i`-th target (column of Y).
+		*/
+		struct MultiTargetResult
+		{
+			unsigned int n; /**< Number of data points. */
+			unsigned int dof; /**< Number of residual degrees of freedom. */
+			Eigen::MatrixXd beta; /**< Fitted coefficients, with targets in columns. */
+			Eigen::VectorXd rss; /**< Residual sums of squares. */
+			Eigen::VectorXd tss; /**< Total sums of squares. */
+
+			/** @brief Returns the number of targets. */
+			Eigen::Index size() const
+			{
+				return beta.cols();
+			}
+
+			/** @brief Estimated variances of observations Y, equal to `rss / dof`. */
+			DLL_DECLSPEC Eigen::VectorXd var_y() const;
+
+			/** @brief R2 coefficients, equal to `1 - rss / tss`. */
+			DLL_DECLSPEC Eigen::VectorXd r2() const;
+		};
+
+		/** @brief Results of multivariate Ordinary Least Squares regressions of many targets on the same X.
+
+		Covariance matrices of different targets differ only by the factor Var(Y), so a single #unscaled_cov matrix is stored.
+		*/
+		struct MultivariateOLSMultiTargetResult : public MultiTargetResult
+		{
+			Eigen::MatrixXd unscaled_cov; /**< Covariance matrix of beta coefficients divided by Var(Y). */
+
+			/** @brief Returns the result for the `i`-th target.
+			@throw std::out_of_range If `i >= size()`.
+			*/
+			DLL_DECLSPEC MultivariateOLSResult operator[](Eigen::Index i) const;
+		};
+
+		/** @brief Results of multivariate ridge regressions with intercept of many targets on the same X.
+
+		Each column of #beta is laid out like RidgeRegressionResult#beta.
+		*/
+		struct RidgeRegressionMultiTargetResult : public MultiTargetResult
+		{
+			Eigen::MatrixXd unscaled_cov; /**< Covariance matrix of beta coefficients divided by Var(Y). */
+			double effective_dof; /**< Effective number of residual degrees of freedom, the same for every target. */
+
+			/** @brief Returns the result for the `i`-th target.
+			@throw std::out_of_range If `i >= size()`.
+			*/
+			DLL_DECLSPEC RidgeRegressionResult operator[](Eigen::Index i) const;
+		};
+
+		/** @brief Results of multivariate Lasso regressions with intercept of many targets on the same X.
+
+		Each column of #beta is laid out like LassoRegressionResult#beta.
+		*/
+		struct LassoRegressionMultiTargetResult : public MultiTargetResult
+		{
+			Eigen::VectorXd effective_dof; /**< Effective numbers of residual degrees of freedom. */
+
+			/** @brief Returns the result for the `i`-th target.
+			@throw std::out_of_range If `i >= size()`.
+			*/
+			DLL_DECLSPEC LassoRegressionResult operator[](Eigen::Index i) const;
+		};
+
 		/** @brief Carries out univariate (aka simple) linear regression with intercept.
 
 		@param[in] x X vector.
@@ -195,6 +301,31 @@ namespace ml
 		*/
 		DLL_DECLSPEC UnivariateOLSResult univariate(double x0, double dx, Eigen::Ref<const Eigen::VectorXd> y);
 
+		/** @brief Carries out univariate linear regressions with intercept on many series at once.
+
+		Equivalent to calling univariate() on every pair of columns `(X.col(i), Y.col(i))`, but computes the
+		moments of all series in two vectorised passes over the data, without allocating memory for each series.
+
+		@param[in] X N x S matrix with X values of the `i`-th series in the `i`-th column.
+		@param[in] Y N x S matrix with Y values of the `i`-th series in the `i`-th column.
+		@return UnivariateOLSBatchResult object with `size() == S`.
+		@throw std::invalid_argument If `X` and `Y` have different shapes, or if `N < 2`.
+		*/
+		DLL_DECLSPEC UnivariateOLSBatchResult univariate_batch(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y);
+
+		/** @brief Carries out univariate linear regressions with intercept on many series with the same regularly spaced X values.
+
+		Equivalent to calling univariate(x0, dx, Y.col(i)) for every column of `Y`. The X moments are calculated only once.
+
+		@param[in] x0 First X value.
+		@param[in] dx Positive X increment.
+		@param[in] Y N x S matrix with Y values of the `i`-th series in the `i`-th column.
+		@return UnivariateOLSBatchResult object with `size() == S`.
+		@throw std::invalid_argument If `N < 2`.
+		@throw std::domain_error If `dx <= 0`.
+		*/
+		DLL_DECLSPEC UnivariateOLSBatchResult univariate_batch(double x0, double dx, Eigen::Ref<const Eigen::MatrixXd> Y);
+
 		/** @brief Carries out univariate (aka simple) linear regression without intercept.
 
 		@param[in] x X vector.
@@ -208,7 +339,7 @@ namespace ml
 
 		Given X and y, finds \f$ \vec{\beta} \f$ minimising \f$ \lVert \vec{y} - X^T \vec{\beta} \rVert^2 \f$.
 
-		If fitting with intercept is desired, include a row of 1's in the X values.
+		If fitting with intercept is desired, include a row of 1's in the X values, or use multivariate_with_intercept().
 
 		@param[in] X D x N matrix of X values, with data points in columns.
 		@param[in] y Y vector with length N.
@@ -218,14 +349,29 @@ namespace ml
 		*/
 		DLL_DECLSPEC MultivariateOLSResult multivariate(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y);
 
+		/** @brief Carries out multivariate linear regression with intercept, without copying `X`.
+
+		Equivalent to `multivariate(add_ones(X), y)`: finds \f$ \vec{\beta'} \f$ and \f$ \beta_0 \f$ minimising \f$ \lVert \vec{y} - X^T \vec{\beta'} - \beta_0 \rVert^2 \f$.
+		The intercept is handled by centring X * X^T and X * y on the means of `X` rows and `y`, instead of adding a row of 1's to `X`.
+
+		@param[in] X D x N matrix of X values, with data points in columns. Should NOT contain a row with all 1's.
+		@param[in] y Y vector with length N.
+		@return MultivariateOLSResult object with `beta.size() == X.rows() + 1` and the intercept in the last element of `beta`.
+		@throw std::invalid_argument If `y.size() != X.cols()` or `X.cols() <= X.rows()`.
+		*/
+		DLL_DECLSPEC MultivariateOLSResult multivariate_with_intercept(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y);
+
 		/** @brief Carries out multivariate ridge regression with intercept.
 
 		Given X and y, finds \f$ \vec{\beta'} \f$ and \f$ \beta_0 \f$ minimising \f$ \lVert \vec{y} - X^T \vec{\beta'} - \beta_0 \rVert^2 + \lambda \lVert \vec{\beta'} \rVert^2 \f$,
 		where \f$ \vec{\beta'} \f$ and \f$ \beta_0 \f$ are concatenated as RidgeRegressionResult#beta in the returned RidgeRegressionResult object.
 
 		The matrix `X` is either assumed to be standardised (`DoStandardise == false`)
-		or is standardised internally (`DoStandardise == true`; requires a matrix copy).
+		or is standardised internally (`DoStandardise == true`; standardisation is applied to \f$ X X^T \f$ and \f$ X \vec{y} \f$, without copying `X`).
 
+		If `X.rows() <= X.cols()`, the D x D matrix \f$ X X^T + \lambda I \f$ is decomposed (primal form). If `X.rows() > X.cols()`,
+		the N x N kernel matrix \f$ X^T X + \lambda I \f$ is decomposed instead (dual form), which costs \f$ O(N^2 D) \f$ instead of \f$ O(D^3) \f$.
+		In the dual form, `dof` is 0 and `cov` is empty, because it would require D x D memory.
 
 		@param[in] X D x N matrix of X values, with data points in columns. Should NOT contain a row with all 1's.
 		@param[in] y Y vector with length N.
@@ -233,7 +379,7 @@ namespace ml
 		@tparam DoStandardise Whether to standardise `X` internally.
 		@return RidgeRegressionResult object with `beta.size() == X.rows() + 1`. If `DoStandardise == true`, `beta`
 		will be rescaled and shifted to original `X` units and origins, and `cov` will be transformed accordingly.
-		@throw std::invalid_argument If `y.size() != X.cols()` or `X.cols() < X.rows()`.
+		@throw std::invalid_argument If `y.size() != X.cols()`, `X.cols() < 2`, or `X.cols() < X.rows()` and `lambda == 0`.
 		@throw std::domain_error If `lambda < 0`.
 		@see standardise()
 		*/
@@ -267,7 +413,7 @@ namespace ml
 		where \f$ \vec{\beta'} \f$ and \f$ \beta_0 \f$ are concatenated as LassoRegressionResult#beta in the returned LassoRegressionResult object.
 
 		The matrix `X` is either assumed to be standardised (`DoStandardise == false`)
-		or is standardised internally (`DoStandardise == true`; requires a matrix copy).
+		or is standardised internally (`DoStandardise == true`; standardisation is applied to \f$ X X^T \f$ and \f$ X \vec{y} \f$, without copying `X`).
 
 		Uses the iterated ridge regression method of Fan and Li (2001).
 
@@ -306,6 +452,67 @@ namespace ml
 			}
 		}
 
+		/** @brief Carries out multivariate linear regressions of many targets on the same X.
+
+		Equivalent to calling multivariate() for every column of `Y`, but \f$ X X^T \f$ is decomposed only once
+		and all coefficients are found with a single solve for the right-hand side \f$ X Y \f$.
+
+		@param[in] X D x N matrix of X values, with data points in columns.
+		@param[in] Y N x T matrix of Y values, with targets in columns.
+		@return MultivariateOLSMultiTargetResult object.
+		@throw std::invalid_argument If `Y.rows() != X.cols()`, `X.cols() < X.rows()` or `Y.cols() == 0`.
+		*/
+		DLL_DECLSPEC MultivariateOLSMultiTargetResult multivariate_multi_target(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y);
+
+		/** @brief Carries out multivariate ridge regressions with intercept of many targets on the same X.
+
+		Equivalent to calling ridge() for every column of `Y`, but \f$ X X^T + \lambda I \f$ is decomposed only once.
+
+		@param[in] X D x N matrix of X values, with data points in columns. Should NOT contain a row with all 1's.
+		@param[in] Y N x T matrix of Y values, with targets in columns.
+		@param[in] lambda Regularisation strength.
+		@tparam DoStandardise Whether to standardise `X` internally.
+		@return RidgeRegressionMultiTargetResult object with `beta.rows() == X.rows() + 1`.
+		@throw std::invalid_argument If `Y.rows() != X.cols()`, `X.cols() < X.rows()` or `Y.cols() == 0`.
+		@throw std::domain_error If `lambda < 0`.
+		*/
+		template <bool DoStandardise> RidgeRegressionMultiTargetResult ridge_multi_target(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y, double lambda);
+
+		/** @brief Carries out multivariate ridge regressions with intercept of many targets, standardising `X` inputs internally.
+		@see ridge_multi_target().
+		*/
+		template <> DLL_DECLSPEC RidgeRegressionMultiTargetResult ridge_multi_target<true>(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y, double lambda);
+
+		/** @brief Carries out multivariate ridge regressions with intercept of many targets, assuming standardised `X` inputs.
+		@see ridge_multi_target().
+		*/
+		template <> DLL_DECLSPEC RidgeRegressionMultiTargetResult ridge_multi_target<false>(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y, double lambda);
+
+		/** @brief Carries out multivariate Lasso regressions with intercept of many targets on the same X.
+
+		Equivalent to calling lasso() for every column of `Y`. \f$ X X^T \f$ and \f$ X Y \f$ are calculated once, and the
+		unregularised starting points for all targets share one decomposition. The iterations are carried out separately for each target.
+
+		@param[in] X D x N matrix of X values, with data points in columns. Should NOT contain a row with all 1's.
+		@param[in] Y N x T matrix of Y values, with targets in columns.
+		@param[in] lambda Regularisation strength.
+		@tparam DoStandardise Whether to standardise `X` internally.
+		@return LassoRegressionMultiTargetResult object with `beta.rows() == X.rows() + 1`.
+		@throw std::invalid_argument If `Y.rows() != X.cols()`, `X.cols() < X.rows()` or `Y.cols() == 0`.
+		@throw std::domain_error If `lambda < 0`.
+		*/
+		template <bool DoStandardise> LassoRegressionMultiTargetResult lasso_multi_target(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y, double lambda);
+
+		/** @brief Carries out multivariate Lasso regressions with intercept of many targets, standardising `X` inputs internally.
+		@see lasso_multi_target().
+		*/
+		template <> DLL_DECLSPEC LassoRegressionMultiTargetResult lasso_multi_target<true>(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y, double lambda);
+
+		/** @brief Carries out multivariate Lasso regressions with intercept of many targets, assuming standardised `X` inputs.
+		@see lasso_multi_target().
+		*/
+		template <> DLL_DECLSPEC LassoRegressionMultiTargetResult lasso_multi_target<false>(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::MatrixXd> Y, double lambda);
+
 		/** @brief Calculates the PRESS statistic (Predicted Residual Error Sum of Squares). 
 
 		See https://en.wikipedia.org/wiki/PRESS_statistic for details.
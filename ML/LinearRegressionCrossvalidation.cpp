@@ -0,0 +1,223 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <stdexcept>
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
+#include "LinearRegressionCrossvalidation.hpp"
+#include "Parallel.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		namespace
+		{
+			/// Number of data points centred, or predicted, at once.
+			constexpr Eigen::Index block_size = 256;
+
+			/// Moments of a set of data points, with X and y shifted by fixed values.
+			struct Moments
+			{
+				Eigen::MatrixXd XXt; /**< Sum of (x - x_shift) (x - x_shift)^T (lower triangle only). */
+				Eigen::VectorXd Xy; /**< Sum of (x - x_shift) (y - y_shift). */
+				Eigen::VectorXd sum_x; /**< Sum of (x - x_shift). */
+				double sum_y; /**< Sum of (y - y_shift). */
+				Eigen::Index n; /**< Number of data points. */
+
+				explicit Moments(const Eigen::Index q)
+					: XXt(Eigen::MatrixXd::Zero(q, q)), Xy(Eigen::VectorXd::Zero(q)), sum_x(Eigen::VectorXd::Zero(q)), sum_y(0), n(0)
+				{}
+
+				Moments& operator+=(const Moments& other)
+				{
+					XXt += other.XXt;
+					Xy += other.Xy;
+					sum_x += other.sum_x;
+					sum_y += other.sum_y;
+					n += other.n;
+					return *this;
+				}
+
+				/// Returns the moments of all data points except those in `part`.
+				Moments without(const Moments& part) const
+				{
+					Moments result(*this);
+					result.XXt -= part.XXt;
+					result.Xy -= part.Xy;
+					result.sum_x -= part.sum_x;
+					result.sum_y -= part.sum_y;
+					result.n -= part.n;
+					return result;
+				}
+			};
+
+			/// Calculates the moments of data points in a fold, shifting X and y by `x_shift` and `y_shift` if `do_shift` is true.
+			Moments calc_moments(const Crossvalidation::FoldView& fold, const Eigen::VectorXd& x_shift, const double y_shift, const bool do_shift)
+			{
+				const auto q = fold.dim();
+				Moments moments(q);
+				Eigen::MatrixXd shifted_X;
+				Eigen::VectorXd shifted_y;
+				fold.for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y) {
+					if (!do_shift) {
+						moments.XXt.selfadjointView<Eigen::Lower>().rankUpdate(X);
+						moments.Xy.noalias() += X * y;
+						moments.sum_x += X.rowwise().sum();
+						moments.sum_y += y.sum();
+						return;
+					}
+					for (Eigen::Index i0 = 0; i0 < X.cols(); i0 += block_size) {
+						const auto len = std::min(block_size, X.cols() - i0);
+						shifted_X = X.middleCols(i0, len).colwise() - x_shift;
+						shifted_y = y.segment(i0, len).array() - y_shift;
+						moments.XXt.selfadjointView<Eigen::Lower>().rankUpdate(shifted_X);
+						moments.Xy.noalias() += shifted_X * shifted_y;
+						moments.sum_x += shifted_X.rowwise().sum();
+						moments.sum_y += shifted_y.sum();
+					}
+				});
+				moments.n = fold.size();
+				return moments;
+			}
+
+			/// Calculates the sums of squared residuals y - X^T * slopes - intercepts on a fold, with one model per column of `slopes`.
+			Eigen::VectorXd calc_sse(const Crossvalidation::FoldView& fold, const Eigen::MatrixXd& slopes, const Eigen::VectorXd& intercepts)
+			{
+				Eigen::VectorXd sse(Eigen::VectorXd::Zero(slopes.cols()));
+				Eigen::MatrixXd residuals;
+				fold.for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y) {
+					for (Eigen::Index i0 = 0; i0 < X.cols(); i0 += block_size) {
+						const auto len = std::min(block_size, X.cols() - i0);
+						residuals.noalias() = -X.middleCols(i0, len).transpose() * slopes;
+						residuals.colwise() += y.segment(i0, len);
+						residuals.rowwise() -= intercepts.transpose();
+						sse += residuals.colwise().squaredNorm().transpose();
+					}
+				});
+				return sse;
+			}
+
+			/** Runs k-fold cross-validation given a function which fits models to the moments of a training set.
+			`fit(moments, slopes, intercepts)` sets the slopes (one model per column) and intercepts of the models.
+			*/
+			template <class Fit> Eigen::VectorXd k_fold_from_moments(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const std::vector<unsigned int>& folds, const unsigned int number_threads, const Eigen::Index min_training_size, const Eigen::Index number_models, const bool do_shift, Fit fit)
+			{
+				if (X.cols() != y.size() || static_cast<size_t>(X.cols()) != folds.size()) {
+					throw std::invalid_argument("Data size mismatch");
+				}
+				const auto fold_sizes = Crossvalidation::calc_fold_sizes(folds);
+				const auto num_folds = static_cast<unsigned int>(fold_sizes.size());
+				for (const auto fold_size : fold_sizes) {
+					if (static_cast<Eigen::Index>(folds.size() - fold_size) < min_training_size) {
+						throw std::invalid_argument("Not enough data points for regression");
+					}
+				}
+				Eigen::VectorXd x_shift;
+				double y_shift = 0;
+				if (do_shift) {
+					x_shift = X.rowwise().mean();
+					y_shift = y.mean();
+				}
+				std::vector<Moments> fold_moments(num_folds, Moments(X.rows()));
+				Parallel::for_each_chunk(num_folds, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+					for (auto k = static_cast<unsigned int>(begin); k < end; ++k) {
+						fold_moments[k] = calc_moments(Crossvalidation::FoldView(X, y, folds, k, true), x_shift, y_shift, do_shift);
+					}
+				});
+				// Summed in fold order, so that the result does not depend on the number of threads.
+				Moments total(X.rows());
+				for (const auto& moments : fold_moments) {
+					total += moments;
+				}
+				std::vector<Eigen::VectorXd> fold_sse(num_folds);
+				Parallel::for_each_chunk(num_folds, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+					Eigen::MatrixXd slopes(X.rows(), number_models);
+					Eigen::VectorXd intercepts(number_models);
+					for (auto k = static_cast<unsigned int>(begin); k < end; ++k) {
+						Moments training = total.without(fold_moments[k]);
+						training.XXt.triangularView<Eigen::StrictlyUpper>() = training.XXt.transpose();
+						fit(training, x_shift, y_shift, slopes, intercepts);
+						fold_sse[k] = calc_sse(Crossvalidation::FoldView(X, y, folds, k, true), slopes, intercepts);
+					}
+				});
+				Eigen::VectorXd sse(Eigen::VectorXd::Zero(number_models));
+				for (const auto& s : fold_sse) {
+					sse += s;
+				}
+				return sse / static_cast<double>(X.cols());
+			}
+
+			template <bool DoStandardise> Eigen::VectorXd k_fold_ridge_impl(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const Eigen::Ref<const Eigen::VectorXd> lambdas, const std::vector<unsigned int>& folds, const unsigned int number_threads)
+			{
+				if (!lambdas.size()) {
+					throw std::invalid_argument("At least one lambda value required");
+				}
+				if (lambdas.minCoeff() < 0) {
+					throw std::domain_error("Ridge regularisation constant cannot be negative");
+				}
+				const auto fit = [&lambdas](const Moments& training, const Eigen::VectorXd& x_shift, const double y_shift, Eigen::MatrixXd& slopes, Eigen::VectorXd& intercepts) {
+					const auto n = static_cast<double>(training.n);
+					Eigen::MatrixXd XXt;
+					Eigen::VectorXd Xy;
+					Eigen::VectorXd standard_deviations;
+					if (DoStandardise) {
+						// Centre on the means of the training set and standardise, like ridge<true>().
+						XXt = training.XXt - training.sum_x * training.sum_x.transpose() / n;
+						Xy = training.Xy - training.sum_x * (training.sum_y / n);
+						standard_deviations = (XXt.diagonal() / n).array().sqrt();
+						if (!(standard_deviations.array() > 0).all()) {
+							throw std::invalid_argument("At least one row has constant values");
+						}
+						XXt.array() /= (standard_deviations * standard_deviations.transpose()).array();
+						Xy.array() /= standard_deviations.array();
+					} else {
+						// Like ridge<false>(), use uncentred X and y.
+						XXt = training.XXt;
+						Xy = training.Xy;
+					}
+					// (X X^T + lambda I)^{-1} X y = V (Lambda + lambda I)^{-1} V^T X y
+					const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigen_solver(XXt);
+					const Eigen::VectorXd projected_Xy(eigen_solver.eigenvectors().transpose() * Xy);
+					const auto& eigenvalues = eigen_solver.eigenvalues();
+					const double mean_y = training.sum_y / n + y_shift;
+					Eigen::MatrixXd scaled(projected_Xy.size(), lambdas.size());
+					for (Eigen::Index l = 0; l < lambdas.size(); ++l) {
+						const Eigen::ArrayXd denominators(eigenvalues.array() + lambdas[l]);
+						if (!(denominators.minCoeff() > 0)) {
+							throw std::domain_error("X * X^T + lambda * I is singular for a training set");
+						}
+						scaled.col(l) = projected_Xy.array() / denominators;
+					}
+					slopes.noalias() = eigen_solver.eigenvectors() * scaled;
+					if (DoStandardise) {
+						slopes.array().colwise() /= standard_deviations.array();
+						const Eigen::VectorXd means(x_shift + training.sum_x / n);
+						intercepts = (mean_y - (slopes.transpose() * means).array()).matrix();
+					} else {
+						intercepts.setConstant(mean_y);
+					}
+				};
+				return k_fold_from_moments(X, y, folds, number_threads, 2, lambdas.size(), DoStandardise, fit);
+			}
+		}
+
+		double k_fold_multivariate(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const std::vector<unsigned int>& folds, const unsigned int number_threads)
+		{
+			const auto fit = [](const Moments& training, const Eigen::VectorXd&, double, Eigen::MatrixXd& slopes, Eigen::VectorXd& intercepts) {
+				slopes.col(0) = training.XXt.ldlt().solve(training.Xy);
+				intercepts[0] = 0;
+			};
+			return k_fold_from_moments(X, y, folds, number_threads, X.rows(), 1, false, fit)[0];
+		}
+
+		template <> Eigen::VectorXd k_fold_ridge<true>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const Eigen::Ref<const Eigen::VectorXd> lambdas, const std::vector<unsigned int>& folds, const unsigned int number_threads)
+		{
+			return k_fold_ridge_impl<true>(X, y, lambdas, folds, number_threads);
+		}
+
+		template <> Eigen::VectorXd k_fold_ridge<false>(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const Eigen::Ref<const Eigen::VectorXd> lambdas, const std::vector<unsigned int>& folds, const unsigned int number_threads)
+		{
+			return k_fold_ridge_impl<false>(X, y, lambdas, folds, number_threads);
+		}
+	}
+}
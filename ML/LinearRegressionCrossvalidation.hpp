@@ -0,0 +1,80 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <vector>
+#include "Crossvalidation.hpp"
+#include "LinearRegression.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		/** @brief Calculates the k-fold cross-validation error of multivariate(), using fold-wise sufficient statistics.
+
+		Gives the same result (up to rounding) as Crossvalidation::k_fold_view() with a trainer calling multivariate() and a tester
+		returning the mean squared prediction error, but without copying or re-reading the training data for every fold.
+		\f$ X_k X_k^T \f$ and \f$ X_k \vec{y}_k \f$ are accumulated once for every fold k; the moments of the training set are
+		obtained by subtracting those of fold k from their sums over all folds. The test error is calculated from the
+		residuals on fold k. The data are read twice in total, irrespective of the number of folds.
+
+		@param[in] X D x N matrix of X values, with data points in columns.
+		@param[in] y Y vector with length N.
+		@param[in] folds Fold index of every data point. Every fold must be non-empty.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used. The result does not depend on it.
+		@return Mean squared prediction error per data point.
+		@throw std::invalid_argument If `y.size() != X.cols()`, `folds.size() != X.cols()`, there are fewer than 2 folds, any fold is empty or any training set has fewer than D data points.
+		@see Crossvalidation::folds_from_permutation(), Crossvalidation::calc_contiguous_folds()
+		*/
+		DLL_DECLSPEC double k_fold_multivariate(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, const std::vector<unsigned int>& folds, unsigned int number_threads = 1);
+
+		/** @brief Calculates the k-fold cross-validation error of multivariate() with contiguous folds.
+		@see k_fold_multivariate(Eigen::Ref<const Eigen::MatrixXd>, Eigen::Ref<const Eigen::VectorXd>, const std::vector<unsigned int>&, unsigned int)
+		@throw std::invalid_argument If `num_folds > X.cols()`.
+		*/
+		inline double k_fold_multivariate(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, const unsigned int num_folds, const unsigned int number_threads = 1)
+		{
+			return k_fold_multivariate(X, y, Crossvalidation::calc_contiguous_folds(static_cast<size_t>(X.cols()), num_folds), number_threads);
+		}
+
+		/** @brief Calculates the k-fold cross-validation errors of ridge() for a grid of regularisation strengths, using fold-wise sufficient statistics.
+
+		Gives the same results (up to rounding) as Crossvalidation::k_fold_view() with a trainer calling `ridge<DoStandardise>()` and a tester
+		returning the mean squared prediction error, repeated for every `lambda`, but reads the data only twice in total.
+
+		The centred moments of every fold are accumulated once (centring on the means of all data, to avoid cancellation).
+		For fold k, the moments of the training set are the sums over all folds minus those of fold k; they are standardised
+		if `DoStandardise == true`, exactly like ridge() would do it for the training set. The training matrix
+		\f$ X X^T \f$ is diagonalised once per fold, after which the slopes for each `lambda` cost \f$ O(D^2) \f$.
+		The prediction errors for all `lambda` values are calculated in one pass over fold k.
+
+		@param[in] X D x N matrix of X values, with data points in columns. Should NOT contain a row with all 1's.
+		@param[in] y Y vector with length N.
+		@param[in] lambdas Regularisation strengths.
+		@param[in] folds Fold index of every data point. Every fold must be non-empty.
+		@param[in] number_threads Number of threads. If 0, the number of hardware threads is used. The result does not depend on it.
+		@tparam DoStandardise Whether to standardise `X` internally, see ridge().
+		@return Vector with the mean squared prediction error per data point for every `lambda`.
+		@throw std::invalid_argument If `y.size() != X.cols()`, `folds.size() != X.cols()`, `lambdas` is empty, there are fewer than 2 folds, any fold is empty, any training set has fewer than 2 data points, or (if `DoStandardise == true`) X has a constant row in any training set.
+		@throw std::domain_error If any `lambda < 0`, or `lambda == 0` and \f$ X X^T \f$ is singular for some training set.
+		*/
+		template <bool DoStandardise> Eigen::VectorXd k_fold_ridge(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Eigen::Ref<const Eigen::VectorXd> lambdas, const std::vector<unsigned int>& folds, unsigned int number_threads = 1);
+
+		/** @brief Calculates the k-fold cross-validation errors of ridge<true>() for a grid of regularisation strengths.
+		@see k_fold_ridge().
+		*/
+		template <> DLL_DECLSPEC Eigen::VectorXd k_fold_ridge<true>(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Eigen::Ref<const Eigen::VectorXd> lambdas, const std::vector<unsigned int>& folds, unsigned int number_threads);
+
+		/** @brief Calculates the k-fold cross-validation errors of ridge<false>() for a grid of regularisation strengths.
+		@see k_fold_ridge().
+		*/
+		template <> DLL_DECLSPEC Eigen::VectorXd k_fold_ridge<false>(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Eigen::Ref<const Eigen::VectorXd> lambdas, const std::vector<unsigned int>& folds, unsigned int number_threads);
+
+		/** @brief Calculates the k-fold cross-validation errors of ridge() for a grid of regularisation strengths, with contiguous folds.
+		@see k_fold_ridge().
+		@throw std::invalid_argument If `num_folds > X.cols()`.
+		*/
+		template <bool DoStandardise> Eigen::VectorXd k_fold_ridge(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, Eigen::Ref<const Eigen::VectorXd> lambdas, const unsigned int num_folds, const unsigned int number_threads = 1)
+		{
+			return k_fold_ridge<DoStandardise>(X, y, lambdas, Crossvalidation::calc_contiguous_folds(static_cast<size_t>(X.cols()), num_folds), number_threads);
+		}
+	}
+}
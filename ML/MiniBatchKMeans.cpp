@@ -0,0 +1,178 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "MiniBatchKMeans.hpp"
+
+namespace ml
+{
+    namespace Clustering
+    {
+		MiniBatchKMeans::MiniBatchKMeans(const unsigned int number_clusters, const unsigned int batch_size)
+			: centroids_initialiser_(std::make_shared<Clustering::KPP>())
+			, absolute_tolerance_(1e-8)
+			, inertia_(0)
+			, maximum_steps_(1000)
+			, num_clusters_(number_clusters)
+			, num_inits_(3)
+			, batch_size_(batch_size)
+			, number_threads_(1)
+			, converged_(false)
+		{
+			if (!number_clusters) {
+				throw std::invalid_argument("MiniBatchKMeans: number of clusters cannot be zero");
+			}
+			if (!batch_size) {
+				throw std::invalid_argument("MiniBatchKMeans: batch size cannot be zero");
+			}
+		}
+
+		bool MiniBatchKMeans::fit(const Eigen::Ref<const Eigen::MatrixXd> data)
+		{
+			reset();
+			const auto sample_size = data.cols();
+			if (!data.rows()) {
+				throw std::invalid_argument("MiniBatchKMeans: At least one dimension required");
+			}
+			if (sample_size < num_clusters_) {
+				throw std::invalid_argument("MiniBatchKMeans: Not enough data");
+			}
+			initialise(data);
+			batch_.resize(data.rows(), batch_size_);
+			std::uniform_int_distribution<Eigen::Index> sample_index(0, sample_size - 1);
+			for (unsigned int step = 0; step < maximum_steps_; ++step) {
+				for (unsigned int j = 0; j < batch_size_; ++j) {
+					batch_.col(j) = data.col(sample_index(prng_));
+				}
+				old_centroids_ = centroids_;
+				update_step(batch_);
+				if (step > 0 && (centroids_ - old_centroids_).squaredNorm() < absolute_tolerance_) {
+					converged_ = true;
+					break;
+				}
+			}
+			assign_all(data);
+			return converged_;
+		}
+
+		void MiniBatchKMeans::partial_fit(const Eigen::Ref<const Eigen::MatrixXd> chunk)
+		{
+			if (!chunk.rows()) {
+				throw std::invalid_argument("MiniBatchKMeans: At least one dimension required");
+			}
+			if (!counts_.size()) {
+				if (chunk.cols() < num_clusters_) {
+					throw std::invalid_argument("MiniBatchKMeans: Not enough data to initialise centroids");
+				}
+				initialise(chunk);
+			} else if (chunk.rows() != centroids_.rows()) {
+				throw std::invalid_argument("MiniBatchKMeans: Data dimension mismatch");
+			}
+			for (Eigen::Index i0 = 0; i0 < chunk.cols(); i0 += batch_size_) {
+				update_step(chunk.middleCols(i0, std::min(static_cast<Eigen::Index>(batch_size_), chunk.cols() - i0)));
+			}
+			assign_all(chunk);
+		}
+
+		void MiniBatchKMeans::reset()
+		{
+			centroids_.resize(0, 0);
+			counts_.resize(0);
+			labels_.clear();
+			inertia_ = 0;
+			converged_ = false;
+		}
+
+		void MiniBatchKMeans::set_seed(const unsigned int seed)
+		{
+			prng_.seed(seed);
+		}
+
+		void MiniBatchKMeans::set_absolute_tolerance(const double absolute_tolerance)
+		{
+			if (absolute_tolerance < 0) {
+				throw std::domain_error("MiniBatchKMeans: Negative absolute tolerance");
+			}
+			absolute_tolerance_ = absolute_tolerance;
+		}
+
+		void MiniBatchKMeans::set_maximum_steps(const unsigned int maximum_steps)
+		{
+			if (maximum_steps < 2) {
+				throw std::invalid_argument("MiniBatchKMeans: At least two steps required for convergence test");
+			}
+			maximum_steps_ = maximum_steps;
+		}
+
+		void MiniBatchKMeans::set_number_initialisations(const unsigned int number_initialisations)
+		{
+			if (number_initialisations < 1) {
+				throw std::invalid_argument("MiniBatchKMeans: At least 1 initialisation required");
+			}
+			num_inits_ = number_initialisations;
+		}
+
+		void MiniBatchKMeans::set_centroids_initialiser(std::shared_ptr<const Clustering::CentroidsInitialiser> centroids_initialiser)
+		{
+			if (!centroids_initialiser) {
+				throw std::invalid_argument("MiniBatchKMeans: Null centroids initialiser");
+			}
+			centroids_initialiser_ = centroids_initialiser;
+		}
+
+		std::pair<unsigned int, double> MiniBatchKMeans::assign_label(const Eigen::Ref<const Eigen::VectorXd> x) const
+		{
+			if (x.size() != centroids_.rows()) {
+				throw std::invalid_argument("MiniBatchKMeans: Data dimension mismatch");
+			}
+			double min_squared_distance = std::numeric_limits<double>::infinity();
+			unsigned int label = 0;
+			for (unsigned int k = 0; k < num_clusters_; ++k) {
+				const auto squared_distance = (x - centroids_.col(k)).squaredNorm();
+				if (squared_distance < min_squared_distance) {
+					min_squared_distance = squared_distance;
+					label = k;
+				}
+			}
+			return std::make_pair(label, min_squared_distance);
+		}
+
+		void MiniBatchKMeans::initialise(const Eigen::Ref<const Eigen::MatrixXd> data)
+		{
+			centroids_.resize(data.rows(), num_clusters_);
+			Eigen::MatrixXd candidate(data.rows(), num_clusters_);
+			double min_inertia = std::numeric_limits<double>::infinity();
+			for (unsigned int n = 0; n < num_inits_; ++n) {
+				centroids_initialiser_->init(data, prng_, num_clusters_, candidate);
+				squared_distances_.resize(data.cols());
+				find_closest_centroids(data, candidate, labels_, squared_distances_, number_threads_);
+				const double inertia = squared_distances_.sum();
+				// The first one in case of a tie.
+				if (inertia < min_inertia || !n) {
+					min_inertia = inertia;
+					centroids_ = candidate;
+				}
+			}
+			counts_.setZero(num_clusters_);
+		}
+
+		void MiniBatchKMeans::update_step(const Eigen::Ref<const Eigen::MatrixXd> batch)
+		{
+			// All points in the batch are assigned to the centroids from before the batch.
+			batch_squared_distances_.resize(batch.cols());
+			find_closest_centroids(batch, centroids_, batch_labels_, batch_squared_distances_, number_threads_);
+			for (Eigen::Index j = 0; j < batch.cols(); ++j) {
+				const unsigned int label = batch_labels_[static_cast<size_t>(j)];
+				const double learning_rate = 1 / (++counts_[label]);
+				centroids_.col(label) += learning_rate * (batch.col(j) - centroids_.col(label));
+			}
+		}
+
+		void MiniBatchKMeans::assign_all(const Eigen::Ref<const Eigen::MatrixXd> data)
+		{
+			squared_distances_.resize(data.cols());
+			find_closest_centroids(data, centroids_, labels_, squared_distances_, number_threads_);
+			inertia_ = squared_distances_.sum();
+		}
+    }
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include "Clustering.hpp"
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+#include "dll.hpp"
+
+namespace ml
+{
+    namespace Clustering
+    {
+        /**
+         * @brief Mini-batch K-means clustering method.
+         *
+         * Instead of assigning all data points in every step, updates the centroids from small batches of points (Sculley, "Web-scale k-means clustering", 2010).
+         * Every point in a batch moves its closest centroid towards itself with a learning rate 1 / n, where n is the number of points which have
+         * been assigned to that centroid so far. Each centroid is therefore the running mean of the points assigned to it.
+         *
+         * fit() samples batches from the data with replacement. partial_fit() instead processes a chunk of a stream in consecutive batches, so that the centroids
+         * can be refined as new chunks arrive without keeping the data which was already seen.
+         *
+         * The centroids are initialised several times (see set_number_initialisations()) and the initialisation with the lowest inertia
+         * on the data (or the first chunk) is kept, because the learning rates soon become too small to move a centroid to a cluster it missed.
+         *
+         * fit() converges if the sum of squared differences between centroids before and after a batch is lower than the tolerance.
+        */
+        class MiniBatchKMeans : public Model
+        {
+        public:
+            /** @brief Constructs a mini-batch K-means model ready to fit.
+            @param[in] number_clusters Number of clusters.
+            @param[in] batch_size Number of data points in a batch.
+            @throw std::invalid_argument If `number_clusters == 0` or `batch_size == 0`.
+            */
+            DLL_DECLSPEC MiniBatchKMeans(unsigned int number_clusters, unsigned int batch_size = 1024);
+
+            /** @brief Fits the model from scratch, sampling batches from the data.
+
+            After fitting, all data points are assigned to the closest centroids, to calculate labels() and inertia().
+            */
+            DLL_DECLSPEC bool fit(Eigen::Ref<const Eigen::MatrixXd> data) override;
+
+            /** @brief Refines the centroids using the next chunk of a data stream.
+
+            If the centroids have not been initialised yet (by fit() or a previous call), they are initialised from `chunk` using the centroids initialiser.
+            The chunk is then processed in consecutive batches. Afterwards, labels() and inertia() refer to the points in `chunk`.
+            @param[in] chunk Matrix with a data point in every column.
+            @throw std::invalid_argument If `chunk` has no rows, a different number of rows than the data fitted previously,
+            or fewer columns than the number of clusters when the centroids need to be initialised.
+            */
+            DLL_DECLSPEC void partial_fit(Eigen::Ref<const Eigen::MatrixXd> chunk);
+
+            /** @brief Forgets the centroids and the numbers of points assigned to them. */
+            DLL_DECLSPEC void reset();
+
+            unsigned int number_clusters() const override
+            {
+                return num_clusters_;
+            }
+
+            const std::vector<unsigned int>& labels() const override
+            {
+                return labels_;
+            }
+
+            const Eigen::MatrixXd& centroids() const override
+            {
+                return centroids_;
+            }
+
+            /** @brief Numbers of data points which have updated each centroid, since the last call to fit() or reset(). */
+            const Eigen::VectorXd& counts() const
+            {
+                return counts_;
+            }
+
+            /** @brief Sets PRNG seed.
+            @param[in] seed PRNG seed.
+            */
+            DLL_DECLSPEC void set_seed(unsigned int seed);
+
+            /** @brief Sets absolute tolerance for convergence test in fit(): || centroids before batch - centroids after batch ||^2 < absolute tolerance.
+            @param[in] absolute_tolerance Absolute tolerance.
+            @throw std::domain_error If `absolute_tolerance < 0`.
+            */
+            DLL_DECLSPEC void set_absolute_tolerance(double absolute_tolerance);
+
+            /** @brief Sets maximum number of batches processed by fit().
+            @param[in] maximum_steps Maximum number of batches.
+            @throw std::invalid_argument If `maximum_steps < 2`.
+            */
+            DLL_DECLSPEC void set_maximum_steps(unsigned int maximum_steps);
+
+            /** @brief Sets the number of initialisations of the centroids, of which the one with the lowest inertia is kept. Default is 3.
+            @param[in] number_initialisations Number of initialisations.
+            @throw std::invalid_argument If `number_initialisations < 1`.
+            */
+            DLL_DECLSPEC void set_number_initialisations(unsigned int number_initialisations);
+
+            /** @brief Sets centroids initialiser.
+            @param[in] centroids_initialiser Pointer to CentroidsInitialiser implementation.
+            @throw std::invalid_argument If `centroids_initialiser` is null.
+            */
+            DLL_DECLSPEC void set_centroids_initialiser(std::shared_ptr<const CentroidsInitialiser> centroids_initialiser);
+
+            /** @brief Sets the number of threads used to assign points to centroids. Default is 1. The results do not depend on it.
+            @param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+            */
+            void set_number_threads(unsigned int number_threads)
+            {
+                number_threads_ = number_threads;
+            }
+
+            /** @brief Given a data point x, assign it to its cluster and return the correct label and squared Euclidean distance to the assigned centroid.
+
+            @param[in] x Data point with correct dimension.
+            @throw std::invalid_argument If `x.size() != centroids().rows()`.
+            */
+            DLL_DECLSPEC std::pair<unsigned int, double> assign_label(Eigen::Ref<const Eigen::VectorXd> x) const;
+
+            /**
+             * @brief Sum of squared distances to the nearest centroid, for the data passed to the last call to fit() or partial_fit().
+             * @return Non-negative number;
+            */
+            double inertia() const
+            {
+                return inertia_;
+            }
+
+            bool converged() const override
+            {
+                return converged_;
+            }
+        private:
+            std::vector<unsigned int> labels_;
+            std::vector<unsigned int> batch_labels_;
+            Eigen::MatrixXd centroids_;
+            Eigen::MatrixXd old_centroids_;
+            Eigen::MatrixXd batch_;
+            Eigen::VectorXd batch_squared_distances_;
+            Eigen::VectorXd squared_distances_;
+            Eigen::VectorXd counts_;
+            std::default_random_engine prng_;
+            std::shared_ptr<const CentroidsInitialiser> centroids_initialiser_;
+            double absolute_tolerance_;
+            double inertia_;
+            unsigned int maximum_steps_;
+            unsigned int num_clusters_;
+            unsigned int num_inits_;
+            unsigned int batch_size_;
+            unsigned int number_threads_;
+            bool converged_;
+
+            /// Initialises centroids using the data, keeping the initialisation with the lowest inertia.
+            void initialise(Eigen::Ref<const Eigen::MatrixXd> data);
+
+            /// Moves the centroids towards the points in the batch, in order.
+            void update_step(Eigen::Ref<const Eigen::MatrixXd> batch);
+
+            /// Assigns all points to centroids and calculates inertia.
+            void assign_all(Eigen::Ref<const Eigen::MatrixXd> data);
+        };
+    }
+}
@@ -0,0 +1,111 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <Eigen/Cholesky>
+#include "MixedPrecisionOLS.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		std::string MixedPrecisionOLSResult::to_string() const
+		{
+			std::stringstream s;
+			s << "MixedPrecisionOLSResult(n=" << n << ", dof=" << dof << ", rss=" << rss << ", tss=" << tss;
+			s << ", var_y=" << var_y() << ", r2=" << r2() << ", adjusted_r2=" << adjusted_r2();
+			s << ", beta=[" << beta.transpose() << "]";
+			s << ", cov=[" << cov << "]";
+			s << ", iterations=" << iterations << ", fell_back=" << fell_back;
+			s << ")";
+			return s.str();
+		}
+
+		/// Number of X columns converted to single precision at once.
+		static constexpr Eigen::Index conversion_block_size = 256;
+
+		static MixedPrecisionOLSResult fall_back(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const unsigned int iterations)
+		{
+			MixedPrecisionOLSResult result;
+			static_cast<MultivariateOLSResult&>(result) = multivariate(X, y);
+			result.iterations = iterations;
+			result.fell_back = true;
+			return result;
+		}
+
+		MixedPrecisionOLSResult multivariate_mixed_precision(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const double tolerance, const unsigned int max_iterations)
+		{
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			if (n != y.size()) {
+				throw std::invalid_argument("X matrix has different number of data points than Y has values");
+			}
+			if (!q) {
+				throw std::invalid_argument("At least one feature required");
+			}
+			if (n < q) {
+				throw std::invalid_argument("Not enough data points for regression");
+			}
+			if (!(tolerance > 0)) {
+				throw std::invalid_argument("Tolerance must be positive");
+			}
+			Eigen::MatrixXf XXt(Eigen::MatrixXf::Zero(q, q));
+			Eigen::MatrixXf X_block(q, std::min(n, conversion_block_size));
+			for (Eigen::Index begin = 0; begin < n; begin += conversion_block_size) {
+				const auto size = std::min(conversion_block_size, n - begin);
+				X_block.leftCols(size) = X.middleCols(begin, size).cast<float>();
+				XXt.selfadjointView<Eigen::Lower>().rankUpdate(X_block.leftCols(size));
+			}
+			const Eigen::LLT<Eigen::MatrixXf> xxt_decomp(XXt);
+			if (xxt_decomp.info() != Eigen::Success) {
+				return fall_back(X, y, 0);
+			}
+			const auto solve = [&xxt_decomp](const Eigen::VectorXd& b) -> Eigen::VectorXd {
+				return xxt_decomp.solve(b.cast<float>()).cast<double>();
+			};
+
+			MixedPrecisionOLSResult result;
+			result.iterations = 0;
+			result.fell_back = false;
+			result.beta = solve(X * y);
+			Eigen::VectorXd residuals(n);
+			double previous_correction_norm = std::numeric_limits<double>::infinity();
+			while (true) {
+				residuals.noalias() = y - X.transpose() * result.beta;
+				if (result.iterations == max_iterations) {
+					return fall_back(X, y, result.iterations);
+				}
+				const Eigen::VectorXd correction(solve(X * residuals));
+				result.beta += correction;
+				++result.iterations;
+				const double correction_norm = correction.norm();
+				if (correction_norm <= tolerance * result.beta.norm()) {
+					break;
+				}
+				if (correction_norm > 0.5 * previous_correction_norm) {
+					// Refinement stalled.
+					return fall_back(X, y, result.iterations);
+				}
+				previous_correction_norm = correction_norm;
+			}
+			// The last correction is negligible, so the residuals before it can be used.
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q);
+			// Residual sum of squares:
+			result.rss = residuals.squaredNorm();
+			if (result.dof) {
+				// (L L^T)^{-1} = L^{-T} L^{-1}, multiplied in double precision to keep it symmetric.
+				const Eigen::MatrixXd L_inv(xxt_decomp.matrixL().solve(Eigen::MatrixXf::Identity(q, q)).cast<double>());
+				result.cov.noalias() = L_inv.transpose() * L_inv;
+				result.cov *= result.var_y();
+			} else {
+				result.cov = Eigen::MatrixXd::Constant(q, q, std::numeric_limits<double>::quiet_NaN());
+			}
+			// Total sum of squares:
+			result.tss = (y.array() - y.mean()).square().sum();
+			return result;
+		}
+	}
+}
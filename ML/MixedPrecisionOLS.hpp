@@ -0,0 +1,46 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include "LinearRegression.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		/** @brief Result of a multivariate OLS regression solved in mixed precision.
+
+		Unless #fell_back is true, #cov is calculated from the single precision decomposition of \f$ X X^T \f$ and has
+		single precision accuracy.
+		*/
+		struct MixedPrecisionOLSResult : public MultivariateOLSResult
+		{
+			unsigned int iterations; /**< Number of refinement steps carried out. */
+			bool fell_back; /**< Whether refinement failed and the result was calculated by multivariate() in double precision. */
+
+			/** @brief Formats the result as string. */
+			DLL_DECLSPEC std::string to_string() const;
+		};
+
+		/** @brief Carries out multivariate linear regression, decomposing \f$ X X^T \f$ in single precision.
+
+		Finds the same \f$ \vec{\beta} \f$ as multivariate() for well-conditioned problems, at lower cost: \f$ X X^T \f$ is
+		formed and decomposed in single precision, which halves its memory and roughly doubles the speed of the O(N D^2) step.
+		X is converted to single precision in blocks of columns, without copying it in whole.
+
+		The single precision solution is refined to double precision by iterating
+		\f$ \vec{\beta} \leftarrow \vec{\beta} + (X X^T)^{-1}_{\mathrm{float}} X (\vec{y} - X^T \vec{\beta}) \f$, with the residuals
+		calculated in double precision. This converges if the condition number of \f$ X X^T \f$ is well below \f$ 10^7 \f$.
+		Refinement stops when the norm of the correction falls below `tolerance` times the norm of \f$ \vec{\beta} \f$.
+
+		If the single precision decomposition fails, a correction does not shrink at least by half, or refinement does not
+		converge within `max_iterations` steps, the function falls back to multivariate().
+
+		@param[in] X D x N matrix of X values, with data points in columns.
+		@param[in] y Y vector with length N.
+		@param[in] tolerance Relative tolerance for the refinement correction.
+		@param[in] max_iterations Maximum number of refinement steps.
+		@return MixedPrecisionOLSResult object.
+		@throw std::invalid_argument If `y.size() != X.cols()`, `X.cols() < X.rows()`, `X.rows() == 0` or `!(tolerance > 0)`.
+		*/
+		DLL_DECLSPEC MixedPrecisionOLSResult multivariate_mixed_precision(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, double tolerance = 1e-14, unsigned int max_iterations = 10);
+	}
+}
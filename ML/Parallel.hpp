@@ -0,0 +1,130 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace ml
+{
+	/** @brief Helpers for running independent pieces of work on several threads.
+
+	Work is split into contiguous chunks assigned to threads in a fixed way, so that which thread processes which index
+	depends only on the number of indices and the number of threads. Callers which combine per-thread partial results
+	in thread order therefore get results which do not depend on thread scheduling.
+	*/
+	namespace Parallel
+	{
+		/** @brief Resolves the requested number of threads.
+		@param[in] number_threads Requested number of threads. If 0, the number of hardware threads is used.
+		@return Number of threads, at least 1.
+		*/
+		inline unsigned int resolve_number_threads(const unsigned int number_threads)
+		{
+			if (number_threads) {
+				return number_threads;
+			}
+			return std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		/** @brief Calls `f(begin, end, thread_index)` on contiguous chunks of the index range [0, n), one chunk per thread.
+
+		Chunk `t` covers indices `[t * n / T, (t + 1) * n / T)`, where T is the number of threads actually used
+		(never more than n). The calling thread processes the last chunk. If any call throws, the first exception
+		(in thread order) is rethrown after all threads finish.
+
+		@param[in] n Number of indices.
+		@param[in] number_threads Requested number of threads. If 0, the number of hardware threads is used.
+		@param[in] f Callable with signature `void(size_t begin, size_t end, unsigned int thread_index)`.
+		@return Number of threads T used (0 if `n == 0`).
+		*/
+		template <class F> unsigned int for_each_chunk(const size_t n, const unsigned int number_threads, F f)
+		{
+			if (!n) {
+				return 0;
+			}
+			const auto T = static_cast<unsigned int>(std::min(static_cast<size_t>(resolve_number_threads(number_threads)), n));
+			if (T == 1) {
+				f(size_t(0), n, 0u);
+				return 1;
+			}
+			std::vector<std::exception_ptr> errors(T);
+			const auto run_chunk = [&](const unsigned int t) {
+				try {
+					f(t * n / T, (t + 1) * n / T, t);
+				} catch (...) {
+					errors[t] = std::current_exception();
+				}
+			};
+			std::vector<std::thread> threads;
+			threads.reserve(T - 1);
+			for (unsigned int t = 0; t + 1 < T; ++t) {
+				threads.emplace_back(run_chunk, t);
+			}
+			run_chunk(T - 1);
+			for (auto& thread : threads) {
+				thread.join();
+			}
+			for (const auto& error : errors) {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			}
+			return T;
+		}
+
+		/** @brief Calls `f(i, thread_index)` for every index i in [0, n), handing out indices to threads dynamically.
+
+		Unlike for_each_chunk(), which thread processes which index depends on timing, so `f` should write its
+		results to a slot determined by `i`. Suitable for tasks of uneven cost. The calling thread takes part in
+		the work. If any call throws, the remaining indices are skipped and one of the exceptions is rethrown after
+		all threads finish.
+
+		@param[in] n Number of indices.
+		@param[in] number_threads Requested number of threads. If 0, the number of hardware threads is used.
+		@param[in] f Callable with signature `void(size_t i, unsigned int thread_index)`.
+		@return Number of threads T used (0 if `n == 0`).
+		*/
+		template <class F> unsigned int for_each_dynamic(const size_t n, const unsigned int number_threads, F f)
+		{
+			if (!n) {
+				return 0;
+			}
+			const auto T = static_cast<unsigned int>(std::min(static_cast<size_t>(resolve_number_threads(number_threads)), n));
+			if (T == 1) {
+				for (size_t i = 0; i < n; ++i) {
+					f(i, 0u);
+				}
+				return 1;
+			}
+			std::atomic<size_t> next(0);
+			std::vector<std::exception_ptr> errors(T);
+			const auto run = [&](const unsigned int t) {
+				try {
+					for (size_t i = next++; i < n; i = next++) {
+						f(i, t);
+					}
+				} catch (...) {
+					errors[t] = std::current_exception();
+					next = n;
+				}
+			};
+			std::vector<std::thread> threads;
+			threads.reserve(T - 1);
+			for (unsigned int t = 0; t + 1 < T; ++t) {
+				threads.emplace_back(run, t);
+			}
+			run(T - 1);
+			for (auto& thread : threads) {
+				thread.join();
+			}
+			for (const auto& error : errors) {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			}
+			return T;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <cstdint>
+#include <limits>
+
+namespace ml
+{
+	/** @brief Counter-based pseudo-random number streams.
+
+	The i-th number in a stream is a hash of the seed, the stream index and i. Numbers from different streams
+	can be generated independently (e.g. on different threads, or in any order), and depend only on the seed
+	and the stream index, which makes parallel computations using them reproducible.
+	*/
+	namespace RandomStreams
+	{
+		/** @brief SplitMix64 mixing function, a bijective hash of 64-bit integers.
+		@param[in] z Integer.
+		@return Hashed value.
+		*/
+		inline uint64_t mix64(uint64_t z)
+		{
+			z += 0x9E3779B97F4A7C15ULL;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+		/** @brief Stream of pseudo-random 64-bit integers, usable as a UniformRandomBitGenerator. */
+		class Stream
+		{
+		public:
+			typedef uint64_t result_type; /**< Type of generated numbers. */
+
+			/** @brief Constructs the stream.
+			@param[in] seed Seed shared by a family of streams.
+			@param[in] stream Stream index.
+			*/
+			Stream(const uint64_t seed, const uint64_t stream)
+				: key_(mix64(mix64(seed) + mix64(stream))), counter_(0)
+			{}
+
+			/** @brief Returns the next number. */
+			result_type operator()()
+			{
+				return mix64(key_ + counter_++);
+			}
+
+			/** @brief Returns the next number reduced to the range [0, n).
+
+			Uses the modulo operation, whose bias (at most n / 2^64) is negligible for any practical n.
+			@param[in] n Upper bound, larger than 0.
+			*/
+			uint64_t uniform_index(const uint64_t n)
+			{
+				return (*this)() % n;
+			}
+
+			/** @brief Smallest generated value. */
+			static constexpr result_type min()
+			{
+				return 0;
+			}
+
+			/** @brief Largest generated value. */
+			static constexpr result_type max()
+			{
+				return std::numeric_limits<result_type>::max();
+			}
+		private:
+			uint64_t key_;
+			uint64_t counter_;
+		};
+	}
+}
@@ -0,0 +1,222 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include <Eigen/Cholesky>
+#include "Parallel.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		/** @brief Bank of many independent recursive multivariate OLS models with the same dimension D, fixed at compile time.
+
+		Every model follows the same recursion as RecursiveMultivariateOLS with one data point per update:
+
+		\f$ \vec{k} = P \vec{x} \f$, \f$ w = 1 + \vec{x}^T \vec{k} \f$, \f$ P \leftarrow P - \vec{k} \vec{k}^T / w \f$, \f$ \vec{\beta} \leftarrow \vec{\beta} + \vec{k} (y - \vec{x}^T \vec{\beta}) / w \f$.
+
+		Instead of keeping a separate object with dynamically sized matrices for every model, the bank stores the upper
+		triangles of all P matrices and all betas in "structure of arrays" layout: every element of P (or beta) is kept
+		in a contiguous array over models. update() sweeps over all models in blocks, so the arithmetic for each element
+		is carried out on whole blocks of models at once and vectorises, and no memory is allocated per model.
+
+		@tparam D Dimension of data points.
+		*/
+		template <int D> class RecursiveOLSBank
+		{
+			static_assert(D > 0, "Dimension must be positive");
+		public:
+			/** @brief Number of elements in the upper triangle of a D x D matrix. */
+			static constexpr int number_P_elements = D * (D + 1) / 2;
+
+			/** @brief Constructs the bank with models which have not seen any data.
+			@param[in] number_models Number of models M.
+			@throw std::invalid_argument If `number_models == 0`.
+			*/
+			RecursiveOLSBank(const unsigned int number_models)
+				: P_(number_models, number_P_elements), betas_(number_models, D), n_(number_models, 0), number_initialised_(0)
+			{
+				if (!number_models) {
+					throw std::invalid_argument("RecursiveOLSBank: number of models cannot be zero");
+				}
+			}
+
+			/** @brief Initialises a model with its first sample and calculates its first beta estimate.
+
+			Can also be used to restart a model which has already been initialised.
+
+			@param[in] model Model index.
+			@param[in] X D x N matrix of X values, with data points in columns.
+			@param[in] y Y vector with length N.
+			@throw std::out_of_range If `model >= number_models()`.
+			@throw std::invalid_argument If `X.rows() != D`, `y.size() != X.cols()` or `X.cols() < D`.
+			@throw std::domain_error If \f$ X X^T \f$ is singular.
+			*/
+			void initialise(const unsigned int model, const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y)
+			{
+				if (model >= number_models()) {
+					throw std::out_of_range("RecursiveOLSBank: model index out of range");
+				}
+				if (X.rows() != D) {
+					throw std::invalid_argument("RecursiveOLSBank: data dimension mismatch");
+				}
+				if (X.cols() != y.size()) {
+					throw std::invalid_argument("RecursiveOLSBank: X matrix has different number of data points than Y has values");
+				}
+				if (X.cols() < D) {
+					throw std::invalid_argument("RecursiveOLSBank: not enough data points for initialisation");
+				}
+				const Eigen::Matrix<double, D, D> XXt(X * X.transpose());
+				const Eigen::LDLT<Eigen::Matrix<double, D, D>> decomp(XXt);
+				if (decomp.info() != Eigen::Success || !(decomp.vectorD().cwiseAbs().minCoeff() > 0)) {
+					throw std::domain_error("RecursiveOLSBank: X * X^T is singular");
+				}
+				const Eigen::Matrix<double, D, D> P(decomp.solve(Eigen::Matrix<double, D, D>::Identity()));
+				betas_.row(model) = decomp.solve(X * y).transpose();
+				for (int a = 0; a < D; ++a) {
+					for (int b = a; b < D; ++b) {
+						P_(model, P_index(a, b)) = P(a, b);
+					}
+				}
+				if (!n_[model]) {
+					++number_initialised_;
+				}
+				n_[model] = static_cast<unsigned int>(X.cols());
+			}
+
+			/** @brief Updates every model with one new data point.
+
+			Models for which `y` is NaN are not updated. Each model's update does not depend on the others, so the results do not depend
+			on the number of threads.
+
+			@param[in] X D x M matrix of new X values, with the data point for model `m` in column `m`.
+			@param[in] y Y vector with length M.
+			@param[in] number_threads Number of threads. If 0, the number of hardware threads is used.
+			@throw std::invalid_argument If `X.rows() != D`, `X.cols() != number_models()` or `y.size() != number_models()`.
+			@throw std::logic_error If any model has not been initialised.
+			*/
+			void update(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const unsigned int number_threads = 1)
+			{
+				const auto M = P_.rows();
+				if (X.rows() != D) {
+					throw std::invalid_argument("RecursiveOLSBank: data dimension mismatch");
+				}
+				if (X.cols() != M || y.size() != M) {
+					throw std::invalid_argument("RecursiveOLSBank: expected one data point per model");
+				}
+				if (number_initialised_ != number_models()) {
+					throw std::logic_error("RecursiveOLSBank: not all models have been initialised");
+				}
+				const auto number_blocks = static_cast<size_t>((M + block_size - 1) / block_size);
+				Parallel::for_each_chunk(number_blocks, number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+					for (size_t block = begin; block < end; ++block) {
+						const auto first = static_cast<Eigen::Index>(block) * block_size;
+						update_block(X, y, first, std::min(block_size, M - first));
+					}
+				});
+				for (Eigen::Index m = 0; m < M; ++m) {
+					if (!std::isnan(y[m])) {
+						++n_[static_cast<size_t>(m)];
+					}
+				}
+			}
+
+			/** @brief Returns the number of models. */
+			unsigned int number_models() const
+			{
+				return static_cast<unsigned int>(P_.rows());
+			}
+
+			/** @brief Returns the number of data points seen so far by a model. If the model has not been initialised, returns 0. */
+			unsigned int n(const unsigned int model) const
+			{
+				return n_.at(model);
+			}
+
+			/** @brief Returns the current estimate of beta for a model. */
+			Eigen::Matrix<double, D, 1> beta(const unsigned int model) const
+			{
+				if (model >= number_models()) {
+					throw std::out_of_range("RecursiveOLSBank: model index out of range");
+				}
+				return betas_.row(model).transpose();
+			}
+
+			/** @brief Returns an M x D matrix with the current beta estimates for all models in rows. */
+			const Eigen::Matrix<double, Eigen::Dynamic, D>& betas() const
+			{
+				return betas_;
+			}
+
+			/** @brief Returns the matrix P, equal to the inverse of the sum of \f$ \vec{x} \vec{x}^T \f$ over data points seen by a model. */
+			Eigen::Matrix<double, D, D> P(const unsigned int model) const
+			{
+				if (model >= number_models()) {
+					throw std::out_of_range("RecursiveOLSBank: model index out of range");
+				}
+				Eigen::Matrix<double, D, D> result;
+				for (int a = 0; a < D; ++a) {
+					for (int b = a; b < D; ++b) {
+						result(a, b) = result(b, a) = P_(model, P_index(a, b));
+					}
+				}
+				return result;
+			}
+		private:
+			/// Number of models updated together.
+			static constexpr Eigen::Index block_size = 128;
+
+			/// Arrays over a block of models, one column per vector element.
+			typedef Eigen::Array<double, Eigen::Dynamic, D, Eigen::ColMajor, block_size, D> BlockArray;
+
+			/// Arrays over a block of models.
+			typedef Eigen::Array<double, Eigen::Dynamic, 1, Eigen::ColMajor, block_size, 1> BlockVector;
+
+			Eigen::Matrix<double, Eigen::Dynamic, number_P_elements> P_; /**< Upper triangles of P matrices: row m holds model m, column P_index(a, b) holds element (a, b). */
+			Eigen::Matrix<double, Eigen::Dynamic, D> betas_; /**< Beta estimates: row m holds model m. */
+			std::vector<unsigned int> n_; /**< Numbers of data points seen by each model. */
+			unsigned int number_initialised_; /**< Number of models which have been initialised. */
+
+			/// Position of element (a, b) of P (with a <= b) in the packed upper triangle.
+			static constexpr int P_index(const int a, const int b)
+			{
+				return a * D - a * (a - 1) / 2 + (b - a);
+			}
+
+			/// Updates models [first, first + size).
+			void update_block(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const Eigen::Index first, const Eigen::Index size)
+			{
+				const BlockArray x(X.middleCols(first, size).transpose().array());
+				const auto y_block = y.segment(first, size).array();
+				// Models with NaN y get a zero gain.
+				const BlockVector is_valid(y_block.isNaN().select(BlockVector::Zero(size), BlockVector::Ones(size)));
+				const BlockVector y_valid(y_block.isNaN().select(BlockVector::Zero(size), y_block));
+				auto P = P_.middleRows(first, size).array();
+				auto beta = betas_.middleRows(first, size).array();
+				BlockArray k(size, D);
+				for (int a = 0; a < D; ++a) {
+					k.col(a) = P.col(P_index(0, a)) * x.col(0);
+					for (int b = 1; b < D; ++b) {
+						k.col(a) += P.col(P_index(std::min(a, b), std::max(a, b))) * x.col(b);
+					}
+				}
+				BlockVector w(BlockVector::Ones(size));
+				BlockVector residuals(y_valid);
+				for (int a = 0; a < D; ++a) {
+					w += x.col(a) * k.col(a);
+					residuals -= x.col(a) * beta.col(a);
+				}
+				const BlockVector gain(is_valid / w);
+				for (int a = 0; a < D; ++a) {
+					const BlockVector scaled_k(gain * k.col(a));
+					for (int b = a; b < D; ++b) {
+						P.col(P_index(a, b)) -= scaled_k * k.col(b);
+					}
+					beta.col(a) += scaled_k * residuals;
+				}
+			}
+		};
+	}
+}
@@ -0,0 +1,132 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <Eigen/QR>
+#include "RandomStreams.hpp"
+#include "SketchedOLS.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		std::string SketchedOLSResult::to_string() const
+		{
+			std::stringstream s;
+			s << "SketchedOLSResult(n=" << n << ", dof=" << dof << ", rss=" << rss << ", tss=" << tss;
+			s << ", var_y=" << var_y() << ", r2=" << r2() << ", adjusted_r2=" << adjusted_r2();
+			s << ", beta=[" << beta.transpose() << "]";
+			s << ", cov=[" << cov << "]";
+			s << ", sketch_size=" << sketch_size << ", iterations=" << iterations << ", relative_residual=" << relative_residual << ", converged=" << converged;
+			s << ")";
+			return s.str();
+		}
+
+		SketchedOLSResult multivariate_sketched(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, unsigned int sketch_size, const double tolerance, const unsigned int max_iterations, const unsigned int seed)
+		{
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = X.rows();
+			const auto n = X.cols();
+			if (n != y.size()) {
+				throw std::invalid_argument("X matrix has different number of data points than Y has values");
+			}
+			if (!q) {
+				throw std::invalid_argument("At least one feature required");
+			}
+			if (n < q) {
+				throw std::invalid_argument("Not enough data points for regression");
+			}
+			if (!(tolerance > 0)) {
+				throw std::invalid_argument("Tolerance must be positive");
+			}
+			if (!sketch_size) {
+				const double default_size = std::ceil(8 * static_cast<double>(q) * std::log2(static_cast<double>(q + 1)));
+				sketch_size = static_cast<unsigned int>(std::max(default_size, 2 * static_cast<double>(q)));
+			} else if (sketch_size < q) {
+				throw std::invalid_argument("Sketch size smaller than data dimension");
+			}
+			const Eigen::Index m = sketch_size;
+
+			// CountSketch of X^T and y, computed in a single pass over the data. The sketch of X^T is stored transposed,
+			// so that every data point is added to a contiguous column. X * y is accumulated on the way.
+			Eigen::MatrixXd SXt(Eigen::MatrixXd::Zero(q, m));
+			Eigen::VectorXd Sy(Eigen::VectorXd::Zero(m));
+			Eigen::VectorXd Xy(Eigen::VectorXd::Zero(q));
+			const uint64_t key = RandomStreams::mix64(seed);
+			for (Eigen::Index i = 0; i < n; ++i) {
+				const uint64_t h = RandomStreams::mix64(key + static_cast<uint64_t>(i));
+				const auto row = static_cast<Eigen::Index>(h % static_cast<uint64_t>(m));
+				const double sign = (h >> 63) ? -1. : 1.;
+				SXt.col(row) += sign * X.col(i);
+				Sy[row] += sign * y[i];
+				Xy += y[i] * X.col(i);
+			}
+
+			const Eigen::HouseholderQR<Eigen::MatrixXd> qr(SXt.transpose());
+			const auto R = qr.matrixQR().topRows(q).triangularView<Eigen::Upper>();
+			const Eigen::VectorXd R_diagonal(qr.matrixQR().diagonal().cwiseAbs());
+			if (!(R_diagonal.minCoeff() > std::numeric_limits<double>::epsilon() * static_cast<double>(m) * R_diagonal.maxCoeff())) {
+				throw std::domain_error("Sketched X matrix does not have full rank");
+			}
+
+			SketchedOLSResult result;
+			result.n = static_cast<unsigned int>(n);
+			result.dof = static_cast<unsigned int>(n - q);
+			result.sketch_size = sketch_size;
+			result.iterations = 0;
+			result.beta = qr.solve(Sy);
+			if (max_iterations) {
+				// CGLS for min |X^T R^{-1} z - y| with beta = R^{-1} z, started from the sketched solution.
+				Eigen::VectorXd r(y - X.transpose() * result.beta);
+				Eigen::VectorXd g(X * r);
+				Eigen::VectorXd s(R.transpose().solve(g));
+				Eigen::VectorXd p(s);
+				Eigen::VectorXd t(q);
+				Eigen::VectorXd w(n);
+				const double Xy_norm = Xy.norm();
+				double g_norm = g.norm();
+				double gamma = s.squaredNorm();
+				while (g_norm > tolerance * Xy_norm && result.iterations < max_iterations) {
+					t = R.solve(p);
+					w.noalias() = X.transpose() * t;
+					const double w_norm2 = w.squaredNorm();
+					if (!(w_norm2 > 0)) {
+						break;
+					}
+					const double alpha = gamma / w_norm2;
+					result.beta += alpha * t;
+					r -= alpha * w;
+					g.noalias() = X * r;
+					g_norm = g.norm();
+					s = R.transpose().solve(g);
+					const double next_gamma = s.squaredNorm();
+					p = s + (next_gamma / gamma) * p;
+					gamma = next_gamma;
+					++result.iterations;
+				}
+				result.relative_residual = Xy_norm > 0 ? g_norm / Xy_norm : 0;
+				result.converged = g_norm <= tolerance * Xy_norm;
+				// Residual sum of squares:
+				result.rss = r.squaredNorm();
+			} else {
+				result.relative_residual = std::numeric_limits<double>::quiet_NaN();
+				result.converged = false;
+				// Residual sum of squares of the sketched problem:
+				result.rss = (Sy - SXt.transpose() * result.beta).squaredNorm();
+			}
+			if (result.dof) {
+				// (R^T R)^{-1} = R^{-1} R^{-T}
+				const Eigen::MatrixXd R_inv(R.solve(Eigen::MatrixXd::Identity(q, q)));
+				result.cov.noalias() = R_inv * R_inv.transpose();
+				result.cov *= result.var_y();
+			} else {
+				result.cov = Eigen::MatrixXd::Constant(q, q, std::numeric_limits<double>::quiet_NaN());
+			}
+			// Total sum of squares:
+			result.tss = (y.array() - y.mean()).square().sum();
+			return result;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include "LinearRegression.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		/** @brief Result of a multivariate OLS regression solved by sketching.
+
+		If no refinement iterations were requested, #rss is the residual sum of squares of the sketched problem, which estimates the
+		true RSS. Otherwise it is calculated from the residuals of the refined solution.
+
+		#cov is calculated from the sketched \f$ X X^T \f$ matrix, which approximates the exact one.
+		*/
+		struct SketchedOLSResult : public MultivariateOLSResult
+		{
+			unsigned int sketch_size; /**< Number of rows M of the sketched problem. */
+			unsigned int iterations; /**< Number of refinement iterations carried out. */
+			double relative_residual; /**< Norm of the residual of the normal equations, divided by the norm of their right-hand side. NaN if no refinement iterations were requested. */
+			bool converged; /**< Whether #relative_residual fell below the requested tolerance. */
+
+			/** @brief Formats the result as string. */
+			DLL_DECLSPEC std::string to_string() const;
+		};
+
+		/** @brief Carries out multivariate linear regression by sketch-and-solve, optionally refined to full precision.
+
+		Compresses the N x D problem \f$ X^T \vec{\beta} \approx \vec{y} \f$ to an M x D one with a CountSketch transform S:
+		every data point is added, with a random sign, to one of M randomly chosen rows. This takes a single pass over X,
+		costing O(N D) instead of O(N D^2) needed to form \f$ X X^T \f$. The small problem \f$ S X^T \vec{\beta} \approx S \vec{y} \f$
+		is then solved by QR decomposition, \f$ S X^T = Q R \f$.
+
+		With `max_iterations > 0`, the solution is refined with preconditioned conjugate gradients for least squares (CGLS)
+		applied to \f$ X^T R^{-1} \f$: because \f$ R^T R \approx X X^T \f$, the preconditioned problem is well-conditioned
+		and every iteration (two passes over X) reduces the error by a roughly constant factor. Iterations stop when the norm
+		of \f$ X (\vec{y} - X^T \vec{\beta}) \f$ falls below `tolerance` times the norm of \f$ X \vec{y} \f$, or after
+		`max_iterations` iterations.
+
+		The accuracy of the sketch-and-solve solution improves with M. If `sketch_size == 0`, M is set to
+		\f$ \lceil 8 D \log_2(D + 1) \rceil \f$ (but not less than 2D). Rows and signs are derived from a hash of the
+		data point index and the seed, so the result is reproducible for the same `seed`.
+
+		@param[in] X D x N matrix of X values, with data points in columns.
+		@param[in] y Y vector with length N.
+		@param[in] sketch_size Number of rows M of the sketched problem. If 0, chosen automatically.
+		@param[in] tolerance Relative tolerance for the residual of the normal equations.
+		@param[in] max_iterations Maximum number of refinement iterations. If 0, the sketched solution is returned.
+		@param[in] seed Seed for the sketching transform.
+		@return SketchedOLSResult object.
+		@throw std::invalid_argument If `y.size() != X.cols()`, `X.rows() == 0`, `X.cols() < X.rows()`, `0 < sketch_size < X.rows()` or `!(tolerance > 0)`.
+		@throw std::domain_error If the sketched X matrix does not have full rank.
+		*/
+		DLL_DECLSPEC SketchedOLSResult multivariate_sketched(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, unsigned int sketch_size = 0, double tolerance = 1e-12, unsigned int max_iterations = 20, unsigned int seed = 0);
+	}
+}
@@ -0,0 +1,133 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <limits>
+#include <stdexcept>
+#include "SlidingWindowMultivariateOLS.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		SlidingWindowMultivariateOLS::SlidingWindowMultivariateOLS(const unsigned int window_size)
+			: sum_y_(0), sum_y2_(0), window_size_(window_size), n_(0), d_(0), oldest_(0), factorised_(false)
+		{
+			if (!window_size) {
+				throw std::invalid_argument("SlidingWindowMultivariateOLS: window size cannot be zero");
+			}
+		}
+
+		void SlidingWindowMultivariateOLS::update(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y)
+		{
+			if (!X.cols()) {
+				throw std::invalid_argument("SlidingWindowMultivariateOLS: no new data points");
+			}
+			if (X.cols() != y.size()) {
+				throw std::invalid_argument("SlidingWindowMultivariateOLS: X matrix has different number of data points than Y has values");
+			}
+			if (!d_) {
+				if (!X.rows()) {
+					throw std::invalid_argument("SlidingWindowMultivariateOLS: at least one dimension required");
+				}
+				if (static_cast<unsigned int>(X.rows()) > window_size_) {
+					throw std::invalid_argument("SlidingWindowMultivariateOLS: window size smaller than data dimension");
+				}
+				d_ = static_cast<unsigned int>(X.rows());
+				window_X_.resize(d_, window_size_);
+				window_y_.resize(window_size_);
+				XXt_.setZero(d_, d_);
+				Xy_.setZero(d_);
+			} else if (d_ != static_cast<unsigned int>(X.rows())) {
+				throw std::invalid_argument("SlidingWindowMultivariateOLS: data dimension mismatch");
+			}
+			for (Eigen::Index i = 0; i < X.cols(); ++i) {
+				add(X.col(i), y[i]);
+			}
+			if (factorised_) {
+				beta_ = xxt_decomp_.solve(Xy_);
+			} else {
+				beta_.resize(0);
+			}
+		}
+
+		double SlidingWindowMultivariateOLS::rss() const
+		{
+			if (!factorised_) {
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+			// RSS = y^T y - beta^T X y for the least-squares beta.
+			return std::max(0., sum_y2_ - beta_.dot(Xy_));
+		}
+
+		MultivariateOLSResult SlidingWindowMultivariateOLS::result() const
+		{
+			if (!factorised_) {
+				throw std::logic_error("SlidingWindowMultivariateOLS: not enough data for regression");
+			}
+			MultivariateOLSResult result;
+			result.n = n_;
+			result.dof = n_ - d_;
+			result.beta = beta_;
+			result.rss = rss();
+			result.tss = std::max(0., sum_y2_ - sum_y_ * sum_y_ / static_cast<double>(n_));
+			if (result.dof) {
+				result.cov = xxt_decomp_.solve(Eigen::MatrixXd::Identity(d_, d_));
+				result.cov *= result.var_y();
+			} else {
+				result.cov = Eigen::MatrixXd::Constant(d_, d_, std::numeric_limits<double>::quiet_NaN());
+			}
+			return result;
+		}
+
+		void SlidingWindowMultivariateOLS::add(const Eigen::Ref<const Eigen::VectorXd> x, const double y)
+		{
+			const bool full = n_ == window_size_;
+			// Until the window is full, oldest_ == 0.
+			const unsigned int pos = full ? oldest_ : n_;
+			Xy_.noalias() += y * x;
+			sum_y_ += y;
+			sum_y2_ += y * y;
+			// Add the new point before removing the old one, to keep X * X^T positive-definite.
+			if (factorised_) {
+				xxt_decomp_.rankUpdate(x, 1);
+			} else {
+				XXt_.noalias() += x * x.transpose();
+			}
+			bool downdate_failed = false;
+			if (full) {
+				const auto old_x = window_X_.col(pos);
+				const double old_y = window_y_[pos];
+				Xy_.noalias() -= old_y * old_x;
+				sum_y_ -= old_y;
+				sum_y2_ -= old_y * old_y;
+				if (factorised_) {
+					xxt_decomp_.rankUpdate(old_x, -1);
+					downdate_failed = xxt_decomp_.info() != Eigen::Success;
+				} else {
+					XXt_.noalias() -= old_x * old_x.transpose();
+				}
+				oldest_ = (oldest_ + 1) % window_size_;
+			} else {
+				++n_;
+			}
+			window_X_.col(pos) = x;
+			window_y_[pos] = y;
+			if (factorised_) {
+				if (downdate_failed) {
+					refactorise(true);
+				}
+			} else if (n_ >= d_) {
+				refactorise(false);
+			}
+		}
+
+		void SlidingWindowMultivariateOLS::refactorise(const bool from_window)
+		{
+			if (from_window) {
+				// Points occupy the first n_ columns regardless of oldest_.
+				const auto X = window_X_.leftCols(n_);
+				XXt_.noalias() = X * X.transpose();
+			}
+			xxt_decomp_.compute(XXt_);
+			factorised_ = xxt_decomp_.info() == Eigen::Success;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <Eigen/Cholesky>
+#include "LinearRegression.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		/** @brief Multivariate Ordinary Least Squares over a sliding window of the most recent data points.
+
+		Given a stream of data points \f$(\vec{x}_i, y_i)\f$, maintains the least-squares estimate for \f$\vec{\beta}\f$
+		using only the last W points, as if multivariate() was called on them.
+
+		Keeps the Cholesky factor of \f$ X X^T \f$ for the points in the window. Arriving points are added with a
+		rank-1 update and departing points are removed with a rank-1 downdate, so that every step costs O(D^2).
+		If a downdate fails numerically, the factor is recomputed from the data in the window.
+		*/
+		class SlidingWindowMultivariateOLS
+		{
+		public:
+			/** @brief Initialises without data.
+			@param[in] window_size Maximum number of data points W used for the estimate.
+			@throw std::invalid_argument If `window_size == 0`.
+			*/
+			DLL_DECLSPEC SlidingWindowMultivariateOLS(unsigned int window_size);
+
+			/** @brief Adds new data points to the window, removing the oldest ones if the window is full.
+
+			The dimension of data points is fixed by the first call.
+
+			@param[in] X D x N matrix of X values, with data points in columns.
+			@param[in] y Y vector with length N.
+			@throw std::invalid_argument If `y.size() != X.cols()`, `X.cols() == 0`, `X.rows()` differs from d() (after the first call) or `window_size() < X.rows()`.
+			*/
+			DLL_DECLSPEC void update(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y);
+
+			/** @brief Returns the regression result for the data points currently in the window.
+
+			The #MultivariateOLSResult::cov matrix is calculated from the Cholesky factor on every call, which costs O(D^3).
+
+			@return MultivariateOLSResult object.
+			@throw std::logic_error If the window does not contain enough data for regression yet.
+			*/
+			DLL_DECLSPEC MultivariateOLSResult result() const;
+
+			/** @brief Returns the number of data points in the window. */
+			unsigned int n() const
+			{
+				return n_;
+			}
+
+			/** @brief Returns the dimension of data points. If no data were seen, returns 0. */
+			unsigned int d() const
+			{
+				return d_;
+			}
+
+			/** @brief Returns the maximum number of data points in the window. */
+			unsigned int window_size() const
+			{
+				return window_size_;
+			}
+
+			/** @brief Returns the current estimate of beta. If the window does not contain enough data for regression yet, returns an empty vector. */
+			const Eigen::VectorXd& beta() const
+			{
+				return beta_;
+			}
+
+			/** @brief Returns the residual sum of squares for the current estimate of beta. If the window does not contain enough data for regression yet, returns NaN. */
+			DLL_DECLSPEC double rss() const;
+		private:
+			Eigen::LLT<Eigen::MatrixXd> xxt_decomp_; /**< Cholesky decomposition of X * X^T for the points in the window. */
+			Eigen::MatrixXd XXt_; /**< D x D matrix X * X^T, used before the first successful factorisation and when refactorising. */
+			Eigen::MatrixXd window_X_; /**< D x W circular buffer with X values in the window. */
+			Eigen::VectorXd window_y_; /**< Circular buffer with Y values in the window. */
+			Eigen::VectorXd Xy_; /**< X * y for the points in the window. */
+			Eigen::VectorXd beta_; /**< Current estimate of beta. */
+			double sum_y_; /**< Sum of Y values in the window. */
+			double sum_y2_; /**< Sum of squared Y values in the window. */
+			unsigned int window_size_; /**< Maximum number of points in the window. */
+			unsigned int n_; /**< Number of points in the window. */
+			unsigned int d_; /**< Dimension of each x data point. */
+			unsigned int oldest_; /**< Position of the oldest point in the circular buffer. */
+			bool factorised_; /**< Whether xxt_decomp_ holds a valid decomposition. */
+
+			/// Adds a single data point to the window, replacing the oldest one if the window is full.
+			void add(Eigen::Ref<const Eigen::VectorXd> x, double y);
+
+			/// Factorises X * X^T from the data in the window (if `from_window` is true) or from XXt_.
+			void refactorise(bool from_window);
+		};
+	}
+}
@@ -0,0 +1,269 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "Parallel.hpp"
+#include "StepwiseSelection.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		namespace
+		{
+			/// Features whose squared distance from the span of the selected ones is below this fraction of their squared norm are treated as collinear.
+			constexpr double collinearity_tolerance = 1e-10;
+
+			/// Maintains the Cholesky factor of the Gram matrix of selected features and scores candidates with bordering updates.
+			class ForwardSelector
+			{
+			public:
+				ForwardSelector(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const StepwiseCriterion criterion, const unsigned int max_features)
+					: X_(X), y_(y), criterion_(criterion), n_(static_cast<unsigned int>(X.cols())), k_(0), selected_(static_cast<size_t>(X.rows()), false)
+				{
+					const auto d = X.rows();
+					G_.setZero(d, d);
+					G_.selfadjointView<Eigen::Lower>().rankUpdate(X);
+					G_ = G_.selfadjointView<Eigen::Lower>();
+					b_.noalias() = X * y;
+					rss_ = y.squaredNorm();
+					L_.setZero(max_features, max_features);
+					z_.resize(max_features);
+					if (criterion == StepwiseCriterion::PRESS) {
+						Q_.resize(n_, max_features);
+						e_ = y;
+						h_.setZero(n_);
+					}
+				}
+
+				unsigned int k() const
+				{
+					return k_;
+				}
+
+				bool is_selected(const unsigned int j) const
+				{
+					return selected_[j];
+				}
+
+				const std::vector<unsigned int>& features() const
+				{
+					return features_;
+				}
+
+				/// Criterion value for the currently selected features.
+				double current_value() const
+				{
+					if (criterion_ == StepwiseCriterion::PRESS) {
+						return (e_.array() / (1 - h_.array())).square().sum();
+					}
+					return information_criterion(rss_, k_);
+				}
+
+				/** Calculates the criterion value after adding feature j, or +Inf if j is collinear with the selected features.
+				`l` and `q` are scratch vectors of size at least k() and N (the latter used only for PRESS).
+				*/
+				double score(const unsigned int j, Eigen::VectorXd& l, Eigen::VectorXd& q) const
+				{
+					double z_j;
+					double d2;
+					if (!border(j, l, z_j, d2)) {
+						return std::numeric_limits<double>::infinity();
+					}
+					if (criterion_ == StepwiseCriterion::PRESS) {
+						new_whitened_feature(j, l, d2, q);
+						double press = 0;
+						for (unsigned int i = 0; i < n_; ++i) {
+							const double h = h_[i] + q[i] * q[i];
+							if (!(h < 1)) {
+								return std::numeric_limits<double>::infinity();
+							}
+							const double e = (e_[i] - z_j * q[i]) / (1 - h);
+							press += e * e;
+						}
+						return press;
+					}
+					return information_criterion(rss_ - z_j * z_j, k_ + 1);
+				}
+
+				/// Adds feature j. Returns false if it is collinear with the selected features.
+				bool add(const unsigned int j)
+				{
+					Eigen::VectorXd l(k_);
+					double z_j;
+					double d2;
+					if (!border(j, l, z_j, d2)) {
+						return false;
+					}
+					if (criterion_ == StepwiseCriterion::PRESS) {
+						Eigen::VectorXd q(n_);
+						new_whitened_feature(j, l, d2, q);
+						e_ -= z_j * q;
+						h_ += q.cwiseAbs2();
+						Q_.col(k_) = q;
+					}
+					L_.row(k_).head(k_) = l.transpose();
+					L_(k_, k_) = std::sqrt(d2);
+					z_[k_] = z_j;
+					rss_ -= z_j * z_j;
+					selected_[j] = true;
+					features_.push_back(j);
+					++k_;
+					return true;
+				}
+
+				/// Fits the OLS regression on the selected features.
+				MultivariateOLSResult regression() const
+				{
+					MultivariateOLSResult result;
+					const auto L = L_.topLeftCorner(k_, k_).triangularView<Eigen::Lower>();
+					result.beta = L.transpose().solve(z_.head(k_));
+					result.n = n_;
+					result.dof = n_ - k_;
+					Eigen::VectorXd residuals(y_);
+					for (unsigned int i = 0; i < k_; ++i) {
+						residuals -= result.beta[i] * X_.row(features_[i]).transpose();
+					}
+					// Residual sum of squares:
+					result.rss = residuals.squaredNorm();
+					// (L L^T)^{-1} = L^{-T} L^{-1}
+					const Eigen::MatrixXd L_inv(L.solve(Eigen::MatrixXd::Identity(k_, k_)));
+					result.cov.noalias() = L_inv.transpose() * L_inv;
+					result.cov *= result.var_y();
+					// Total sum of squares:
+					result.tss = (y_.array() - y_.mean()).square().sum();
+					return result;
+				}
+			private:
+				Eigen::Ref<const Eigen::MatrixXd> X_;
+				Eigen::Ref<const Eigen::VectorXd> y_;
+				Eigen::MatrixXd G_; /**< X * X^T. */
+				Eigen::VectorXd b_; /**< X * y. */
+				Eigen::MatrixXd L_; /**< Lower Cholesky factor of the Gram matrix of selected features, in the top-left k_ x k_ corner. */
+				Eigen::VectorXd z_; /**< L^{-1} X_S y in the first k_ elements. */
+				Eigen::MatrixXd Q_; /**< X_S^T L^{-T} in the first k_ columns (PRESS only). */
+				Eigen::VectorXd e_; /**< Residuals of the current model (PRESS only). */
+				Eigen::VectorXd h_; /**< Leverages of the current model (PRESS only). */
+				StepwiseCriterion criterion_;
+				double rss_; /**< Residual sum of squares of the current model. */
+				unsigned int n_;
+				unsigned int k_; /**< Number of selected features. */
+				std::vector<bool> selected_;
+				std::vector<unsigned int> features_;
+
+				double information_criterion(const double rss, const unsigned int k) const
+				{
+					const double N = static_cast<double>(n_);
+					const double penalty = criterion_ == StepwiseCriterion::AIC ? 2 : std::log(N);
+					return N * std::log(std::max(rss, 0.) / N) + penalty * static_cast<double>(k);
+				}
+
+				/** Calculates the new row of L (stored in `l`), the square of the new diagonal element of L and the new element of z for feature j, in O(k^2).
+				Returns false if j is collinear with the selected features.
+				*/
+				bool border(const unsigned int j, Eigen::VectorXd& l, double& z_j, double& d2) const
+				{
+					const double g_jj = G_(j, j);
+					d2 = g_jj;
+					double lz = 0;
+					if (k_) {
+						auto l_head = l.head(k_);
+						for (unsigned int i = 0; i < k_; ++i) {
+							l_head[i] = G_(features_[i], j);
+						}
+						L_.topLeftCorner(k_, k_).triangularView<Eigen::Lower>().solveInPlace(l_head);
+						d2 -= l_head.squaredNorm();
+						lz = l_head.dot(z_.head(k_));
+					}
+					if (!(d2 > collinearity_tolerance * g_jj)) {
+						return false;
+					}
+					z_j = (b_[j] - lz) / std::sqrt(d2);
+					return true;
+				}
+
+				/// Calculates the whitened new feature (X_j^T - Q l) / d, which extends the orthonormal basis Q.
+				void new_whitened_feature(const unsigned int j, const Eigen::VectorXd& l, const double d2, Eigen::VectorXd& q) const
+				{
+					q = X_.row(j).transpose();
+					if (k_) {
+						q.noalias() -= Q_.leftCols(k_) * l.head(k_);
+					}
+					q /= std::sqrt(d2);
+				}
+			};
+		}
+
+		StepwiseSelectionResult forward_stepwise(const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y, const StepwiseCriterion criterion, unsigned int max_features, const std::vector<unsigned int>& initial_features, const unsigned int number_threads)
+		{
+			// X is an q x N matrix and y is a N-size vector.
+			const auto q = static_cast<unsigned int>(X.rows());
+			const auto n = static_cast<unsigned int>(X.cols());
+			if (X.cols() != y.size()) {
+				throw std::invalid_argument("X matrix has different number of data points than Y has values");
+			}
+			if (!q) {
+				throw std::invalid_argument("At least one feature required");
+			}
+			if (n < 2) {
+				throw std::invalid_argument("Not enough data points for regression");
+			}
+			const unsigned int feature_limit = std::min(q, n - 1);
+			if (!max_features || max_features > feature_limit) {
+				max_features = feature_limit;
+			}
+			if (initial_features.size() > max_features) {
+				throw std::invalid_argument("More initial features than the maximum number of features");
+			}
+			ForwardSelector selector(X, y, criterion, max_features);
+			for (const auto j : initial_features) {
+				if (j >= q) {
+					throw std::invalid_argument("Initial feature index out of range");
+				}
+				if (selector.is_selected(j)) {
+					throw std::invalid_argument("Repeated initial feature index");
+				}
+				if (!selector.add(j)) {
+					throw std::domain_error("Initial features are collinear");
+				}
+			}
+			StepwiseSelectionResult result;
+			double current_value = selector.current_value();
+			result.criterion_values.push_back(current_value);
+			std::vector<unsigned int> candidates;
+			std::vector<double> scores;
+			while (selector.k() < max_features) {
+				candidates.clear();
+				for (unsigned int j = 0; j < q; ++j) {
+					if (!selector.is_selected(j)) {
+						candidates.push_back(j);
+					}
+				}
+				scores.resize(candidates.size());
+				Parallel::for_each_chunk(candidates.size(), number_threads, [&](const size_t begin, const size_t end, unsigned int) {
+					Eigen::VectorXd l(selector.k());
+					Eigen::VectorXd q_scratch(criterion == StepwiseCriterion::PRESS ? n : 0);
+					for (size_t c = begin; c < end; ++c) {
+						scores[c] = selector.score(candidates[c], l, q_scratch);
+					}
+				});
+				// Candidates are in increasing index order, so the first minimum breaks ties by the lowest index.
+				size_t best = 0;
+				for (size_t c = 1; c < candidates.size(); ++c) {
+					if (scores[c] < scores[best]) {
+						best = c;
+					}
+				}
+				if (candidates.empty() || !(scores[best] < current_value)) {
+					break;
+				}
+				selector.add(candidates[best]);
+				current_value = scores[best];
+				result.criterion_values.push_back(current_value);
+			}
+			result.features = selector.features();
+			result.regression = selector.regression();
+			return result;
+		}
+	}
+}
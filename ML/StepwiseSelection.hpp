@@ -0,0 +1,64 @@
+#pragma once
+/* (C) 2021 Roman Werpachowski. */
+#include <vector>
+#include "LinearRegression.hpp"
+
+namespace ml
+{
+	namespace LinearRegression
+	{
+		/** @brief Criterion minimised by forward_stepwise().
+
+		For a model with k features fitted to N data points with residual sum of squares RSS:
+		- AIC is \f$ N \ln(\mathrm{RSS} / N) + 2k \f$,
+		- BIC is \f$ N \ln(\mathrm{RSS} / N) + k \ln N \f$,
+		- PRESS is the Predicted Residual Error Sum of Squares (see press()).
+		*/
+		enum class StepwiseCriterion
+		{
+			AIC,
+			BIC,
+			PRESS
+		};
+
+		/** @brief Result of forward stepwise feature selection. */
+		struct StepwiseSelectionResult
+		{
+			/** @brief Indices of selected rows of X, in the order in which they were added (initial features first). */
+			std::vector<unsigned int> features;
+
+			/** @brief Criterion values: the first one for the initial features, followed by one for every feature added after them. */
+			std::vector<double> criterion_values;
+
+			/** @brief Result of multivariate() for the rows of X given by #features, in the same order. */
+			MultivariateOLSResult regression;
+		};
+
+		/** @brief Carries out forward stepwise feature selection for multivariate OLS regression.
+
+		Starting from the initial features, at every step adds the feature which minimises the criterion, as long as it
+		improves on the current model and the number of features is below the limit.
+
+		\f$ X X^T \f$ and \f$ X \vec{y} \f$ are calculated once. The selector keeps the Cholesky factor L of the Gram matrix
+		of the selected features and \f$ \vec{z} = L^{-1} X_S \vec{y} \f$, so that \f$ \mathrm{RSS} = \vec{y}^T \vec{y} - |\vec{z}|^2 \f$.
+		Scoring a candidate feature requires only the new row of L, obtained by a bordering update costing O(k^2) for k selected
+		features (plus O(N k) for PRESS, which also tracks residuals and leverages). Candidates are scored in parallel and
+		the best one (with the lowest index in case of a tie) is added; the outcome does not depend on the number of threads.
+
+		Features nearly collinear with the selected ones are not considered.
+
+		X should contain a row of 1s if the model should have an intercept; pass its index in `initial_features` to always include it.
+
+		@param[in] X D x N matrix of X values, with data points in columns.
+		@param[in] y Y vector with length N.
+		@param[in] criterion Selection criterion.
+		@param[in] max_features Maximum number of selected features (including the initial ones). If 0 or larger than `min(D, N - 1)`, `min(D, N - 1)` is used.
+		@param[in] initial_features Indices of rows of X which are always included.
+		@param[in] number_threads Number of threads used to score candidates. If 0, the number of hardware threads is used.
+		@return StepwiseSelectionResult object.
+		@throw std::invalid_argument If `y.size() != X.cols()`, `X.rows() == 0`, `X.cols() < 2`, an initial feature index is out of range or repeated, or there are more initial features than `max_features`.
+		@throw std::domain_error If initial features are collinear.
+		*/
+		DLL_DECLSPEC StepwiseSelectionResult forward_stepwise(Eigen::Ref<const Eigen::MatrixXd> X, Eigen::Ref<const Eigen::VectorXd> y, StepwiseCriterion criterion, unsigned int max_features = 0, const std::vector<unsigned int>& initial_features = std::vector<unsigned int>(), unsigned int number_threads = 1);
+	}
+}
@@ -16,6 +16,16 @@ We provide the Gaussian E-M and K-means algorithms. Initial means can be initial
 - <a href="https://en.wikipedia.org/wiki/K-means_clustering#Initialization_methods">Forgy and Random partition</a>
 - <a href="https://en.wikipedia.org/wiki/K-means%2B%2B">K++</a>
 
+K-means can skip most distance calculations using the triangle inequality (Hamerly and Elkan algorithms), with the same results as the standard algorithm.
+For low-dimensional data, K-means can use the filtering algorithm over a kd-tree, which assigns whole tree nodes to centroids at once.
+Closest centroids are found using matrix products over tiles of points and centroids, with a safeguard against cancellation errors.
+K-means iterations can run on multiple threads, with results independent of the number of threads.
+Mini-batch K-means (ml::Clustering::MiniBatchKMeans) updates centroids from small batches, and can be refined chunk by chunk on streaming data.
+Multiple initialisations of K-means and E-M run concurrently, with reproducible random streams for each initialisation.
+K++ initialisation updates the distances to the closest centroid incrementally, and the k-means|| initialiser (ml::Clustering::ScalableKPP) chooses centroids in a few parallel passes over the data.
+K-means and E-M can fit weighted data points. A weighted coreset (ml::Clustering::Coreset) summarises large or streamed data sets chunk by chunk, and coresets of different chunks can be merged.
+Hierarchical K-means (ml::Clustering::HierarchicalKMeans) builds a tree of K-means fits with a given branching factor, for very large numbers of clusters, and assigns points to leaves in time logarithmic in the number of clusters.
+
 Implemented in ml::Clustering namespace and ml::EM class.
 
 @subsection decision_trees Decision trees
@@ -32,10 +42,18 @@ Implemented in ml::DecisionTrees namespace.
 
 Only Ordinary Least Squares for now:
 - univariate with and without intercept
-- multivariate
+- batched univariate regressions over many series
+- multivariate (with intercept handled via a row of 1s or implicitly, without copying the data)
+- approximate multivariate for tall data by CountSketch sketch-and-solve, optionally refined to full precision
+- multivariate with X * X^T decomposed in single precision and the solution refined in double precision
 - <a href="https://cpb-us-w2.wpmucdn.com/sites.gatech.edu/dist/2/436/files/2017/07/22-notes-6250-f16.pdf">recursive multivariate</a>
-- ridge regression
+- sliding-window multivariate (with Cholesky updates and downdates)
+- banks of many small recursive multivariate models, updated together in a vectorised sweep
+- ridge regression (direct in primal or dual form, or matrix-free with preconditioned conjugate gradients for wide or sparse data)
+- multi-target multivariate, ridge and Lasso regressions sharing one decomposition
+- forward stepwise feature selection (AIC, BIC or PRESS) with bordered Cholesky updates
 - PRESS statistic
+- k-fold cross-validation errors of multivariate and ridge regression (for a grid of regularisation strengths) from fold-wise sufficient statistics
 
 Implemented in ml::LinearRegression namespace.
 
@@ -49,6 +67,11 @@ Methods:
 - <a href="https://en.wikipedia.org/wiki/Cross-validation_(statistics)#k-fold_cross-validation">k-fold</a>
 - <a href="https://en.wikipedia.org/wiki/Cross-validation_(statistics)#Leave-one-out_cross-validation">leave-one-out</a>
 
+Folds can be trained on multiple threads, with results independent of the number of threads.
+Training data can be passed to models as views of the original data, for contiguous or shuffled folds, without copying.
+Shuffled, stratified and repeated k-fold splits are generated from counter-based random streams, reproducibly for any number of threads.
+Hyperparameters can be chosen by grid search, random search, successive halving or Hyperband, with (candidate, fold) trainings run on multiple threads.
+
 Implemented in ml::Crossvalidation namespace.
 
 @subsection Statistics
@@ -0,0 +1,156 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "ML/Coreset.hpp"
+#include "ML/KMeans.hpp"
+
+class CoresetTest : public testing::Test
+{
+protected:
+	CoresetTest()
+		: centres(3, 8), data(3, 20000)
+	{
+		std::default_random_engine rng(41);
+		std::uniform_real_distribution<double> uniform(-10, 10);
+		std::normal_distribution<double> standard_normal;
+		for (Eigen::Index k = 0; k < centres.cols(); ++k) {
+			for (Eigen::Index l = 0; l < centres.rows(); ++l) {
+				centres(l, k) = uniform(rng);
+			}
+		}
+		for (Eigen::Index i = 0; i < data.cols(); ++i) {
+			for (Eigen::Index l = 0; l < data.rows(); ++l) {
+				data(l, i) = centres(l, i % centres.cols()) + standard_normal(rng);
+			}
+		}
+	}
+
+	/// Weighted K-means cost of the centroids on the points.
+	static double cost(const Eigen::MatrixXd& points, const Eigen::VectorXd& weights, const Eigen::MatrixXd& centroids)
+	{
+		std::vector<unsigned int> labels;
+		Eigen::VectorXd squared_distances(points.cols());
+		ml::Clustering::find_closest_centroids(points, centroids, labels, squared_distances);
+		return weights.dot(squared_distances);
+	}
+
+	Eigen::MatrixXd centres;
+	Eigen::MatrixXd data;
+};
+
+TEST_F(CoresetTest, add)
+{
+	ml::Clustering::Coreset coreset(8, 500);
+	ASSERT_EQ(8u, coreset.number_clusters());
+	ASSERT_EQ(500u, coreset.size());
+	coreset.set_seed(3);
+	coreset.add(data);
+	ASSERT_EQ(3, coreset.points().rows());
+	ASSERT_LE(coreset.points().cols(), 500);
+	ASSERT_EQ(coreset.points().cols(), coreset.weights().size());
+	ASSERT_TRUE((coreset.weights().array() > 0).all());
+	// The total weight is an unbiased estimate of the number of points.
+	ASSERT_NEAR(static_cast<double>(data.cols()), coreset.weights().sum(), 0.1 * static_cast<double>(data.cols()));
+
+	// The cost of centroids fitted to the coreset approximates the cost on the full data, for these and other centroids.
+	ml::Clustering::KMeans km(8);
+	km.set_seed(5);
+	km.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+	km.set_number_initialisations(3);
+	km.fit(coreset.points(), coreset.weights());
+	const Eigen::VectorXd unit_weights(Eigen::VectorXd::Ones(data.cols()));
+	const double full_cost = cost(data, unit_weights, km.centroids());
+	ASSERT_NEAR(full_cost, km.inertia(), 0.1 * full_cost);
+	ASSERT_NEAR(full_cost, cost(data, unit_weights, centres), 0.1 * full_cost);
+	const Eigen::MatrixXd shifted(centres.array() + 1);
+	const double shifted_cost = cost(data, unit_weights, shifted);
+	ASSERT_NEAR(shifted_cost, cost(coreset.points(), coreset.weights(), shifted), 0.1 * shifted_cost);
+
+	// Reproducible and independent of the number of threads.
+	ml::Clustering::Coreset coreset2(8, 500);
+	coreset2.set_seed(3);
+	coreset2.set_number_threads(4);
+	coreset2.add(data);
+	ASSERT_EQ(coreset.points(), coreset2.points());
+	ASSERT_EQ(coreset.weights(), coreset2.weights());
+}
+
+TEST_F(CoresetTest, chunks)
+{
+	ml::Clustering::Coreset coreset(8, 400);
+	coreset.set_seed(7);
+	const Eigen::Index chunk_size = 2000;
+	for (Eigen::Index i0 = 0; i0 < data.cols(); i0 += chunk_size) {
+		coreset.add(data.middleCols(i0, chunk_size));
+	}
+	// 10 chunks occupy levels 1 and 3.
+	ASSERT_LE(coreset.points().cols(), 2 * 400);
+	ASSERT_NEAR(static_cast<double>(data.cols()), coreset.weights().sum(), 0.1 * static_cast<double>(data.cols()));
+	const Eigen::VectorXd unit_weights(Eigen::VectorXd::Ones(data.cols()));
+	const double centres_cost = cost(data, unit_weights, centres);
+	// Points in higher levels were reduced several times, so the error is larger than for a single reduction.
+	ASSERT_NEAR(centres_cost, cost(coreset.points(), coreset.weights(), centres), 0.15 * centres_cost);
+
+	// Coresets of two halves, built separately and merged.
+	ml::Clustering::Coreset first(8, 400);
+	ml::Clustering::Coreset second(8, 400);
+	first.set_seed(1);
+	second.set_seed(2);
+	first.add(data.leftCols(data.cols() / 2));
+	second.add(data.rightCols(data.cols() / 2));
+	first.merge(second);
+	ASSERT_LE(first.points().cols(), 400);
+	ASSERT_NEAR(centres_cost, cost(first.points(), first.weights(), centres), 0.15 * centres_cost);
+
+	first.reset();
+	ASSERT_EQ(0, first.points().cols());
+	ASSERT_EQ(0, first.weights().size());
+	first.add(Eigen::MatrixXd::Zero(2, 10));
+	ASSERT_EQ(2, first.points().rows());
+	ASSERT_THROW(first.merge(coreset), std::invalid_argument);
+	ASSERT_THROW(first.merge(ml::Clustering::Coreset(8, 300)), std::invalid_argument);
+	ASSERT_THROW(first.merge(ml::Clustering::Coreset(7, 400)), std::invalid_argument);
+}
+
+TEST_F(CoresetTest, small_chunks)
+{
+	// Chunks with at most `size` points are kept exactly, until they are merged.
+	ml::Clustering::Coreset coreset(2, 100);
+	Eigen::VectorXd weights(Eigen::VectorXd::LinSpaced(60, 0, 59));
+	coreset.add(data.leftCols(60), weights);
+	ASSERT_EQ(59, coreset.points().cols());
+	ASSERT_EQ(data.middleCols(1, 59), coreset.points());
+	ASSERT_EQ(weights.tail(59), coreset.weights());
+	coreset.add(data.middleCols(60, 30));
+	ASSERT_EQ(89, coreset.points().cols());
+	ASSERT_EQ(data.middleCols(1, 89), coreset.points());
+	// The third chunk goes to the empty level 0.
+	coreset.add(data.middleCols(90, 30));
+	ASSERT_EQ(119, coreset.points().cols());
+	ASSERT_EQ(data.middleCols(90, 30), coreset.points().leftCols(30));
+	// The fourth chunk is merged with the third one, and then with the first two, which are reduced.
+	coreset.add(data.middleCols(120, 30));
+	ASSERT_LE(coreset.points().cols(), 100);
+	const double total_weight = weights.sum() + 90;
+	ASSERT_NEAR(total_weight, coreset.weights().sum(), 0.2 * total_weight);
+	const auto number_points = coreset.points().cols();
+	coreset.add(data.leftCols(10), Eigen::VectorXd::Zero(10));
+	ASSERT_EQ(number_points, coreset.points().cols());
+}
+
+TEST_F(CoresetTest, errors)
+{
+	ASSERT_THROW(ml::Clustering::Coreset(0, 10), std::invalid_argument);
+	ASSERT_THROW(ml::Clustering::Coreset(11, 10), std::invalid_argument);
+	ml::Clustering::Coreset coreset(2, 10);
+	ASSERT_THROW(coreset.add(Eigen::MatrixXd(0, 10)), std::invalid_argument);
+	ASSERT_THROW(coreset.add(data.leftCols(10), Eigen::VectorXd::Ones(9)), std::invalid_argument);
+	ASSERT_THROW(coreset.add(data.leftCols(10), -Eigen::VectorXd::Ones(10)), std::domain_error);
+	Eigen::VectorXd weights(Eigen::VectorXd::Ones(10));
+	weights[3] = std::numeric_limits<double>::quiet_NaN();
+	ASSERT_THROW(coreset.add(data.leftCols(10), weights), std::domain_error);
+	coreset.add(data.leftCols(10));
+	ASSERT_THROW(coreset.add(Eigen::MatrixXd::Zero(2, 10)), std::invalid_argument);
+}
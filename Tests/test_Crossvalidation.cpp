@@ -1,5 +1,8 @@
 /* (C) 2020 Roman Werpachowski. */
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
+#include <Eigen/Cholesky>
 #include <gtest/gtest.h>
 #include "ML/Crossvalidation.hpp"
 #include "ML/LinearRegression.hpp"
@@ -32,6 +35,15 @@ TEST(CrossvalidationTest, calc_fold_indices)
 	Crossvalidation::calc_fold_indices(5, 2, 3, i0, i1);
 	ASSERT_EQ(4u, i0);
 	ASSERT_EQ(5u, i1);
+	// Rounding up would run past the end: 15 points in 10 folds of 1 or 2 points.
+	size_t expected_i0 = 0;
+	for (unsigned int k = 0; k < 10; ++k) {
+		Crossvalidation::calc_fold_indices(15, k, 10, i0, i1);
+		ASSERT_EQ(expected_i0, i0) << k;
+		ASSERT_EQ((k + 1) * 15 / 10, i1) << k;
+		expected_i0 = i1;
+	}
+	ASSERT_EQ(15u, expected_i0);
 }
 
 TEST(CrossvalidationTest, calc_fold_indices_throws)
@@ -179,4 +191,260 @@ TEST(CrossvalidationTest, cv_scalar)
 	ASSERT_NEAR((4 + 1 + 4) / 3, loocv_error, 1e-15);
 	const double kfold_error = Crossvalidation::k_fold_scalar(x, y, trainer, tester, 3);
 	ASSERT_NEAR(kfold_error, loocv_error, 1e-15);
-}
\ No newline at end of file
+}
+TEST(CrossvalidationTest, parallel)
+{
+	const Eigen::Index n = 50;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, n));
+	const Eigen::VectorXd x(X.row(0).transpose());
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(3) + 0.1 * Eigen::VectorXd::Random(n));
+	const auto trainer = [](const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y) -> LinearRegression::MultivariateOLSResult {
+		return LinearRegression::multivariate(X, y);
+	};
+	const auto tester = [](const LinearRegression::MultivariateOLSResult& model, const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y) -> double {
+		return (y - model.predict(X)).squaredNorm() / static_cast<double>(y.size());
+	};
+	const auto scalar_trainer = [](const Eigen::Ref<const Eigen::VectorXd> x, const Eigen::Ref<const Eigen::VectorXd> y) {
+		return LinearRegression::univariate(x, y);
+	};
+	const auto scalar_tester = [](const LinearRegression::UnivariateOLSResult& model, const Eigen::Ref<const Eigen::VectorXd> x, const Eigen::Ref<const Eigen::VectorXd> y) -> double {
+		return (y - model.predict(x)).squaredNorm() / static_cast<double>(y.size());
+	};
+	const double kfold_error = Crossvalidation::k_fold(X, y, trainer, tester, 7);
+	const double kfold_scalar_error = Crossvalidation::k_fold_scalar(x, y, scalar_trainer, scalar_tester, 7);
+	const double loocv_error = Crossvalidation::leave_one_out(X, y, trainer, tester);
+	const double loocv_scalar_error = Crossvalidation::leave_one_out_scalar(x, y, scalar_trainer, scalar_tester);
+	ASSERT_NEAR(LinearRegression::press(X, y, LinearRegression::multivariate) / static_cast<double>(n), loocv_error, 1e-15);
+	// Results do not depend on the number of threads.
+	for (const unsigned int number_threads : {0u, 2u, 3u, 7u, 100u}) {
+		ASSERT_EQ(kfold_error, Crossvalidation::k_fold(X, y, trainer, tester, 7, number_threads)) << number_threads;
+		ASSERT_EQ(kfold_scalar_error, Crossvalidation::k_fold_scalar(x, y, scalar_trainer, scalar_tester, 7, number_threads)) << number_threads;
+		ASSERT_EQ(loocv_error, Crossvalidation::leave_one_out(X, y, trainer, tester, number_threads)) << number_threads;
+		ASSERT_EQ(loocv_scalar_error, Crossvalidation::leave_one_out_scalar(x, y, scalar_trainer, scalar_tester, number_threads)) << number_threads;
+	}
+	// Exceptions thrown on worker threads are propagated.
+	const auto throwing_trainer = [](const Eigen::Ref<const Eigen::MatrixXd>, const Eigen::Ref<const Eigen::VectorXd> y) -> LinearRegression::MultivariateOLSResult {
+		if (y.size() < 50) {
+			throw std::runtime_error("Training failed");
+		}
+		return LinearRegression::MultivariateOLSResult();
+	};
+	ASSERT_THROW(Crossvalidation::k_fold(X, y, throwing_trainer, tester, 7, 3), std::runtime_error);
+	ASSERT_THROW(Crossvalidation::leave_one_out(X, y, throwing_trainer, tester, 3), std::runtime_error);
+	ASSERT_THROW(Crossvalidation::k_fold(X, y, trainer, tester, 51, 3), std::invalid_argument);
+}
+
+TEST(CrossvalidationTest, fold_view)
+{
+	Eigen::MatrixXd X(2, 5);
+	X << 0, 1, 2, 3, 4,
+		5, 6, 7, 8, 9;
+	const Eigen::VectorXd y(X.row(0).transpose());
+	const Crossvalidation::FoldView without_fold(X, y, 0, 2, 4, 5);
+	ASSERT_EQ(3, without_fold.size());
+	ASSERT_EQ(2, without_fold.dim());
+	ASSERT_EQ(Crossvalidation::without_kth_fold_2d(X, 1, 3), without_fold.X());
+	ASSERT_EQ(Crossvalidation::without_kth_fold_1d(y, 1, 3), without_fold.y());
+	unsigned int number_blocks = 0;
+	without_fold.for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> X_block, const Eigen::Ref<const Eigen::VectorXd>) {
+		// Blocks refer to the original data.
+		ASSERT_EQ(&X(0, number_blocks ? 4 : 0), X_block.data());
+		++number_blocks;
+	});
+	ASSERT_EQ(2u, number_blocks);
+	const std::vector<unsigned int> folds({ 1, 0, 1, 1, 0 });
+	const Crossvalidation::FoldView in_fold(X, y, folds, 0, true);
+	ASSERT_EQ(2, in_fold.size());
+	Eigen::MatrixXd expected(2, 2);
+	expected << 1, 4,
+		6, 9;
+	ASSERT_EQ(expected, in_fold.X());
+	ASSERT_EQ(Eigen::Vector2d(1, 4), in_fold.y());
+	const Crossvalidation::FoldView not_in_fold(X, y, folds, 0, false);
+	ASSERT_EQ(3, not_in_fold.size());
+	expected.resize(2, 3);
+	expected << 0, 2, 3,
+		5, 7, 8;
+	ASSERT_EQ(expected, not_in_fold.X());
+	ASSERT_THROW(Crossvalidation::FoldView(X, y, 0, 3, 2, 5), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::FoldView(X, y, 0, 2, 4, 6), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::FoldView(X, y, std::vector<unsigned int>({ 0, 1 }), 0, true), std::invalid_argument);
+	// Long runs are passed without copying, short ones are gathered in blocks.
+	const Eigen::Index n = 1000;
+	const Eigen::MatrixXd X2(Eigen::MatrixXd::Random(3, n));
+	const Eigen::VectorXd y2(Eigen::VectorXd::Random(n));
+	std::vector<unsigned int> folds2(n);
+	for (Eigen::Index i = 0; i < n; ++i) {
+		folds2[i] = (i < 500) ? static_cast<unsigned int>(i % 2) : 0;
+	}
+	const Crossvalidation::FoldView view2(X2, y2, folds2, 1, false);
+	ASSERT_EQ(750, view2.size());
+	Eigen::Index total = 0;
+	view2.for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> X_block, const Eigen::Ref<const Eigen::VectorXd> y_block) {
+		ASSERT_LE(X_block.cols(), total < 250 ? Crossvalidation::FoldView::gather_block_size : 500);
+		ASSERT_EQ(X_block.cols(), y_block.size());
+		total += X_block.cols();
+	});
+	ASSERT_EQ(750, total);
+	ASSERT_EQ(X2.rightCols(500), view2.X().rightCols(500));
+	ASSERT_EQ(X2.col(498), view2.X().col(249));
+}
+
+TEST(CrossvalidationTest, folds_from_permutation)
+{
+	ASSERT_EQ(std::vector<unsigned int>({ 2, 1, 0, 0, 1 }), Crossvalidation::folds_from_permutation({ 2, 3, 1, 4, 0 }, 3));
+	ASSERT_THROW(Crossvalidation::folds_from_permutation({ 2, 3, 1, 3, 0 }, 3), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::folds_from_permutation({ 2, 5, 1, 4, 0 }, 3), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::folds_from_permutation({ 1, 0 }, 3), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::folds_from_permutation({ 1, 0 }, 0), std::invalid_argument);
+	std::vector<size_t> reversed(15);
+	for (size_t j = 0; j < reversed.size(); ++j) {
+		reversed[j] = reversed.size() - 1 - j;
+	}
+	ASSERT_EQ(std::vector<unsigned int>({ 9, 9, 8, 7, 7, 6, 5, 5, 4, 3, 3, 2, 1, 1, 0 }), Crossvalidation::folds_from_permutation(reversed, 10));
+	ASSERT_EQ(std::vector<unsigned int>({ 0, 0, 1, 1, 2 }), Crossvalidation::calc_contiguous_folds(5, 3));
+	ASSERT_THROW(Crossvalidation::calc_contiguous_folds(2, 3), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::calc_contiguous_folds(5, 0), std::invalid_argument);
+	ASSERT_EQ(std::vector<unsigned int>({ 0, 1, 1, 2, 3, 3, 4, 5, 5, 6, 7, 7, 8, 9, 9 }), Crossvalidation::calc_contiguous_folds(15, 10));
+	ASSERT_EQ(std::vector<size_t>({ 2, 2, 1 }), Crossvalidation::calc_fold_sizes({ 2, 1, 0, 0, 1 }));
+	ASSERT_THROW(Crossvalidation::calc_fold_sizes({ 0, 0 }), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::calc_fold_sizes({ 0, 2 }), std::invalid_argument);
+}
+
+TEST(CrossvalidationTest, k_fold_view)
+{
+	const Eigen::Index n = 1000;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, n));
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(3) + 0.1 * Eigen::VectorXd::Random(n));
+	const auto trainer = [](const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y) -> LinearRegression::MultivariateOLSResult {
+		return LinearRegression::multivariate(X, y);
+	};
+	const auto tester = [](const LinearRegression::MultivariateOLSResult& model, const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::Ref<const Eigen::VectorXd> y) -> double {
+		return (y - model.predict(X)).squaredNorm() / static_cast<double>(y.size());
+	};
+	// Fits OLS by accumulating X * X^T and X * y over blocks.
+	const auto view_trainer = [](const Crossvalidation::FoldView& train) -> Eigen::VectorXd {
+		Eigen::MatrixXd XXt(Eigen::MatrixXd::Zero(train.dim(), train.dim()));
+		Eigen::VectorXd Xy(Eigen::VectorXd::Zero(train.dim()));
+		train.for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> X_block, const Eigen::Ref<const Eigen::VectorXd> y_block) {
+			XXt.noalias() += X_block * X_block.transpose();
+			Xy.noalias() += X_block * y_block;
+		});
+		return XXt.ldlt().solve(Xy);
+	};
+	const auto view_tester = [](const Eigen::VectorXd& beta, const Crossvalidation::FoldView& test) -> double {
+		double sse = 0;
+		test.for_each_block([&](const Eigen::Ref<const Eigen::MatrixXd> X_block, const Eigen::Ref<const Eigen::VectorXd> y_block) {
+			sse += (y_block - X_block.transpose() * beta).squaredNorm();
+		});
+		return sse / static_cast<double>(test.size());
+	};
+	const double expected_kfold_error = Crossvalidation::k_fold(X, y, trainer, tester, 10);
+	const double kfold_error = Crossvalidation::k_fold_view(X, y, view_trainer, view_tester, 10);
+	ASSERT_NEAR(expected_kfold_error, kfold_error, 1e-14);
+	const double expected_loocv_error = LinearRegression::press(X, y, LinearRegression::multivariate) / static_cast<double>(n);
+	ASSERT_NEAR(expected_loocv_error, Crossvalidation::leave_one_out_view(X, y, view_trainer, view_tester), 1e-14);
+	// Shuffled folds give the same result as contiguous folds on shuffled data.
+	std::vector<size_t> permutation(n);
+	for (size_t i = 0; i < permutation.size(); ++i) {
+		permutation[i] = (i * 7919) % n;
+	}
+	Eigen::MatrixXd shuffled_X(X.rows(), n);
+	Eigen::VectorXd shuffled_y(n);
+	for (Eigen::Index j = 0; j < n; ++j) {
+		shuffled_X.col(j) = X.col(permutation[j]);
+		shuffled_y[j] = y[permutation[j]];
+	}
+	const auto folds = Crossvalidation::folds_from_permutation(permutation, 10);
+	const double shuffled_error = Crossvalidation::k_fold_view(X, y, view_trainer, view_tester, folds);
+	ASSERT_NEAR(Crossvalidation::k_fold(shuffled_X, shuffled_y, trainer, tester, 10), shuffled_error, 1e-14);
+	ASSERT_NE(kfold_error, shuffled_error);
+	for (const unsigned int number_threads : {0u, 3u, 20u}) {
+		ASSERT_EQ(kfold_error, Crossvalidation::k_fold_view(X, y, view_trainer, view_tester, 10, number_threads)) << number_threads;
+		ASSERT_EQ(shuffled_error, Crossvalidation::k_fold_view(X, y, view_trainer, view_tester, folds, number_threads)) << number_threads;
+	}
+	ASSERT_THROW(Crossvalidation::k_fold_view(X, y, view_trainer, view_tester, std::vector<unsigned int>(n, 0)), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::k_fold_view(X, y.head(n - 1), view_trainer, view_tester, 10), std::invalid_argument);
+}
+
+TEST(CrossvalidationTest, random_folds)
+{
+	const size_t n = 103;
+	const auto permutation = Crossvalidation::random_permutation(n, 42, 3);
+	ASSERT_EQ(permutation, Crossvalidation::random_permutation(n, 42, 3));
+	ASSERT_NE(permutation, Crossvalidation::random_permutation(n, 42, 4));
+	ASSERT_NE(permutation, Crossvalidation::random_permutation(n, 43, 3));
+	std::vector<size_t> sorted(permutation);
+	std::sort(sorted.begin(), sorted.end());
+	for (size_t i = 0; i < n; ++i) {
+		ASSERT_EQ(i, sorted[i]);
+	}
+
+	const auto shuffled = Crossvalidation::calc_shuffled_folds(n, 10, 42, 3);
+	ASSERT_EQ(Crossvalidation::folds_from_permutation(permutation, 10), shuffled);
+	const auto shuffled_sizes = Crossvalidation::calc_fold_sizes(shuffled);
+	ASSERT_EQ(10u, shuffled_sizes.size());
+	for (unsigned int k = 0; k < 10; ++k) {
+		size_t i0, i1;
+		Crossvalidation::calc_fold_indices(n, k, 10, i0, i1);
+		ASSERT_EQ(i1 - i0, shuffled_sizes[k]);
+	}
+	ASSERT_THROW(Crossvalidation::calc_shuffled_folds(n, 104, 42), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::calc_shuffled_folds(n, 0, 42), std::invalid_argument);
+	// 15 points in 10 folds of 1 or 2 points.
+	const auto few_shuffled_sizes = Crossvalidation::calc_fold_sizes(Crossvalidation::calc_shuffled_folds(15, 10, 42));
+	ASSERT_EQ(std::vector<size_t>({ 1, 2, 1, 2, 1, 2, 1, 2, 1, 2 }), few_shuffled_sizes);
+
+	Eigen::VectorXd labels(n);
+	for (size_t i = 0; i < n; ++i) {
+		labels[i] = i < 70 ? 1 : (i < 100 ? -1 : 5);
+	}
+	const auto stratified = Crossvalidation::calc_stratified_folds(labels, 4, 42, 0);
+	ASSERT_EQ(stratified, Crossvalidation::calc_stratified_folds(labels, 4, 42, 0));
+	ASSERT_NE(stratified, Crossvalidation::calc_stratified_folds(labels, 4, 42, 1));
+	const auto stratified_sizes = Crossvalidation::calc_fold_sizes(stratified);
+	ASSERT_EQ(std::vector<size_t>({ 26, 26, 26, 25 }), stratified_sizes);
+	for (const double label : { -1., 1., 5. }) {
+		std::vector<size_t> class_counts(4, 0);
+		for (size_t i = 0; i < n; ++i) {
+			if (labels[i] == label) {
+				++class_counts[stratified[i]];
+			}
+		}
+		const auto minmax = std::minmax_element(class_counts.begin(), class_counts.end());
+		ASSERT_LE(*minmax.second - *minmax.first, 1u) << label;
+	}
+	ASSERT_THROW(Crossvalidation::calc_stratified_folds(labels, 0, 42), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::calc_stratified_folds(labels, 104, 42), std::invalid_argument);
+	labels[3] = std::numeric_limits<double>::quiet_NaN();
+	ASSERT_THROW(Crossvalidation::calc_stratified_folds(labels, 4, 42), std::invalid_argument);
+}
+
+TEST(CrossvalidationTest, repeated_k_fold_view)
+{
+	const Eigen::Index n = 200;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, n));
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(3) + 0.1 * Eigen::VectorXd::Random(n));
+	const auto trainer = [](const Crossvalidation::FoldView& train) -> LinearRegression::MultivariateOLSResult {
+		return LinearRegression::multivariate(train.X(), train.y());
+	};
+	const auto tester = [](const LinearRegression::MultivariateOLSResult& model, const Crossvalidation::FoldView& test) -> double {
+		return (test.y() - model.predict(test.X())).squaredNorm() / static_cast<double>(test.size());
+	};
+	const auto splitter = [n](const unsigned int repeat) {
+		return Crossvalidation::calc_shuffled_folds(n, 5, 1234, repeat);
+	};
+	const auto errors = Crossvalidation::repeated_k_fold_view(X, y, trainer, tester, splitter, 4);
+	ASSERT_EQ(4u, errors.size());
+	for (unsigned int r = 0; r < 4; ++r) {
+		ASSERT_EQ(Crossvalidation::k_fold_view(X, y, trainer, tester, splitter(r)), errors[r]) << r;
+	}
+	ASSERT_NE(errors[0], errors[1]);
+	for (const unsigned int number_threads : { 0u, 3u, 30u }) {
+		ASSERT_EQ(errors, Crossvalidation::repeated_k_fold_view(X, y, trainer, tester, splitter, 4, number_threads)) << number_threads;
+	}
+	ASSERT_THROW(Crossvalidation::repeated_k_fold_view(X, y, trainer, tester, splitter, 0), std::invalid_argument);
+	ASSERT_THROW(Crossvalidation::repeated_k_fold_view(X, y, trainer, tester, [](unsigned int) {
+		return std::vector<unsigned int>(10, 0);
+	}, 2), std::invalid_argument);
+}
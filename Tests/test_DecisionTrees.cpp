@@ -290,6 +290,9 @@ TEST(DecisionTreeTest, univariate_regression_with_crossvalidation)
 	const double test_error = ml::DecisionTrees::regression_tree_mean_squared_error(tree, test_X, test_y);
 	ASSERT_NEAR(test_error, noise_strength * noise_strength, 2e-5);	
 	ASSERT_GT(cv_test_error, test_error);
+	const auto parallel_result = ml::DecisionTrees::regression_tree_auto_prune(train_X, train_y, 100, 2, alphas, 10, 4);
+	ASSERT_EQ(alpha, std::get<1>(parallel_result));
+	ASSERT_EQ(cv_test_error, std::get<2>(parallel_result));
 }
 
 TEST(DecisionTreeTest, pruning)
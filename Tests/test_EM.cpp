@@ -141,4 +141,97 @@ TEST(EMTest, deterministic)
 		ASSERT_EQ(i, em.labels()[i]) << i;
 		ASSERT_EQ(0, (em.means().col(i) - data.col(i)).norm()) << i;
 	}
-}
\ No newline at end of file
+}
+TEST(EMTest, multiple_initialisations)
+{
+	std::default_random_engine rng(3);
+	std::normal_distribution<double> standard_normal;
+	const unsigned int num_components = 4;
+	const unsigned int sample_size = 600;
+	Eigen::MatrixXd data(2, sample_size);
+	for (unsigned int i = 0; i < sample_size; ++i) {
+		const auto k = i % num_components;
+		data(0, i) = 3. * static_cast<double>(k % 2) + 0.3 * standard_normal(rng);
+		data(1, i) = 3. * static_cast<double>(k / 2) + 0.3 * standard_normal(rng);
+	}
+	const auto fit = [&](const unsigned int number_initialisations, const unsigned int number_threads) {
+		ml::EM em(num_components);
+		em.set_seed(77);
+		em.set_number_initialisations(number_initialisations);
+		em.set_number_threads(number_threads);
+		em.fit(data);
+		return em;
+	};
+	const auto single = fit(1, 1);
+	const auto multiple = fit(5, 1);
+	ASSERT_TRUE(multiple.converged());
+	// The first initialisation is the same as a single fit.
+	ASSERT_LE(single.log_likelihood(), multiple.log_likelihood());
+	for (const unsigned int number_threads : { 0u, 2u, 5u, 8u }) {
+		const auto parallel = fit(5, number_threads);
+		ASSERT_EQ(multiple.log_likelihood(), parallel.log_likelihood()) << number_threads;
+		ASSERT_EQ(multiple.means(), parallel.means()) << number_threads;
+		ASSERT_EQ(multiple.labels(), parallel.labels()) << number_threads;
+	}
+	ml::EM em(num_components);
+	ASSERT_THROW(em.set_number_initialisations(0), std::invalid_argument);
+}
+
+TEST(EMTest, weights)
+{
+	std::default_random_engine rng(8);
+	std::normal_distribution<double> standard_normal;
+	const unsigned int num_components = 2;
+	Eigen::MatrixXd data(2, 200);
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		data(0, i) = 5. * static_cast<double>(i % 2) + 0.5 * standard_normal(rng);
+		data(1, i) = -3. * static_cast<double>(i % 2) + 0.3 * standard_normal(rng);
+	}
+	Eigen::VectorXd weights(data.cols());
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		weights[i] = static_cast<double>(1 + i % 3);
+	}
+	Eigen::MatrixXd replicated(2, static_cast<Eigen::Index>(weights.sum()));
+	Eigen::Index j = 0;
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		for (int n = 0; n < static_cast<int>(weights[i]); ++n) {
+			replicated.col(j++) = data.col(i);
+		}
+	}
+	const auto make_em = []() {
+		ml::EM em(num_components);
+		em.set_seed(12);
+		em.set_absolute_tolerance(1e-12);
+		em.set_relative_tolerance(1e-12);
+		return em;
+	};
+	// Unit weights are the same as no weights (Forgy initialisation ignores the weights).
+	auto unweighted = make_em();
+	auto unit_weighted = make_em();
+	ASSERT_TRUE(unweighted.fit(data));
+	ASSERT_TRUE(unit_weighted.fit(data, Eigen::VectorXd::Ones(data.cols())));
+	ASSERT_NEAR(unweighted.log_likelihood(), unit_weighted.log_likelihood(), 1e-10 * std::abs(unweighted.log_likelihood()));
+	ASSERT_NEAR(0, (unweighted.means() - unit_weighted.means()).norm(), 1e-10);
+
+	// Integer weights give the same mixture as replicated points, apart from the bias correction of the initial covariance.
+	auto weighted = make_em();
+	auto repeated = make_em();
+	weighted.set_means_initialiser(std::make_shared<ml::Clustering::KPP>());
+	repeated.set_means_initialiser(std::make_shared<ml::Clustering::KPP>());
+	ASSERT_TRUE(weighted.fit(data, weights));
+	ASSERT_TRUE(repeated.fit(replicated));
+	ASSERT_NEAR(repeated.log_likelihood(), weighted.log_likelihood(), 1e-6 * std::abs(repeated.log_likelihood()));
+	for (unsigned int k = 0; k < num_components; ++k) {
+		Eigen::Index closest;
+		(repeated.means().colwise() - weighted.means().col(k)).colwise().norm().minCoeff(&closest);
+		ASSERT_NEAR(0, (repeated.means().col(closest) - weighted.means().col(k)).norm(), 1e-6) << k;
+		ASSERT_NEAR(repeated.mixing_probabilities()[closest], weighted.mixing_probabilities()[k], 1e-6) << k;
+		ASSERT_NEAR(0, (repeated.covariances()[static_cast<size_t>(closest)] - weighted.covariances()[k]).norm(), 1e-6) << k;
+	}
+	ASSERT_EQ(static_cast<size_t>(data.cols()), weighted.labels().size());
+
+	ml::EM em(num_components);
+	ASSERT_THROW(em.fit(data, weights.head(10)), std::invalid_argument);
+	ASSERT_THROW(em.fit(data, -weights), std::domain_error);
+	ASSERT_THROW(em.fit(data, Eigen::VectorXd::Zero(data.cols())), std::domain_error);
+}
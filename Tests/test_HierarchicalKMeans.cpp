@@ -0,0 +1,163 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "ML/HierarchicalKMeans.hpp"
+
+class HierarchicalKMeansTest : public testing::Test
+{
+protected:
+	HierarchicalKMeansTest()
+		: centres(2, 64), data(2, 6400)
+	{
+		// 8 groups of 8 clusters.
+		for (Eigen::Index k = 0; k < centres.cols(); ++k) {
+			const auto group = k / 8;
+			const auto member = k % 8;
+			centres(0, k) = 100. * static_cast<double>(group % 4) + 10. * static_cast<double>(member % 4);
+			centres(1, k) = 100. * static_cast<double>(group / 4) + 10. * static_cast<double>(member / 4);
+		}
+		std::default_random_engine rng(19);
+		std::normal_distribution<double> standard_normal;
+		for (Eigen::Index i = 0; i < data.cols(); ++i) {
+			for (Eigen::Index l = 0; l < data.rows(); ++l) {
+				data(l, i) = centres(l, i % centres.cols()) + 0.5 * standard_normal(rng);
+			}
+		}
+	}
+
+	Eigen::MatrixXd centres;
+	Eigen::MatrixXd data;
+};
+
+TEST_F(HierarchicalKMeansTest, fit)
+{
+	ml::Clustering::HierarchicalKMeans hkm(64, 8);
+	ASSERT_EQ(64u, hkm.number_clusters());
+	ASSERT_EQ(8u, hkm.branching_factor());
+	ASSERT_FALSE(hkm.converged());
+	hkm.set_seed(2);
+	hkm.set_number_initialisations(4);
+	ASSERT_TRUE(hkm.fit(data));
+	ASSERT_TRUE(hkm.converged());
+	ASSERT_EQ(2u, hkm.depth());
+	ASSERT_EQ(2, hkm.centroids().rows());
+	ASSERT_EQ(64, hkm.centroids().cols());
+	for (Eigen::Index k = 0; k < centres.cols(); ++k) {
+		ASSERT_NEAR(0, (hkm.centroids().colwise() - centres.col(k)).colwise().norm().minCoeff(), 0.5) << k;
+	}
+	ASSERT_EQ(static_cast<size_t>(data.cols()), hkm.labels().size());
+	double inertia = 0;
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		const auto label_and_distance = hkm.assign_label(data.col(i));
+		ASSERT_EQ(label_and_distance.first, hkm.labels()[static_cast<size_t>(i)]) << i;
+		ASSERT_NEAR((data.col(i) - hkm.centroids().col(label_and_distance.first)).squaredNorm(), label_and_distance.second, 1e-12) << i;
+		// On well separated clusters, the tree finds the closest leaf.
+		Eigen::Index closest;
+		(hkm.centroids().colwise() - data.col(i)).colwise().squaredNorm().minCoeff(&closest);
+		ASSERT_EQ(static_cast<unsigned int>(closest), label_and_distance.first) << i;
+		inertia += label_and_distance.second;
+	}
+	ASSERT_NEAR(inertia, hkm.inertia(), 1e-8 * inertia);
+
+	// Reproducible and independent of the number of threads.
+	for (const unsigned int number_threads : { 0u, 3u, 16u }) {
+		ml::Clustering::HierarchicalKMeans hkm2(64, 8);
+		hkm2.set_seed(2);
+		hkm2.set_number_initialisations(4);
+		hkm2.set_number_threads(number_threads);
+		hkm2.fit(data);
+		ASSERT_EQ(hkm.centroids(), hkm2.centroids()) << number_threads;
+		ASSERT_EQ(hkm.labels(), hkm2.labels()) << number_threads;
+		ASSERT_EQ(hkm.inertia(), hkm2.inertia()) << number_threads;
+	}
+
+	ASSERT_THROW(hkm.assign_label(Eigen::VectorXd::Zero(3)), std::invalid_argument);
+	ASSERT_THROW(hkm.fit(data.leftCols(63)), std::invalid_argument);
+	ASSERT_THROW(hkm.fit(Eigen::MatrixXd(0, 100)), std::invalid_argument);
+}
+
+TEST_F(HierarchicalKMeansTest, uneven_budgets)
+{
+	// 50 leaves with branching factor 4: budgets 13, 13, 12, 12, and so on.
+	ml::Clustering::HierarchicalKMeans hkm(50, 4);
+	hkm.set_seed(7);
+	hkm.set_algorithm(ml::Clustering::KMeansAlgorithm::HAMERLY);
+	hkm.fit(data);
+	ASSERT_EQ(3u, hkm.depth());
+	ASSERT_EQ(50, hkm.centroids().cols());
+	std::vector<unsigned int> labels(hkm.labels());
+	std::sort(labels.begin(), labels.end());
+	ASSERT_EQ(50, std::unique(labels.begin(), labels.end()) - labels.begin());
+	ASSERT_EQ(49u, labels.back());
+
+	// Every data point is a leaf, even if some clusters have fewer points than their share.
+	const Eigen::MatrixXd few_points(data.leftCols(20));
+	ml::Clustering::HierarchicalKMeans all_leaves(20, 3);
+	all_leaves.fit(few_points);
+	ASSERT_EQ(0, all_leaves.inertia());
+	for (Eigen::Index i = 0; i < few_points.cols(); ++i) {
+		ASSERT_EQ(few_points.col(i), all_leaves.centroids().col(all_leaves.labels()[static_cast<size_t>(i)])) << i;
+	}
+
+	// A single cluster is the root.
+	ml::Clustering::HierarchicalKMeans root(1, 4);
+	ASSERT_TRUE(root.fit(data));
+	ASSERT_EQ(0u, root.depth());
+	ASSERT_NEAR(0, (data.rowwise().mean() - root.centroids().col(0)).norm(), 1e-12);
+	ASSERT_EQ(std::vector<unsigned int>(static_cast<size_t>(data.cols()), 0), root.labels());
+}
+
+/// Checks that every data point is the centroid of a leaf.
+static void check_leaves_cover_points(const ml::Clustering::HierarchicalKMeans& hkm, const Eigen::Ref<const Eigen::MatrixXd> data)
+{
+	ASSERT_EQ(static_cast<Eigen::Index>(hkm.number_clusters()), hkm.centroids().cols());
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		ASSERT_EQ(0, (hkm.centroids().colwise() - data.col(i)).colwise().squaredNorm().minCoeff()) << i;
+	}
+}
+
+TEST_F(HierarchicalKMeansTest, duplicate_points)
+{
+	// 20 points with 2 distinct values.
+	Eigen::MatrixXd two_values(2, 20);
+	for (Eigen::Index i = 0; i < two_values.cols(); ++i) {
+		two_values.col(i) = centres.col(i % 2);
+	}
+	ml::Clustering::HierarchicalKMeans hkm(4, 2);
+	ASSERT_THROW(hkm.fit(two_values), std::invalid_argument);
+	ml::Clustering::HierarchicalKMeans two_leaves(2, 2);
+	two_leaves.fit(two_values);
+	ASSERT_EQ(0, two_leaves.inertia());
+
+	// With as many leaves as distinct points, every leaf gets one distinct point, even if a child has more points than distinct points.
+	Eigen::MatrixXd duplicates(2, 30);
+	for (Eigen::Index i = 0; i < duplicates.cols(); ++i) {
+		duplicates.col(i) = i < 24 ? centres.col(i % 3) : data.col(i);
+	}
+	for (const unsigned int branching_factor : { 2u, 3u, 5u }) {
+		ml::Clustering::HierarchicalKMeans all_leaves(9, branching_factor);
+		all_leaves.fit(duplicates);
+		check_leaves_cover_points(all_leaves, duplicates);
+	}
+
+	// Forgy chooses duplicate points as the initial centroids, so K-means puts all points in one cluster.
+	Eigen::MatrixXd few_distinct(Eigen::MatrixXd::Ones(2, 1000));
+	few_distinct.rightCols(4) = data.leftCols(4);
+	ml::Clustering::HierarchicalKMeans forgy(5, 2);
+	forgy.set_centroids_initialiser(std::make_shared<ml::Clustering::Forgy>());
+	forgy.fit(few_distinct);
+	check_leaves_cover_points(forgy, few_distinct);
+}
+
+TEST_F(HierarchicalKMeansTest, errors)
+{
+	ASSERT_THROW(ml::Clustering::HierarchicalKMeans(0), std::invalid_argument);
+	ASSERT_THROW(ml::Clustering::HierarchicalKMeans(10, 1), std::invalid_argument);
+	ml::Clustering::HierarchicalKMeans hkm(10);
+	ASSERT_THROW(hkm.set_absolute_tolerance(-1), std::domain_error);
+	ASSERT_THROW(hkm.set_maximum_steps(1), std::invalid_argument);
+	ASSERT_THROW(hkm.set_number_initialisations(0), std::invalid_argument);
+	ASSERT_THROW(hkm.set_centroids_initialiser(nullptr), std::invalid_argument);
+}
@@ -0,0 +1,144 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <cmath>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "ML/HyperparameterSearch.hpp"
+#include "ML/LinearRegression.hpp"
+
+using namespace ml;
+
+class HyperparameterSearchTest : public testing::Test
+{
+protected:
+	HyperparameterSearchTest()
+		: X(Eigen::MatrixXd::Random(5, 300)), y(X.transpose() * Eigen::VectorXd::LinSpaced(5, -1, 1) + 0.5 * Eigen::VectorXd::Random(300)),
+		folds(Crossvalidation::calc_shuffled_folds(300, 6, 17))
+	{}
+
+	static LinearRegression::RidgeRegressionResult train(const double lambda, const Crossvalidation::FoldView& train)
+	{
+		return LinearRegression::ridge<true>(train.X(), train.y(), lambda);
+	}
+
+	static double test(const LinearRegression::RidgeRegressionResult& model, const Crossvalidation::FoldView& test)
+	{
+		return (test.y() - model.predict(test.X())).squaredNorm() / static_cast<double>(test.size());
+	}
+
+	static double sample(RandomStreams::Stream& stream)
+	{
+		return std::pow(10., -3. + 6. * static_cast<double>(stream.uniform_index(1000001)) / 1e6);
+	}
+
+	const Eigen::MatrixXd X;
+	const Eigen::VectorXd y;
+	const std::vector<unsigned int> folds;
+};
+
+TEST_F(HyperparameterSearchTest, grid_search)
+{
+	const std::vector<double> lambdas({ 1e-3, 1e-2, 1e-1, 1, 10, 100, 1e3, 1e4, 1e5 });
+	const auto result = HyperparameterSearch::grid_search(X, y, lambdas, train, test, folds);
+	ASSERT_EQ(lambdas, result.candidates);
+	ASSERT_EQ(lambdas.size() * 6, result.number_trainings);
+	size_t expected_best = 0;
+	for (size_t i = 0; i < lambdas.size(); ++i) {
+		ASSERT_EQ(6u, result.number_folds[i]);
+		const double expected_error = Crossvalidation::k_fold_view(X, y, [&](const Crossvalidation::FoldView& train_data) {
+			return train(lambdas[i], train_data);
+		}, test, folds);
+		ASSERT_EQ(expected_error, result.errors[i]) << i;
+		if (result.errors[i] < result.errors[expected_best]) {
+			expected_best = i;
+		}
+	}
+	ASSERT_EQ(expected_best, result.best);
+	ASSERT_EQ(lambdas[expected_best], result.best_candidate());
+	ASSERT_EQ(result.errors[expected_best], result.best_error());
+	ASSERT_LT(result.best_error(), result.errors.back());
+	for (const unsigned int number_threads : { 0u, 3u, 8u }) {
+		const auto parallel_result = HyperparameterSearch::grid_search(X, y, lambdas, train, test, folds, number_threads);
+		ASSERT_EQ(result.errors, parallel_result.errors) << number_threads;
+		ASSERT_EQ(result.best, parallel_result.best) << number_threads;
+	}
+	ASSERT_THROW(HyperparameterSearch::grid_search(X, y, std::vector<double>(), train, test, folds), std::invalid_argument);
+	ASSERT_THROW(HyperparameterSearch::grid_search(X, y, lambdas, train, test, std::vector<unsigned int>(300, 0)), std::invalid_argument);
+	// Exceptions thrown on worker threads are propagated.
+	const auto throwing_train = [](const double lambda, const Crossvalidation::FoldView& train_data) {
+		if (lambda > 50) {
+			throw std::runtime_error("Training failed");
+		}
+		return train(lambda, train_data);
+	};
+	ASSERT_THROW(HyperparameterSearch::grid_search(X, y, lambdas, throwing_train, test, folds, 4), std::runtime_error);
+}
+
+TEST_F(HyperparameterSearchTest, random_search)
+{
+	const auto result = HyperparameterSearch::random_search(X, y, sample, 8, 42, train, test, folds);
+	ASSERT_EQ(8u, result.candidates.size());
+	for (const double lambda : result.candidates) {
+		ASSERT_LE(1e-3, lambda);
+		ASSERT_GE(1e3, lambda);
+	}
+	const auto grid_result = HyperparameterSearch::grid_search(X, y, result.candidates, train, test, folds);
+	ASSERT_EQ(grid_result.errors, result.errors);
+	ASSERT_EQ(grid_result.best, result.best);
+	const auto parallel_result = HyperparameterSearch::random_search(X, y, sample, 8, 42, train, test, folds, 3);
+	ASSERT_EQ(result.candidates, parallel_result.candidates);
+	ASSERT_EQ(result.errors, parallel_result.errors);
+	ASSERT_NE(result.candidates, HyperparameterSearch::random_search(X, y, sample, 8, 43, train, test, folds).candidates);
+}
+
+TEST_F(HyperparameterSearchTest, successive_halving)
+{
+	const std::vector<double> lambdas({ 1e-3, 1e-2, 1e-1, 1, 10, 100, 1e3, 1e4, 1e5 });
+	const auto result = HyperparameterSearch::successive_halving(X, y, lambdas, train, test, folds, 3, 1);
+	// 9 candidates on 1 fold, 3 on 3 folds, 1 on 6 folds.
+	ASSERT_EQ(9u + 3u * 2u + 3u, result.number_trainings);
+	ASSERT_EQ(6u, result.number_folds[result.best]);
+	unsigned int number_on_3_folds = 0;
+	for (size_t i = 0; i < lambdas.size(); ++i) {
+		if (result.number_folds[i] == 3) {
+			++number_on_3_folds;
+		} else if (i != result.best) {
+			ASSERT_EQ(1u, result.number_folds[i]) << i;
+		}
+	}
+	ASSERT_EQ(2u, number_on_3_folds);
+	const auto grid_result = HyperparameterSearch::grid_search(X, y, lambdas, train, test, folds);
+	ASSERT_EQ(grid_result.errors[result.best], result.best_error());
+	// Strongly regularised candidates are dropped after the first stage.
+	ASSERT_EQ(1u, result.number_folds.back());
+	for (const unsigned int number_threads : { 0u, 4u }) {
+		const auto parallel_result = HyperparameterSearch::successive_halving(X, y, lambdas, train, test, folds, 3, 1, number_threads);
+		ASSERT_EQ(result.errors, parallel_result.errors) << number_threads;
+		ASSERT_EQ(result.number_folds, parallel_result.number_folds) << number_threads;
+	}
+	ASSERT_THROW(HyperparameterSearch::successive_halving(X, y, lambdas, train, test, folds, 1), std::invalid_argument);
+	ASSERT_THROW(HyperparameterSearch::successive_halving(X, y, lambdas, train, test, folds, 3, 0), std::invalid_argument);
+	ASSERT_THROW(HyperparameterSearch::successive_halving(X, y, std::vector<double>(), train, test, folds), std::invalid_argument);
+}
+
+TEST_F(HyperparameterSearchTest, hyperband)
+{
+	const auto result = HyperparameterSearch::hyperband(X, y, sample, 42, train, test, folds, 3);
+	// With 6 folds and eta = 3: 3 candidates starting on 2 folds, then 2 candidates on all folds.
+	ASSERT_EQ(5u, result.candidates.size());
+	ASSERT_EQ(3u * 2u + 4u + 2u * 6u, result.number_trainings);
+	const auto random_result = HyperparameterSearch::random_search(X, y, sample, 5, 42, train, test, folds);
+	ASSERT_EQ(random_result.candidates, result.candidates);
+	for (size_t i = 0; i < result.candidates.size(); ++i) {
+		if (result.number_folds[i] == 6) {
+			ASSERT_EQ(random_result.errors[i], result.errors[i]) << i;
+			ASSERT_LE(result.best_error(), result.errors[i]) << i;
+		} else {
+			ASSERT_EQ(2u, result.number_folds[i]) << i;
+		}
+	}
+	const auto parallel_result = HyperparameterSearch::hyperband(X, y, sample, 42, train, test, folds, 3, 5);
+	ASSERT_EQ(result.candidates, parallel_result.candidates);
+	ASSERT_EQ(result.errors, parallel_result.errors);
+	ASSERT_EQ(result.best, parallel_result.best);
+	ASSERT_THROW(HyperparameterSearch::hyperband(X, y, sample, 42, train, test, folds, 1), std::invalid_argument);
+}
@@ -1,4 +1,6 @@
 /* (C) 2021 Roman Werpachowski. */
+#include <algorithm>
+#include <limits>
 #include <random>
 #include <gtest/gtest.h>
 #include "ML/Clustering.hpp"
@@ -105,6 +107,11 @@ TEST(KMeansTest, two_gaussians_kpp)
 	test_two_gaussians(std::make_shared<ml::Clustering::KPP>());
 }
 
+TEST(KMeansTest, two_gaussians_scalable_kpp)
+{
+	test_two_gaussians(std::make_shared<ml::Clustering::ScalableKPP>());
+}
+
 TEST(KMeansTest, deterministic)
 {
 	const unsigned int num_clusters = 2;
@@ -125,4 +132,321 @@ TEST(KMeansTest, deterministic)
 		ASSERT_EQ(i, km.labels()[i]) << i;
 		ASSERT_EQ(0, (km.centroids().col(i) - data.col(i)).norm()) << i;
 	}
-}
\ No newline at end of file
+}
+
+static void test_algorithms_agree(const Eigen::Ref<const Eigen::MatrixXd> data, const unsigned int num_clusters, std::shared_ptr<const ml::Clustering::CentroidsInitialiser> centroids_initialiser, const unsigned int number_initialisations)
+{
+	const auto fit = [&](const ml::Clustering::KMeansAlgorithm algorithm) {
+		ml::Clustering::KMeans km(num_clusters);
+		km.set_algorithm(algorithm);
+		km.set_centroids_initialiser(centroids_initialiser);
+		km.set_number_initialisations(number_initialisations);
+		km.set_absolute_tolerance(0);
+		km.set_maximum_steps(200);
+		km.set_seed(1234);
+		km.fit(data);
+		return km;
+	};
+	const auto lloyd = fit(ml::Clustering::KMeansAlgorithm::LLOYD);
+	ASSERT_TRUE(lloyd.converged());
+	for (const auto algorithm : { ml::Clustering::KMeansAlgorithm::HAMERLY, ml::Clustering::KMeansAlgorithm::ELKAN }) {
+		const auto km = fit(algorithm);
+		const auto name = algorithm == ml::Clustering::KMeansAlgorithm::HAMERLY ? "Hamerly" : "Elkan";
+		ASSERT_TRUE(km.converged()) << name;
+		ASSERT_EQ(lloyd.labels(), km.labels()) << name;
+		ASSERT_EQ(lloyd.inertia(), km.inertia()) << name;
+		ASSERT_EQ(lloyd.centroids(), km.centroids()) << name;
+	}
+	// Points are added up in a different order, so the centroids can differ by rounding errors.
+	const auto filtering = fit(ml::Clustering::KMeansAlgorithm::FILTERING);
+	ASSERT_TRUE(filtering.converged());
+	ASSERT_EQ(lloyd.labels(), filtering.labels());
+	ASSERT_NEAR(lloyd.inertia(), filtering.inertia(), 1e-12 * lloyd.inertia());
+	ASSERT_NEAR(0, (lloyd.centroids() - filtering.centroids()).norm(), 1e-12 * lloyd.centroids().norm());
+}
+
+TEST(KMeansTest, accelerated_algorithms)
+{
+	std::default_random_engine rng(42);
+	std::normal_distribution<double> standard_normal;
+	const unsigned int num_dimensions = 4;
+	const unsigned int num_clusters = 20;
+	const unsigned int sample_size = 3000;
+	const Eigen::MatrixXd centres(5 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (unsigned int i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+	test_algorithms_agree(data, num_clusters, std::make_shared<ml::Clustering::KPP>(), 1);
+	test_algorithms_agree(data, num_clusters, std::make_shared<ml::Clustering::Forgy>(), 3);
+	test_algorithms_agree(data, 1, std::make_shared<ml::Clustering::Forgy>(), 1);
+	// Points on an integer grid, with many ties between distances to centroids.
+	Eigen::MatrixXd grid_data(2, 400);
+	for (unsigned int i = 0; i < 400; ++i) {
+		grid_data(0, i) = static_cast<double>(i % 10);
+		grid_data(1, i) = static_cast<double>((i / 10) % 10);
+	}
+	test_algorithms_agree(grid_data, 7, std::make_shared<ml::Clustering::Forgy>(), 2);
+	test_algorithms_agree(grid_data, 16, std::make_shared<ml::Clustering::RandomPartition>(), 1);
+	// Large common offset: the coordinates are rounded to much less than the relative precision of the distances.
+	const Eigen::MatrixXd offset_data(data.array() + 1e8);
+	test_algorithms_agree(offset_data, num_clusters, std::make_shared<ml::Clustering::Forgy>(), 2);
+	// Stopped before convergence: labels and inertia refer to the centroids before the last update.
+	const auto fit_three_steps = [&](const ml::Clustering::KMeansAlgorithm algorithm) {
+		ml::Clustering::KMeans km(num_clusters);
+		km.set_algorithm(algorithm);
+		km.set_maximum_steps(3);
+		km.set_seed(7);
+		km.fit(data);
+		return km;
+	};
+	const auto lloyd = fit_three_steps(ml::Clustering::KMeansAlgorithm::LLOYD);
+	const auto filtering = fit_three_steps(ml::Clustering::KMeansAlgorithm::FILTERING);
+	ASSERT_FALSE(lloyd.converged());
+	ASSERT_FALSE(filtering.converged());
+	ASSERT_EQ(lloyd.labels(), filtering.labels());
+	ASSERT_NEAR(lloyd.inertia(), filtering.inertia(), 1e-12 * lloyd.inertia());
+}
+
+static void test_find_closest_centroids(const Eigen::Ref<const Eigen::MatrixXd> data, const Eigen::Ref<const Eigen::MatrixXd> centroids)
+{
+	std::vector<unsigned int> labels;
+	Eigen::VectorXd squared_distances(data.cols());
+	ml::Clustering::find_closest_centroids(data, centroids, labels, squared_distances);
+	ASSERT_EQ(static_cast<size_t>(data.cols()), labels.size());
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		double min_squared_distance = std::numeric_limits<double>::infinity();
+		unsigned int label = 0;
+		for (Eigen::Index k = 0; k < centroids.cols(); ++k) {
+			const double squared_distance = (data.col(i) - centroids.col(k)).squaredNorm();
+			if (squared_distance < min_squared_distance) {
+				min_squared_distance = squared_distance;
+				label = static_cast<unsigned int>(k);
+			}
+		}
+		ASSERT_EQ(label, labels[static_cast<size_t>(i)]) << i;
+		ASSERT_EQ(min_squared_distance, squared_distances[i]) << i;
+	}
+}
+
+TEST(KMeansTest, find_closest_centroids)
+{
+	const Eigen::MatrixXd data(Eigen::MatrixXd::Random(20, 700));
+	test_find_closest_centroids(data, Eigen::MatrixXd::Random(20, 1));
+	test_find_closest_centroids(data, Eigen::MatrixXd::Random(20, 300));
+	test_find_closest_centroids(data, data.leftCols(300));
+	// Distances much smaller than norms: |x|^2 - 2 x^T c + |c|^2 suffers from cancellation.
+	const Eigen::MatrixXd offset_data((data.array() * 1e-4 + 1e4).matrix());
+	test_find_closest_centroids(offset_data, offset_data.leftCols(50));
+	test_find_closest_centroids(offset_data, (Eigen::MatrixXd::Random(20, 50).array() * 1e-4 + 1e4).matrix());
+	// Ties.
+	Eigen::MatrixXd grid_data(2, 400);
+	for (unsigned int i = 0; i < 400; ++i) {
+		grid_data(0, i) = static_cast<double>(i % 10);
+		grid_data(1, i) = static_cast<double>((i / 10) % 10);
+	}
+	Eigen::MatrixXd grid_centroids(2, 4);
+	grid_centroids << 2, 6, 2, 2,
+		2, 2, 6, 2;
+	test_find_closest_centroids(grid_data, grid_centroids);
+	std::vector<unsigned int> labels;
+	Eigen::VectorXd squared_distances(700);
+	ASSERT_THROW(ml::Clustering::find_closest_centroids(data, Eigen::MatrixXd(20, 0), labels, squared_distances), std::invalid_argument);
+	ASSERT_THROW(ml::Clustering::find_closest_centroids(data, Eigen::MatrixXd::Random(19, 3), labels, squared_distances), std::invalid_argument);
+	ASSERT_THROW(ml::Clustering::find_closest_centroids(data, Eigen::MatrixXd::Random(20, 3), labels, squared_distances.head(699)), std::invalid_argument);
+}
+
+TEST(KMeansTest, number_threads)
+{
+	std::default_random_engine rng(7);
+	std::normal_distribution<double> standard_normal;
+	const unsigned int num_dimensions = 3;
+	const unsigned int num_clusters = 10;
+	const unsigned int sample_size = 20000;
+	const Eigen::MatrixXd centres(5 * Eigen::MatrixXd::Random(num_dimensions, num_clusters));
+	Eigen::MatrixXd data(num_dimensions, sample_size);
+	for (unsigned int i = 0; i < sample_size; ++i) {
+		for (unsigned int l = 0; l < num_dimensions; ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+	for (const auto algorithm : { ml::Clustering::KMeansAlgorithm::LLOYD, ml::Clustering::KMeansAlgorithm::HAMERLY, ml::Clustering::KMeansAlgorithm::ELKAN, ml::Clustering::KMeansAlgorithm::FILTERING }) {
+		const auto fit = [&](const unsigned int number_threads) {
+			ml::Clustering::KMeans km(num_clusters);
+			km.set_algorithm(algorithm);
+			km.set_number_threads(number_threads);
+			km.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+			km.set_seed(91);
+			km.fit(data);
+			return km;
+		};
+		const auto single_threaded = fit(1);
+		ASSERT_TRUE(single_threaded.converged());
+		for (const unsigned int number_threads : { 0u, 2u, 3u, 8u }) {
+			const auto multi_threaded = fit(number_threads);
+			ASSERT_TRUE(multi_threaded.converged()) << number_threads;
+			ASSERT_EQ(single_threaded.labels(), multi_threaded.labels()) << number_threads;
+			ASSERT_EQ(single_threaded.inertia(), multi_threaded.inertia()) << number_threads;
+			ASSERT_EQ(single_threaded.centroids(), multi_threaded.centroids()) << number_threads;
+		}
+		// Centroids are the means of their clusters.
+		for (unsigned int k = 0; k < num_clusters; ++k) {
+			Eigen::VectorXd sum(Eigen::VectorXd::Zero(num_dimensions));
+			double count = 0;
+			for (unsigned int i = 0; i < sample_size; ++i) {
+				if (single_threaded.labels()[i] == k) {
+					sum += data.col(i);
+					++count;
+				}
+			}
+			ASSERT_NEAR(0, (sum / count - single_threaded.centroids().col(k)).norm(), 1e-12) << k;
+		}
+	}
+}
+
+TEST(KMeansTest, multiple_initialisations)
+{
+	const Eigen::MatrixXd data(Eigen::MatrixXd::Random(2, 2000));
+	const auto fit = [&](const unsigned int number_initialisations, const unsigned int number_threads) {
+		ml::Clustering::KMeans km(12);
+		km.set_seed(5);
+		km.set_number_initialisations(number_initialisations);
+		km.set_number_threads(number_threads);
+		km.fit(data);
+		return km;
+	};
+	const auto single = fit(1, 1);
+	const auto multiple = fit(6, 1);
+	ASSERT_TRUE(multiple.converged());
+	ASSERT_LE(multiple.inertia(), single.inertia());
+	for (const unsigned int number_threads : { 0u, 2u, 6u, 16u }) {
+		const auto parallel = fit(6, number_threads);
+		ASSERT_EQ(multiple.inertia(), parallel.inertia()) << number_threads;
+		ASSERT_EQ(multiple.centroids(), parallel.centroids()) << number_threads;
+		ASSERT_EQ(multiple.labels(), parallel.labels()) << number_threads;
+	}
+}
+
+TEST(KMeansTest, centroids_initialisers)
+{
+	// 50 well separated clusters.
+	std::default_random_engine rng(3);
+	std::normal_distribution<double> standard_normal;
+	const unsigned int num_clusters = 50;
+	const Eigen::MatrixXd centres(100 * Eigen::MatrixXd::Random(4, num_clusters));
+	Eigen::MatrixXd data(4, 5000);
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		for (Eigen::Index l = 0; l < data.rows(); ++l) {
+			data(l, i) = centres(l, i % num_clusters) + 0.1 * standard_normal(rng);
+		}
+	}
+	const auto init = [&](const ml::Clustering::CentroidsInitialiser& initialiser, const Eigen::Ref<const Eigen::MatrixXd> X, const unsigned int number_components) {
+		std::default_random_engine prng(17);
+		Eigen::MatrixXd centroids(X.rows(), number_components);
+		initialiser.init(X, prng, number_components, centroids);
+		return centroids;
+	};
+	const auto count_distinct_data_points = [](const Eigen::Ref<const Eigen::MatrixXd> X, const Eigen::MatrixXd& centroids) {
+		std::vector<unsigned int> labels;
+		Eigen::VectorXd squared_distances(centroids.cols());
+		ml::Clustering::find_closest_centroids(centroids, X, labels, squared_distances);
+		std::sort(labels.begin(), labels.end());
+		EXPECT_EQ(0, squared_distances.maxCoeff());
+		return static_cast<size_t>(std::unique(labels.begin(), labels.end()) - labels.begin());
+	};
+	const auto count_clusters_found = [&](const Eigen::MatrixXd& centroids) {
+		std::vector<unsigned int> labels;
+		Eigen::VectorXd squared_distances(centroids.cols());
+		ml::Clustering::find_closest_centroids(centroids, centres, labels, squared_distances);
+		std::sort(labels.begin(), labels.end());
+		return static_cast<size_t>(std::unique(labels.begin(), labels.end()) - labels.begin());
+	};
+	const auto kpp_centroids = init(ml::Clustering::KPP(), data, num_clusters);
+	ASSERT_EQ(num_clusters, count_distinct_data_points(data, kpp_centroids));
+	ASSERT_LE(num_clusters - 2, count_clusters_found(kpp_centroids));
+	const auto scalable_kpp_centroids = init(ml::Clustering::ScalableKPP(), data, num_clusters);
+	ASSERT_EQ(num_clusters, count_distinct_data_points(data, scalable_kpp_centroids));
+	ASSERT_LE(num_clusters - 2, count_clusters_found(scalable_kpp_centroids));
+	for (const unsigned int number_threads : { 0u, 3u }) {
+		ASSERT_EQ(kpp_centroids, init(ml::Clustering::KPP(number_threads), data, num_clusters)) << number_threads;
+		ASSERT_EQ(scalable_kpp_centroids, init(ml::Clustering::ScalableKPP(2, 2, number_threads), data, num_clusters)) << number_threads;
+	}
+	// A single round with little oversampling leaves too few candidates, which are then added one by one.
+	ASSERT_EQ(num_clusters, count_distinct_data_points(data, init(ml::Clustering::ScalableKPP(0.1, 1), data, num_clusters)));
+	// Fewer distinct points than centroids.
+	const Eigen::MatrixXd duplicated(data.leftCols(3).replicate(1, 4));
+	for (const auto& centroids : { init(ml::Clustering::KPP(), duplicated, 5), init(ml::Clustering::ScalableKPP(), duplicated, 5) }) {
+		ASSERT_EQ(3u, count_distinct_data_points(duplicated, centroids));
+	}
+	ASSERT_THROW(ml::Clustering::ScalableKPP(0), std::domain_error);
+	ASSERT_THROW(ml::Clustering::ScalableKPP(-1), std::domain_error);
+	ASSERT_THROW(ml::Clustering::ScalableKPP(2, 0), std::invalid_argument);
+}
+
+TEST(KMeansTest, weights)
+{
+	std::default_random_engine rng(11);
+	std::normal_distribution<double> standard_normal;
+	const unsigned int num_clusters = 3;
+	Eigen::MatrixXd centres(2, num_clusters);
+	centres << 0, 10, 0,
+		0, 0, 10;
+	Eigen::MatrixXd data(2, 300);
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		for (Eigen::Index l = 0; l < data.rows(); ++l) {
+			data(l, i) = centres(l, i % num_clusters) + standard_normal(rng);
+		}
+	}
+	Eigen::VectorXd weights(data.cols());
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		weights[i] = static_cast<double>(i % 4);
+	}
+	// Data points repeated as many times as their weights.
+	Eigen::MatrixXd replicated(2, static_cast<Eigen::Index>(weights.sum()));
+	Eigen::Index j = 0;
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		for (int n = 0; n < static_cast<int>(weights[i]); ++n) {
+			replicated.col(j++) = data.col(i);
+		}
+	}
+	for (const auto algorithm : { ml::Clustering::KMeansAlgorithm::LLOYD, ml::Clustering::KMeansAlgorithm::HAMERLY, ml::Clustering::KMeansAlgorithm::ELKAN, ml::Clustering::KMeansAlgorithm::FILTERING }) {
+		const auto make_kmeans = [algorithm](const unsigned int number_initialisations) {
+			ml::Clustering::KMeans km(num_clusters);
+			km.set_seed(4);
+			km.set_algorithm(algorithm);
+			km.set_number_initialisations(number_initialisations);
+			return km;
+		};
+		// Unit weights are the same as no weights (Forgy initialisation ignores the weights).
+		auto unweighted = make_kmeans(1);
+		auto unit_weighted = make_kmeans(1);
+		ASSERT_TRUE(unweighted.fit(data));
+		ASSERT_TRUE(unit_weighted.fit(data, Eigen::VectorXd::Ones(data.cols())));
+		ASSERT_EQ(unweighted.labels(), unit_weighted.labels());
+		ASSERT_NEAR(0, (unweighted.centroids() - unit_weighted.centroids()).norm(), 1e-12);
+		ASSERT_NEAR(unweighted.inertia(), unit_weighted.inertia(), 1e-10 * unweighted.inertia());
+
+		// Integer weights give the same clusters as replicated points (the weighted K++ initialisation draws different points).
+		auto weighted = make_kmeans(5);
+		auto repeated = make_kmeans(5);
+		weighted.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+		repeated.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+		ASSERT_TRUE(weighted.fit(data, weights));
+		ASSERT_TRUE(repeated.fit(replicated));
+		ASSERT_NEAR(repeated.inertia(), weighted.inertia(), 1e-10 * repeated.inertia());
+		for (Eigen::Index k = 0; k < num_clusters; ++k) {
+			ASSERT_NEAR(0, (repeated.centroids().colwise() - weighted.centroids().col(k)).colwise().norm().minCoeff(), 1e-10) << k;
+		}
+		// Inertia() is weighted, labels() are for all points.
+		ASSERT_EQ(static_cast<size_t>(data.cols()), weighted.labels().size());
+	}
+
+	ml::Clustering::KMeans km(num_clusters);
+	ASSERT_THROW(km.fit(data, weights.head(10)), std::invalid_argument);
+	ASSERT_THROW(km.fit(data, -weights), std::domain_error);
+	ASSERT_THROW(km.fit(data, Eigen::VectorXd::Zero(data.cols())), std::domain_error);
+	weights[0] = std::numeric_limits<double>::infinity();
+	ASSERT_THROW(km.fit(data, weights), std::domain_error);
+}
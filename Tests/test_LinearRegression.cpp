@@ -1,10 +1,18 @@
 /* (C) 2020 Roman Werpachowski. */
+#include <algorithm>
 #include <cmath>
 #include <random>
 #include <Eigen/Eigenvalues>
 #include <gtest/gtest.h>
+#include "ML/ConjugateGradientRidge.hpp"
 #include "ML/LinearRegression.hpp"
+#include "ML/LinearRegressionCrossvalidation.hpp"
+#include "ML/MixedPrecisionOLS.hpp"
 #include "ML/RecursiveMultivariateOLS.hpp"
+#include "ML/RecursiveOLSBank.hpp"
+#include "ML/SketchedOLS.hpp"
+#include "ML/SlidingWindowMultivariateOLS.hpp"
+#include "ML/StepwiseSelection.hpp"
 #include "ML/Statistics.hpp"
 
 using namespace ml::LinearRegression;
@@ -459,6 +467,65 @@ TEST_F(LinearRegressionTest, univariate_true_model_regular)
 	EXPECT_NEAR(covariance, result.cov_slope_intercept, 2e-6);
 }
 
+static void test_batch_result(const UnivariateOLSResult& expected, const UnivariateOLSResult& actual, const double tol)
+{
+	ASSERT_EQ(expected.n, actual.n);
+	ASSERT_EQ(expected.dof, actual.dof);
+	ASSERT_NEAR(expected.slope, actual.slope, tol);
+	ASSERT_NEAR(expected.intercept, actual.intercept, tol);
+	ASSERT_NEAR(expected.rss, actual.rss, tol);
+	ASSERT_NEAR(expected.tss, actual.tss, tol);
+	ASSERT_NEAR(expected.var_slope, actual.var_slope, tol);
+	ASSERT_NEAR(expected.var_intercept, actual.var_intercept, tol);
+	ASSERT_NEAR(expected.cov_slope_intercept, actual.cov_slope_intercept, tol);
+}
+
+TEST_F(LinearRegressionTest, univariate_batch_errors)
+{
+	ASSERT_THROW(univariate_batch(Eigen::MatrixXd(4, 3), Eigen::MatrixXd(4, 2)), std::invalid_argument);
+	ASSERT_THROW(univariate_batch(Eigen::MatrixXd(4, 3), Eigen::MatrixXd(3, 3)), std::invalid_argument);
+	ASSERT_THROW(univariate_batch(Eigen::MatrixXd(1, 3), Eigen::MatrixXd(1, 3)), std::invalid_argument);
+	ASSERT_THROW(univariate_batch(0, 0.1, Eigen::MatrixXd(1, 3)), std::invalid_argument);
+	ASSERT_THROW(univariate_batch(0, 0, Eigen::MatrixXd(4, 3)), std::domain_error);
+	ASSERT_THROW(univariate_batch(0, -0.1, Eigen::MatrixXd(4, 3)), std::domain_error);
+}
+
+TEST_F(LinearRegressionTest, univariate_batch)
+{
+	constexpr unsigned int n = 50;
+	constexpr unsigned int num_series = 13;
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(n, num_series));
+	const Eigen::MatrixXd Y((2 * X.array() + 0.3 * Eigen::ArrayXXd::Random(n, num_series)).matrix());
+	const auto results = univariate_batch(X, Y);
+	ASSERT_EQ(num_series, results.size());
+	ASSERT_EQ(n, results.n);
+	ASSERT_EQ(n - 2, results.dof);
+	for (unsigned int i = 0; i < num_series; ++i) {
+		const auto expected = univariate(X.col(i), Y.col(i));
+		const auto actual = results[i];
+		test_batch_result(expected, actual, 1e-13);
+		ASSERT_NEAR(expected.r2(), results.r2()[i], 1e-13) << i;
+		ASSERT_NEAR(expected.var_y(), results.var_y()[i], 1e-13) << i;
+	}
+	ASSERT_THROW(results[num_series], std::out_of_range);
+	ASSERT_THROW(results[-1], std::out_of_range);
+}
+
+TEST_F(LinearRegressionTest, univariate_batch_regular)
+{
+	constexpr unsigned int n = 40;
+	constexpr unsigned int num_series = 7;
+	constexpr double x0 = -0.4;
+	constexpr double dx = 0.15;
+	const Eigen::MatrixXd Y(Eigen::MatrixXd::Random(n, num_series));
+	const auto results = univariate_batch(x0, dx, Y);
+	ASSERT_EQ(num_series, results.size());
+	for (unsigned int i = 0; i < num_series; ++i) {
+		const auto expected = univariate(x0, dx, Y.col(i));
+		test_batch_result(expected, results[i], 1e-13);
+	}
+}
+
 TEST_F(LinearRegressionTest, univariate_without_intercept_errors)
 {
 	Eigen::VectorXd x(4);
@@ -580,6 +647,40 @@ TEST_F(LinearRegressionTest, multivariate_error)
 	ASSERT_THROW(multivariate(X, y), std::invalid_argument);
 }
 
+TEST_F(LinearRegressionTest, multivariate_with_intercept_errors)
+{
+	Eigen::MatrixXd X(3, 10);
+	Eigen::VectorXd y(9);
+	ASSERT_THROW(multivariate_with_intercept(X, y), std::invalid_argument);
+	X.resize(3, 3);
+	y.resize(3);
+	ASSERT_THROW(multivariate_with_intercept(X, y), std::invalid_argument);
+}
+
+TEST_F(LinearRegressionTest, multivariate_with_intercept)
+{
+	constexpr unsigned int d = 3;
+	// 1000 > block size used internally.
+	for (unsigned int n : {10u, 1000u}) {
+		Eigen::MatrixXd X0(Eigen::MatrixXd::Random(d, n));
+		X0.row(0) *= 2;
+		X0.row(1).array() += 5;
+		const Eigen::MatrixXd X(add_ones(X0));
+		const Eigen::VectorXd true_beta(Eigen::VectorXd::Random(d + 1));
+		const Eigen::VectorXd y(X.transpose() * true_beta + 0.1 * Eigen::VectorXd::Random(n));
+		const auto expected = multivariate(X, y);
+		const auto actual = multivariate_with_intercept(X0, y);
+		test_result(actual, 1e-14);
+		ASSERT_EQ(expected.n, actual.n);
+		ASSERT_EQ(expected.dof, actual.dof);
+		ASSERT_NEAR(expected.rss, actual.rss, 1e-14 * expected.rss);
+		ASSERT_NEAR(expected.tss, actual.tss, 1e-14 * expected.tss);
+		ASSERT_NEAR(0, (expected.beta - actual.beta).norm(), 1e-12) << actual.beta;
+		ASSERT_NEAR(0, (expected.cov - actual.cov).norm(), 1e-12 * expected.cov.norm()) << expected.cov << "\n\n" << actual.cov;
+		ASSERT_NEAR(0, (expected.predict(X) - actual.predict(X)).norm(), 1e-11);
+	}
+}
+
 TEST_F(LinearRegressionTest, multivariate_exact_fit)
 {
 	Eigen::MatrixXd X(2, 2);
@@ -775,6 +876,172 @@ TEST_F(LinearRegressionTest, recursive_multivariate_ols_errors)
 	ASSERT_THROW(rmols.update(X, y), std::invalid_argument);
 }
 
+TEST_F(LinearRegressionTest, recursive_ols_bank_errors)
+{
+	ASSERT_THROW(RecursiveOLSBank<3>(0), std::invalid_argument);
+	RecursiveOLSBank<3> bank(2);
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, 5));
+	const Eigen::VectorXd y(Eigen::VectorXd::Random(5));
+	ASSERT_THROW(bank.initialise(2, X, y), std::out_of_range);
+	ASSERT_THROW(bank.initialise(0, Eigen::MatrixXd::Random(2, 5), y), std::invalid_argument);
+	ASSERT_THROW(bank.initialise(0, X, Eigen::VectorXd::Random(4)), std::invalid_argument);
+	ASSERT_THROW(bank.initialise(0, X.leftCols(2), y.head(2)), std::invalid_argument);
+	ASSERT_THROW(bank.initialise(0, Eigen::MatrixXd::Zero(3, 5), y), std::domain_error);
+	bank.initialise(0, X, y);
+	ASSERT_THROW(bank.update(Eigen::MatrixXd::Random(3, 2), Eigen::VectorXd::Random(2)), std::logic_error);
+	bank.initialise(1, X, y);
+	ASSERT_THROW(bank.update(Eigen::MatrixXd::Random(3, 3), Eigen::VectorXd::Random(2)), std::invalid_argument);
+	ASSERT_THROW(bank.update(Eigen::MatrixXd::Random(3, 2), Eigen::VectorXd::Random(3)), std::invalid_argument);
+	ASSERT_THROW(bank.update(Eigen::MatrixXd::Random(4, 2), Eigen::VectorXd::Random(2)), std::invalid_argument);
+	ASSERT_THROW(bank.beta(2), std::out_of_range);
+}
+
+TEST_F(LinearRegressionTest, recursive_ols_bank)
+{
+	constexpr int d = 4;
+	// Not a multiple of the block size.
+	constexpr unsigned int number_models = 300;
+	constexpr unsigned int number_updates = 20;
+	std::vector<RecursiveMultivariateOLS> models;
+	RecursiveOLSBank<d> bank(number_models);
+	RecursiveOLSBank<d> parallel_bank(number_models);
+	for (unsigned int m = 0; m < number_models; ++m) {
+		const Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, d + m % 3));
+		const Eigen::VectorXd y(Eigen::VectorXd::Random(X.cols()));
+		models.emplace_back(X, y);
+		bank.initialise(m, X, y);
+		parallel_bank.initialise(m, X, y);
+		ASSERT_EQ(models[m].n(), bank.n(m));
+		ASSERT_NEAR(0, (models[m].beta() - bank.beta(m)).norm(), 1e-12 * models[m].beta().norm());
+	}
+	for (unsigned int i = 0; i < number_updates; ++i) {
+		const Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, number_models));
+		Eigen::VectorXd y(Eigen::VectorXd::Random(number_models));
+		// Every 7th model skips this update.
+		for (unsigned int m = i % 7; m < number_models; m += 7) {
+			y[m] = std::numeric_limits<double>::quiet_NaN();
+		}
+		bank.update(X, y);
+		parallel_bank.update(X, y, 3);
+		for (unsigned int m = 0; m < number_models; ++m) {
+			if (!std::isnan(y[m])) {
+				models[m].update(X.col(m), y.segment(m, 1));
+			}
+		}
+	}
+	for (unsigned int m = 0; m < number_models; ++m) {
+		ASSERT_EQ(models[m].n(), bank.n(m)) << m;
+		ASSERT_NEAR(0, (models[m].beta() - bank.beta(m)).norm(), 1e-10 * models[m].beta().norm()) << m;
+		ASSERT_NEAR(0, (bank.P(m) - bank.P(m).transpose()).norm(), 0) << m;
+	}
+	ASSERT_EQ(bank.betas(), parallel_bank.betas());
+	ASSERT_EQ(number_models, static_cast<unsigned int>(bank.betas().rows()));
+}
+
+TEST_F(LinearRegressionTest, sliding_window_multivariate_ols_no_data)
+{
+	SlidingWindowMultivariateOLS swols(10);
+	ASSERT_EQ(0u, swols.n());
+	ASSERT_EQ(0u, swols.d());
+	ASSERT_EQ(10u, swols.window_size());
+	ASSERT_EQ(0, swols.beta().size());
+	ASSERT_TRUE(std::isnan(swols.rss()));
+	ASSERT_THROW(swols.result(), std::logic_error);
+}
+
+TEST_F(LinearRegressionTest, sliding_window_multivariate_ols_one_by_one)
+{
+	constexpr unsigned int d = 4;
+	constexpr unsigned int window_size = 12;
+	constexpr unsigned int total_n = 100;
+	const Eigen::VectorXd true_beta(Eigen::VectorXd::Random(d));
+	const Eigen::MatrixXd all_X = Eigen::MatrixXd::Random(d, total_n);
+	const Eigen::VectorXd all_y = all_X.transpose() * true_beta + 0.1 * Eigen::VectorXd::Random(total_n);
+	SlidingWindowMultivariateOLS swols(window_size);
+	for (unsigned int i = 0; i < total_n; ++i) {
+		swols.update(all_X.col(i), all_y.segment(i, 1));
+		ASSERT_EQ(d, swols.d());
+		const unsigned int n = std::min(i + 1, window_size);
+		ASSERT_EQ(n, swols.n()) << i;
+		if (n < d) {
+			ASSERT_EQ(0, swols.beta().size()) << i;
+			ASSERT_THROW(swols.result(), std::logic_error);
+			continue;
+		}
+		const auto X = all_X.block(0, i + 1 - n, d, n);
+		const auto y = all_y.segment(i + 1 - n, n);
+		const auto expected = multivariate(X, y);
+		const auto actual = swols.result();
+		ASSERT_EQ(expected.n, actual.n) << i;
+		ASSERT_EQ(expected.dof, actual.dof) << i;
+		ASSERT_NEAR(0, (expected.beta - swols.beta()).norm(), 1e-10) << i;
+		ASSERT_NEAR(0, (expected.beta - actual.beta).norm(), 1e-10) << i;
+		ASSERT_NEAR(expected.rss, actual.rss, 1e-10) << i;
+		ASSERT_NEAR(expected.rss, swols.rss(), 1e-10) << i;
+		ASSERT_NEAR(expected.tss, actual.tss, 1e-12) << i;
+		if (expected.dof) {
+			ASSERT_NEAR(0, (expected.cov - actual.cov).norm(), 1e-10) << i;
+		} else {
+			ASSERT_TRUE(std::isnan(actual.cov(0, 0))) << i;
+		}
+	}
+}
+
+TEST_F(LinearRegressionTest, sliding_window_multivariate_ols_many_samples)
+{
+	constexpr unsigned int d = 5;
+	constexpr unsigned int window_size = 30;
+	const std::vector<unsigned int> sample_sizes({ 3, 10, 1, 40, 7, 25, 2 });
+	const unsigned int total_n = std::accumulate(sample_sizes.begin(), sample_sizes.end(), 0u);
+	const Eigen::VectorXd true_beta(Eigen::VectorXd::Random(d));
+	const Eigen::MatrixXd all_X = Eigen::MatrixXd::Random(d, total_n);
+	const Eigen::VectorXd all_y = all_X.transpose() * true_beta + 0.1 * Eigen::VectorXd::Random(total_n);
+	SlidingWindowMultivariateOLS swols(window_size);
+	unsigned int cumulative_n = 0;
+	for (const auto n : sample_sizes) {
+		swols.update(all_X.block(0, cumulative_n, d, n), all_y.segment(cumulative_n, n));
+		cumulative_n += n;
+		const unsigned int window_n = std::min(cumulative_n, window_size);
+		ASSERT_EQ(window_n, swols.n());
+		if (window_n >= d) {
+			const auto expected = multivariate(all_X.block(0, cumulative_n - window_n, d, window_n), all_y.segment(cumulative_n - window_n, window_n));
+			ASSERT_NEAR(0, (expected.beta - swols.beta()).norm(), 1e-10) << cumulative_n;
+			ASSERT_NEAR(expected.rss, swols.rss(), 1e-10) << cumulative_n;
+		}
+	}
+}
+
+TEST_F(LinearRegressionTest, sliding_window_multivariate_ols_singular_window)
+{
+	// The window is as large as the dimension, so repeating a point makes X * X^T singular.
+	constexpr unsigned int d = 2;
+	Eigen::MatrixXd X(d, 4);
+	X << 1, 0, 0, 1,
+		0, 1, 1, 0;
+	Eigen::VectorXd y(4);
+	y << 1, 2, 4, 3;
+	SlidingWindowMultivariateOLS swols(d);
+	swols.update(X.leftCols(2), y.head(2));
+	ASSERT_NEAR(0, (Eigen::Vector2d(1, 2) - swols.beta()).norm(), 1e-14);
+	swols.update(X.col(2), y.segment(2, 1));
+	ASSERT_EQ(0, swols.beta().size());
+	ASSERT_THROW(swols.result(), std::logic_error);
+	swols.update(X.col(3), y.segment(3, 1));
+	ASSERT_NEAR(0, (Eigen::Vector2d(3, 4) - swols.beta()).norm(), 1e-14);
+	ASSERT_NEAR(0, swols.rss(), 1e-14);
+}
+
+TEST_F(LinearRegressionTest, sliding_window_multivariate_ols_errors)
+{
+	ASSERT_THROW(SlidingWindowMultivariateOLS(0), std::invalid_argument);
+	SlidingWindowMultivariateOLS swols(5);
+	ASSERT_THROW(swols.update(Eigen::MatrixXd::Random(6, 10), Eigen::VectorXd::Random(10)), std::invalid_argument);
+	ASSERT_THROW(swols.update(Eigen::MatrixXd::Random(3, 10), Eigen::VectorXd::Random(9)), std::invalid_argument);
+	ASSERT_THROW(swols.update(Eigen::MatrixXd::Random(3, 0), Eigen::VectorXd::Random(0)), std::invalid_argument);
+	swols.update(Eigen::MatrixXd::Random(3, 2), Eigen::VectorXd::Random(2));
+	ASSERT_THROW(swols.update(Eigen::MatrixXd::Random(4, 2), Eigen::VectorXd::Random(2)), std::invalid_argument);
+}
+
 TEST_F(LinearRegressionTest, standardise_errors)
 {
 	Eigen::MatrixXd X;
@@ -879,8 +1146,12 @@ template <bool DoStandardise> void test_ridge_errors()
 	Eigen::MatrixXd X(3, 10);
 	Eigen::VectorXd y(9);
 	ASSERT_THROW(ridge<DoStandardise>(X, y, 1), std::invalid_argument);
-	X.resize(3, 2);
-	y.resize(2);
+	X = Eigen::MatrixXd::Random(3, 2);
+	y = Eigen::VectorXd::Random(2);
+	// More features than data points requires regularisation.
+	ASSERT_THROW(ridge<DoStandardise>(X, y, 0), std::invalid_argument);
+	X = Eigen::MatrixXd::Random(3, 1);
+	y = Eigen::VectorXd::Random(1);
 	ASSERT_THROW(ridge<DoStandardise>(X, y, 1), std::invalid_argument);
 	X = Eigen::MatrixXd::Random(3, 10);
 	y.resize(10);
@@ -1098,6 +1369,72 @@ TEST_F(LinearRegressionTest, ridge_do_standardise_nonzero_lambda)
 	ASSERT_EQ(0., (regularised.beta - regularised2.beta).norm());
 }
 
+TEST_F(LinearRegressionTest, ridge_effective_dof_and_covariance)
+{
+	constexpr unsigned int n = 50;
+	constexpr unsigned int d = 4;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	standardise(X);
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(d) + 0.1 * Eigen::VectorXd::Random(n));
+	const double lambda = 2;
+	const auto result = ridge<false>(X, y, lambda);
+	test_result(result);
+	// Direct formulas, using N x N and extra Q x Q matrices.
+	const Eigen::MatrixXd XXt(X * X.transpose());
+	const Eigen::MatrixXd inv_xxt_lambda((XXt + lambda * Eigen::MatrixXd::Identity(d, d)).inverse());
+	const double expected_effective_dof = n - (X.transpose() * inv_xxt_lambda * X).trace() - 1;
+	ASSERT_NEAR(expected_effective_dof, result.effective_dof, 1e-12);
+	const Eigen::MatrixXd expected_cov_slopes(result.var_y() * inv_xxt_lambda * XXt * inv_xxt_lambda);
+	ASSERT_NEAR(0, (expected_cov_slopes - result.cov.topLeftCorner(d, d)).norm(), 1e-14 * expected_cov_slopes.norm());
+	ASSERT_NEAR(result.var_y() / n, result.cov(d, d), 1e-16);
+	ASSERT_NEAR((y.array() - y.mean() - (X.transpose() * result.beta.head(d)).array()).square().sum(), result.rss, 1e-14);
+}
+
+template <bool DoStandardise> static void test_dual_ridge()
+{
+	constexpr unsigned int n = 20;
+	constexpr unsigned int d = 300;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	X.row(0) *= 3;
+	X.row(1).array() += 2;
+	Eigen::VectorXd means;
+	Eigen::VectorXd standard_deviations;
+	Eigen::MatrixXd standardised_X(X);
+	standardise(standardised_X, means, standard_deviations);
+	if (!DoStandardise) {
+		X = standardised_X;
+	}
+	const Eigen::VectorXd y(standardised_X.transpose() * Eigen::VectorXd::Random(d) / 10 + 0.1 * Eigen::VectorXd::Random(n) + Eigen::VectorXd::Constant(n, 0.3));
+	const double lambda = 0.5;
+	const auto result = ridge<DoStandardise>(X, y, lambda);
+	ASSERT_EQ(n, result.n);
+	ASSERT_EQ(0u, result.dof);
+	ASSERT_EQ(0, result.cov.size());
+	ASSERT_EQ(d + 1, static_cast<unsigned int>(result.beta.size()));
+	// Primal solution in standardised units, with a D x D matrix.
+	const Eigen::MatrixXd XXt_lambda(standardised_X * standardised_X.transpose() + lambda * Eigen::MatrixXd::Identity(d, d));
+	const Eigen::VectorXd standardised_slopes(XXt_lambda.ldlt().solve(standardised_X * y));
+	Eigen::VectorXd expected_slopes(standardised_slopes);
+	double expected_intercept = y.mean();
+	if (DoStandardise) {
+		expected_slopes.array() /= standard_deviations.array();
+		expected_intercept -= expected_slopes.dot(means);
+	}
+	ASSERT_NEAR(0, (expected_slopes - result.beta.head(d)).norm(), 1e-12);
+	ASSERT_NEAR(expected_intercept, result.beta[d], 1e-12);
+	ASSERT_NEAR((y - result.predict(X)).squaredNorm(), result.rss, 1e-14);
+	ASSERT_NEAR((y.array() - y.mean()).square().sum(), result.tss, 1e-14);
+	const double expected_effective_dof = n - (XXt_lambda.ldlt().solve(standardised_X * standardised_X.transpose())).trace() - 1;
+	ASSERT_NEAR(std::max(expected_effective_dof, 0.), result.effective_dof, 1e-12);
+	ASSERT_LT(0, result.effective_dof);
+}
+
+TEST_F(LinearRegressionTest, ridge_dual)
+{
+	test_dual_ridge<false>();
+	test_dual_ridge<true>();
+}
+
 TEST_F(LinearRegressionTest, ridge_covariance)
 {
 	constexpr unsigned int n = 1000;
@@ -1341,6 +1678,518 @@ TEST_F(LinearRegressionTest, lasso_do_standardise_zero_lambda)
 	ASSERT_NEAR(0, (expected.beta - actual.beta).norm(), tol) << actual.beta;	
 }
 
+TEST_F(LinearRegressionTest, do_standardise_without_copy)
+{
+	constexpr unsigned int n = 1000;
+	constexpr unsigned int d = 3;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	X.row(0) *= 2;
+	X.row(1).array() += 5;
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(d) + 0.1 * Eigen::VectorXd::Random(n) + Eigen::VectorXd::Constant(n, 0.3));
+	Eigen::MatrixXd standardised_X(X);
+	Eigen::VectorXd means;
+	Eigen::VectorXd standard_deviations;
+	standardise(standardised_X, means, standard_deviations);
+	const double lambda = 0.5;
+	const auto ridge_actual = ridge<true>(X, y, lambda);
+	const auto ridge_standardised = ridge<false>(standardised_X, y, lambda);
+	test_result(ridge_actual, 1e-14);
+	ASSERT_NEAR(ridge_standardised.rss, ridge_actual.rss, 1e-13 * ridge_standardised.rss);
+	ASSERT_NEAR(ridge_standardised.tss, ridge_actual.tss, 1e-13 * ridge_standardised.tss);
+	ASSERT_NEAR(ridge_standardised.effective_dof, ridge_actual.effective_dof, 1e-10);
+	ASSERT_NEAR(0, (ridge_standardised.predict(standardised_X) - ridge_actual.predict(X)).norm(), 1e-12);
+	ASSERT_NEAR(ridge_standardised.cov(d, d) + means.dot(ridge_actual.cov.topLeftCorner(d, d) * means), ridge_actual.cov(d, d), 1e-14);
+	ASSERT_NEAR(0, (ridge_standardised.cov.topLeftCorner(d, d).diagonal().array() / standard_deviations.array().square() - ridge_actual.cov.topLeftCorner(d, d).diagonal().array()).matrix().norm(), 1e-14);
+	const auto lasso_actual = lasso<true>(X, y, lambda);
+	const auto lasso_standardised = lasso<false>(standardised_X, y, lambda);
+	test_result(lasso_actual, 1e-14);
+	ASSERT_NEAR(lasso_standardised.rss, lasso_actual.rss, 1e-12 * lasso_standardised.rss);
+	ASSERT_NEAR(lasso_standardised.effective_dof, lasso_actual.effective_dof, 1e-15);
+	ASSERT_NEAR(0, (lasso_standardised.predict(standardised_X) - lasso_actual.predict(X)).norm(), 1e-10);
+	Eigen::MatrixXd constant_row_X(X);
+	constant_row_X.row(2).setConstant(1);
+	ASSERT_THROW(ridge<true>(constant_row_X, y, lambda), std::invalid_argument);
+	ASSERT_THROW(lasso<true>(constant_row_X, y, lambda), std::invalid_argument);
+}
+
+template <class R> static void test_multi_target_result(const R& expected, const R& actual, const double tol)
+{
+	ASSERT_EQ(expected.n, actual.n);
+	ASSERT_EQ(expected.dof, actual.dof);
+	ASSERT_NEAR(expected.rss, actual.rss, tol * expected.rss);
+	ASSERT_NEAR(expected.tss, actual.tss, tol * expected.tss);
+	ASSERT_NEAR(0, (expected.beta - actual.beta).norm(), tol * expected.beta.norm()) << actual.beta;
+}
+
+TEST_F(LinearRegressionTest, multi_target_errors)
+{
+	ASSERT_THROW(multivariate_multi_target(Eigen::MatrixXd::Random(3, 10), Eigen::MatrixXd::Random(9, 2)), std::invalid_argument);
+	ASSERT_THROW(multivariate_multi_target(Eigen::MatrixXd::Random(3, 2), Eigen::MatrixXd::Random(2, 2)), std::invalid_argument);
+	ASSERT_THROW(multivariate_multi_target(Eigen::MatrixXd::Random(3, 10), Eigen::MatrixXd::Random(10, 0)), std::invalid_argument);
+	ASSERT_THROW(ridge_multi_target<false>(Eigen::MatrixXd::Random(3, 10), Eigen::MatrixXd::Random(9, 2), 1), std::invalid_argument);
+	ASSERT_THROW(ridge_multi_target<true>(Eigen::MatrixXd::Random(3, 10), Eigen::MatrixXd::Random(10, 2), -1), std::domain_error);
+	ASSERT_THROW(lasso_multi_target<false>(Eigen::MatrixXd::Random(3, 2), Eigen::MatrixXd::Random(2, 2), 1), std::invalid_argument);
+	ASSERT_THROW(lasso_multi_target<true>(Eigen::MatrixXd::Random(3, 10), Eigen::MatrixXd::Random(10, 2), -1), std::domain_error);
+	const auto result = multivariate_multi_target(Eigen::MatrixXd::Random(3, 10), Eigen::MatrixXd::Random(10, 2));
+	ASSERT_THROW(result[2], std::out_of_range);
+	ASSERT_THROW(result[-1], std::out_of_range);
+}
+
+TEST_F(LinearRegressionTest, multi_target)
+{
+	constexpr unsigned int n = 300;
+	constexpr unsigned int d = 4;
+	constexpr unsigned int num_targets = 5;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	X.row(0) *= 2;
+	X.row(1).array() += 3;
+	const Eigen::MatrixXd Y(X.transpose() * Eigen::MatrixXd::Random(d, num_targets) + 0.1 * Eigen::MatrixXd::Random(n, num_targets) + Eigen::MatrixXd::Constant(n, num_targets, 0.5));
+	Eigen::MatrixXd standardised_X(X);
+	standardise(standardised_X);
+	const double lambda = 0.3;
+	const auto ols = multivariate_multi_target(X, Y);
+	const auto ridge_standardise = ridge_multi_target<true>(X, Y, lambda);
+	const auto ridge_standardised = ridge_multi_target<false>(standardised_X, Y, lambda);
+	const auto lasso_standardise = lasso_multi_target<true>(X, Y, lambda);
+	const auto lasso_standardised = lasso_multi_target<false>(standardised_X, Y, lambda);
+	for (const auto& results : std::initializer_list<const MultiTargetResult*>{ &ols, &ridge_standardise, &ridge_standardised, &lasso_standardise, &lasso_standardised }) {
+		ASSERT_EQ(num_targets, results->size());
+		ASSERT_EQ(n, results->n);
+		ASSERT_NEAR(0, (results->r2() - (1 - results->rss.array() / results->tss.array()).matrix()).norm(), 1e-15);
+		ASSERT_NEAR(0, (results->var_y() - results->rss / results->dof).norm(), 1e-15);
+	}
+	for (unsigned int i = 0; i < num_targets; ++i) {
+		const Eigen::VectorXd y(Y.col(i));
+		const auto ols_i = ols[i];
+		const auto ols_expected = multivariate(X, y);
+		test_multi_target_result(ols_expected, ols_i, 1e-12);
+		ASSERT_NEAR(0, (ols_expected.cov - ols_i.cov).norm(), 1e-12 * ols_expected.cov.norm());
+		const auto ridge_standardise_i = ridge_standardise[i];
+		const auto ridge_standardise_expected = ridge<true>(X, y, lambda);
+		test_multi_target_result(ridge_standardise_expected, ridge_standardise_i, 1e-12);
+		ASSERT_NEAR(ridge_standardise_expected.effective_dof, ridge_standardise_i.effective_dof, 1e-12);
+		ASSERT_NEAR(0, (ridge_standardise_expected.cov - ridge_standardise_i.cov).norm(), 1e-12 * ridge_standardise_expected.cov.norm());
+		const auto ridge_standardised_i = ridge_standardised[i];
+		const auto ridge_standardised_expected = ridge<false>(standardised_X, y, lambda);
+		test_multi_target_result(ridge_standardised_expected, ridge_standardised_i, 1e-12);
+		ASSERT_NEAR(ridge_standardised_expected.effective_dof, ridge_standardised_i.effective_dof, 1e-12);
+		ASSERT_NEAR(0, (ridge_standardised_expected.cov - ridge_standardised_i.cov).norm(), 1e-12 * ridge_standardised_expected.cov.norm());
+		const auto lasso_standardise_i = lasso_standardise[i];
+		const auto lasso_standardise_expected = lasso<true>(X, y, lambda);
+		test_multi_target_result(lasso_standardise_expected, lasso_standardise_i, 1e-10);
+		ASSERT_EQ(lasso_standardise_expected.effective_dof, lasso_standardise_i.effective_dof);
+		const auto lasso_standardised_i = lasso_standardised[i];
+		const auto lasso_standardised_expected = lasso<false>(standardised_X, y, lambda);
+		test_multi_target_result(lasso_standardised_expected, lasso_standardised_i, 1e-10);
+		ASSERT_EQ(lasso_standardised_expected.effective_dof, lasso_standardised_i.effective_dof);
+	}
+}
+
+TEST_F(LinearRegressionTest, ridge_conjugate_gradient_errors)
+{
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, 10));
+	ASSERT_THROW(ridge_conjugate_gradient(X, Eigen::VectorXd::Random(9), 1), std::invalid_argument);
+	ASSERT_THROW(ridge_conjugate_gradient(X, Eigen::VectorXd::Random(10), -1), std::domain_error);
+	ASSERT_THROW(ridge_conjugate_gradient(X, Eigen::VectorXd::Random(10), 1, 0), std::invalid_argument);
+	ASSERT_THROW(ridge_conjugate_gradient(Eigen::MatrixXd(0, 10), Eigen::VectorXd::Random(10), 1), std::invalid_argument);
+	ASSERT_THROW(ridge_conjugate_gradient(Eigen::MatrixXd(3, 1), Eigen::VectorXd::Random(1), 1), std::invalid_argument);
+	ASSERT_THROW(ridge_conjugate_gradient(Eigen::SparseMatrix<double>(3, 10), Eigen::VectorXd::Random(9), 1), std::invalid_argument);
+}
+
+TEST_F(LinearRegressionTest, ridge_conjugate_gradient_dense)
+{
+	constexpr unsigned int n = 200;
+	constexpr unsigned int d = 20;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	standardise(X);
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(d) + 0.1 * Eigen::VectorXd::Random(n) + Eigen::VectorXd::Constant(n, 0.4));
+	const double lambda = 2;
+	const auto expected = ridge<false>(X, y, lambda);
+	const auto actual = ridge_conjugate_gradient(X, y, lambda, 1e-14);
+	test_result(actual, 1e-14);
+	ASSERT_TRUE(actual.converged);
+	ASSERT_GE(d, actual.iterations);
+	ASSERT_GE(1e-14, actual.relative_residual);
+	ASSERT_TRUE(std::isnan(actual.effective_dof));
+	ASSERT_EQ(expected.n, actual.n);
+	ASSERT_EQ(expected.dof, actual.dof);
+	ASSERT_NEAR(expected.rss, actual.rss, 1e-12 * expected.rss);
+	ASSERT_NEAR(expected.tss, actual.tss, 1e-14 * expected.tss);
+	ASSERT_NEAR(0, (expected.beta - actual.beta).norm(), 1e-12) << actual.beta;
+	// Early termination.
+	const auto early = ridge_conjugate_gradient(X, y, lambda, 1e-14, 2);
+	ASSERT_FALSE(early.converged);
+	ASSERT_EQ(2u, early.iterations);
+	ASSERT_LT(1e-14, early.relative_residual);
+	ASSERT_LE(expected.rss, early.rss);
+	const auto loose = ridge_conjugate_gradient(X, y, lambda, 1e-2);
+	ASSERT_TRUE(loose.converged);
+	ASSERT_GE(actual.iterations, loose.iterations);
+	ASSERT_GE(1e-2, loose.relative_residual);
+}
+
+TEST_F(LinearRegressionTest, ridge_conjugate_gradient_constant_feature)
+{
+	constexpr unsigned int n = 50;
+	Eigen::MatrixXd X(3, n);
+	X.row(0) = Eigen::RowVectorXd::Random(n);
+	X.row(1).setConstant(1e3);
+	X.row(2) = Eigen::RowVectorXd::Random(n);
+	const Eigen::VectorXd y(2 * X.row(0).transpose() - X.row(2).transpose() + 0.1 * Eigen::VectorXd::Random(n));
+	Eigen::MatrixXd varying_X(2, n);
+	varying_X << X.row(0), X.row(2);
+	const auto expected = ridge_conjugate_gradient(varying_X, y, 0, 1e-14);
+	const auto actual = ridge_conjugate_gradient(X, y, 0, 1e-14);
+	ASSERT_TRUE(actual.beta.allFinite()) << actual.beta;
+	ASSERT_TRUE(actual.converged);
+	ASSERT_EQ(0, actual.beta[1]);
+	ASSERT_NEAR(expected.beta[0], actual.beta[0], 1e-12);
+	ASSERT_NEAR(expected.beta[1], actual.beta[2], 1e-12);
+	ASSERT_NEAR(expected.beta[2], actual.beta[3], 1e-12);
+	ASSERT_NEAR(expected.rss, actual.rss, 1e-10 * expected.rss);
+	// Only constant features.
+	const auto constant = ridge_conjugate_gradient(X.middleRows(1, 1), y, 0, 1e-14);
+	ASSERT_TRUE(constant.converged);
+	ASSERT_EQ(0, constant.beta[0]);
+	ASSERT_NEAR(y.mean(), constant.beta[1], 1e-14);
+	// With a penalty, the constant feature is kept and its slope is 0 up to rounding errors.
+	const auto penalised = ridge_conjugate_gradient(X, y, 1e-3, 1e-14);
+	ASSERT_TRUE(penalised.beta.allFinite()) << penalised.beta;
+	ASSERT_NEAR(0, penalised.beta[1], 1e-6);
+}
+
+TEST_F(LinearRegressionTest, ridge_conjugate_gradient_sparse)
+{
+	constexpr unsigned int n = 300;
+	constexpr unsigned int d = 50;
+	std::default_random_engine rng(3409324);
+	std::uniform_int_distribution<unsigned int> feature_dist(0, d - 1);
+	std::uniform_real_distribution<double> value_dist(-1, 1);
+	std::vector<Eigen::Triplet<double>> triplets;
+	for (unsigned int i = 0; i < n; ++i) {
+		for (unsigned int k = 0; k < 4; ++k) {
+			triplets.emplace_back(feature_dist(rng), i, value_dist(rng));
+		}
+	}
+	Eigen::SparseMatrix<double> sparse_X(d, n);
+	sparse_X.setFromTriplets(triplets.begin(), triplets.end());
+	const Eigen::MatrixXd X(sparse_X);
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(d) + 0.1 * Eigen::VectorXd::Random(n) + Eigen::VectorXd::Constant(n, -0.2));
+	const double lambda = 0.5;
+	const auto sparse_result = ridge_conjugate_gradient(sparse_X, y, lambda, 1e-13);
+	const auto dense_result = ridge_conjugate_gradient(X, y, lambda, 1e-13);
+	test_result(sparse_result, 1e-14);
+	ASSERT_TRUE(sparse_result.converged);
+	ASSERT_NEAR(0, (dense_result.beta - sparse_result.beta).norm(), 1e-12);
+	// X is not centred, so compare with an explicit solution of the centred normal equations.
+	const Eigen::VectorXd means(X.rowwise().mean());
+	const Eigen::MatrixXd centred_X(X.colwise() - means);
+	const Eigen::VectorXd expected_slopes((centred_X * centred_X.transpose() + lambda * Eigen::MatrixXd::Identity(d, d)).ldlt().solve(centred_X * y));
+	ASSERT_NEAR(0, (expected_slopes - sparse_result.beta.head(d)).norm(), 1e-11);
+	ASSERT_NEAR(y.mean() - expected_slopes.dot(means), sparse_result.beta[d], 1e-12);
+	ASSERT_NEAR((y - sparse_result.predict(X)).squaredNorm(), sparse_result.rss, 1e-12);
+}
+
+TEST_F(LinearRegressionTest, multivariate_sketched_errors)
+{
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, 10));
+	ASSERT_THROW(multivariate_sketched(X, Eigen::VectorXd::Random(9)), std::invalid_argument);
+	ASSERT_THROW(multivariate_sketched(X, Eigen::VectorXd::Random(10), 2), std::invalid_argument);
+	ASSERT_THROW(multivariate_sketched(X, Eigen::VectorXd::Random(10), 0, 0), std::invalid_argument);
+	ASSERT_THROW(multivariate_sketched(Eigen::MatrixXd(0, 10), Eigen::VectorXd::Random(10)), std::invalid_argument);
+	ASSERT_THROW(multivariate_sketched(Eigen::MatrixXd::Random(3, 2), Eigen::VectorXd::Random(2)), std::invalid_argument);
+	Eigen::MatrixXd singular_X(X);
+	singular_X.row(2) = singular_X.row(0);
+	ASSERT_THROW(multivariate_sketched(singular_X, Eigen::VectorXd::Random(10)), std::domain_error);
+}
+
+TEST_F(LinearRegressionTest, multivariate_sketched)
+{
+	constexpr unsigned int n = 5000;
+	constexpr unsigned int d = 8;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	X.row(d - 1).setOnes();
+	// Make the problem moderately ill-conditioned.
+	X.row(1) = X.row(0) + 0.01 * X.row(1);
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(d) + 0.1 * Eigen::VectorXd::Random(n));
+	const auto expected = multivariate(X, y);
+	const auto refined = multivariate_sketched(X, y, 0, 1e-13, 50, 12);
+	test_result(refined, 1e-14);
+	ASSERT_TRUE(refined.converged) << refined.to_string();
+	ASSERT_GE(1e-13, refined.relative_residual);
+	ASSERT_LT(0u, refined.iterations);
+	ASSERT_EQ(expected.n, refined.n);
+	ASSERT_EQ(expected.dof, refined.dof);
+	ASSERT_NEAR(0, (expected.beta - refined.beta).norm(), 1e-10 * expected.beta.norm());
+	ASSERT_NEAR(expected.rss, refined.rss, 1e-12 * expected.rss);
+	ASSERT_NEAR((y - refined.predict(X)).squaredNorm(), refined.rss, 1e-10 * refined.rss);
+	ASSERT_NEAR(expected.tss, refined.tss, 1e-14 * expected.tss);
+	// The sketched X * X^T is an unbiased estimate of the exact one, so the covariance matrix is approximate.
+	ASSERT_NEAR(0, (expected.cov - refined.cov).norm(), 0.5 * expected.cov.norm());
+
+	// Sketch-and-solve without refinement.
+	const auto sketched = multivariate_sketched(X, y, 0, 1e-13, 0, 12);
+	test_result(sketched, 1e-14);
+	ASSERT_EQ(0u, sketched.iterations);
+	ASSERT_FALSE(sketched.converged);
+	ASSERT_TRUE(std::isnan(sketched.relative_residual));
+	ASSERT_EQ(refined.sketch_size, sketched.sketch_size);
+	ASSERT_LT(1e-10, (expected.beta - sketched.beta).norm());
+	ASSERT_NEAR(0, (expected.beta - sketched.beta).norm(), 0.5 * expected.beta.norm());
+	ASSERT_LE(expected.rss, (y - sketched.predict(X)).squaredNorm());
+	ASSERT_NEAR(expected.rss, sketched.rss, 0.5 * expected.rss);
+
+	// A larger sketch is more accurate.
+	const auto large_sketch = multivariate_sketched(X, y, 2000, 1e-13, 0, 12);
+	ASSERT_EQ(2000u, large_sketch.sketch_size);
+	ASSERT_GT((y - sketched.predict(X)).squaredNorm(), (y - large_sketch.predict(X)).squaredNorm());
+
+	// Same seed, same result; different seed, different sketch.
+	const auto repeated = multivariate_sketched(X, y, 0, 1e-13, 0, 12);
+	ASSERT_EQ(sketched.beta, repeated.beta);
+	const auto reseeded = multivariate_sketched(X, y, 0, 1e-13, 0, 13);
+	ASSERT_NE(sketched.beta, reseeded.beta);
+}
+
+TEST_F(LinearRegressionTest, forward_stepwise_errors)
+{
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, 10));
+	ASSERT_THROW(forward_stepwise(X, Eigen::VectorXd::Random(9), StepwiseCriterion::AIC), std::invalid_argument);
+	ASSERT_THROW(forward_stepwise(Eigen::MatrixXd(0, 10), Eigen::VectorXd::Random(10), StepwiseCriterion::AIC), std::invalid_argument);
+	ASSERT_THROW(forward_stepwise(Eigen::MatrixXd::Random(3, 1), Eigen::VectorXd::Random(1), StepwiseCriterion::AIC), std::invalid_argument);
+	ASSERT_THROW(forward_stepwise(X, Eigen::VectorXd::Random(10), StepwiseCriterion::AIC, 0, {3}), std::invalid_argument);
+	ASSERT_THROW(forward_stepwise(X, Eigen::VectorXd::Random(10), StepwiseCriterion::AIC, 0, {1, 1}), std::invalid_argument);
+	ASSERT_THROW(forward_stepwise(X, Eigen::VectorXd::Random(10), StepwiseCriterion::AIC, 1, {0, 1}), std::invalid_argument);
+	Eigen::MatrixXd collinear_X(X);
+	collinear_X.row(2) = 2 * collinear_X.row(0);
+	ASSERT_THROW(forward_stepwise(collinear_X, Eigen::VectorXd::Random(10), StepwiseCriterion::AIC, 0, {0, 2}), std::domain_error);
+}
+
+/** Forward selection by refitting multivariate() for every candidate. */
+static std::vector<unsigned int> brute_force_forward_stepwise(const Eigen::MatrixXd& X, const Eigen::VectorXd& y, const StepwiseCriterion criterion, const std::vector<unsigned int>& initial_features, std::vector<double>& criterion_values)
+{
+	const auto n = static_cast<double>(X.cols());
+	const auto evaluate = [&](const std::vector<unsigned int>& features) {
+		Eigen::MatrixXd sub_X(features.size(), X.cols());
+		for (size_t i = 0; i < features.size(); ++i) {
+			sub_X.row(i) = X.row(features[i]);
+		}
+		if (criterion == StepwiseCriterion::PRESS) {
+			return press(sub_X, y, multivariate);
+		}
+		const double rss = multivariate(sub_X, y).rss;
+		const double penalty = criterion == StepwiseCriterion::AIC ? 2 : std::log(n);
+		return n * std::log(rss / n) + penalty * static_cast<double>(features.size());
+	};
+	std::vector<unsigned int> features(initial_features);
+	criterion_values.assign(1, evaluate(features));
+	while (true) {
+		double best_value = criterion_values.back();
+		unsigned int best_j = static_cast<unsigned int>(X.rows());
+		for (unsigned int j = 0; j < X.rows(); ++j) {
+			if (std::find(features.begin(), features.end(), j) != features.end()) {
+				continue;
+			}
+			auto candidate(features);
+			candidate.push_back(j);
+			const double value = evaluate(candidate);
+			if (value < best_value) {
+				best_value = value;
+				best_j = j;
+			}
+		}
+		if (best_j == X.rows()) {
+			return features;
+		}
+		features.push_back(best_j);
+		criterion_values.push_back(best_value);
+	}
+}
+
+TEST_F(LinearRegressionTest, forward_stepwise)
+{
+	constexpr unsigned int n = 60;
+	constexpr unsigned int d = 12;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	X.row(0).setOnes();
+	Eigen::VectorXd true_beta(Eigen::VectorXd::Zero(d));
+	true_beta[0] = 0.5;
+	true_beta[3] = 2;
+	true_beta[7] = -1;
+	true_beta[10] = 0.4;
+	const Eigen::VectorXd y(X.transpose() * true_beta + 0.1 * Eigen::VectorXd::Random(n));
+	for (const auto criterion : {StepwiseCriterion::AIC, StepwiseCriterion::BIC, StepwiseCriterion::PRESS}) {
+		std::vector<double> expected_values;
+		const auto expected_features = brute_force_forward_stepwise(X, y, criterion, {0}, expected_values);
+		const auto actual = forward_stepwise(X, y, criterion, 0, {0});
+		ASSERT_EQ(expected_features, actual.features) << static_cast<int>(criterion);
+		ASSERT_EQ(expected_values.size(), actual.criterion_values.size());
+		for (size_t i = 0; i < expected_values.size(); ++i) {
+			ASSERT_NEAR(expected_values[i], actual.criterion_values[i], 1e-10 * std::abs(expected_values[i])) << i;
+		}
+		ASSERT_EQ(0u, actual.features[0]);
+		for (const unsigned int j : {3, 7, 10}) {
+			ASSERT_NE(actual.features.end(), std::find(actual.features.begin(), actual.features.end(), j)) << j;
+		}
+		Eigen::MatrixXd sub_X(actual.features.size(), n);
+		for (size_t i = 0; i < actual.features.size(); ++i) {
+			sub_X.row(i) = X.row(actual.features[i]);
+		}
+		const auto expected = multivariate(sub_X, y);
+		test_result(actual.regression, 1e-14);
+		ASSERT_EQ(expected.n, actual.regression.n);
+		ASSERT_EQ(expected.dof, actual.regression.dof);
+		ASSERT_NEAR(0, (expected.beta - actual.regression.beta).norm(), 1e-12);
+		ASSERT_NEAR(expected.rss, actual.regression.rss, 1e-12 * expected.rss);
+		ASSERT_NEAR(expected.tss, actual.regression.tss, 1e-12 * expected.tss);
+		ASSERT_NEAR(0, (expected.cov - actual.regression.cov).norm(), 1e-12 * expected.cov.norm());
+		// The number of threads does not change the outcome.
+		const auto parallel = forward_stepwise(X, y, criterion, 0, {0}, 3);
+		ASSERT_EQ(actual.features, parallel.features);
+		ASSERT_EQ(actual.criterion_values, parallel.criterion_values);
+	}
+	// Feature limit.
+	const auto limited = forward_stepwise(X, y, StepwiseCriterion::AIC, 2);
+	ASSERT_EQ(2u, limited.features.size());
+	ASSERT_EQ(3u, limited.features[0]);
+	ASSERT_EQ(3u, limited.criterion_values.size());
+	ASSERT_EQ(2, limited.regression.beta.size());
+}
+
+TEST_F(LinearRegressionTest, multivariate_mixed_precision_errors)
+{
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, 10));
+	ASSERT_THROW(multivariate_mixed_precision(X, Eigen::VectorXd::Random(9)), std::invalid_argument);
+	ASSERT_THROW(multivariate_mixed_precision(X, Eigen::VectorXd::Random(10), 0), std::invalid_argument);
+	ASSERT_THROW(multivariate_mixed_precision(Eigen::MatrixXd(0, 10), Eigen::VectorXd::Random(10)), std::invalid_argument);
+	ASSERT_THROW(multivariate_mixed_precision(Eigen::MatrixXd::Random(3, 2), Eigen::VectorXd::Random(2)), std::invalid_argument);
+}
+
+TEST_F(LinearRegressionTest, multivariate_mixed_precision)
+{
+	constexpr unsigned int n = 1000;
+	constexpr unsigned int d = 10;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	X.row(d - 1).setOnes();
+	const Eigen::VectorXd y(X.transpose() * Eigen::VectorXd::Random(d) + 0.1 * Eigen::VectorXd::Random(n));
+	const auto expected = multivariate(X, y);
+	const auto actual = multivariate_mixed_precision(X, y);
+	test_result(actual, 1e-14);
+	ASSERT_FALSE(actual.fell_back) << actual.to_string();
+	ASSERT_LT(1u, actual.iterations);
+	ASSERT_GE(5u, actual.iterations);
+	ASSERT_EQ(expected.n, actual.n);
+	ASSERT_EQ(expected.dof, actual.dof);
+	ASSERT_NEAR(0, (expected.beta - actual.beta).norm(), 1e-14 * expected.beta.norm());
+	ASSERT_NEAR(expected.rss, actual.rss, 1e-14 * expected.rss);
+	ASSERT_NEAR(expected.tss, actual.tss, 1e-14 * expected.tss);
+	// Single precision accuracy.
+	ASSERT_NEAR(0, (expected.cov - actual.cov).norm(), 1e-5 * expected.cov.norm());
+
+	// Refinement cut short.
+	const auto loose = multivariate_mixed_precision(X, y, 1e-4);
+	ASSERT_FALSE(loose.fell_back);
+	ASSERT_EQ(1u, loose.iterations);
+	ASSERT_NEAR(0, (expected.beta - loose.beta).norm(), 1e-8 * expected.beta.norm());
+	const auto no_refinement = multivariate_mixed_precision(X, y, 1e-14, 1);
+	ASSERT_TRUE(no_refinement.fell_back);
+	ASSERT_EQ(1u, no_refinement.iterations);
+	ASSERT_EQ(expected.beta, no_refinement.beta);
+	ASSERT_EQ(expected.cov, no_refinement.cov);
+
+	// Condition number too large for single precision.
+	Eigen::MatrixXd ill_conditioned_X(X);
+	ill_conditioned_X.row(1) = ill_conditioned_X.row(0) + 1e-5 * ill_conditioned_X.row(1);
+	const auto ill_conditioned = multivariate_mixed_precision(ill_conditioned_X, y);
+	ASSERT_TRUE(ill_conditioned.fell_back);
+	const auto ill_conditioned_expected = multivariate(ill_conditioned_X, y);
+	ASSERT_EQ(ill_conditioned_expected.beta, ill_conditioned.beta);
+	ASSERT_EQ(ill_conditioned_expected.rss, ill_conditioned.rss);
+}
+
+TEST_F(LinearRegressionTest, k_fold_from_moments_errors)
+{
+	const Eigen::MatrixXd X(Eigen::MatrixXd::Random(3, 10));
+	const Eigen::VectorXd y(Eigen::VectorXd::Random(10));
+	const Eigen::VectorXd lambdas(Eigen::Vector2d(0.1, 1));
+	ASSERT_THROW(k_fold_multivariate(X, y.head(9), 5), std::invalid_argument);
+	ASSERT_THROW(k_fold_multivariate(X, y, 11), std::invalid_argument);
+	ASSERT_THROW(k_fold_multivariate(X, y, std::vector<unsigned int>(10, 0)), std::invalid_argument);
+	ASSERT_THROW(k_fold_multivariate(X, y, std::vector<unsigned int>(9, 0)), std::invalid_argument);
+	// Training sets with fewer data points than features.
+	ASSERT_THROW(k_fold_multivariate(X, y, std::vector<unsigned int>({ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1 })), std::invalid_argument);
+	ASSERT_THROW(k_fold_ridge<true>(X, y, Eigen::VectorXd(), 5), std::invalid_argument);
+	ASSERT_THROW(k_fold_ridge<false>(X, y, Eigen::Vector2d(0.1, -1), 5), std::domain_error);
+	Eigen::MatrixXd constant_row_X(X);
+	constant_row_X.row(1).setConstant(2);
+	ASSERT_THROW(k_fold_ridge<true>(constant_row_X, y, lambdas, 5), std::invalid_argument);
+	Eigen::MatrixXd zero_row_X(X);
+	zero_row_X.row(1).setZero();
+	ASSERT_THROW(k_fold_ridge<false>(zero_row_X, y, Eigen::VectorXd::Zero(1), 5), std::domain_error);
+}
+
+TEST_F(LinearRegressionTest, k_fold_from_moments)
+{
+	constexpr unsigned int n = 500;
+	constexpr unsigned int d = 8;
+	constexpr unsigned int num_folds = 7;
+	Eigen::MatrixXd X(Eigen::MatrixXd::Random(d, n));
+	// Large offsets test the centring.
+	X.array().colwise() += Eigen::ArrayXd::LinSpaced(d, 0, 1e3);
+	const Eigen::VectorXd y(((X.array() - 500).matrix().transpose() * Eigen::VectorXd::Random(d)).array() + 10 + Eigen::ArrayXd::Random(n));
+	const Eigen::VectorXd lambdas(Eigen::Vector4d(0, 0.1, 10, 1000));
+	const Eigen::MatrixXd scaled_X(X / 1e3);
+	const auto tester = [](const auto& model, const Eigen::Ref<const Eigen::MatrixXd> test_X, const Eigen::Ref<const Eigen::VectorXd> test_y) -> double {
+		return (test_y - model.predict(test_X)).squaredNorm() / static_cast<double>(test_y.size());
+	};
+	std::vector<size_t> permutation(n);
+	for (size_t i = 0; i < n; ++i) {
+		permutation[i] = (i * 263) % n;
+	}
+	const auto shuffled_folds = ml::Crossvalidation::folds_from_permutation(permutation, num_folds);
+	for (const auto& folds : { ml::Crossvalidation::calc_contiguous_folds(n, num_folds), shuffled_folds }) {
+		// Reference values are calculated by fitting every training set from scratch.
+		const auto k_fold = [&](const auto train_func, const Eigen::Ref<const Eigen::MatrixXd> all_X) {
+			return ml::Crossvalidation::k_fold_view(all_X, y, [&](const ml::Crossvalidation::FoldView& train) {
+				return train_func(train.X(), train.y());
+			}, [&](const auto& model, const ml::Crossvalidation::FoldView& test) {
+				return tester(model, test.X(), test.y());
+			}, folds);
+		};
+		const double expected_ols = k_fold([](const Eigen::MatrixXd& train_X, const Eigen::VectorXd& train_y) {
+			return multivariate(train_X, train_y);
+		}, X);
+		const double actual_ols = k_fold_multivariate(X, y, folds);
+		ASSERT_NEAR(expected_ols, actual_ols, 1e-10 * expected_ols);
+		const Eigen::VectorXd actual_standardised(k_fold_ridge<true>(X, y, lambdas, folds));
+		const Eigen::VectorXd actual_unstandardised(k_fold_ridge<false>(scaled_X, y, lambdas.tail(3), folds));
+		ASSERT_EQ(lambdas.size(), actual_standardised.size());
+		for (Eigen::Index l = 0; l < lambdas.size(); ++l) {
+			const double expected = k_fold([&](const Eigen::MatrixXd& train_X, const Eigen::VectorXd& train_y) {
+				return ridge<true>(train_X, train_y, lambdas[l]);
+			}, X);
+			ASSERT_NEAR(expected, actual_standardised[l], 1e-10 * expected) << lambdas[l];
+			if (l) {
+				const double expected_unstandardised = k_fold([&](const Eigen::MatrixXd& train_X, const Eigen::VectorXd& train_y) {
+					return ridge<false>(train_X, train_y, lambdas[l]);
+				}, scaled_X);
+				ASSERT_NEAR(expected_unstandardised, actual_unstandardised[l - 1], 1e-10 * expected_unstandardised) << lambdas[l];
+			}
+		}
+		// Strong regularisation worsens the fit.
+		ASSERT_LT(actual_standardised[0], actual_standardised[3]);
+		for (const unsigned int number_threads : { 0u, 3u, 20u }) {
+			ASSERT_EQ(actual_ols, k_fold_multivariate(X, y, folds, number_threads)) << number_threads;
+			ASSERT_EQ(actual_standardised, k_fold_ridge<true>(X, y, lambdas, folds, number_threads)) << number_threads;
+		}
+	}
+	// The number of points is not a multiple of the number of folds, and rounding up the fold length would overrun the data.
+	const double expected_15_points = ml::Crossvalidation::k_fold(X.leftCols(15), y.head(15), [](const Eigen::Ref<const Eigen::MatrixXd> train_X, const Eigen::Ref<const Eigen::VectorXd> train_y) {
+		return multivariate(train_X, train_y);
+	}, tester, 10);
+	ASSERT_NEAR(expected_15_points, k_fold_multivariate(X.leftCols(15), y.head(15), 10), 1e-8 * expected_15_points);
+}
+
 TEST_F(LinearRegressionTest, multivariate_polynomial)
 {
 	constexpr unsigned int n = 101;
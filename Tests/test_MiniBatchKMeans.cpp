@@ -0,0 +1,112 @@
+/* (C) 2021 Roman Werpachowski. */
+#include <random>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "ML/KMeans.hpp"
+#include "ML/MiniBatchKMeans.hpp"
+
+class MiniBatchKMeansTest : public testing::Test
+{
+protected:
+	MiniBatchKMeansTest()
+		: centres(3, 4), data(3, 20000)
+	{
+		centres << 0, 5, 0, -5,
+			0, 0, 5, 5,
+			0, 1, -1, 2;
+		std::default_random_engine rng(23);
+		std::normal_distribution<double> standard_normal;
+		for (Eigen::Index i = 0; i < data.cols(); ++i) {
+			for (Eigen::Index l = 0; l < data.rows(); ++l) {
+				data(l, i) = centres(l, i % centres.cols()) + 0.5 * standard_normal(rng);
+			}
+		}
+	}
+
+	/// Checks that every true centre has a centroid close to it.
+	void check_centroids(const Eigen::MatrixXd& centroids, const double tolerance) const
+	{
+		ASSERT_EQ(centres.rows(), centroids.rows());
+		ASSERT_EQ(centres.cols(), centroids.cols());
+		for (Eigen::Index k = 0; k < centres.cols(); ++k) {
+			ASSERT_NEAR(0, (centroids.colwise() - centres.col(k)).colwise().norm().minCoeff(), tolerance) << k;
+		}
+	}
+
+	Eigen::MatrixXd centres;
+	Eigen::MatrixXd data;
+};
+
+TEST_F(MiniBatchKMeansTest, fit)
+{
+	ml::Clustering::MiniBatchKMeans mbkm(4, 256);
+	ASSERT_EQ(4u, mbkm.number_clusters());
+	ASSERT_FALSE(mbkm.converged());
+	mbkm.set_seed(1);
+	mbkm.set_maximum_steps(200);
+	mbkm.set_absolute_tolerance(1e-6);
+	ASSERT_TRUE(mbkm.fit(data));
+	ASSERT_TRUE(mbkm.converged());
+	check_centroids(mbkm.centroids(), 0.1);
+	ASSERT_EQ(static_cast<size_t>(data.cols()), mbkm.labels().size());
+	double inertia = 0;
+	for (Eigen::Index i = 0; i < data.cols(); ++i) {
+		const auto label_and_distance = mbkm.assign_label(data.col(i));
+		ASSERT_EQ(label_and_distance.first, mbkm.labels()[static_cast<size_t>(i)]) << i;
+		inertia += label_and_distance.second;
+	}
+	ASSERT_NEAR(inertia, mbkm.inertia(), 1e-8 * inertia);
+	ASSERT_LE(mbkm.counts().sum(), 200 * 256);
+
+	// Close to the inertia of full-batch K-means.
+	ml::Clustering::KMeans km(4);
+	km.set_centroids_initialiser(std::make_shared<ml::Clustering::KPP>());
+	ASSERT_TRUE(km.fit(data));
+	ASSERT_NEAR(km.inertia(), mbkm.inertia(), 1e-2 * km.inertia());
+
+	// Reproducible and independent of the number of threads.
+	ml::Clustering::MiniBatchKMeans mbkm2(4, 256);
+	mbkm2.set_seed(1);
+	mbkm2.set_maximum_steps(200);
+	mbkm2.set_absolute_tolerance(1e-6);
+	mbkm2.set_number_threads(3);
+	mbkm2.fit(data);
+	ASSERT_EQ(mbkm.centroids(), mbkm2.centroids());
+	ASSERT_EQ(mbkm.labels(), mbkm2.labels());
+
+	ASSERT_THROW(mbkm.fit(data.leftCols(3)), std::invalid_argument);
+	ASSERT_THROW(mbkm.fit(Eigen::MatrixXd(0, 10)), std::invalid_argument);
+}
+
+TEST_F(MiniBatchKMeansTest, partial_fit)
+{
+	ml::Clustering::MiniBatchKMeans mbkm(4, 100);
+	mbkm.set_seed(5);
+	const Eigen::Index chunk_size = 1000;
+	for (Eigen::Index i0 = 0; i0 < data.cols(); i0 += chunk_size) {
+		mbkm.partial_fit(data.middleCols(i0, chunk_size));
+		ASSERT_EQ(static_cast<size_t>(chunk_size), mbkm.labels().size());
+	}
+	check_centroids(mbkm.centroids(), 0.05);
+	ASSERT_EQ(static_cast<double>(data.cols()), mbkm.counts().sum());
+	ml::Clustering::MiniBatchKMeans mbkm_one_chunk(4, 100);
+	mbkm_one_chunk.set_seed(5);
+	mbkm_one_chunk.partial_fit(data.leftCols(chunk_size));
+	ASSERT_THROW(mbkm_one_chunk.partial_fit(Eigen::MatrixXd::Zero(2, 10)), std::invalid_argument);
+	mbkm_one_chunk.reset();
+	ASSERT_EQ(0, mbkm_one_chunk.counts().size());
+	ASSERT_THROW(mbkm_one_chunk.partial_fit(data.leftCols(3)), std::invalid_argument);
+	mbkm_one_chunk.partial_fit(Eigen::MatrixXd::Zero(2, 10));
+	ASSERT_EQ(2, mbkm_one_chunk.centroids().rows());
+}
+
+TEST_F(MiniBatchKMeansTest, errors)
+{
+	ASSERT_THROW(ml::Clustering::MiniBatchKMeans(0), std::invalid_argument);
+	ASSERT_THROW(ml::Clustering::MiniBatchKMeans(2, 0), std::invalid_argument);
+	ml::Clustering::MiniBatchKMeans mbkm(2);
+	ASSERT_THROW(mbkm.set_absolute_tolerance(-1), std::domain_error);
+	ASSERT_THROW(mbkm.set_maximum_steps(1), std::invalid_argument);
+	ASSERT_THROW(mbkm.set_number_initialisations(0), std::invalid_argument);
+	ASSERT_THROW(mbkm.set_centroids_initialiser(nullptr), std::invalid_argument);
+}
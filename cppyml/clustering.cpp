@@ -94,6 +94,10 @@ void init_clustering(py::module& m)
         .def(py::init<>())
         .doc() = "KMeans++ initialisation algorithm.";
 
+    py::class_<ml::Clustering::ScalableKPP, std::shared_ptr<ml::Clustering::ScalableKPP>, ml::Clustering::CentroidsInitialiser>(m_clustering, "ScalableKPP")
+        .def(py::init<double, unsigned int, unsigned int>(), py::arg("oversampling_factor") = 2., py::arg("number_rounds") = 2u, py::arg("number_threads") = 1u)
+        .doc() = "Scalable KMeans++ (KMeans||) initialisation algorithm.";
+
     py::class_<ml::Clustering::ClosestCentroid, std::shared_ptr<ml::Clustering::ClosestCentroid>, ml::Clustering::ResponsibilitiesInitialiser>(m_clustering, "ClosestCentroid")
         .def(py::init<std::shared_ptr<ml::Clustering::CentroidsInitialiser>>(), py::arg("centroids_initialiser"))
         .doc() = "Assigns points to closest centroid.";